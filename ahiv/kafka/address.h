@@ -4,11 +4,13 @@
 #ifndef AHIV_KAFKA_ADDRESS_H
 #define AHIV_KAFKA_ADDRESS_H
 
+#include <cstring>
 #include <memory>
 #include <string>
 #include <iostream>
 
 #include "ahiv/kafka/event.h"
+#include "ahiv/kafka/internal/dnscache.h"
 #include "uvw.hpp"
 
 namespace ahiv::kafka {
@@ -17,7 +19,18 @@ class Address : public uvw::Emitter<Address> {
   Address(const std::string hostname, const std::string port)
       : hostname(hostname), port(port) {}
 
+  // Resolve looks up all addresses of the hostname. Results are served from
+  // the shared DNS cache when a non expired entry exists, otherwise the
+  // resolver is asked and the result is cached for other configs of the same
+  // host
   void Resolve(const std::shared_ptr<uvw::Loop>& loop) {
+    auto cached = internal::DNSCache::Shared().Lookup(this->hostname, this->port);
+    if (cached != nullptr) {
+      this->resolvedAddresses = cached;
+      this->publish(ResolvedEvent{});
+      return;
+    }
+
     auto request = loop->resource<uvw::GetAddrInfoReq>();
     request->on<uvw::ErrorEvent>(
         [this](const uvw::ErrorEvent& errorEvent, auto&) {
@@ -28,14 +41,40 @@ class Address : public uvw::Emitter<Address> {
 
     request->on<uvw::AddrInfoEvent>(
         [this](const uvw::AddrInfoEvent& addrInfoEvent, auto&) {
-          this->resolvedAddress = addrInfoEvent.data->ai_addr;
+          internal::ResolvedAddresses addresses;
+          for (const addrinfo* info = addrInfoEvent.data.get(); info != nullptr;
+               info = info->ai_next) {
+            if (info->ai_addr == nullptr ||
+                info->ai_addrlen > sizeof(sockaddr_storage)) {
+              continue;
+            }
+
+            sockaddr_storage address{};
+            std::memcpy(&address, info->ai_addr, info->ai_addrlen);
+            addresses.emplace_back(address);
+          }
+
+          this->resolvedAddresses = internal::DNSCache::Shared().Store(
+              this->hostname, this->port,
+              internal::InterleaveAddressFamilies(addresses));
           this->publish(ResolvedEvent{});
         });
 
-    request->addrInfo(this->hostname, this->port);
+    // Only ask for stream sockets, otherwise every address is reported once
+    // per socket type
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    request->addrInfo(this->hostname, this->port, &hints);
+  }
+
+  // Invalidate drops the cached addresses of this host, so that the next
+  // Resolve asks the resolver again
+  void Invalidate() {
+    internal::DNSCache::Shared().Invalidate(this->hostname, this->port);
   }
 
-  sockaddr* resolvedAddress;
+  std::shared_ptr<const internal::ResolvedAddresses> resolvedAddresses;
   const std::string hostname;
   const std::string port;
 };
@@ -0,0 +1,43 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_BATCH_H
+#define AHIV_KAFKA_BATCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+
+namespace ahiv::kafka {
+using RecordView = protocol::packet::RecordView;
+
+// BatchOptions controls how consumed records are grouped before they are
+// handed to the application.
+struct BatchOptions {
+  // MaxRecords is the highest amount of records in a single batch.
+  std::size_t MaxRecords = 500;
+  // MaxWait is the longest time records wait for a batch to fill up.
+  std::chrono::milliseconds MaxWait{10};
+};
+
+// PartitionBatch is a run of consecutive records of a single partition.
+struct PartitionBatch {
+  std::string Topic;
+  int32_t Partition;
+  int64_t FirstOffset;
+  int64_t LastOffset;
+  // HighWatermark is the high watermark of the partition when the records
+  // were fetched.
+  int64_t HighWatermark;
+  // Records point into fetched memory, which is kept alive by Storage for as
+  // long as the batch lives.
+  std::vector<RecordView> Records;
+  std::vector<std::shared_ptr<const void>> Storage;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_BATCH_H
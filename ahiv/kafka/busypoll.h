@@ -0,0 +1,91 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_BUSYPOLL_H
+#define AHIV_KAFKA_BUSYPOLL_H
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <chrono>
+#include <memory>
+
+#include "ahiv/kafka/internal/loopactivity.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka {
+// BusyPollLoop runs a loop without ever waiting in the kernel for events:
+// every iteration polls the sockets with UV_RUN_NOWAIT and starts over right
+// away, which saves the wakeup latency at the price of a core spinning at
+// full load. Pair it with Connection::UseLowLatency. The iterations and the
+// time which found broker I/O or only spun are reported as LoopStats in the
+// StatsEvent of every client on the loop
+class BusyPollLoop {
+ public:
+  explicit BusyPollLoop(std::shared_ptr<uvw::Loop> loop)
+      : loop(std::move(loop)),
+        activity(internal::LoopActivity::Of(this->loop)) {}
+
+  // Run pins the calling thread to the CPU, unless it is negative, and spins
+  // the loop until it has nothing left to do, Stop has been called or
+  // uvw::Loop::stop has been called from a callback. Returns false without
+  // running the loop when the thread could not be pinned
+  bool Run(int cpu = -1) {
+    if (cpu >= 0 && !pin(cpu)) {
+      return false;
+    }
+
+    // stop only interrupts the current iteration, the check handle sees the
+    // flag before the iteration ends and ends the spinning
+    auto check = this->loop->resource<uvw::CheckHandle>();
+    check->on<uvw::CheckEvent>(
+        [this](const uvw::CheckEvent&, uvw::CheckHandle&) {
+          if (this->loop->raw()->stop_flag != 0) {
+            this->stopped = true;
+          }
+        });
+    check->start();
+    check->unreference();
+
+    this->stopped = false;
+    auto last = std::chrono::steady_clock::now();
+    while (!this->stopped && this->loop->alive()) {
+      uint64_t events = this->activity->Events();
+      this->loop->run<uvw::Loop::Mode::NOWAIT>();
+
+      auto now = std::chrono::steady_clock::now();
+      this->activity->RecordIteration(this->activity->Events() != events,
+                                      now - last);
+      last = now;
+    }
+
+    check->close();
+    return true;
+  }
+
+  // Stop ends Run after the current iteration, call it from the loop thread
+  void Stop() { this->stopped = true; }
+
+  LoopStats Stats() const { return this->activity->Stats(); }
+
+ private:
+  static bool pin(int cpu) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+  }
+
+  std::shared_ptr<uvw::Loop> loop;
+  std::shared_ptr<internal::LoopActivity> activity;
+  bool stopped = false;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_BUSYPOLL_H
@@ -4,6 +4,7 @@
 #ifndef AHIV_KAFKA_CONNECTION_H
 #define AHIV_KAFKA_CONNECTION_H
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
 #include <iostream>
@@ -13,21 +14,35 @@
 #include <string>
 
 #include "ahiv/kafka/connectionconfig.h"
+#include "ahiv/kafka/coroutine.h"
 #include "ahiv/kafka/error.h"
 #include "ahiv/kafka/event.h"
 #include "ahiv/kafka/internal/errorcodes.h"
+#include "ahiv/kafka/internal/loopactivity.h"
+#include "ahiv/kafka/internal/memorybudget.h"
+#include "ahiv/kafka/internal/snapshot.h"
 #include "ahiv/kafka/internal/tcpconnection.h"
+#include "ahiv/kafka/internal/timerwheel.h"
+#include "ahiv/kafka/lowlatencyconfig.h"
+#include "ahiv/kafka/stats.h"
+#include "ahiv/kafka/tlsconfig.h"
 #include "ahiv/kafka/util.h"
 #include "uvw.hpp"
 
 namespace ahiv::kafka {
+// SnapshotSaveInterval is the longest time positions stored for the warm
+// start wait before they are written to the snapshot file
+const std::chrono::milliseconds SnapshotSaveInterval{5000};
+
 class Connection : public uvw::Emitter<Connection> {
  public:
   // Bootstrap connects to at least one of the servers given in the set. Every
-  // server must have a protocol prefixed, currently plaintext:// is the only
-  // supported connection protocol. If there is no server available an error
-  // will be published to the error callback containing the
-  // Error.NoValidBootstrapServerGiven code
+  // server must have a protocol prefixed, plaintext://, unix:///path or, when
+  // built with TLS support, ssl://. Brokers discovered via metadata are
+  // connected with the protocol of the bootstrap servers. A unix:// server is
+  // a local proxy, it has to advertise its brokers with their socket path as
+  // host. If there is no server available an error will be published to the
+  // error callback containing the Error.NoValidBootstrapServerGiven code
   //
   // After connecting to a bootstrap server, the cluster metadata state is asked
   // for, to discover more brokers and connect to them async. Once a full
@@ -39,9 +54,186 @@ class Connection : public uvw::Emitter<Connection> {
       this->publish(ErrorEvent{
           .Reason = "No valid server for bootstrapping has been found",
           .Error = Error::NoValidBootstrapServerGiven});
+      return;
     }
 
+    this->bootstrapStartedAt = std::chrono::steady_clock::now();
     this->connectToServers(bootstrapServers);
+    this->warmStart();
+  }
+
+  // WarmStartFrom loads the snapshot written by an earlier run from the given
+  // path and keeps it up to date with every metadata response. Call it before
+  // Bootstrap: the brokers of a valid snapshot are connected in parallel to
+  // the bootstrap servers and its topics are published right away, the real
+  // metadata reconciles them once it arrived. Stored positions are written
+  // every SnapshotSaveInterval and on Close
+  void WarmStartFrom(const std::string& snapshotPath) {
+    this->snapshotPath = snapshotPath;
+    this->snapshot = internal::WarmStartSnapshot::Load(snapshotPath);
+  }
+
+  // WarmStartPosition returns the position of the partition stored in the
+  // snapshot, -1 when there is none
+  int64_t WarmStartPosition(const std::string& topic,
+                            int32_t partitionIndex) const {
+    return this->snapshot.has_value()
+               ? this->snapshot->Position(topic, partitionIndex)
+               : -1;
+  }
+
+#ifdef AHIV_KAFKA_TLS
+  // UseTLS configures the TLS sessions of ssl:// brokers, call it before
+  // Bootstrap. Without it brokers are verified against the default CA
+  // locations of the system. Returns false if the certificates of the config
+  // could not be loaded
+  bool UseTLS(const TLSConfig& config) {
+    this->tlsContext = internal::TLSContext::Create(config);
+    return this->tlsContext != nullptr;
+  }
+#endif
+
+  // UseIOBackend selects what moves the bytes of plaintext broker
+  // connections, call it before Bootstrap. ssl:// connections always use
+  // their TLS session. Returns false, keeping libuv, if the backend is not
+  // available in this build or on this kernel
+  bool UseIOBackend(IOBackend ioBackend) {
+    if (ioBackend == IOBackend::IOUring) {
+#ifdef AHIV_KAFKA_IO_URING
+      this->ioUring = internal::LoopIOUring::Of(this->loop);
+      if (this->ioUring == nullptr) {
+        return false;
+      }
+#else
+      return false;
+#endif
+    }
+
+    this->ioBackend = ioBackend;
+    return true;
+  }
+
+  // UseLowLatency tunes the sockets of all broker connections for latency,
+  // call it before Bootstrap. Producers and consumers also stop holding
+  // records back for batching. Run the loop with a BusyPollLoop to avoid the
+  // wakeup latency as well
+  void UseLowLatency(const LowLatencyConfig& config = LowLatencyConfig{}) {
+    this->lowLatency = config;
+  }
+
+  // StartupTiming returns the breakdown of the bootstrap phases. Fields are
+  // zero until the phase has been reached
+  const StartupEvent& StartupTiming() const { return this->startupTiming; }
+
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+  // Request sends the request to the connection which connected first when
+  // awaited, the awaiting coroutine is resumed with the decoded response:
+  //
+  //   auto response = co_await connection.Request<MetadataPacket>(request);
+  //
+  // The response is empty when no connection has been established yet
+  template <typename Message>
+  RequestAwaitable<Message, internal::TCPConnection> Request(
+      typename Message::Request request) {
+    return RequestAwaitable<Message, internal::TCPConnection>(
+        this->firstConnected(), std::move(request));
+  }
+#endif
+
+  // EnableStats publishes a StatsEvent every interval. Stats are always
+  // recorded, this only controls the periodic event
+  void EnableStats(std::chrono::milliseconds interval) {
+    if (this->statsTimer == nullptr) {
+      this->statsTimer = this->loop->resource<uvw::TimerHandle>();
+      this->statsTimer->on<uvw::TimerEvent>(
+          [this](const uvw::TimerEvent&, auto&) {
+            this->publish(this->Stats());
+          });
+    }
+
+    this->statsTimer->start(interval, interval);
+  }
+
+  // DisableStats stops the periodic StatsEvent
+  void DisableStats() {
+    if (this->statsTimer != nullptr) {
+      this->statsTimer->stop();
+    }
+  }
+
+  // Stats returns a snapshot of the stats of every broker connection
+  StatsEvent Stats() const {
+    StatsEvent stats;
+    stats.Brokers.reserve(this->tcpHandles.size());
+    for (const auto& tcpConnection : this->tcpHandles) {
+      BrokerStats brokerStats{};
+      tcpConnection->Stats(brokerStats);
+      stats.Brokers.emplace_back(std::move(brokerStats));
+    }
+
+    if (this->activity->BusyPolled()) {
+      stats.Loop = this->activity->Stats();
+    }
+    if (this->statsExtension) {
+      this->statsExtension(stats);
+    }
+    return stats;
+  }
+
+  // CaptureFrames appends the raw request and response frames of all broker
+  // connections to the file at path, for replaying them through the decoders
+  // later (see benchmark/replay.cpp). Returns false if the file could not be
+  // created
+  bool CaptureFrames(const std::string& path) {
+    this->frameCapture = internal::FrameCapture::Open(path);
+    for (const auto& tcpConnection : this->tcpHandles) {
+      tcpConnection->CaptureFrames(this->frameCapture);
+    }
+
+    return this->frameCapture != nullptr;
+  }
+
+  // StopCapture stops capturing frames and flushes the capture file
+  void StopCapture() {
+    for (const auto& tcpConnection : this->tcpHandles) {
+      tcpConnection->CaptureFrames(nullptr);
+    }
+    this->frameCapture.reset();
+  }
+
+  // StatsJSON returns the stats snapshot as JSON document
+  std::string StatsJSON() const { return ToJSON(this->Stats()); }
+
+  // SetMemoryBudget limits the bytes all broker connections may hold in
+  // request and response buffers. When the budget is exhausted requests are
+  // refused, reading is paused and a BackpressureEvent is published. Another
+  // one is published once the buffers have drained to three quarters of the
+  // budget. The budget is unlimited by default
+  void SetMemoryBudget(std::size_t bytes) {
+    this->memoryBudget->SetLimit(bytes);
+  }
+
+  // MemoryUsed returns the bytes currently accounted against the budget
+  std::size_t MemoryUsed() const { return this->memoryBudget->Used(); }
+
+  // Close writes the positions stored for the warm start and closes the
+  // connections to all brokers
+  void Close() {
+    if (this->snapshotDirty) {
+      this->saveSnapshot();
+    }
+    this->cancelTimer(this->metadataRetryTimer);
+    if (this->statsTimer != nullptr) {
+      this->statsTimer->close();
+      this->statsTimer = nullptr;
+    }
+
+    for (const auto& tcpConnection : this->tcpHandles) {
+      tcpConnection->Close();
+    }
+    this->tcpHandles.clear();
+    this->connectedHandles.clear();
+    this->tcpHandleByNodeId.clear();
   }
 
   // On registers a listener for the given event via the E template type. This
@@ -62,16 +254,85 @@ class Connection : public uvw::Emitter<Connection> {
  protected:
   // Init a new connection with the given loop. All actions are processed via
   // the given loop
-  Connection(std::shared_ptr<uvw::Loop>& loop) : loop(loop) {}
+  Connection(std::shared_ptr<uvw::Loop>& loop)
+      : activity(internal::LoopActivity::Of(loop)), loop(loop) {
+    this->memoryBudget->OnStateChange([this](bool blocked) {
+      if (!blocked) {
+        for (const auto& tcpConnection : this->tcpHandles) {
+          tcpConnection->ResumeReading();
+        }
+      }
 
-  // Send the given buffer to the first connection, if there is one
-  template <typename Message>
-  void SendToFirstConnection(
-      typename Message::Request&& request,
-      ahiv::kafka::ResponseCallback<typename Message::Response> responseCallback) {
-    if (this->tcpHandles.size() > 0) {
-      this->tcpHandles[0]->Send<Message>(request, responseCallback);
+      this->publish(BackpressureEvent{.Blocked = blocked,
+                                      .Used = this->memoryBudget->Used(),
+                                      .Limit = this->memoryBudget->Limit()});
+    });
+  }
+
+  ~Connection() {
+    this->cancelTimer(this->metadataRetryTimer);
+    this->cancelTimer(this->snapshotSaveTimer);
+  }
+
+  // Send the given request to the connection which connected first, if
+  // there is one. Bootstrap servers are connected concurrently so this is
+  // whichever broker answered fastest and is not throttled. Returns false
+  // when the request would block, because there is no connection or the
+  // memory budget is exhausted. The failure callback is called when the
+  // request times out, see TCPConnection::Send
+  template <typename Message, typename Callback,
+            typename FailureCallback = internal::IgnoreFailure>
+  bool SendToFirstConnection(
+      typename Message::Request&& request, Callback&& responseCallback,
+      FailureCallback&& failureCallback = FailureCallback{}) {
+    auto tcpConnection = this->firstConnected();
+    if (tcpConnection == nullptr) {
+      return false;
+    }
+
+    return tcpConnection->template Send<Message>(
+        request, std::forward<Callback>(responseCallback),
+        std::forward<FailureCallback>(failureCallback));
+  }
+
+  // SendToBroker sends the request to the broker with the given node id.
+  // Returns false when the broker is not connected or the request would block
+  template <typename Message, typename Callback,
+            typename FailureCallback = internal::IgnoreFailure>
+  bool SendToBroker(int32_t nodeId, typename Message::Request&& request,
+                    Callback&& responseCallback,
+                    FailureCallback&& failureCallback = FailureCallback{}) {
+    auto tcpConnection = this->tcpHandleByNodeId.find(nodeId);
+    if (tcpConnection == this->tcpHandleByNodeId.end() ||
+        !tcpConnection->second->IsConnected()) {
+      return false;
+    }
+
+    return tcpConnection->second->template Send<Message>(
+        request, std::forward<Callback>(responseCallback),
+        std::forward<FailureCallback>(failureCallback));
+  }
+
+  // firstConnected returns the connection which connected first and is still
+  // open, or nullptr if there is none. Requests which any broker can answer
+  // go through here, so connections the broker throttles are skipped as long
+  // as there is one which is not throttled
+  std::shared_ptr<internal::TCPConnection> firstConnected() const {
+    std::shared_ptr<internal::TCPConnection> throttled;
+    for (const auto& tcpConnection : this->connectedHandles) {
+      if (!tcpConnection->IsConnected()) {
+        continue;
+      }
+
+      if (!tcpConnection->IsThrottled()) {
+        return tcpConnection;
+      }
+      if (throttled == nullptr) {
+        throttled = tcpConnection;
+      }
     }
+
+    return throttled;
   }
 
   void requestMetadataForTopics(std::vector<std::string>& wantedTopics,
@@ -79,21 +340,79 @@ class Connection : public uvw::Emitter<Connection> {
     this->requestMetadataForTopicsWithRetry(wantedTopics, autoCreate, 0);
   }
 
+  // timers returns the timer wheel of the loop, which is shared by all
+  // connections on it
+  const std::shared_ptr<internal::LoopTimerWheel>& timers() {
+    if (this->timerWheel == nullptr) {
+      this->timerWheel = internal::LoopTimerWheel::Of(this->loop);
+    }
+
+    return this->timerWheel;
+  }
+
+  // cancelTimer cancels a timer of the shared wheel. Timers calling back into
+  // the client have to be cancelled when it is closed or destroyed, the wheel
+  // may outlive it
+  void cancelTimer(internal::TimerId& timer) {
+    if (this->timerWheel != nullptr) {
+      this->timerWheel->Cancel(timer);
+    }
+    timer = internal::TimerId{};
+  }
+
+  // extendStats registers a function which adds the stats of a client kind to
+  // every snapshot
+  void extendStats(std::function<void(StatsEvent&)> extension) {
+    this->statsExtension = std::move(extension);
+  }
+
+  // storePosition records the position of a partition for the next warm
+  // start, it is written within SnapshotSaveInterval
+  void storePosition(const std::string& topic, int32_t partitionIndex,
+                     int64_t position) {
+    if (!this->snapshot.has_value()) {
+      return;
+    }
+
+    this->snapshot->SetPosition(topic, partitionIndex, position);
+    if (!this->snapshotDirty) {
+      this->snapshotDirty = true;
+      this->snapshotSaveTimer = this->timers()->Schedule(
+          SnapshotSaveInterval, [this] { this->saveSnapshot(); });
+    }
+  }
+
  private:
   void requestMetadataForTopicsWithRetry(std::vector<std::string>& wantedTopics,
                                          bool autoCreate, int8_t retries) {
-    this->SendToFirstConnection<protocol::packet::MetadataPacket>(
+    bool sent = this->SendToFirstConnection<protocol::packet::MetadataPacket>(
         protocol::packet::MetadataRequestPacket(wantedTopics, autoCreate, false,
                                                 false),
-        [this, &wantedTopics, &retries,
+        [this, &wantedTopics, retries,
          autoCreate](protocol::packet::MetadataResponsePacket& response) {
+          this->markStartupPhase(this->startupTiming.FirstMetadata);
+          this->reconcileWarmStart(response);
+          this->publish(
+              UpdateBrokerInformationEvent{.brokers = response.brokers});
+
           for (const auto& broker : response.brokers) {
             auto tcpConnection = this->consumeFromMetadata(broker);
             if (tcpConnection != nullptr) {
               this->connectionInfoByNodeId.insert(std::make_pair(
                   broker.nodeId, tcpConnection->connectionConfig));
+            } else {
+              this->connectToBroker(broker);
+            }
+          }
+
+          for (const auto& topic : response.topicInformation) {
+            for (const auto& partition : topic.partitionInformation) {
+              if (partition.leaderId >= 0) {
+                this->leaderIds.insert(partition.leaderId);
+              }
             }
           }
+          this->checkLeadersConnected();
 
           bool retrying = false;
           for (const auto& topic : response.topicInformation) {
@@ -102,31 +421,139 @@ class Connection : public uvw::Emitter<Connection> {
                       (internal::ErrorCode)topic.errorCode) &&
                   !retrying && retries < 25) {
                 retrying = true;
-                auto retryTimerHandle =
-                    this->loop->resource<uvw::TimerHandle>();
-                retryTimerHandle->on<uvw::TimerEvent>(
-                    [this, &wantedTopics, autoCreate, &retries](const auto&,
-                                                                auto& handle) {
-                      this->requestMetadataForTopicsWithRetry(
-                          wantedTopics, autoCreate, retries++);
-                    });
-
-                retryTimerHandle->start(
-                    uvw::TimerHandle::Time{(retries + 1) * 100},
-                    uvw::TimerHandle::Time{0});
+                this->scheduleMetadataRetry(wantedTopics, autoCreate,
+                                            retries);
               }
             } else {
               this->publish(
                   UpdateTopicInformationEvent{.topicInformation = topic});
             }
           }
+        },
+        [this, &wantedTopics, retries, autoCreate](Error) {
+          this->scheduleMetadataRetry(wantedTopics, autoCreate, retries);
+        });
+    if (!sent) {
+      this->scheduleMetadataRetry(wantedTopics, autoCreate, retries);
+    }
+  }
+
+  // scheduleMetadataRetry requests the metadata again after a backoff which
+  // grows with every retry, up to 25 retries
+  void scheduleMetadataRetry(std::vector<std::string>& wantedTopics,
+                             bool autoCreate, int8_t retries) {
+    if (retries >= 25) {
+      return;
+    }
+
+    this->cancelTimer(this->metadataRetryTimer);
+    this->metadataRetryTimer = this->timers()->Schedule(
+        std::chrono::milliseconds{(retries + 1) * 100},
+        [this, &wantedTopics, autoCreate, retries] {
+          this->metadataRetryTimer = internal::TimerId{};
+          this->requestMetadataForTopicsWithRetry(wantedTopics, autoCreate,
+                                                  retries + 1);
         });
   }
 
+  // warmStart connects to the brokers of the snapshot and publishes its
+  // topics, so work can start before the first metadata response
+  void warmStart() {
+    if (!this->snapshot.has_value()) {
+      return;
+    }
+
+    for (const auto& broker : this->snapshot->brokers) {
+      this->connectToBroker(broker);
+    }
+    this->publish(
+        UpdateBrokerInformationEvent{.brokers = this->snapshot->brokers});
+
+    for (const auto& topic : this->snapshot->topics) {
+      for (const auto& partition : topic.partitions) {
+        if (partition.leaderId >= 0) {
+          this->leaderIds.insert(partition.leaderId);
+        }
+      }
+
+      this->publish(UpdateTopicInformationEvent{
+          .topicInformation =
+              internal::WarmStartSnapshot::ToTopicInformation(topic)});
+    }
+  }
+
+  // reconcileWarmStart replaces the snapshot with the metadata response.
+  // Connections to brokers of the snapshot which are no longer part of the
+  // cluster are closed, leaders are recollected from the response
+  void reconcileWarmStart(
+      const protocol::packet::MetadataResponsePacket& response) {
+    if (this->snapshotPath.empty()) {
+      return;
+    }
+
+    if (this->snapshot.has_value()) {
+      for (const auto& broker : this->snapshot->brokers) {
+        bool known = std::any_of(
+            response.brokers.begin(), response.brokers.end(),
+            [&broker](const auto& current) {
+              return current.nodeId == broker.nodeId &&
+                     current.host == broker.host && current.port == broker.port;
+            });
+        if (!known) {
+          this->forgetBroker(broker.nodeId);
+        }
+      }
+
+      if (!this->reconciled) {
+        this->leaderIds.clear();
+      }
+    }
+
+    this->reconciled = true;
+    auto previous = std::move(this->snapshot);
+    this->snapshot = internal::WarmStartSnapshot::FromMetadata(
+        response, previous.has_value() ? &*previous : nullptr);
+    this->saveSnapshot();
+  }
+
+  // saveSnapshot writes the snapshot with all positions stored so far
+  void saveSnapshot() {
+    this->timers()->Cancel(this->snapshotSaveTimer);
+    this->snapshotDirty = false;
+    if (this->snapshot.has_value() && !this->snapshotPath.empty()) {
+      this->snapshot->Save(this->snapshotPath);
+    }
+  }
+
+  // forgetBroker closes the connection to a broker which left the cluster
+  void forgetBroker(int32_t nodeId) {
+    auto known = this->tcpHandleByNodeId.find(nodeId);
+    if (known == this->tcpHandleByNodeId.end()) {
+      return;
+    }
+
+    auto tcpConnection = known->second;
+    tcpConnection->Close();
+    this->tcpHandleByNodeId.erase(known);
+    this->connectionInfoByNodeId.erase(nodeId);
+    this->tcpHandles.erase(std::remove(this->tcpHandles.begin(),
+                                       this->tcpHandles.end(), tcpConnection),
+                           this->tcpHandles.end());
+    this->connectedHandles.erase(
+        std::remove(this->connectedHandles.begin(),
+                    this->connectedHandles.end(), tcpConnection),
+        this->connectedHandles.end());
+  }
+
   // consumeFromMetadata tells the tcp connections to grab their broker id if
   // they don't know them yet and stores the broker id in a map for lookup
   std::shared_ptr<internal::TCPConnection> consumeFromMetadata(
       const protocol::packet::BrokerNodeInformation& brokerNodeInformation) {
+    auto known = this->tcpHandleByNodeId.find(brokerNodeInformation.nodeId);
+    if (known != this->tcpHandleByNodeId.end()) {
+      return known->second;
+    }
+
     for (const auto& tcpConnection : this->tcpHandles) {
       if (tcpConnection->ConsumeFromMetadata(brokerNodeInformation)) {
         this->tcpHandleByNodeId.insert(
@@ -138,36 +565,159 @@ class Connection : public uvw::Emitter<Connection> {
     return nullptr;
   }
 
+  // connectToBroker connects to a broker which has been discovered via
+  // metadata and has no connection yet
+  void connectToBroker(
+      const protocol::packet::BrokerNodeInformation& brokerNodeInformation) {
+    if (!this->pendingNodeIds.insert(brokerNodeInformation.nodeId).second) {
+      return;
+    }
+
+    std::string server = ConnectionURLPrefix(this->brokerConnectionType)
+                             .append(brokerNodeInformation.host);
+    if (this->brokerConnectionType != ConnectionType::Unix) {
+      server.append(":").append(std::to_string(brokerNodeInformation.port));
+    }
+    this->connectToServer(server, brokerNodeInformation);
+  }
+
   // connectToServerViaTCP takes in the resolved connection config and connects
-  // a TCP socket to the resolved IP:Port
+  // a TCP socket to the resolved IP:Port, or the pipe of a unix:// config to
+  // its path
   void connectToServerViaTCP(
-      const std::shared_ptr<ConnectionConfig>& connectionConfig) {
+      const std::shared_ptr<ConnectionConfig>& connectionConfig,
+      const std::optional<protocol::packet::BrokerNodeInformation>& broker) {
     auto tcpConnection =
-        std::make_shared<internal::TCPConnection>(this->loop, connectionConfig);
+        std::make_shared<internal::TCPConnection>(this->loop, connectionConfig,
+                                                  this->memoryBudget);
+    tcpConnection->CaptureFrames(this->frameCapture);
+    tcpConnection->On<ErrorEvent>(
+        [this](const ErrorEvent& event, auto&) { this->publish(event); });
     tcpConnection->On<ConnectedEvent>(
-        [this](const ConnectedEvent& event, auto&) { this->publish(event); });
+        [this, tcpConnection](const ConnectedEvent& event, auto&) {
+          this->markStartupPhase(this->startupTiming.TCPConnected);
+          this->connectedHandles.emplace_back(tcpConnection);
+          this->publish(event);
+          this->checkLeadersConnected();
+        });
     tcpHandles.emplace_back(tcpConnection);
+
+    if (broker.has_value()) {
+      tcpConnection->ConsumeFromMetadata(*broker);
+      this->tcpHandleByNodeId.insert(
+          std::make_pair(broker->nodeId, tcpConnection));
+      this->connectionInfoByNodeId.insert(
+          std::make_pair(broker->nodeId, connectionConfig));
+      this->pendingNodeIds.erase(broker->nodeId);
+    }
   }
 
   // connectToServer parses the server address and connects to the given IP or
-  // hostname via TCP
-  void connectToServer(const std::string& server) {
+  // hostname via TCP. When the server has been discovered via metadata its
+  // broker information is given, otherwise it is a bootstrap server
+  void connectToServer(
+      const std::string& server,
+      const std::optional<protocol::packet::BrokerNodeInformation>& broker =
+          std::nullopt) {
     auto config = ConnectionConfig::ParseFromConnectionURL(server);
+    config->ioBackend = this->ioBackend;
+    config->lowLatency = this->lowLatency;
+#ifdef AHIV_KAFKA_TLS
+    if (config->connectionType == ConnectionType::SSL) {
+      if (this->tlsContext == nullptr && !this->UseTLS(TLSConfig{})) {
+        this->publish(ErrorEvent{
+            .Reason = std::string("Could not set up TLS: ")
+                          .append(internal::TLSErrorString()),
+            .Error = Error::TLSConfigurationInvalid});
+        if (broker.has_value()) {
+          this->pendingNodeIds.erase(broker->nodeId);
+        }
+        return;
+      }
+      config->tlsContext = this->tlsContext;
+    }
+#endif
+    if (config->connectionType == ConnectionType::Unix) {
+      this->connectToServerViaTCP(config, broker);
+      return;
+    }
+
     config->address->on<ahiv::kafka::ErrorEvent>(
-        [this](const ahiv::kafka::ErrorEvent& errorEvent, auto& emitter) {
+        [this, broker](const ahiv::kafka::ErrorEvent& errorEvent,
+                       auto& emitter) {
+          // the broker may be connected again with the next metadata
+          if (broker.has_value()) {
+            this->pendingNodeIds.erase(broker->nodeId);
+          }
           this->publish(errorEvent);
         });
     config->address->on<ahiv::kafka::ResolvedEvent>(
-        [this, config](const ahiv::kafka::ResolvedEvent& resolvedEvent,
-                       auto& emitter) { this->connectToServerViaTCP(config); });
+        [this, config, broker](const ahiv::kafka::ResolvedEvent& resolvedEvent,
+                               auto& emitter) {
+          this->markStartupPhase(this->startupTiming.DNSResolved);
+          this->connectToServerViaTCP(config, broker);
+        });
     config->address->Resolve(this->loop);
   }
 
+  // checkLeadersConnected finishes the startup once every known partition
+  // leader is connected. Bootstrap connections which did not turn out to be
+  // one of the brokers are closed at this point
+  void checkLeadersConnected() {
+    if (this->startupCompleted || this->leaderIds.empty()) {
+      return;
+    }
+
+    for (const auto& leaderId : this->leaderIds) {
+      auto tcpConnection = this->tcpHandleByNodeId.find(leaderId);
+      if (tcpConnection == this->tcpHandleByNodeId.end() ||
+          !tcpConnection->second->IsConnected()) {
+        return;
+      }
+    }
+
+    this->startupCompleted = true;
+    this->closeUnmatchedConnections();
+    this->markStartupPhase(this->startupTiming.AllLeadersConnected);
+    this->publish(this->startupTiming);
+  }
+
+  // closeUnmatchedConnections closes connections which could not be matched
+  // to a broker id, for example bootstrap servers given via a load balancer
+  void closeUnmatchedConnections() {
+    auto unmatched = [](const std::shared_ptr<internal::TCPConnection>& conn) {
+      return !conn->HasBrokerId();
+    };
+
+    for (const auto& tcpConnection : this->tcpHandles) {
+      if (unmatched(tcpConnection)) {
+        tcpConnection->Close();
+      }
+    }
+
+    this->tcpHandles.erase(std::remove_if(this->tcpHandles.begin(),
+                                          this->tcpHandles.end(), unmatched),
+                           this->tcpHandles.end());
+    this->connectedHandles.erase(
+        std::remove_if(this->connectedHandles.begin(),
+                       this->connectedHandles.end(), unmatched),
+        this->connectedHandles.end());
+  }
+
+  // markStartupPhase stores the time since bootstrap in the given phase, if
+  // it has not been reached before
+  void markStartupPhase(std::chrono::steady_clock::duration& phase) {
+    if (phase == std::chrono::steady_clock::duration::zero()) {
+      phase = std::chrono::steady_clock::now() - this->bootstrapStartedAt;
+    }
+  }
+
   // connectToServers looks for all servers in the set and connects to valid
   // ones
   void connectToServers(const std::set<std::string>& servers) {
     for (const auto& server : servers) {
       if (this->canBeUsedForConnecting(server)) {
+        this->brokerConnectionType = *ConnectionTypeOf(server);
         this->connectToServer(server);
       }
     }
@@ -176,7 +726,13 @@ class Connection : public uvw::Emitter<Connection> {
   // canBeUsedForConnecting checks if the given server address can be used to
   // connect to a broker
   bool canBeUsedForConnecting(const std::string& bootstrapServer) {
-    return bootstrapServer.find("plaintext://") == 0;
+    auto connectionType = ConnectionTypeOf(bootstrapServer);
+#ifndef AHIV_KAFKA_TLS
+    if (connectionType == ConnectionType::SSL) {
+      return false;
+    }
+#endif
+    return connectionType.has_value();
   }
 
   // canAtLeasOneBeUsedForConnecting checks if the given set can be used for
@@ -193,8 +749,36 @@ class Connection : public uvw::Emitter<Connection> {
   }
 
   std::vector<std::shared_ptr<internal::TCPConnection>> tcpHandles;
+  std::vector<std::shared_ptr<internal::TCPConnection>> connectedHandles;
   std::map<int32_t, std::shared_ptr<internal::TCPConnection>> tcpHandleByNodeId;
+  std::set<int32_t> pendingNodeIds;
+  std::set<int32_t> leaderIds;
+  std::chrono::steady_clock::time_point bootstrapStartedAt;
+  StartupEvent startupTiming{};
+  std::shared_ptr<uvw::TimerHandle> statsTimer;
+  std::shared_ptr<internal::LoopTimerWheel> timerWheel;
+  std::shared_ptr<internal::FrameCapture> frameCapture;
+  std::function<void(StatsEvent&)> statsExtension;
+  std::shared_ptr<internal::MemoryBudget> memoryBudget =
+      std::make_shared<internal::MemoryBudget>();
+  bool startupCompleted = false;
+  std::string snapshotPath;
+  std::optional<internal::WarmStartSnapshot> snapshot;
+  internal::TimerId snapshotSaveTimer;
+  internal::TimerId metadataRetryTimer;
+  bool snapshotDirty = false;
+  bool reconciled = false;
   std::map<int32_t, std::shared_ptr<ConnectionConfig>> connectionInfoByNodeId;
+  ConnectionType brokerConnectionType = ConnectionType::Plaintext;
+  IOBackend ioBackend = IOBackend::Libuv;
+  std::optional<LowLatencyConfig> lowLatency;
+  std::shared_ptr<internal::LoopActivity> activity;
+#ifdef AHIV_KAFKA_TLS
+  std::shared_ptr<internal::TLSContext> tlsContext;
+#endif
+#ifdef AHIV_KAFKA_IO_URING
+  std::shared_ptr<internal::LoopIOUring> ioUring;
+#endif
   std::shared_ptr<uvw::Loop>& loop;
   std::vector<std::string> wantedTopics;
   bool autoCreate;
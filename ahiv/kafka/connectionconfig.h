@@ -4,26 +4,87 @@
 #ifndef AHIV_KAFKA_CONNECTIONCONFIG_H
 #define AHIV_KAFKA_CONNECTIONCONFIG_H
 
+#include <optional>
+#include <string>
+
 #include "ahiv/kafka/address.h"
 #include "ahiv/kafka/event.h"
+#include "ahiv/kafka/internal/iouring.h"
+#include "ahiv/kafka/internal/tlssession.h"
+#include "ahiv/kafka/lowlatencyconfig.h"
 #include "uvw.hpp"
 
 namespace ahiv::kafka {
 const std::size_t PlaintextLength = 12;
+const std::size_t SSLLength = 6;
+const std::size_t UnixLength = 7;
+
+enum class ConnectionType { Plaintext, SSL, Unix };
+
+// IOBackend is what moves the bytes of plaintext connections: the libuv
+// stream of the handle, or io_uring when built with AHIV_KAFKA_IO_URING
+enum class IOBackend { Libuv, IOUring };
 
-enum class ConnectionType { Plaintext };
+// ConnectionTypeOf returns the connection type of the URL prefix, nullopt
+// when the prefix is unknown
+inline std::optional<ConnectionType> ConnectionTypeOf(const std::string& url) {
+  if (url.compare(0, PlaintextLength, "plaintext://") == 0) {
+    return ConnectionType::Plaintext;
+  }
+  if (url.compare(0, SSLLength, "ssl://") == 0) {
+    return ConnectionType::SSL;
+  }
+  if (url.compare(0, UnixLength, "unix://") == 0) {
+    return ConnectionType::Unix;
+  }
+
+  return std::nullopt;
+}
+
+// ConnectionURLPrefix returns the URL prefix of the connection type
+inline std::string ConnectionURLPrefix(ConnectionType connectionType) {
+  switch (connectionType) {
+    case ConnectionType::SSL:
+      return "ssl://";
+    case ConnectionType::Unix:
+      return "unix://";
+    default:
+      return "plaintext://";
+  }
+}
 
 struct ConnectionConfig {
   Address* address;
   ConnectionType connectionType;
+  IOBackend ioBackend = IOBackend::Libuv;
+  // lowLatency holds the socket options of the low latency mode, if enabled
+  std::optional<LowLatencyConfig> lowLatency;
+#ifdef AHIV_KAFKA_TLS
+  // tlsContext is the context the sessions of ssl:// connections are created
+  // from
+  std::shared_ptr<internal::TLSContext> tlsContext;
+#endif
 
+  // ParseFromConnectionURL parses plaintext://host:port, ssl://host:port and
+  // unix:///path URLs. The address of unix:// URLs has the socket path as
+  // hostname and no port, it is never resolved
   static std::shared_ptr<ConnectionConfig> ParseFromConnectionURL(
       const std::string& url) {
-    std::string hostnameAndPort = url.substr(PlaintextLength);
+    ConnectionType connectionType =
+        ConnectionTypeOf(url).value_or(ConnectionType::Plaintext);
+    if (connectionType == ConnectionType::Unix) {
+      return std::make_shared<ConnectionConfig>(ConnectionConfig{
+        address : new Address(url.substr(UnixLength), ""),
+        connectionType : connectionType,
+      });
+    }
+
+    std::string hostnameAndPort = url.substr(
+        connectionType == ConnectionType::SSL ? SSLLength : PlaintextLength);
     std::string::size_type positionOfColon = hostnameAndPort.find(":");
     struct ConnectionConfig connectionConfig = {
       address : nullptr,
-      connectionType : ConnectionType::Plaintext,
+      connectionType : connectionType,
     };
 
     if (positionOfColon == std::string::npos) {
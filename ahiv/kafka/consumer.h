@@ -4,19 +4,40 @@
 #ifndef AHIV_KAFKA_CONSUMER_H
 #define AHIV_KAFKA_CONSUMER_H
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "ahiv/kafka/batch.h"
 #include "ahiv/kafka/connection.h"
+#include "ahiv/kafka/internal/batchaccumulator.h"
+#include "ahiv/kafka/internal/replicaselector.h"
 #include "ahiv/kafka/internal/topic.h"
+#include "ahiv/kafka/parallelexecutor.h"
+#include "ahiv/kafka/protocol/packet/fetch.h"
 #include "ahiv/kafka/protocol/packet/metadata.h"
 #include "uvw.hpp"
 
 namespace ahiv::kafka {
 class Consumer : public Connection {
  public:
-  Consumer(std::shared_ptr<uvw::Loop>& loop) : Connection(loop) {
+  Consumer(std::shared_ptr<uvw::Loop>& loop)
+      : Connection(loop),
+        loop(loop),
+        batchAccumulator(BatchOptions{}, [this](PartitionBatch& batch) {
+          this->deliverBatch(batch);
+        }) {
     this->Once<ConnectedEvent>([this](const ConnectedEvent& event, auto&) {
       this->requestMetadataForTopics(this->wantedTopics, this->autoCreate);
     });
 
+    this->On<UpdateBrokerInformationEvent>(
+        [this](const UpdateBrokerInformationEvent& event, auto&) {
+          this->replicaSelector.UpdateBrokers(event.brokers);
+        });
+
     this->On<UpdateTopicInformationEvent>([this](const UpdateTopicInformationEvent& event, auto&) {
       this->updateTopicInformation(event);
     });
@@ -35,15 +56,254 @@ class Consumer : public Connection {
   // nothing
   void AutoCreateTopics(bool value) { this->autoCreate = value; }
 
+  // ClientRack sets the rack of the client (client.rack). Partitions are
+  // fetched from an in-sync replica in the same rack when there is one, the
+  // brokers may point the client to another replica. It has to be set before
+  // bootstrapping the consumer
+  void ClientRack(const std::string& rack) {
+    this->replicaSelector.SetClientRack(rack);
+  }
+
+  // ServingReplica returns the node id of the replica the partition is
+  // fetched from, -1 if the partition is unknown
+  int32_t ServingReplica(const std::string& topic,
+                         int32_t partitionIndex) const {
+    return this->replicaSelector.ServingReplica(topic, partitionIndex);
+  }
+
+  // OnBatch registers the callback which receives consumed records, one call
+  // per PartitionBatch. Batches are delivered once they hold
+  // options.MaxRecords records or waited options.MaxWait
+  void OnBatch(std::function<void(PartitionBatch&)> callback,
+               BatchOptions options = BatchOptions{}) {
+    this->batchCallback = std::move(callback);
+    this->resetBatching(options);
+  }
+
+  // UseLowLatency tunes the broker sockets like Connection::UseLowLatency and
+  // delivers the records of every fetched partition right away, the MaxWait
+  // of the batch options is ignored from here on
+  void UseLowLatency(const LowLatencyConfig& config = LowLatencyConfig{}) {
+    Connection::UseLowLatency(config);
+    this->lowLatency = true;
+    this->resetBatching(this->batchAccumulator.Options());
+  }
+
+  // ProcessInParallel hands every batch to the executor instead of a batch
+  // callback. The processed offsets the executor reports are stored as the
+  // positions to resume from and published as ProcessedOffsetEvent, on the
+  // loop thread. The handle waking the loop for them keeps it alive until
+  // Close
+  void ProcessInParallel(std::shared_ptr<ParallelExecutor> executor,
+                         BatchOptions options = BatchOptions{}) {
+    this->closeProcessedSignal();
+    this->processedSignal = std::make_shared<ProcessedSignal>();
+    this->processedSignal->handle = this->loop->resource<uvw::AsyncHandle>();
+    this->processedSignal->handle->on<uvw::AsyncEvent>(
+        [this, executor](const uvw::AsyncEvent&, auto&) {
+          for (const auto& [partition, offset] : executor->TakeCommittable()) {
+            this->storePosition(partition.first, partition.second, offset);
+            this->publish(ProcessedOffsetEvent{.Topic = partition.first,
+                                               .Partition = partition.second,
+                                               .Offset = offset});
+          }
+        });
+    executor->OnCommittable([signal = this->processedSignal] {
+      std::lock_guard<std::mutex> lock(signal->mutex);
+      if (signal->handle != nullptr) {
+        signal->handle->send();
+      }
+    });
+
+    this->OnBatch(
+        [executor](PartitionBatch& batch) { executor->Submit(std::move(batch)); },
+        options);
+  }
+
+  ~Consumer() { this->cancelTimer(this->batchTimer); }
+
+  // Close stops waking the loop for processed offsets and delivering
+  // batches, and closes the connection like Connection::Close
+  void Close() {
+    this->closeProcessedSignal();
+    this->cancelTimer(this->batchTimer);
+    Connection::Close();
+  }
+
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+  // BatchAwaitable resumes the awaiting coroutine with the next batch
+  class BatchAwaitable {
+   public:
+    explicit BatchAwaitable(Consumer& consumer) : consumer(consumer) {}
+
+    bool await_ready() const noexcept {
+      return !this->consumer.readyBatches.empty();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      this->consumer.batchWaiter = handle;
+    }
+
+    PartitionBatch await_resume() {
+      PartitionBatch batch = std::move(this->consumer.readyBatches.front());
+      this->consumer.readyBatches.pop_front();
+      return batch;
+    }
+
+   private:
+    Consumer& consumer;
+  };
+
+  // NextBatch is the awaitable alternative to OnBatch, only one coroutine may
+  // wait for batches at a time:
+  //
+  //   auto batch = co_await consumer.NextBatch();
+  BatchAwaitable NextBatch() { return BatchAwaitable(*this); }
+#endif
+
+ protected:
+  // deliverFetched hands the record batches fetched for a partition to the
+  // batch accumulator. Storage owns the memory the batches are in. Batches
+  // with compressed records are skipped and reported as ErrorEvent
+  void deliverFetched(const std::string& topic, int32_t partitionIndex,
+                      int64_t highWatermark, int64_t fetchOffset,
+                      const char* data, std::size_t size,
+                      std::shared_ptr<const void> storage) {
+    auto skipped =
+        this->batchAccumulator.Add(topic, partitionIndex, highWatermark,
+                                   fetchOffset, data, size, std::move(storage));
+    for (const auto& batch : skipped) {
+      this->publish(ErrorEvent{
+          .Reason = "Skipped " + std::string(batch.Codec) +
+                    " compressed records " + std::to_string(batch.BaseOffset) +
+                    " to " + std::to_string(batch.LastOffset) + " of " +
+                    topic + "/" + std::to_string(partitionIndex) +
+                    ", compression is not supported",
+          .Error = Error::UnsupportedCompression});
+    }
+    this->scheduleBatchTimer();
+  }
+
+  // newFetchRequest returns a fetch request which carries the rack of the
+  // client
+  protocol::packet::FetchRequestPacket newFetchRequest() const {
+    return protocol::packet::FetchRequestPacket(
+        this->replicaSelector.ClientRack());
+  }
+
+  // handleFetchedPartition applies a partition of a fetch response, which was
+  // requested for fetchOffset. The serving replica follows the preferred read
+  // replica of the broker and falls back to the leader on errors, records are
+  // only delivered without error. Returns the replica to fetch from next
+  int32_t handleFetchedPartition(
+      const std::string& topic,
+      const protocol::packet::FetchPartitionResponse& partition,
+      int64_t fetchOffset, std::shared_ptr<const void> storage) {
+    int32_t next = this->replicaSelector.OnFetchResponse(
+        topic, partition.partitionIndex, partition.errorCode,
+        partition.preferredReadReplica);
+
+    if (partition.errorCode == 0 && !partition.records.empty()) {
+      this->deliverFetched(topic, partition.partitionIndex,
+                           partition.highWatermark, fetchOffset,
+                           partition.records.data(), partition.records.size(),
+                           std::move(storage));
+    }
+
+    return next;
+  }
+
  private:
+  // ProcessedSignal is shared with the workers of the executor, the handle is
+  // reset under the mutex when it is closed so no worker sends on it anymore
+  struct ProcessedSignal {
+    std::mutex mutex;
+    std::shared_ptr<uvw::AsyncHandle> handle;
+  };
+
+  void closeProcessedSignal() {
+    if (this->processedSignal == nullptr) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->processedSignal->mutex);
+      this->processedSignal->handle->close();
+      this->processedSignal->handle = nullptr;
+    }
+    this->processedSignal = nullptr;
+  }
+
   // updateTopicInformation takes the event from the connection when it found a new or updated topic in metadata
   void updateTopicInformation(const UpdateTopicInformationEvent& event) {
+    for (const auto& partition :
+         event.topicInformation.partitionInformation) {
+      this->replicaSelector.UpdatePartition(event.topicInformation.name,
+                                            partition);
+    }
+  }
+
+  // deliverBatch calls the batch callback, without one the batch is queued
+  // for NextBatch
+  void deliverBatch(PartitionBatch& batch) {
+    if (this->batchCallback) {
+      this->batchCallback(batch);
+      return;
+    }
+
+    this->readyBatches.emplace_back(std::move(batch));
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+    if (this->batchWaiter) {
+      std::exchange(this->batchWaiter, nullptr).resume();
+    }
+#endif
+  }
+
+  // resetBatching delivers what is pending and groups records with the new
+  // options from here on
+  void resetBatching(BatchOptions options) {
+    if (this->lowLatency) {
+      options.MaxWait = std::chrono::milliseconds{0};
+    }
+
+    this->batchAccumulator.Flush();
+    this->batchAccumulator = internal::BatchAccumulator(
+        options,
+        [this](PartitionBatch& batch) { this->deliverBatch(batch); });
+  }
+
+  // scheduleBatchTimer schedules the timer for the batch which waits
+  // longest, replacing the previous one
+  void scheduleBatchTimer() {
+    this->timers()->Cancel(this->batchTimer);
+    auto deadline = this->batchAccumulator.NextDeadline();
+    if (!deadline.has_value()) {
+      return;
+    }
 
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+        *deadline - std::chrono::steady_clock::now());
+    this->batchTimer = this->timers()->Schedule(
+        std::max(wait, std::chrono::milliseconds{0}), [this] {
+          this->batchAccumulator.FlushExpired();
+          this->scheduleBatchTimer();
+        });
   }
 
+  std::shared_ptr<uvw::Loop>& loop;
   std::vector<internal::Topic> topics;
   std::vector<std::string> wantedTopics;
   bool autoCreate;
+  internal::BatchAccumulator batchAccumulator;
+  internal::ReplicaSelector replicaSelector;
+  internal::TimerId batchTimer;
+  bool lowLatency = false;
+  std::shared_ptr<ProcessedSignal> processedSignal;
+  std::function<void(PartitionBatch&)> batchCallback;
+  std::deque<PartitionBatch> readyBatches;
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+  std::coroutine_handle<> batchWaiter;
+#endif
 };
 }  // namespace ahiv::kafka
 
@@ -0,0 +1,165 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_COROUTINE_H
+#define AHIV_KAFKA_COROUTINE_H
+
+// The awaitable API needs C++20 coroutines, build with --config=cxx20 to
+// enable it. Everything else in the client stays usable with C++17.
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define AHIV_KAFKA_HAS_COROUTINES
+#endif
+#endif
+
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "ahiv/kafka/error.h"
+
+namespace ahiv::kafka {
+namespace internal {
+// FramePool hands out memory for coroutine frames. Frames are grouped into
+// size classes of FrameGranularity bytes, freed frames are kept in a free
+// list per class and reused by the next coroutine of the same size. Frames
+// larger than MaxPooledFrameSize go to the global allocator. There is one
+// pool per thread, coroutines must be destroyed on the thread that created
+// them (which is always the loop thread)
+class FramePool {
+ public:
+  static constexpr std::size_t FrameGranularity = 64;
+  static constexpr std::size_t MaxPooledFrameSize = 2048;
+  static constexpr std::size_t SizeClasses =
+      MaxPooledFrameSize / FrameGranularity;
+
+  // Local returns the pool of the current thread
+  static FramePool& Local() {
+    thread_local FramePool pool;
+    return pool;
+  }
+
+  ~FramePool() {
+    for (auto& head : this->freeLists) {
+      while (head != nullptr) {
+        FreeFrame* next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+  }
+
+  // Allocate returns a frame of at least the given size
+  void* Allocate(std::size_t size) {
+    if (size > MaxPooledFrameSize) {
+      return ::operator new(size);
+    }
+
+    std::size_t sizeClass = this->sizeClass(size);
+    FreeFrame* frame = this->freeLists[sizeClass];
+    if (frame != nullptr) {
+      this->freeLists[sizeClass] = frame->next;
+      return frame;
+    }
+
+    return ::operator new((sizeClass + 1) * FrameGranularity);
+  }
+
+  // Deallocate gives the frame back to the pool, size must be the size given
+  // to Allocate
+  void Deallocate(void* memory, std::size_t size) {
+    if (size > MaxPooledFrameSize) {
+      ::operator delete(memory);
+      return;
+    }
+
+    std::size_t sizeClass = this->sizeClass(size);
+    auto* frame = static_cast<FreeFrame*>(memory);
+    frame->next = this->freeLists[sizeClass];
+    this->freeLists[sizeClass] = frame;
+  }
+
+ private:
+  struct FreeFrame {
+    FreeFrame* next;
+  };
+
+  std::size_t sizeClass(std::size_t size) {
+    return size == 0 ? 0 : (size - 1) / FrameGranularity;
+  }
+
+  std::array<FreeFrame*, SizeClasses> freeLists{};
+};
+}  // namespace internal
+
+// Task is the return type of coroutines which drive requests. It starts
+// running right away and destroys itself once it finished, its frame is taken
+// from the frame pool of the loop thread. Exceptions escaping the coroutine
+// terminate the process
+class Task {
+ public:
+  struct promise_type {
+    Task get_return_object() noexcept { return Task{}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    static void* operator new(std::size_t size) {
+      return internal::FramePool::Local().Allocate(size);
+    }
+
+    static void operator delete(void* frame, std::size_t size) {
+      internal::FramePool::Local().Deallocate(frame, size);
+    }
+  };
+};
+
+// RequestAwaitable sends a request when awaited and resumes the awaiting
+// coroutine from the read path of the connection once the response has been
+// decoded. The result is empty when there was no connection to send on or
+// the request would block on the memory budget, the coroutine continues right
+// away then. It is also empty when the request timed out. A connection which
+// is closed with requests in flight never resumes them
+template <typename Message, typename Connection>
+class RequestAwaitable {
+ public:
+  using Response = typename Message::Response;
+
+  RequestAwaitable(std::shared_ptr<Connection> connection,
+                   typename Message::Request request)
+      : connection(std::move(connection)), request(std::move(request)) {}
+
+  bool await_ready() const noexcept { return this->connection == nullptr; }
+
+  bool await_suspend(std::coroutine_handle<> handle) {
+    this->handle = handle;
+    return this->connection->template Send<Message>(
+        this->request,
+        [this](Response& response) {
+          this->response.emplace(std::move(response));
+          this->handle.resume();
+        },
+        [this](Error) { this->handle.resume(); });
+  }
+
+  std::optional<Response> await_resume() { return std::move(this->response); }
+
+ private:
+  std::shared_ptr<Connection> connection;
+  typename Message::Request request;
+  std::coroutine_handle<> handle;
+  std::optional<Response> response;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_HAS_COROUTINES
+
+#endif  // AHIV_KAFKA_COROUTINE_H
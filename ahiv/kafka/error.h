@@ -9,7 +9,14 @@ enum class Error {
   NoValidBootstrapServerGiven,
   DNSResolveFailed,
   TCPConnectionRefused,
-  UnknownTCPError
+  UnknownTCPError,
+  TooManyInFlightRequests,
+  InitProducerIdFailed,
+  RequestTimedOut,
+  TLSConfigurationInvalid,
+  TLSHandshakeFailed,
+  TLSSessionFailed,
+  UnsupportedCompression
 };
 }
 
@@ -4,7 +4,10 @@
 #ifndef AHIV_KAFKA_EVENT_H_
 #define AHIV_KAFKA_EVENT_H_
 
+#include <chrono>
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #include "ahiv/kafka/error.h"
 #include "ahiv/kafka/protocol/packet/metadata.h"
@@ -22,14 +25,62 @@ struct ErrorEvent {
 // resolved the IP of the given hostname.
 struct ResolvedEvent {};
 
+// ConnectedEvent is fired when a connection to a broker has been established.
 struct ConnectedEvent {};
 
+// StartupEvent is fired once after bootstrapping, when every partition leader
+// of the wanted topics is connected. All durations are measured from the call
+// to Bootstrap.
+struct StartupEvent {
+  // DNSResolved is the time until the first bootstrap server was resolved.
+  std::chrono::steady_clock::duration DNSResolved;
+  // TCPConnected is the time until the first bootstrap server was connected.
+  std::chrono::steady_clock::duration TCPConnected;
+  // FirstMetadata is the time until the first metadata response arrived.
+  std::chrono::steady_clock::duration FirstMetadata;
+  // AllLeadersConnected is the time until all partition leaders were
+  // connected.
+  std::chrono::steady_clock::duration AllLeadersConnected;
+};
+
+// BackpressureEvent is fired when the memory budget of a connection has been
+// exhausted and again once enough memory has been released. While blocked,
+// requests are refused and reading of responses is paused.
+struct BackpressureEvent {
+  bool Blocked;
+  // Used is the amount of bytes held in request and response buffers.
+  std::size_t Used;
+  std::size_t Limit;
+};
+
 // UpdateTopicInformationEvent is fired when metadata changes have been detected
 // for a topic. The updated metadata is part of this event.
 struct UpdateTopicInformationEvent {
   protocol::packet::TopicInformation topicInformation;
 };
 
+// UpdateBrokerInformationEvent is fired with the brokers of every metadata
+// response, before the topics of the response are published.
+struct UpdateBrokerInformationEvent {
+  std::vector<protocol::packet::BrokerNodeInformation> brokers;
+};
+
+// ProducerIdEvent is fired by an idempotent producer when the broker assigned
+// it a producer id and epoch, batches can be sent from then on.
+struct ProducerIdEvent {
+  int64_t ProducerId;
+  int16_t ProducerEpoch;
+};
+
+// ProcessedOffsetEvent is fired by a consumer which processes in parallel when
+// every record of a partition in front of Offset has been processed. Offset is
+// the position consuming resumes from and the offset to commit.
+struct ProcessedOffsetEvent {
+  std::string Topic;
+  int32_t Partition;
+  int64_t Offset;
+};
+
 }  // namespace ahiv::kafka
 
 #endif  // AHIV_KAFKA_EVENT_H_
@@ -0,0 +1,147 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_BATCHACCUMULATOR_H
+#define AHIV_KAFKA_INTERNAL_BATCHACCUMULATOR_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/batch.h"
+
+namespace ahiv::kafka::internal {
+// SkippedBatch is a fetched record batch whose records could not be decoded
+// because they are compressed with Codec
+struct SkippedBatch {
+  int64_t BaseOffset;
+  int64_t LastOffset;
+  const char* Codec;
+};
+
+// BatchAccumulator groups the records of fetched record batches into
+// PartitionBatches. A batch is delivered to the sink as soon as it holds
+// MaxRecords records or when it waited MaxWait, so the application gets one
+// call per batch instead of one per record. With a MaxWait of zero the
+// records of every fetched partition are delivered right away
+class BatchAccumulator {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Sink = std::function<void(PartitionBatch&)>;
+
+  BatchAccumulator(BatchOptions options, Sink sink)
+      : options(options), sink(std::move(sink)) {}
+
+  // Add decodes the fetched record batches of a partition. Records in front
+  // of the fetch offset, which the broker returns as part of the first batch,
+  // are skipped. Storage owns the memory the batches are in. Compressed
+  // batches are not decoded, they are returned so the caller can report them
+  std::vector<SkippedBatch> Add(const std::string& topic, int32_t partitionIndex,
+           int64_t highWatermark, int64_t fetchOffset, const char* data,
+           std::size_t size, std::shared_ptr<const void> storage,
+           Clock::time_point now = Clock::now()) {
+    auto& pending = this->pending[{topic, partitionIndex}];
+    std::vector<SkippedBatch> skipped;
+
+    protocol::packet::RecordBatchReader batches(data, size);
+    while (auto batch = batches.Next()) {
+      protocol::packet::RecordReader records(*batch);
+      if (records.Compressed()) {
+        skipped.emplace_back(SkippedBatch{batch->baseOffset, batch->lastOffset,
+                                          records.CompressionName()});
+        continue;
+      }
+
+      while (auto record = records.Next()) {
+        if (record->Offset < fetchOffset) {
+          continue;
+        }
+
+        if (pending.batch.Records.empty()) {
+          pending.batch.Topic = topic;
+          pending.batch.Partition = partitionIndex;
+          pending.batch.FirstOffset = record->Offset;
+          pending.startedAt = now;
+        }
+        if (pending.batch.Storage.empty() ||
+            pending.batch.Storage.back() != storage) {
+          pending.batch.Storage.emplace_back(storage);
+        }
+
+        pending.batch.HighWatermark = highWatermark;
+        pending.batch.LastOffset = record->Offset;
+        pending.batch.Records.emplace_back(*record);
+
+        if (pending.batch.Records.size() >= this->options.MaxRecords) {
+          this->deliver(pending);
+        }
+      }
+    }
+
+    if (this->options.MaxWait.count() == 0 && !pending.batch.Records.empty()) {
+      this->deliver(pending);
+    }
+
+    return skipped;
+  }
+
+  const BatchOptions& Options() const { return this->options; }
+
+  // FlushExpired delivers all batches which waited at least MaxWait
+  void FlushExpired(Clock::time_point now = Clock::now()) {
+    for (auto& [key, pending] : this->pending) {
+      if (!pending.batch.Records.empty() &&
+          now - pending.startedAt >= this->options.MaxWait) {
+        this->deliver(pending);
+      }
+    }
+  }
+
+  // Flush delivers all batches regardless of their age
+  void Flush() {
+    for (auto& [key, pending] : this->pending) {
+      if (!pending.batch.Records.empty()) {
+        this->deliver(pending);
+      }
+    }
+  }
+
+  // NextDeadline returns when the oldest batch waited MaxWait, nothing if
+  // there is no batch waiting
+  std::optional<Clock::time_point> NextDeadline() const {
+    std::optional<Clock::time_point> deadline;
+    for (const auto& [key, pending] : this->pending) {
+      if (!pending.batch.Records.empty() &&
+          (!deadline.has_value() ||
+           pending.startedAt + this->options.MaxWait < *deadline)) {
+        deadline = pending.startedAt + this->options.MaxWait;
+      }
+    }
+
+    return deadline;
+  }
+
+ private:
+  struct PendingBatch {
+    PartitionBatch batch;
+    Clock::time_point startedAt;
+  };
+
+  void deliver(PendingBatch& pending) {
+    PartitionBatch batch = std::move(pending.batch);
+    pending.batch = PartitionBatch{};
+    this->sink(batch);
+  }
+
+  BatchOptions options;
+  Sink sink;
+  std::map<std::pair<std::string, int32_t>, PendingBatch> pending;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_BATCHACCUMULATOR_H
@@ -0,0 +1,240 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_BATCHCONTROLLER_H
+#define AHIV_KAFKA_INTERNAL_BATCHCONTROLLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/stats.h"
+
+namespace ahiv::kafka::internal {
+// BatchingBounds are the limits the adaptive batch controller tunes linger
+// and batch size within
+struct BatchingBounds {
+  std::chrono::microseconds MinLinger{0};
+  std::chrono::microseconds MaxLinger{100000};
+  std::size_t MinBatchBytes = 16 << 10;
+  std::size_t MaxBatchBytes = 1 << 20;
+};
+
+// BatchingDecision is how long a partition batch may wait for more records
+// and how large it may grow before it is sent
+struct BatchingDecision {
+  std::chrono::microseconds Linger;
+  std::size_t BatchBytes;
+};
+
+// AdaptiveBatchController tunes linger and batch size of every partition
+// with additive increase and multiplicative decrease, based on how batches
+// were closed and on the produce round trip times of their broker:
+//
+//  * a batch which filled up grows the batch size of the partition by one
+//    step, the partition has more records than a batch holds
+//  * a batch which lingered while its broker is congested (the smoothed round
+//    trip time is twice the lowest one) grows the linger by one step, fewer
+//    and larger requests relieve the broker
+//  * any other batch which lingered halves linger and shrinks the batch size,
+//    waiting didn't help so records are sent with the lowest latency
+//
+// The linger is also capped by the time the partition needs to fill a batch
+// at its current arrival rate. An idle partition converges to MinLinger, a
+// busy one to full batches. The controller is used from the loop thread only
+class AdaptiveBatchController {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // RateWindow is the interval arrival rates are sampled in
+  static constexpr std::chrono::milliseconds RateWindow{10};
+  static constexpr uint32_t AdditiveSteps = 16;
+
+  explicit AdaptiveBatchController(BatchingBounds bounds = BatchingBounds{})
+      : bounds(normalize(bounds)) {}
+
+  const BatchingBounds& Bounds() const { return this->bounds; }
+
+  // SetBounds replaces the bounds, a minimum above its maximum is swapped
+  // with it and a negative linger counts as 0
+  void SetBounds(BatchingBounds bounds) {
+    this->bounds = normalize(bounds);
+    for (auto& [key, partition] : this->partitions) {
+      partition.linger = this->clampLinger(partition.linger);
+      partition.batchBytes = this->clampBatch(partition.batchBytes);
+    }
+  }
+
+  // OnRecord accounts a record appended to the batch of a partition
+  void OnRecord(const std::string& topic, int32_t partitionIndex,
+                std::size_t bytes, Clock::time_point now = Clock::now()) {
+    auto& partition = this->partition(topic, partitionIndex);
+    if (partition.windowStart == Clock::time_point{}) {
+      partition.windowStart = now;
+    }
+
+    partition.windowBytes += bytes;
+    auto elapsed = now - partition.windowStart;
+    if (elapsed >= RateWindow) {
+      double seconds = std::chrono::duration<double>(elapsed).count();
+      double rate = partition.windowBytes / seconds;
+      partition.arrivalRate = partition.arrivalRate == 0
+                                  ? rate
+                                  : 0.75 * partition.arrivalRate + 0.25 * rate;
+      partition.windowBytes = 0;
+      partition.windowStart = now;
+    }
+  }
+
+  // OnBatchClosed adjusts the partition after its batch has been closed,
+  // because it reached the batch size (full) or because it lingered long
+  // enough. The batch is sent to the given broker
+  void OnBatchClosed(const std::string& topic, int32_t partitionIndex,
+                     bool full, int32_t brokerId) {
+    auto& partition = this->partition(topic, partitionIndex);
+    if (full) {
+      partition.batchBytes =
+          this->clampBatch(partition.batchBytes + this->batchStep());
+      partition.increases++;
+    } else if (this->congested(brokerId)) {
+      partition.linger = this->clampLinger(partition.linger + this->lingerStep());
+      partition.increases++;
+    } else {
+      partition.linger = this->clampLinger(partition.linger / 2);
+      partition.batchBytes = this->clampBatch(
+          partition.batchBytes > this->batchStep()
+              ? partition.batchBytes - this->batchStep()
+              : 0);
+      partition.decreases++;
+    }
+  }
+
+  // OnProduceResponse accounts the round trip time of a produce request to
+  // the broker
+  void OnProduceResponse(int32_t brokerId, Clock::duration roundTrip) {
+    auto& broker = this->brokers[brokerId];
+    double micros =
+        std::chrono::duration<double, std::micro>(roundTrip).count();
+    broker.smoothedRtt =
+        broker.smoothedRtt == 0 ? micros : 0.875 * broker.smoothedRtt +
+                                               0.125 * micros;
+    broker.minRtt = broker.minRtt == 0 ? micros : std::min(broker.minRtt, micros);
+  }
+
+  // Decision returns the current linger and batch size of the partition
+  BatchingDecision Decision(const std::string& topic,
+                            int32_t partitionIndex) const {
+    auto known = this->partitions.find({topic, partitionIndex});
+    if (known == this->partitions.end()) {
+      return BatchingDecision{this->bounds.MinLinger, this->bounds.MinBatchBytes};
+    }
+
+    const auto& partition = known->second;
+    auto linger = partition.linger;
+    if (partition.arrivalRate > 0) {
+      auto fillTime = std::chrono::microseconds(static_cast<int64_t>(
+          partition.batchBytes / partition.arrivalRate * 1e6));
+      linger = this->clampLinger(std::min(linger, fillTime));
+    }
+
+    return BatchingDecision{linger, partition.batchBytes};
+  }
+
+  // Stats returns the decisions and their inputs for every partition
+  std::vector<PartitionBatchingStats> Stats() const {
+    std::vector<PartitionBatchingStats> stats;
+    stats.reserve(this->partitions.size());
+    for (const auto& [key, partition] : this->partitions) {
+      auto decision = this->Decision(key.first, key.second);
+      stats.emplace_back(PartitionBatchingStats{
+          .Topic = key.first,
+          .Partition = key.second,
+          .LingerUs = static_cast<uint64_t>(decision.Linger.count()),
+          .BatchBytes = decision.BatchBytes,
+          .ArrivalBytesPerSecond = static_cast<uint64_t>(partition.arrivalRate),
+          .Increases = partition.increases,
+          .Decreases = partition.decreases});
+    }
+
+    return stats;
+  }
+
+ private:
+  struct PartitionState {
+    std::chrono::microseconds linger;
+    std::size_t batchBytes;
+    double arrivalRate = 0;
+    std::size_t windowBytes = 0;
+    Clock::time_point windowStart{};
+    uint64_t increases = 0;
+    uint64_t decreases = 0;
+  };
+
+  struct BrokerState {
+    double smoothedRtt = 0;
+    double minRtt = 0;
+  };
+
+  PartitionState& partition(const std::string& topic, int32_t partitionIndex) {
+    auto key = std::make_pair(topic, partitionIndex);
+    auto known = this->partitions.find(key);
+    if (known != this->partitions.end()) {
+      return known->second;
+    }
+
+    PartitionState state;
+    state.linger = this->bounds.MinLinger;
+    state.batchBytes = this->bounds.MinBatchBytes;
+    return this->partitions.emplace(key, state).first->second;
+  }
+
+  bool congested(int32_t brokerId) const {
+    auto broker = this->brokers.find(brokerId);
+    return broker != this->brokers.end() && broker->second.minRtt > 0 &&
+           broker->second.smoothedRtt > 2 * broker->second.minRtt;
+  }
+
+  static BatchingBounds normalize(BatchingBounds bounds) {
+    bounds.MinLinger = std::max(bounds.MinLinger, std::chrono::microseconds{0});
+    bounds.MaxLinger = std::max(bounds.MaxLinger, std::chrono::microseconds{0});
+    if (bounds.MaxLinger < bounds.MinLinger) {
+      std::swap(bounds.MinLinger, bounds.MaxLinger);
+    }
+    if (bounds.MaxBatchBytes < bounds.MinBatchBytes) {
+      std::swap(bounds.MinBatchBytes, bounds.MaxBatchBytes);
+    }
+    return bounds;
+  }
+
+  std::chrono::microseconds lingerStep() const {
+    return std::max(std::chrono::microseconds{1},
+                    (this->bounds.MaxLinger - this->bounds.MinLinger) /
+                        AdditiveSteps);
+  }
+
+  std::size_t batchStep() const {
+    return std::max<std::size_t>(
+        1, (this->bounds.MaxBatchBytes - this->bounds.MinBatchBytes) /
+               AdditiveSteps);
+  }
+
+  std::chrono::microseconds clampLinger(std::chrono::microseconds linger) const {
+    return std::clamp(linger, this->bounds.MinLinger, this->bounds.MaxLinger);
+  }
+
+  std::size_t clampBatch(std::size_t batchBytes) const {
+    return std::clamp(batchBytes, this->bounds.MinBatchBytes,
+                      this->bounds.MaxBatchBytes);
+  }
+
+  BatchingBounds bounds;
+  std::map<std::pair<std::string, int32_t>, PartitionState> partitions;
+  std::map<int32_t, BrokerState> brokers;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_BATCHCONTROLLER_H
@@ -0,0 +1,54 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_BYTESTREAM_H
+#define AHIV_KAFKA_INTERNAL_BYTESTREAM_H
+
+#include <cstddef>
+#include <memory>
+
+#include "ahiv/kafka/stats.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::internal {
+// ReceivedEvent carries bytes received by a ByteStream, the data is only
+// valid during the listener call
+struct ReceivedEvent {
+  const char* Data;
+  std::size_t Length;
+};
+
+// ByteStream moves the bytes of a connected socket for transports which
+// don't use the libuv stream of the handle, like TLS sessions or io_uring.
+// The handle stays idle for as long as the stream exists. Streams publish
+// ConnectedEvent once they are ready for requests, ReceivedEvent for
+// received bytes, uvw::WriteEvent for every write which has been taken
+// completely and ErrorEvent when they failed. Writes are taken in order
+class ByteStream : public uvw::Emitter<ByteStream> {
+ public:
+  virtual ~ByteStream() = default;
+
+  // Start begins using the socket, writes before that are queued
+  virtual void Start() = 0;
+
+  // Read starts publishing received bytes
+  virtual void Read() = 0;
+
+  // Stop pauses reading, the socket buffers the data in the meantime
+  virtual void Stop() = 0;
+
+  // Write queues the bytes, they are written in order
+  virtual void Write(std::unique_ptr<char[]> data, std::size_t length) = 0;
+
+  // Close stops using the socket. The socket itself belongs to the handle
+  virtual void Close() = 0;
+
+  // QueuedBytes is the amount of bytes waiting to be written
+  virtual std::size_t QueuedBytes() const = 0;
+
+  // Stats fills the transport fields of the broker stats
+  virtual void Stats(BrokerStats& brokerStats) const = 0;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_BYTESTREAM_H
@@ -0,0 +1,144 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_CONNECTIONSTATS_H
+#define AHIV_KAFKA_INTERNAL_CONNECTIONSTATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "ahiv/kafka/internal/histogram.h"
+#include "ahiv/kafka/stats.h"
+
+namespace ahiv::kafka::internal {
+// MaxTrackedApiKey is the amount of api keys which have their own latency
+// histogram, requests with higher keys are only counted
+const int16_t MaxTrackedApiKey = 64;
+
+// ConnectionStats records the counters of a single broker connection. All
+// counters are relaxed atomics, recording is done on the loop thread and
+// snapshots may be taken from any thread. Histograms are allocated the first
+// time an api key is used, after that recording never allocates
+class ConnectionStats {
+ public:
+  ~ConnectionStats() {
+    for (auto& histogram : this->histograms) {
+      delete histogram.load(std::memory_order_acquire);
+    }
+  }
+
+  // RecordRequest counts a request which has been written to the socket
+  void RecordRequest(std::size_t bytes) {
+    this->inFlight.fetch_add(1, std::memory_order_relaxed);
+    this->requestsSent.fetch_add(1, std::memory_order_relaxed);
+    this->bytesOut.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // RecordBytesIn counts bytes which have been read from the socket
+  void RecordBytesIn(std::size_t bytes) {
+    this->bytesIn.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // RecordResponse counts a response and its latency for the api key
+  void RecordResponse(int16_t apiKey, std::chrono::steady_clock::duration latency) {
+    this->inFlight.fetch_sub(1, std::memory_order_relaxed);
+    this->responsesReceived.fetch_add(1, std::memory_order_relaxed);
+
+    if (apiKey < 0 || apiKey >= MaxTrackedApiKey) {
+      return;
+    }
+
+    auto& slot = this->histograms[apiKey];
+    LatencyHistogram* histogram = slot.load(std::memory_order_acquire);
+    if (histogram == nullptr) {
+      histogram = new LatencyHistogram();
+      slot.store(histogram, std::memory_order_release);
+    }
+
+    histogram->Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+  }
+
+  // RecordThrottle counts a throttle time reported by the broker
+  void RecordThrottle(int32_t throttleTimeMs) {
+    if (throttleTimeMs <= 0) {
+      return;
+    }
+
+    this->throttledResponses.fetch_add(1, std::memory_order_relaxed);
+    this->throttleTimeMs.fetch_add(throttleTimeMs, std::memory_order_relaxed);
+
+    uint64_t currentMax = this->maxThrottleTimeMs.load(std::memory_order_relaxed);
+    while (static_cast<uint64_t>(throttleTimeMs) > currentMax &&
+           !this->maxThrottleTimeMs.compare_exchange_weak(
+               currentMax, throttleTimeMs, std::memory_order_relaxed)) {
+    }
+  }
+
+  // RecordTimeout counts a request which has not been answered in time
+  void RecordTimeout() {
+    this->inFlight.fetch_sub(1, std::memory_order_relaxed);
+    this->requestTimeouts.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // RecordUnmatchedResponse counts a response frame which no request waits
+  // for
+  void RecordUnmatchedResponse() {
+    this->unmatchedResponses.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // RecordPaced counts a request which has been held back because the broker
+  // throttled the connection
+  void RecordPaced() {
+    this->pacedRequests.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Snapshot copies all counters into the given broker stats
+  void Snapshot(BrokerStats& stats) const {
+    stats.InFlight = this->inFlight.load(std::memory_order_relaxed);
+    stats.RequestsSent = this->requestsSent.load(std::memory_order_relaxed);
+    stats.ResponsesReceived =
+        this->responsesReceived.load(std::memory_order_relaxed);
+    stats.BytesOut = this->bytesOut.load(std::memory_order_relaxed);
+    stats.BytesIn = this->bytesIn.load(std::memory_order_relaxed);
+    stats.ThrottledResponses =
+        this->throttledResponses.load(std::memory_order_relaxed);
+    stats.ThrottleTimeMs = this->throttleTimeMs.load(std::memory_order_relaxed);
+    stats.MaxThrottleTimeMs =
+        this->maxThrottleTimeMs.load(std::memory_order_relaxed);
+    stats.PacedRequests = this->pacedRequests.load(std::memory_order_relaxed);
+    stats.RequestTimeouts =
+        this->requestTimeouts.load(std::memory_order_relaxed);
+    stats.UnmatchedResponses =
+        this->unmatchedResponses.load(std::memory_order_relaxed);
+
+    stats.Apis.clear();
+    for (int16_t apiKey = 0; apiKey < MaxTrackedApiKey; apiKey++) {
+      const LatencyHistogram* histogram =
+          this->histograms[apiKey].load(std::memory_order_acquire);
+      if (histogram != nullptr) {
+        stats.Apis.emplace_back(
+            ApiStats{.ApiKey = apiKey, .Latency = histogram->Snapshot()});
+      }
+    }
+  }
+
+ private:
+  std::array<std::atomic<LatencyHistogram*>, MaxTrackedApiKey> histograms{};
+  std::atomic<uint64_t> inFlight{0};
+  std::atomic<uint64_t> requestsSent{0};
+  std::atomic<uint64_t> responsesReceived{0};
+  std::atomic<uint64_t> bytesOut{0};
+  std::atomic<uint64_t> bytesIn{0};
+  std::atomic<uint64_t> throttledResponses{0};
+  std::atomic<uint64_t> throttleTimeMs{0};
+  std::atomic<uint64_t> maxThrottleTimeMs{0};
+  std::atomic<uint64_t> pacedRequests{0};
+  std::atomic<uint64_t> requestTimeouts{0};
+  std::atomic<uint64_t> unmatchedResponses{0};
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_CONNECTIONSTATS_H
@@ -0,0 +1,134 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_DNSCACHE_H
+#define AHIV_KAFKA_INTERNAL_DNSCACHE_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "uv.h"
+
+namespace ahiv::kafka::internal {
+// ResolvedAddresses holds owned copies of every address a lookup returned, in
+// the order connections should be attempted
+using ResolvedAddresses = std::vector<sockaddr_storage>;
+
+// DefaultDNSTTL is used for cache entries, getaddrinfo does not expose the
+// record TTL so a conservative fixed value is used
+const std::chrono::milliseconds DefaultDNSTTL = std::chrono::seconds(30);
+
+// InterleaveAddressFamilies reorders the given addresses so IPv6 and IPv4
+// addresses alternate, starting with the family of the first address. This
+// is the ordering RFC 8305 (happy eyeballs) asks for so that a broken family
+// does not delay connecting for every address it has
+inline ResolvedAddresses InterleaveAddressFamilies(
+    const ResolvedAddresses& addresses) {
+  if (addresses.empty()) {
+    return addresses;
+  }
+
+  ResolvedAddresses preferred;
+  ResolvedAddresses other;
+  auto preferredFamily = addresses[0].ss_family;
+  for (const auto& address : addresses) {
+    if (address.ss_family == preferredFamily) {
+      preferred.emplace_back(address);
+    } else {
+      other.emplace_back(address);
+    }
+  }
+
+  ResolvedAddresses interleaved;
+  interleaved.reserve(addresses.size());
+  for (std::size_t index = 0;
+       index < preferred.size() || index < other.size(); index++) {
+    if (index < preferred.size()) {
+      interleaved.emplace_back(preferred[index]);
+    }
+
+    if (index < other.size()) {
+      interleaved.emplace_back(other[index]);
+    }
+  }
+
+  return interleaved;
+}
+
+// DNSCache stores resolved addresses per hostname and port. It is shared by
+// every Address so that multiple connection configs (and reconnects) for the
+// same broker don't hit the resolver again until the entry expired
+class DNSCache {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Shared returns the process wide cache instance
+  static DNSCache& Shared() {
+    static DNSCache cache;
+    return cache;
+  }
+
+  // Lookup returns the cached addresses for the given host or nullptr if
+  // there is no entry or the entry has expired
+  std::shared_ptr<const ResolvedAddresses> Lookup(const std::string& hostname,
+                                                  const std::string& port) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto entry = this->entries.find(this->key(hostname, port));
+    if (entry == this->entries.end()) {
+      return nullptr;
+    }
+
+    if (entry->second.expiresAt <= Clock::now()) {
+      this->entries.erase(entry);
+      return nullptr;
+    }
+
+    return entry->second.addresses;
+  }
+
+  // Store caches the given addresses for the host until the ttl runs out
+  std::shared_ptr<const ResolvedAddresses> Store(
+      const std::string& hostname, const std::string& port,
+      ResolvedAddresses addresses,
+      std::chrono::milliseconds ttl = DefaultDNSTTL) {
+    auto shared =
+        std::make_shared<const ResolvedAddresses>(std::move(addresses));
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries[this->key(hostname, port)] =
+        Entry{.addresses = shared, .expiresAt = Clock::now() + ttl};
+    return shared;
+  }
+
+  // Invalidate drops the entry for the given host, the next lookup goes to the
+  // resolver again. Used when every cached address refused a connection
+  void Invalidate(const std::string& hostname, const std::string& port) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries.erase(this->key(hostname, port));
+  }
+
+  // Clear drops all entries
+  void Clear() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries.clear();
+  }
+
+ private:
+  struct Entry {
+    std::shared_ptr<const ResolvedAddresses> addresses;
+    Clock::time_point expiresAt;
+  };
+
+  std::string key(const std::string& hostname, const std::string& port) {
+    return std::string(hostname).append(":").append(port);
+  }
+
+  std::map<std::string, Entry> entries;
+  std::mutex mutex;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_DNSCACHE_H
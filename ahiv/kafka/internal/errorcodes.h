@@ -4,6 +4,8 @@
 #ifndef AHIV_KAFKA_INTERNAL_ERRORCODES_H_
 #define AHIV_KAFKA_INTERNAL_ERRORCODES_H_
 
+#include <cstdint>
+
 namespace ahiv::kafka::internal {
 enum class ErrorCode : int16_t {
   UNKNOWN_SERVER_ERROR = -1,
@@ -16,11 +18,16 @@ enum class ErrorCode : int16_t {
   NOT_LEADER_FOR_PARTITION,
   REQUEST_TIMED_OUT,
   BROKER_NOT_AVAILABLE,
-  REPLICA_NOT_AVAILABLE
-
+  REPLICA_NOT_AVAILABLE,
+  NOT_ENOUGH_REPLICAS = 19,
+  NOT_ENOUGH_REPLICAS_AFTER_APPEND = 20,
+  OUT_OF_ORDER_SEQUENCE_NUMBER = 45,
+  DUPLICATE_SEQUENCE_NUMBER = 46,
+  INVALID_PRODUCER_EPOCH = 47,
+  UNKNOWN_PRODUCER_ID = 59
 };
 
-bool IsErrorCodeRetryable(ErrorCode errorCode) {
+inline bool IsErrorCodeRetryable(ErrorCode errorCode) {
   return errorCode == ErrorCode::CORRUPT_MESSAGE ||
       errorCode == ErrorCode::UNKNOWN_TOPIC_OR_PARTITION ||
       (errorCode >= ErrorCode::LEADER_NOT_AVAILABLE &&
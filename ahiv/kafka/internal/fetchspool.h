@@ -0,0 +1,374 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_FETCHSPOOL_H
+#define AHIV_KAFKA_INTERNAL_FETCHSPOOL_H
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+
+namespace ahiv::kafka::internal {
+// DefaultSpoolSegmentBytes is the size a segment file grows to before the
+// spool rolls over to a new one
+const std::size_t DefaultSpoolSegmentBytes = 64 << 20;
+
+// SpoolIndexInterval is the amount of bytes between two entries of the sparse
+// offset index of a segment
+const std::size_t SpoolIndexInterval = 4096;
+
+// SpoolView is a range of spooled record batches in a mapped segment. It can
+// be walked with a RecordBatchReader and stays valid as long as the spool
+struct SpoolView {
+  const char* data;
+  std::size_t size;
+};
+
+// SpoolSegment is a single file of record batches of one partition, stored
+// verbatim as they were fetched. The whole capacity of the segment is mapped
+// once, so views into it stay valid while the file grows
+class SpoolSegment {
+ public:
+  // Open opens or creates the segment file. Batches which are already in the
+  // file are indexed, a partial batch at the end is cut off
+  static std::unique_ptr<SpoolSegment> Open(const std::string& path,
+                                            int64_t baseOffset,
+                                            std::size_t capacity) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return nullptr;
+    }
+
+    struct stat fileStat {};
+    if (::fstat(fd, &fileStat) != 0) {
+      ::close(fd);
+      return nullptr;
+    }
+
+    capacity = std::max(capacity, static_cast<std::size_t>(fileStat.st_size));
+    void* mapping = ::mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      ::close(fd);
+      return nullptr;
+    }
+
+    std::unique_ptr<SpoolSegment> segment(new SpoolSegment(
+        fd, static_cast<const char*>(mapping), capacity, baseOffset));
+    segment->indexExisting(fileStat.st_size);
+    return segment;
+  }
+
+  ~SpoolSegment() {
+    ::munmap(const_cast<char*>(this->mapping), this->capacity);
+    ::close(this->fd);
+  }
+
+  SpoolSegment(const SpoolSegment&) = delete;
+  SpoolSegment& operator=(const SpoolSegment&) = delete;
+
+  // BaseOffset is the first offset this segment covers
+  int64_t BaseOffset() const { return this->baseOffset; }
+
+  // NextOffset is the offset after the last spooled batch
+  int64_t NextOffset() const { return this->nextOffset; }
+
+  bool Covers(int64_t offset) const {
+    return offset >= this->baseOffset && offset < this->nextOffset;
+  }
+
+  bool Fits(std::size_t bytes) const {
+    return bytes <= this->capacity - this->size;
+  }
+
+  // Append writes the batch to the end of the segment
+  bool Append(const protocol::packet::RecordBatchSpan& batch) {
+    if (!this->Fits(batch.size)) {
+      return false;
+    }
+
+    std::size_t written = 0;
+    while (written < batch.size) {
+      ssize_t result = ::pwrite(this->fd, batch.data + written,
+                                batch.size - written, this->size + written);
+      if (result < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      written += result;
+    }
+
+    this->indexBatch(batch.baseOffset, batch.lastOffset, batch.size);
+    return true;
+  }
+
+  // Read returns the spooled batches starting with the one containing the
+  // offset, up to maxBytes but at least one batch
+  std::optional<SpoolView> Read(int64_t offset, std::size_t maxBytes) const {
+    if (!this->Covers(offset)) {
+      return std::nullopt;
+    }
+
+    auto entry = std::upper_bound(
+        this->index.begin(), this->index.end(), offset,
+        [](int64_t wanted, const IndexEntry& indexEntry) {
+          return wanted < indexEntry.offset;
+        });
+    std::size_t start =
+        entry == this->index.begin() ? 0 : (entry - 1)->position;
+
+    protocol::packet::RecordBatchReader reader(this->mapping + start,
+                                               this->size - start);
+    const char* first = nullptr;
+    std::size_t viewSize = 0;
+    while (auto batch = reader.Next()) {
+      if (first == nullptr) {
+        if (batch->lastOffset < offset) {
+          continue;
+        }
+        first = batch->data;
+      } else if (viewSize + batch->size > maxBytes) {
+        break;
+      }
+      viewSize += batch->size;
+    }
+
+    if (first == nullptr) {
+      return std::nullopt;
+    }
+    return SpoolView{first, viewSize};
+  }
+
+ private:
+  struct IndexEntry {
+    int64_t offset;
+    std::size_t position;
+  };
+
+  SpoolSegment(int fd, const char* mapping, std::size_t capacity,
+               int64_t baseOffset)
+      : fd(fd),
+        mapping(mapping),
+        capacity(capacity),
+        baseOffset(baseOffset),
+        nextOffset(baseOffset) {}
+
+  void indexExisting(std::size_t fileSize) {
+    protocol::packet::RecordBatchReader reader(this->mapping, fileSize);
+    while (auto batch = reader.Next()) {
+      this->indexBatch(batch->baseOffset, batch->lastOffset, batch->size);
+    }
+
+    if (this->size != fileSize) {
+      (void)::ftruncate(this->fd, this->size);
+    }
+  }
+
+  // indexBatch adds a batch which has been written at the end of the file to
+  // the sparse index
+  void indexBatch(int64_t batchBaseOffset, int64_t batchLastOffset,
+                  std::size_t batchSize) {
+    if (this->index.empty() ||
+        this->size - this->index.back().position >= SpoolIndexInterval) {
+      this->index.emplace_back(IndexEntry{batchBaseOffset, this->size});
+    }
+
+    this->size += batchSize;
+    this->nextOffset = std::max(this->nextOffset, batchLastOffset + 1);
+  }
+
+  int fd;
+  const char* mapping;
+  std::size_t capacity;
+  std::size_t size = 0;
+  int64_t baseOffset;
+  int64_t nextOffset;
+  std::vector<IndexEntry> index;
+};
+
+// FetchSpool keeps fetched record batches on disk, one directory per
+// partition with segment files named after the first offset they cover.
+// Ranges which have been spooled once, also by an earlier process, are read
+// back through the page cache instead of fetching them from the brokers
+// again. The spool is used from the loop thread only
+class FetchSpool {
+ public:
+  explicit FetchSpool(std::string directory,
+                      std::size_t segmentBytes = DefaultSpoolSegmentBytes)
+      : directory(std::move(directory)), segmentBytes(segmentBytes) {
+    ::mkdir(this->directory.c_str(), 0755);
+  }
+
+  // Append spools the complete record batches of a fetch response, which was
+  // requested for fetchOffset. Batches which are spooled already are skipped.
+  // Returns the amount of bytes which have been consumed from batches, a
+  // partial batch at the end is not consumed
+  std::size_t Append(const std::string& topic, int32_t partitionIndex,
+                     int64_t fetchOffset, const char* batches,
+                     std::size_t size) {
+    auto& segments = this->partition(topic, partitionIndex);
+    SpoolSegment* segment = findContinued(segments, fetchOffset);
+
+    protocol::packet::RecordBatchReader reader(batches, size);
+    while (auto batch = reader.Next()) {
+      if (segment != nullptr && batch->lastOffset < segment->NextOffset()) {
+        continue;
+      }
+
+      if (segment == nullptr || !segment->Fits(batch->size)) {
+        int64_t segmentBase =
+            segment != nullptr ? segment->NextOffset()
+                               : std::min(fetchOffset, batch->baseOffset);
+        segment = this->createSegment(topic, partitionIndex, segments,
+                                      segmentBase, batch->size);
+        if (segment == nullptr) {
+          return reader.Position() - batch->size;
+        }
+      }
+
+      if (!segment->Append(*batch)) {
+        return reader.Position() - batch->size;
+      }
+    }
+
+    return reader.Position();
+  }
+
+  // Read returns spooled batches starting with the one containing the offset,
+  // up to maxBytes but at least one batch
+  std::optional<SpoolView> Read(const std::string& topic,
+                                int32_t partitionIndex, int64_t offset,
+                                std::size_t maxBytes) {
+    auto* segment =
+        findCovering(this->partition(topic, partitionIndex), offset);
+    if (segment == nullptr) {
+      return std::nullopt;
+    }
+
+    return segment->Read(offset, maxBytes);
+  }
+
+  // Contains reports if the offset has been spooled
+  bool Contains(const std::string& topic, int32_t partitionIndex,
+                int64_t offset) {
+    return findCovering(this->partition(topic, partitionIndex), offset) !=
+           nullptr;
+  }
+
+ private:
+  using Segments = std::map<int64_t, std::unique_ptr<SpoolSegment>>;
+
+  static SpoolSegment* findCovering(Segments& segments, int64_t offset) {
+    auto segment = segments.upper_bound(offset);
+    if (segment == segments.begin()) {
+      return nullptr;
+    }
+
+    segment--;
+    return segment->second->Covers(offset) ? segment->second.get() : nullptr;
+  }
+
+  // findContinued returns the segment a fetch from the offset continues,
+  // which is the one covering it or ending right in front of it
+  static SpoolSegment* findContinued(Segments& segments, int64_t offset) {
+    auto* covering = findCovering(segments, offset);
+    if (covering != nullptr) {
+      return covering;
+    }
+
+    auto segment = segments.upper_bound(offset);
+    if (segment == segments.begin()) {
+      return nullptr;
+    }
+
+    segment--;
+    return segment->second->NextOffset() == offset ? segment->second.get()
+                                                   : nullptr;
+  }
+
+  std::string partitionDirectory(const std::string& topic,
+                                 int32_t partitionIndex) const {
+    return this->directory + "/" + topic + "-" + std::to_string(partitionIndex);
+  }
+
+  static std::string segmentName(int64_t baseOffset) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020lld.log",
+                  static_cast<long long>(baseOffset));
+    return name;
+  }
+
+  // partition returns the segments of the partition, segments spooled by an
+  // earlier process are opened on first access
+  Segments& partition(const std::string& topic, int32_t partitionIndex) {
+    auto key = std::make_pair(topic, partitionIndex);
+    auto known = this->partitions.find(key);
+    if (known != this->partitions.end()) {
+      return known->second;
+    }
+
+    auto& segments = this->partitions[key];
+    std::string path = this->partitionDirectory(topic, partitionIndex);
+    DIR* dir = ::opendir(path.c_str());
+    if (dir == nullptr) {
+      return segments;
+    }
+
+    while (dirent* entry = ::readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() != 24 || name.compare(20, 4, ".log") != 0) {
+        continue;
+      }
+
+      int64_t baseOffset = std::stoll(name.substr(0, 20));
+      auto segment = SpoolSegment::Open(path + "/" + name, baseOffset,
+                                        this->segmentBytes);
+      if (segment != nullptr && segment->NextOffset() > baseOffset) {
+        segments.emplace(baseOffset, std::move(segment));
+      }
+    }
+    ::closedir(dir);
+
+    return segments;
+  }
+
+  SpoolSegment* createSegment(const std::string& topic, int32_t partitionIndex,
+                              Segments& segments, int64_t baseOffset,
+                              std::size_t minimumCapacity) {
+    std::string path = this->partitionDirectory(topic, partitionIndex);
+    ::mkdir(path.c_str(), 0755);
+
+    auto segment = SpoolSegment::Open(
+        path + "/" + segmentName(baseOffset), baseOffset,
+        std::max(this->segmentBytes, minimumCapacity));
+    if (segment == nullptr) {
+      return nullptr;
+    }
+
+    auto* created = segment.get();
+    segments[baseOffset] = std::move(segment);
+    return created;
+  }
+
+  std::string directory;
+  std::size_t segmentBytes;
+  std::map<std::pair<std::string, int32_t>, Segments> partitions;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_FETCHSPOOL_H
@@ -0,0 +1,172 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_FRAMECAPTURE_H
+#define AHIV_KAFKA_INTERNAL_FRAMECAPTURE_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ahiv/kafka/protocol/endian.h"
+#include "ahiv/kafka/protocol/schema.h"
+
+namespace ahiv::kafka::internal {
+enum class FrameDirection : uint8_t { Request = 0, Response = 1 };
+
+// CapturedFrame is a single frame of a capture file. Data points into the
+// memory of the reader and includes the length prefix of the frame
+struct CapturedFrame {
+  // Timestamp is the time the frame has been written or read, in
+  // nanoseconds since the epoch
+  int64_t Timestamp;
+  FrameDirection Direction;
+  // ApiKey is the api of the request the frame belongs to, -1 for responses
+  // which didn't match a request
+  int16_t ApiKey;
+  const char* Data;
+  std::size_t Size;
+};
+
+// FrameCapture appends the raw frames of broker connections to a file. The
+// file starts with the magic "AHKC" and a version, followed by one record per
+// frame: a 16 byte header (timestamp, frame size, api key, direction, all big
+// endian) and the frame as it has been on the wire. Writes go through the
+// stdio buffer, so capturing costs a copy per frame and a write per buffer
+// full. A capture is shared by all connections of a client and used from the
+// loop thread only
+class FrameCapture {
+ public:
+  static constexpr uint32_t Magic = 0x41484b43;  // "AHKC"
+  static constexpr uint16_t Version = 1;
+  static constexpr std::size_t FileHeaderSize = 8;
+  static constexpr std::size_t RecordHeaderSize = 16;
+  static constexpr std::size_t WriteBufferSize = 1 << 20;
+
+  // Open creates or truncates the capture file
+  static std::shared_ptr<FrameCapture> Open(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      return nullptr;
+    }
+
+    std::shared_ptr<FrameCapture> capture(new FrameCapture(file));
+    char header[FileHeaderSize]{};
+    protocol::schema::Codec<uint32_t>::EncodeFixed(Magic, header);
+    protocol::schema::Codec<uint16_t>::EncodeFixed(Version, header + 4);
+    std::fwrite(header, 1, FileHeaderSize, file);
+    return capture;
+  }
+
+  ~FrameCapture() { std::fclose(this->file); }
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  // Append writes a frame along with the current time
+  void Append(FrameDirection direction, int16_t apiKey, const char* frame,
+              std::size_t size) {
+    int64_t timestamp =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+
+    char header[RecordHeaderSize]{};
+    protocol::schema::Codec<int64_t>::EncodeFixed(timestamp, header);
+    protocol::schema::Codec<uint32_t>::EncodeFixed(size, header + 8);
+    protocol::schema::Codec<int16_t>::EncodeFixed(apiKey, header + 12);
+    header[14] = static_cast<char>(direction);
+    std::fwrite(header, 1, RecordHeaderSize, this->file);
+    std::fwrite(frame, 1, size, this->file);
+  }
+
+  // Flush hands the buffered frames to the file
+  void Flush() { std::fflush(this->file); }
+
+ private:
+  explicit FrameCapture(std::FILE* file) : file(file) {
+    std::setvbuf(this->file, nullptr, _IOFBF, WriteBufferSize);
+  }
+
+  std::FILE* file;
+};
+
+// FrameCaptureReader loads a capture file and iterates its frames, a
+// truncated record at the end is ignored
+class FrameCaptureReader {
+ public:
+  static std::optional<FrameCaptureReader> Open(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return std::nullopt;
+    }
+
+    std::vector<char> content;
+    char chunk[1 << 16];
+    std::size_t read;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      content.insert(content.end(), chunk, chunk + read);
+    }
+    std::fclose(file);
+
+    uint32_t magic;
+    uint16_t version;
+    if (content.size() < FrameCapture::FileHeaderSize) {
+      return std::nullopt;
+    }
+    std::memcpy(&magic, content.data(), 4);
+    std::memcpy(&version, content.data() + 4, 2);
+    if (be32toh(magic) != FrameCapture::Magic ||
+        be16toh(version) != FrameCapture::Version) {
+      return std::nullopt;
+    }
+
+    return FrameCaptureReader(std::move(content));
+  }
+
+  // Next returns the next frame, nothing at the end of the capture
+  std::optional<CapturedFrame> Next() {
+    if (this->content.size() - this->position <
+        FrameCapture::RecordHeaderSize) {
+      return std::nullopt;
+    }
+
+    const char* header = this->content.data() + this->position;
+    uint64_t timestamp;
+    uint32_t size;
+    uint16_t apiKey;
+    std::memcpy(&timestamp, header, 8);
+    std::memcpy(&size, header + 8, 4);
+    std::memcpy(&apiKey, header + 12, 2);
+    size = be32toh(size);
+
+    std::size_t frameStart = this->position + FrameCapture::RecordHeaderSize;
+    if (this->content.size() - frameStart < size) {
+      return std::nullopt;
+    }
+
+    this->position = frameStart + size;
+    return CapturedFrame{static_cast<int64_t>(be64toh(timestamp)),
+                         static_cast<FrameDirection>(header[14]),
+                         static_cast<int16_t>(be16toh(apiKey)),
+                         this->content.data() + frameStart, size};
+  }
+
+  // Rewind starts iterating from the first frame again
+  void Rewind() { this->position = FrameCapture::FileHeaderSize; }
+
+ private:
+  explicit FrameCaptureReader(std::vector<char> content)
+      : content(std::move(content)) {}
+
+  std::vector<char> content;
+  std::size_t position = FrameCapture::FileHeaderSize;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_FRAMECAPTURE_H
@@ -0,0 +1,139 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_HISTOGRAM_H
+#define AHIV_KAFKA_INTERNAL_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#include "ahiv/kafka/stats.h"
+
+namespace ahiv::kafka::internal {
+// LatencyHistogram records microsecond values into log-linear buckets in the
+// style of HDR histograms: every power of two is split into 8 linear sub
+// buckets, which bounds the relative error to 12.5%. Recording is a handful of
+// relaxed atomic increments, it never allocates or locks so snapshots can be
+// taken from any thread while the loop records
+class LatencyHistogram {
+ public:
+  // SubBucketBits is the amount of significant bits kept per value
+  static constexpr int SubBucketBits = 4;
+  static constexpr uint64_t SubBucketHalf = uint64_t{1} << (SubBucketBits - 1);
+  // MaxValueBits caps values at roughly 71 minutes, larger values are
+  // recorded into the last bucket
+  static constexpr int MaxValueBits = 32;
+  static constexpr std::size_t BucketCount =
+      (MaxValueBits - SubBucketBits + 2) * SubBucketHalf;
+
+  // Record adds the given value to the histogram
+  void Record(uint64_t value) {
+    uint64_t maxValue = (uint64_t{1} << MaxValueBits) - 1;
+    if (value > maxValue) {
+      value = maxValue;
+    }
+
+    this->buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    this->count.fetch_add(1, std::memory_order_relaxed);
+    this->sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t currentMin = this->min.load(std::memory_order_relaxed);
+    while (value < currentMin &&
+           !this->min.compare_exchange_weak(currentMin, value,
+                                            std::memory_order_relaxed)) {
+    }
+
+    uint64_t currentMax = this->max.load(std::memory_order_relaxed);
+    while (value > currentMax &&
+           !this->max.compare_exchange_weak(currentMax, value,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+
+  // Count returns the amount of recorded values
+  uint64_t Count() const { return this->count.load(std::memory_order_relaxed); }
+
+  // Percentile returns the highest value equivalent to the given percentile
+  // (0 to 100), capped at the maximum recorded value
+  uint64_t Percentile(double percentile) const {
+    uint64_t total = this->Count();
+    if (total == 0) {
+      return 0;
+    }
+
+    auto wanted = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+    if (wanted == 0) {
+      wanted = 1;
+    }
+
+    uint64_t seen = 0;
+    uint64_t maxValue = this->max.load(std::memory_order_relaxed);
+    for (std::size_t index = 0; index < BucketCount; index++) {
+      seen += this->buckets[index].load(std::memory_order_relaxed);
+      if (seen >= wanted) {
+        uint64_t upper = BucketUpperBound(index);
+        return upper < maxValue ? upper : maxValue;
+      }
+    }
+
+    return maxValue;
+  }
+
+  // Snapshot summarizes the histogram
+  HistogramSnapshot Snapshot() const {
+    HistogramSnapshot snapshot{};
+    snapshot.Count = this->Count();
+    if (snapshot.Count == 0) {
+      return snapshot;
+    }
+
+    snapshot.Min = this->min.load(std::memory_order_relaxed);
+    snapshot.Max = this->max.load(std::memory_order_relaxed);
+    snapshot.Mean = static_cast<double>(this->sum.load(std::memory_order_relaxed)) /
+                    snapshot.Count;
+    snapshot.P50 = this->Percentile(50);
+    snapshot.P90 = this->Percentile(90);
+    snapshot.P99 = this->Percentile(99);
+    snapshot.P999 = this->Percentile(99.9);
+    return snapshot;
+  }
+
+  // BucketIndex returns the bucket the given value is counted in
+  static constexpr std::size_t BucketIndex(uint64_t value) {
+    int mostSignificantBit = 63;
+    while (mostSignificantBit > 0 &&
+           (value & (uint64_t{1} << mostSignificantBit)) == 0) {
+      mostSignificantBit--;
+    }
+
+    int shift = mostSignificantBit - (SubBucketBits - 1);
+    if (shift < 0) {
+      shift = 0;
+    }
+
+    return shift * SubBucketHalf + (value >> shift);
+  }
+
+  // BucketUpperBound returns the highest value counted in the given bucket
+  static constexpr uint64_t BucketUpperBound(std::size_t index) {
+    if (index < 2 * SubBucketHalf) {
+      return index;
+    }
+
+    std::size_t shift = index / SubBucketHalf - 1;
+    uint64_t mantissa = index - shift * SubBucketHalf;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, BucketCount> buckets{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> max{0};
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_HISTOGRAM_H
@@ -0,0 +1,100 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_INFLIGHTTABLE_H
+#define AHIV_KAFKA_INTERNAL_INFLIGHTTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ahiv::kafka::internal {
+// InFlightTable stores the entries of in flight requests in a slab which is
+// allocated once and indexed by correlation id. Correlation ids are handed out
+// sequentially, so as long as less than Capacity requests are in flight every
+// id maps to its own slot. Capacity must be a power of two
+template <typename Entry, std::size_t Capacity = 1024>
+class InFlightTable {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  InFlightTable() : slots(new Slot[Capacity]) {}
+
+  // Insert stores the entry for the correlation id. Returns false when the
+  // slot is still taken by an older request, which happens as soon as the
+  // ids in flight span Capacity, even with few requests in flight
+  bool Insert(int32_t correlationId, Entry&& entry) {
+    Slot& slot = this->slotOf(correlationId);
+    if (slot.occupied) {
+      return false;
+    }
+
+    slot.occupied = true;
+    slot.correlationId = correlationId;
+    slot.entry = std::move(entry);
+    if (this->size++ == 0) {
+      this->oldest = correlationId;
+    }
+
+    return true;
+  }
+
+  // Find returns the entry for the correlation id, or nullptr if there is no
+  // request in flight with this id
+  Entry* Find(int32_t correlationId) {
+    Slot& slot = this->slotOf(correlationId);
+    if (!slot.occupied || slot.correlationId != correlationId) {
+      return nullptr;
+    }
+
+    return &slot.entry;
+  }
+
+  // Erase frees the slot of the correlation id
+  void Erase(int32_t correlationId) {
+    Slot& slot = this->slotOf(correlationId);
+    if (!slot.occupied || slot.correlationId != correlationId) {
+      return;
+    }
+
+    slot.occupied = false;
+    slot.entry = Entry();
+    if (--this->size > 0 && correlationId == this->oldest) {
+      // the slot of an id may hold a newer id which wrapped around, the next
+      // oldest is the next id in flight
+      do {
+        this->oldest =
+            static_cast<int32_t>(static_cast<uint32_t>(this->oldest) + 1);
+      } while (this->Find(this->oldest) == nullptr);
+    }
+  }
+
+  // Oldest returns the entry which has been in flight the longest, or nullptr
+  // if the table is empty
+  Entry* Oldest() {
+    return this->size == 0 ? nullptr : &this->slotOf(this->oldest).entry;
+  }
+
+  std::size_t Size() const { return this->size; }
+
+  bool Empty() const { return this->size == 0; }
+
+ private:
+  struct Slot {
+    Entry entry;
+    int32_t correlationId = 0;
+    bool occupied = false;
+  };
+
+  Slot& slotOf(int32_t correlationId) {
+    return this->slots[static_cast<uint32_t>(correlationId) & (Capacity - 1)];
+  }
+
+  std::unique_ptr<Slot[]> slots;
+  std::size_t size = 0;
+  int32_t oldest = 0;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_INFLIGHTTABLE_H
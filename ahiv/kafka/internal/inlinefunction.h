@@ -0,0 +1,110 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_INLINEFUNCTION_H
+#define AHIV_KAFKA_INTERNAL_INLINEFUNCTION_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ahiv::kafka::internal {
+template <typename Signature, std::size_t Capacity>
+class InlineFunction;
+
+// InlineFunction is a move only replacement for std::function which stores the
+// callable in a fixed buffer of Capacity bytes inside the object. It never
+// allocates, callables which don't fit are rejected at compile time instead of
+// silently moving to the heap
+template <typename Result, typename... Arguments, std::size_t Capacity>
+class InlineFunction<Result(Arguments...), Capacity> {
+ public:
+  InlineFunction() = default;
+
+  template <typename Callable,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::decay_t<Callable>, InlineFunction>>>
+  InlineFunction(Callable&& callable) {
+    using Stored = std::decay_t<Callable>;
+    static_assert(sizeof(Stored) <= Capacity,
+                  "Callable does not fit into the inline storage, reduce its "
+                  "captures or raise the capacity");
+    static_assert(alignof(Stored) <= alignof(std::max_align_t),
+                  "Callable is over aligned for the inline storage");
+    static_assert(std::is_nothrow_move_constructible_v<Stored>,
+                  "Callable must be nothrow move constructible");
+
+    new (&this->storage) Stored(std::forward<Callable>(callable));
+    this->invoker = &invoke<Stored>;
+    this->manager = &manage<Stored>;
+  }
+
+  InlineFunction(InlineFunction&& other) noexcept { this->moveFrom(other); }
+
+  InlineFunction& operator=(InlineFunction&& other) noexcept {
+    if (this != &other) {
+      this->reset();
+      this->moveFrom(other);
+    }
+
+    return *this;
+  }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator=(const InlineFunction&) = delete;
+
+  ~InlineFunction() { this->reset(); }
+
+  Result operator()(Arguments... arguments) {
+    return this->invoker(&this->storage,
+                         std::forward<Arguments>(arguments)...);
+  }
+
+  explicit operator bool() const { return this->invoker != nullptr; }
+
+  // reset destroys the stored callable
+  void reset() {
+    if (this->manager != nullptr) {
+      this->manager(Operation::Destroy, &this->storage, nullptr);
+      this->invoker = nullptr;
+      this->manager = nullptr;
+    }
+  }
+
+ private:
+  enum class Operation { Move, Destroy };
+
+  template <typename Stored>
+  static Result invoke(void* storage, Arguments&&... arguments) {
+    return (*static_cast<Stored*>(storage))(
+        std::forward<Arguments>(arguments)...);
+  }
+
+  template <typename Stored>
+  static void manage(Operation operation, void* source, void* destination) {
+    auto* stored = static_cast<Stored*>(source);
+    if (operation == Operation::Move) {
+      new (destination) Stored(std::move(*stored));
+    }
+
+    stored->~Stored();
+  }
+
+  void moveFrom(InlineFunction& other) {
+    if (other.manager != nullptr) {
+      other.manager(Operation::Move, &other.storage, &this->storage);
+      this->invoker = other.invoker;
+      this->manager = other.manager;
+      other.invoker = nullptr;
+      other.manager = nullptr;
+    }
+  }
+
+  std::aligned_storage_t<Capacity, alignof(std::max_align_t)> storage;
+  Result (*invoker)(void*, Arguments&&...) = nullptr;
+  void (*manager)(Operation, void*, void*) = nullptr;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_INLINEFUNCTION_H
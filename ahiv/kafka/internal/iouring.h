@@ -0,0 +1,553 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_IOURING_H
+#define AHIV_KAFKA_INTERNAL_IOURING_H
+
+// The io_uring backend needs liburing 2.4 and Linux 6.0 or newer, build with
+// --config=io-uring to enable it. Connections use libuv for their socket I/O
+// otherwise.
+#ifdef AHIV_KAFKA_IO_URING
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ahiv/kafka/error.h"
+#include "ahiv/kafka/event.h"
+#include "ahiv/kafka/internal/bytestream.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::internal {
+// IOUringEntries is the size of the submission queue of a ring
+const unsigned IOUringEntries = 256;
+
+// IOUringReceiveBuffers is the amount of buffers in the provided buffer ring
+// of a ring, shared by the receives of all its streams. It has to be a power
+// of two
+const unsigned IOUringReceiveBuffers = 256;
+
+// IOUringReceiveBufferSize is the most a single receive completion carries
+const std::size_t IOUringReceiveBufferSize = 16 << 10;
+
+// IOUringBufferGroup is the id of the provided buffer ring
+const int IOUringBufferGroup = 0;
+
+// IOUringMaxVectors is the amount of queued writes gathered into one send
+const std::size_t IOUringMaxVectors = 64;
+
+// IOUringOperation is the operation of a stream a completion belongs to, it
+// is kept in the low bits of the user data next to the stream id
+enum class IOUringOperation : uint64_t { Receive = 1, Send = 2, Cancel = 3 };
+
+class IOUringStream;
+
+// IOUring is a ring with a provided buffer ring for receives. Streams queue
+// their operations on it, Submit hands all of them to the kernel with a
+// single system call and Reap dispatches the completions to their streams.
+// Driving the ring is up to the owner, see LoopIOUring
+class IOUring {
+ public:
+  // Create sets up a ring, nullptr when the kernel refuses io_uring or has no
+  // provided buffer rings
+  static std::shared_ptr<IOUring> Create() {
+    std::shared_ptr<IOUring> ring(new IOUring());
+    return ring->initialize() ? ring : nullptr;
+  }
+
+  virtual ~IOUring() {
+    if (this->bufferRing != nullptr) {
+      io_uring_free_buf_ring(&this->ring, this->bufferRing,
+                             IOUringReceiveBuffers, IOUringBufferGroup);
+    }
+    if (this->initialized) {
+      io_uring_queue_exit(&this->ring);
+    }
+  }
+
+  IOUring(const IOUring&) = delete;
+  IOUring& operator=(const IOUring&) = delete;
+
+  // Submission returns a free submission queue entry, the queued entries are
+  // submitted first when the queue is full
+  io_uring_sqe* Submission() {
+    io_uring_sqe* submission = io_uring_get_sqe(&this->ring);
+    if (submission == nullptr) {
+      io_uring_submit(&this->ring);
+      submission = io_uring_get_sqe(&this->ring);
+    }
+    return submission;
+  }
+
+  // Submit gathers the writes of the streams which asked for it and hands
+  // everything queued to the kernel
+  inline void Submit();
+
+  // Reap dispatches all available completions and returns their amount
+  inline std::size_t Reap();
+
+  // Register adds the stream and returns its id, the ring keeps the stream
+  // alive until it is unregistered
+  uint64_t Register(std::shared_ptr<IOUringStream> stream) {
+    uint64_t id = this->nextStreamId++;
+    this->streams.emplace(id, std::move(stream));
+    this->streamsChanged();
+    return id;
+  }
+
+  void Unregister(uint64_t id) {
+    if (this->streams.erase(id) > 0) {
+      this->streamsChanged();
+    }
+  }
+
+  // ScheduleSend gathers the queued writes of the stream into a send on the
+  // next Submit
+  void ScheduleSend(uint64_t id) { this->pendingSends.emplace_back(id); }
+
+  std::size_t Streams() const { return this->streams.size(); }
+
+ protected:
+  IOUring() = default;
+
+  bool initialize() {
+    if (io_uring_queue_init(IOUringEntries, &this->ring, 0) < 0) {
+      return false;
+    }
+    this->initialized = true;
+
+    int result;
+    this->bufferRing =
+        io_uring_setup_buf_ring(&this->ring, IOUringReceiveBuffers,
+                                IOUringBufferGroup, 0, &result);
+    if (this->bufferRing == nullptr) {
+      return false;
+    }
+
+    this->receiveBuffers.reset(
+        new char[IOUringReceiveBuffers * IOUringReceiveBufferSize]);
+    for (unsigned id = 0; id < IOUringReceiveBuffers; id++) {
+      this->provide(id, static_cast<int>(id));
+    }
+    io_uring_buf_ring_advance(this->bufferRing, IOUringReceiveBuffers);
+    return true;
+  }
+
+  // registerEventFD makes the kernel signal the eventfd on every completion
+  bool registerEventFD(int eventFD) {
+    return io_uring_register_eventfd(&this->ring, eventFD) == 0;
+  }
+
+  // streamsChanged is called whenever a stream has been added or removed
+  virtual void streamsChanged() {}
+
+ private:
+  // provide hands the receive buffer back to the kernel, at the given offset
+  // from the tail of the buffer ring
+  void provide(unsigned id, int offset) {
+    io_uring_buf_ring_add(
+        this->bufferRing,
+        this->receiveBuffers.get() + id * IOUringReceiveBufferSize,
+        IOUringReceiveBufferSize, static_cast<unsigned short>(id),
+        io_uring_buf_ring_mask(IOUringReceiveBuffers), offset);
+  }
+
+  inline void dispatch(uint64_t userData, int32_t result, uint32_t flags);
+
+  io_uring ring{};
+  bool initialized = false;
+  io_uring_buf_ring* bufferRing = nullptr;
+  std::unique_ptr<char[]> receiveBuffers;
+  std::unordered_map<uint64_t, std::shared_ptr<IOUringStream>> streams;
+  std::vector<uint64_t> pendingSends;
+  uint64_t nextStreamId = 1;
+};
+
+// QueuedWrite is a write of a stream which has not been sent completely
+struct QueuedWrite {
+  std::unique_ptr<char[]> data;
+  std::size_t length;
+};
+
+// IOUringStream does the socket I/O of a connection through an IOUring. A
+// single multishot receive stays armed while reading, every completion
+// carries a buffer of the provided buffer ring which is recycled after the
+// ReceivedEvent. Writes are gathered into one sendmsg, with at most one send
+// in flight so that partial sends keep their order. The stream stays
+// registered with the ring until its operations have been completed or
+// cancelled after Close
+class IOUringStream : public ByteStream,
+                      public std::enable_shared_from_this<IOUringStream> {
+ public:
+  IOUringStream(std::shared_ptr<IOUring> ring, int socket)
+      : ring(std::move(ring)), socket(socket) {}
+
+  // Start registers the stream with the ring, it is ready right away
+  void Start() override {
+    this->id = this->ring->Register(this->shared_from_this());
+    this->started = true;
+    this->scheduleSend();
+    this->publish(ConnectedEvent{});
+  }
+
+  void Read() override {
+    this->reading = true;
+    if (this->started && !this->closed && !this->receiveArmed) {
+      this->armReceive();
+    }
+  }
+
+  // Stop cancels the armed receive, data which is already on its way is
+  // still published
+  void Stop() override {
+    this->reading = false;
+    if (this->receiveArmed) {
+      this->cancel(IOUringOperation::Receive);
+    }
+  }
+
+  void Write(std::unique_ptr<char[]> data, std::size_t length) override {
+    this->queuedBytes += length;
+    this->writes.emplace_back(QueuedWrite{std::move(data), length});
+    this->scheduleSend();
+  }
+
+  // Close cancels the operations in flight. They are submitted right away,
+  // as the handle closes the socket next
+  void Close() override {
+    if (this->closed) {
+      return;
+    }
+
+    this->closed = true;
+    this->reading = false;
+    if (!this->started) {
+      return;
+    }
+
+    if (this->receiveArmed) {
+      this->cancel(IOUringOperation::Receive);
+    }
+    if (this->sendInFlight) {
+      this->cancel(IOUringOperation::Send);
+    }
+    this->ring->Submit();
+    this->unregisterWhenDone();
+  }
+
+  std::size_t QueuedBytes() const override { return this->queuedBytes; }
+
+  void Stats(BrokerStats& brokerStats) const override {
+    brokerStats.IOUring = true;
+  }
+
+  // OnCompletion handles a completion of an operation of this stream, buffer
+  // is the receive buffer it carries
+  void OnCompletion(IOUringOperation operation, int32_t result, uint32_t flags,
+                    const char* buffer) {
+    if (operation == IOUringOperation::Receive) {
+      this->onReceived(result, flags, buffer);
+    } else if (operation == IOUringOperation::Send) {
+      this->onSent(result);
+    }
+
+    this->unregisterWhenDone();
+  }
+
+  // FlushWrites gathers the queued writes into a send, unless one is in
+  // flight already
+  void FlushWrites() {
+    this->sendScheduled = false;
+    if (this->closed || this->sendInFlight || this->writes.empty()) {
+      return;
+    }
+
+    std::size_t count = 0;
+    for (auto& write : this->writes) {
+      if (count == IOUringMaxVectors) {
+        break;
+      }
+
+      std::size_t offset = count == 0 ? this->frontWritten : 0;
+      this->vectors[count].iov_base = write.data.get() + offset;
+      this->vectors[count].iov_len = write.length - offset;
+      count++;
+    }
+
+    this->message = msghdr{};
+    this->message.msg_iov = this->vectors.data();
+    this->message.msg_iovlen = count;
+
+    io_uring_sqe* submission = this->ring->Submission();
+    io_uring_prep_sendmsg(submission, this->socket, &this->message,
+                          MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(submission,
+                            this->userData(IOUringOperation::Send));
+    this->sendInFlight = true;
+  }
+
+ private:
+  void onReceived(int32_t result, uint32_t flags, const char* buffer) {
+    if ((flags & IORING_CQE_F_MORE) == 0) {
+      this->receiveArmed = false;
+    }
+
+    if (result > 0) {
+      if (!this->closed) {
+        this->publish(
+            ReceivedEvent{buffer, static_cast<std::size_t>(result)});
+      }
+    } else if (result == 0) {
+      this->fail("connection closed by the broker");
+    } else if (result != -ENOBUFS && result != -ECANCELED) {
+      this->fail(std::strerror(-result));
+    }
+
+    // the receive ends when the buffer ring ran dry, after Stop or after an
+    // error, it is armed again if it is still wanted
+    if (!this->receiveArmed && this->reading && !this->closed) {
+      this->armReceive();
+    }
+  }
+
+  void onSent(int32_t result) {
+    this->sendInFlight = false;
+    if (result < 0) {
+      if (result != -ECANCELED) {
+        this->fail(std::strerror(-result));
+      }
+      return;
+    }
+
+    auto sent = static_cast<std::size_t>(result);
+    this->queuedBytes -= sent;
+    while (sent > 0 && !this->writes.empty()) {
+      std::size_t remaining = this->writes.front().length - this->frontWritten;
+      if (sent < remaining) {
+        this->frontWritten += sent;
+        break;
+      }
+
+      sent -= remaining;
+      this->frontWritten = 0;
+      this->writes.pop_front();
+      this->publish(uvw::WriteEvent{});
+    }
+
+    this->FlushWrites();
+  }
+
+  void armReceive() {
+    io_uring_sqe* submission = this->ring->Submission();
+    io_uring_prep_recv_multishot(submission, this->socket, nullptr, 0, 0);
+    submission->flags |= IOSQE_BUFFER_SELECT;
+    submission->buf_group = IOUringBufferGroup;
+    io_uring_sqe_set_data64(submission,
+                            this->userData(IOUringOperation::Receive));
+    this->receiveArmed = true;
+  }
+
+  void cancel(IOUringOperation operation) {
+    io_uring_sqe* submission = this->ring->Submission();
+    io_uring_prep_cancel64(submission, this->userData(operation), 0);
+    io_uring_sqe_set_data64(submission,
+                            this->userData(IOUringOperation::Cancel));
+  }
+
+  void scheduleSend() {
+    if (this->started && !this->sendScheduled && !this->sendInFlight &&
+        !this->writes.empty()) {
+      this->sendScheduled = true;
+      this->ring->ScheduleSend(this->id);
+    }
+  }
+
+  void unregisterWhenDone() {
+    if (this->closed && !this->receiveArmed && !this->sendInFlight) {
+      this->ring->Unregister(this->id);
+    }
+  }
+
+  void fail(const std::string& reason) {
+    if (this->closed) {
+      return;
+    }
+
+    this->Close();
+    this->publish(ErrorEvent{
+        .Reason = std::string("io_uring socket I/O failed: ").append(reason),
+        .Error = Error::UnknownTCPError});
+  }
+
+  uint64_t userData(IOUringOperation operation) const {
+    return this->id << 2 | static_cast<uint64_t>(operation);
+  }
+
+  std::shared_ptr<IOUring> ring;
+  int socket;
+  uint64_t id = 0;
+  std::deque<QueuedWrite> writes;
+  std::size_t frontWritten = 0;
+  std::size_t queuedBytes = 0;
+  std::array<iovec, IOUringMaxVectors> vectors{};
+  msghdr message{};
+  bool started = false;
+  bool reading = false;
+  bool receiveArmed = false;
+  bool sendScheduled = false;
+  bool sendInFlight = false;
+  bool closed = false;
+};
+
+void IOUring::Submit() {
+  std::vector<uint64_t> scheduled;
+  scheduled.swap(this->pendingSends);
+  for (uint64_t id : scheduled) {
+    auto stream = this->streams.find(id);
+    if (stream != this->streams.end()) {
+      stream->second->FlushWrites();
+    }
+  }
+
+  if (io_uring_sq_ready(&this->ring) > 0) {
+    io_uring_submit(&this->ring);
+  }
+}
+
+std::size_t IOUring::Reap() {
+  std::size_t reaped = 0;
+  io_uring_cqe* completion;
+  while (io_uring_peek_cqe(&this->ring, &completion) == 0) {
+    uint64_t userData = io_uring_cqe_get_data64(completion);
+    int32_t result = completion->res;
+    uint32_t flags = completion->flags;
+    io_uring_cqe_seen(&this->ring, completion);
+
+    this->dispatch(userData, result, flags);
+    reaped++;
+  }
+
+  return reaped;
+}
+
+// dispatch hands the completion to its stream, completions of streams which
+// are gone only give their receive buffer back
+void IOUring::dispatch(uint64_t userData, int32_t result, uint32_t flags) {
+  auto operation = static_cast<IOUringOperation>(userData & 3);
+  const char* buffer = nullptr;
+  int bufferId = -1;
+  if ((flags & IORING_CQE_F_BUFFER) != 0) {
+    bufferId = static_cast<int>(flags >> IORING_CQE_BUFFER_SHIFT);
+    buffer = this->receiveBuffers.get() + bufferId * IOUringReceiveBufferSize;
+  }
+
+  auto stream = this->streams.find(userData >> 2);
+  if (stream != this->streams.end() &&
+      operation != IOUringOperation::Cancel) {
+    std::shared_ptr<IOUringStream> keep = stream->second;
+    keep->OnCompletion(operation, result, flags, buffer);
+  }
+
+  if (bufferId >= 0) {
+    this->provide(static_cast<unsigned>(bufferId), 0);
+    io_uring_buf_ring_advance(this->bufferRing, 1);
+  }
+}
+
+// LoopIOUring drives the IOUring of a loop. The kernel signals completions
+// on an eventfd which the loop polls, and everything the streams queued
+// during a loop iteration is submitted with one system call right before the
+// loop waits for events again. The eventfd keeps the loop alive only while
+// streams are registered
+class LoopIOUring : public IOUring {
+ public:
+  // Of returns the ring of the loop, nullptr when io_uring is not available
+  static std::shared_ptr<LoopIOUring> Of(
+      const std::shared_ptr<uvw::Loop>& loop) {
+    thread_local std::map<uvw::Loop*, std::weak_ptr<LoopIOUring>> rings;
+    auto& known = rings[loop.get()];
+    if (auto ring = known.lock()) {
+      return ring;
+    }
+
+    std::shared_ptr<LoopIOUring> ring(new LoopIOUring());
+    if (!ring->initialize() || !ring->attach(loop)) {
+      return nullptr;
+    }
+
+    known = ring;
+    return ring;
+  }
+
+  ~LoopIOUring() override {
+    if (this->poll != nullptr && !this->poll->closing()) {
+      this->poll->close();
+    }
+    if (this->prepare != nullptr && !this->prepare->closing()) {
+      this->prepare->close();
+    }
+    if (this->eventFD >= 0) {
+      close(this->eventFD);
+    }
+  }
+
+ protected:
+  void streamsChanged() override {
+    if (this->Streams() > 0) {
+      this->poll->reference();
+    } else {
+      this->poll->unreference();
+    }
+  }
+
+ private:
+  LoopIOUring() = default;
+
+  bool attach(const std::shared_ptr<uvw::Loop>& loop) {
+    this->eventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->eventFD < 0 || !this->registerEventFD(this->eventFD)) {
+      return false;
+    }
+
+    this->poll = loop->resource<uvw::PollHandle>(this->eventFD);
+    this->poll->on<uvw::PollEvent>(
+        [this](const uvw::PollEvent&, uvw::PollHandle&) {
+          uint64_t signals;
+          while (read(this->eventFD, &signals, sizeof(signals)) > 0) {
+          }
+          this->Reap();
+        });
+    this->poll->start(uvw::PollHandle::Event::READABLE);
+    this->poll->unreference();
+
+    this->prepare = loop->resource<uvw::PrepareHandle>();
+    this->prepare->on<uvw::PrepareEvent>(
+        [this](const uvw::PrepareEvent&, uvw::PrepareHandle&) {
+          this->Submit();
+        });
+    this->prepare->start();
+    this->prepare->unreference();
+    return true;
+  }
+
+  int eventFD = -1;
+  std::shared_ptr<uvw::PollHandle> poll;
+  std::shared_ptr<uvw::PrepareHandle> prepare;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_IO_URING
+
+#endif  // AHIV_KAFKA_INTERNAL_IOURING_H
@@ -0,0 +1,75 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_LOOPACTIVITY_H
+#define AHIV_KAFKA_INTERNAL_LOOPACTIVITY_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+#include "ahiv/kafka/stats.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::internal {
+// LoopActivity counts the broker I/O handled on a loop. The connections of
+// the loop record every received chunk and completed write, which lets a busy
+// polled loop tell iterations which found work from iterations which only
+// spun. It is used from the loop thread only
+class LoopActivity {
+ public:
+  // Of returns the activity of the loop, it is created on first use
+  static std::shared_ptr<LoopActivity> Of(
+      const std::shared_ptr<uvw::Loop>& loop) {
+    thread_local std::map<uvw::Loop*, std::weak_ptr<LoopActivity>> activities;
+    auto& known = activities[loop.get()];
+    if (auto activity = known.lock()) {
+      return activity;
+    }
+
+    auto activity = std::make_shared<LoopActivity>();
+    known = activity;
+    return activity;
+  }
+
+  // RecordEvent counts a received chunk or a completed write
+  void RecordEvent() { this->events++; }
+
+  uint64_t Events() const { return this->events; }
+
+  // RecordIteration accounts an iteration of a busy polled loop, busy tells
+  // if it handled any event
+  void RecordIteration(bool busy, std::chrono::nanoseconds duration) {
+    this->stats.Iterations++;
+    if (busy) {
+      this->busy += duration;
+    } else {
+      this->stats.SpinIterations++;
+      this->spin += duration;
+    }
+  }
+
+  // BusyPolled tells if the loop has been run by a busy poll loop
+  bool BusyPolled() const { return this->stats.Iterations > 0; }
+
+  LoopStats Stats() const {
+    LoopStats stats = this->stats;
+    stats.BusyUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(this->busy)
+            .count();
+    stats.SpinUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(this->spin)
+            .count();
+    return stats;
+  }
+
+ private:
+  uint64_t events = 0;
+  LoopStats stats{};
+  std::chrono::nanoseconds busy{0};
+  std::chrono::nanoseconds spin{0};
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_LOOPACTIVITY_H
@@ -0,0 +1,107 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_MEMORYBUDGET_H
+#define AHIV_KAFKA_INTERNAL_MEMORYBUDGET_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <limits>
+
+namespace ahiv::kafka::internal {
+// MemoryBudget accounts the bytes a connection holds in request and response
+// buffers against a limit. Requests reserve with TryReserve and are refused
+// when the budget is exhausted, received bytes are always accounted with
+// Reserve because they have been read already. Once the budget is exhausted
+// it stays blocked until usage dropped to the low watermark, so callers don't
+// flap between blocked and unblocked on every response. The listener is told
+// about both transitions. Accounting happens on the loop thread, Used may be
+// read from any thread
+class MemoryBudget {
+ public:
+  static constexpr std::size_t Unlimited =
+      std::numeric_limits<std::size_t>::max();
+
+  explicit MemoryBudget(std::size_t limit = Unlimited) : limit(limit) {}
+
+  // SetLimit changes the limit, an exhausted budget is rechecked right away
+  void SetLimit(std::size_t limit) {
+    this->limit = limit;
+    this->update();
+  }
+
+  // OnStateChange registers the listener which is called with true when the
+  // budget got exhausted and with false once it has been released again
+  void OnStateChange(std::function<void(bool)> listener) {
+    this->listener = std::move(listener);
+  }
+
+  // TryReserve accounts the bytes if they fit into the budget. A reservation
+  // larger than the whole budget fails without blocking the budget
+  bool TryReserve(std::size_t bytes) {
+    std::size_t current = this->Used();
+    if (!this->blocked && current <= this->limit &&
+        bytes <= this->limit - current) {
+      this->used.fetch_add(bytes, std::memory_order_relaxed);
+      return true;
+    }
+
+    if (current > this->lowWatermark()) {
+      this->setBlocked(true);
+    }
+    return false;
+  }
+
+  // Reserve accounts the bytes even if they exceed the budget
+  void Reserve(std::size_t bytes) {
+    this->used.fetch_add(bytes, std::memory_order_relaxed);
+    this->update();
+  }
+
+  void Release(std::size_t bytes) {
+    this->used.fetch_sub(bytes, std::memory_order_relaxed);
+    this->update();
+  }
+
+  // Blocked reports if the budget is exhausted
+  bool Blocked() const { return this->blocked; }
+
+  std::size_t Used() const {
+    return this->used.load(std::memory_order_relaxed);
+  }
+  std::size_t Limit() const { return this->limit; }
+
+ private:
+  // update blocks the budget above the limit and unblocks it at the low
+  // watermark of three quarters of the limit
+  void update() {
+    std::size_t current = this->Used();
+    if (!this->blocked && current > this->limit) {
+      this->setBlocked(true);
+    } else if (this->blocked && current <= this->lowWatermark()) {
+      this->setBlocked(false);
+    }
+  }
+
+  std::size_t lowWatermark() const { return this->limit / 4 * 3; }
+
+  void setBlocked(bool blocked) {
+    if (this->blocked == blocked) {
+      return;
+    }
+
+    this->blocked = blocked;
+    if (this->listener) {
+      this->listener(blocked);
+    }
+  }
+
+  std::size_t limit;
+  std::atomic<std::size_t> used{0};
+  bool blocked = false;
+  std::function<void(bool)> listener;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_MEMORYBUDGET_H
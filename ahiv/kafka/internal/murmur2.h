@@ -0,0 +1,105 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_MURMUR2_H
+#define AHIV_KAFKA_INTERNAL_MURMUR2_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ahiv::kafka::internal {
+constexpr uint32_t Murmur2Seed = 0x9747b28c;
+constexpr uint32_t Murmur2Multiplier = 0x5bd1e995;
+
+// murmur2Block reads four bytes little endian, like the Java client does
+inline uint32_t murmur2Block(const char* data) {
+  auto bytes = reinterpret_cast<const unsigned char*>(data);
+  return static_cast<uint32_t>(bytes[0]) |
+         static_cast<uint32_t>(bytes[1]) << 8 |
+         static_cast<uint32_t>(bytes[2]) << 16 |
+         static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+inline uint32_t murmur2Mix(uint32_t hash, uint32_t block) {
+  block *= Murmur2Multiplier;
+  block ^= block >> 24;
+  block *= Murmur2Multiplier;
+  return (hash * Murmur2Multiplier) ^ block;
+}
+
+// murmur2Finish hashes the blocks of the key from the given one on, the tail
+// bytes and applies the final avalanche
+inline uint32_t murmur2Finish(uint32_t hash, std::string_view key,
+                              std::size_t fromBlock) {
+  std::size_t blocks = key.size() / 4;
+  for (std::size_t block = fromBlock; block < blocks; block++) {
+    hash = murmur2Mix(hash, murmur2Block(key.data() + block * 4));
+  }
+
+  auto tail = reinterpret_cast<const unsigned char*>(key.data()) + blocks * 4;
+  switch (key.size() % 4) {
+    case 3:
+      hash ^= static_cast<uint32_t>(tail[2]) << 16;
+      [[fallthrough]];
+    case 2:
+      hash ^= static_cast<uint32_t>(tail[1]) << 8;
+      [[fallthrough]];
+    case 1:
+      hash ^= static_cast<uint32_t>(tail[0]);
+      hash *= Murmur2Multiplier;
+  }
+
+  hash ^= hash >> 13;
+  hash *= Murmur2Multiplier;
+  hash ^= hash >> 15;
+  return hash;
+}
+
+// Murmur2 is the murmur2 variant of the Java client, keys hash to the same
+// value and therefore land on the same partitions as records of JVM producers
+inline int32_t Murmur2(std::string_view key) {
+  uint32_t hash = Murmur2Seed ^ static_cast<uint32_t>(key.size());
+  return static_cast<int32_t>(murmur2Finish(hash, key, 0));
+}
+
+// Murmur2Bulk hashes count keys into hashes. Keys are hashed four at a time
+// with their blocks interleaved, which keeps four independent multiply chains
+// in flight instead of waiting on the latency of a single one
+inline void Murmur2Bulk(const std::string_view* keys, std::size_t count,
+                        int32_t* hashes) {
+  constexpr std::size_t Lanes = 4;
+  std::size_t key = 0;
+  for (; key + Lanes <= count; key += Lanes) {
+    uint32_t lane[Lanes];
+    std::size_t commonBlocks = keys[key].size() / 4;
+    for (std::size_t index = 0; index < Lanes; index++) {
+      lane[index] =
+          Murmur2Seed ^ static_cast<uint32_t>(keys[key + index].size());
+      commonBlocks = std::min(commonBlocks, keys[key + index].size() / 4);
+    }
+
+    for (std::size_t block = 0; block < commonBlocks; block++) {
+      for (std::size_t index = 0; index < Lanes; index++) {
+        lane[index] = murmur2Mix(
+            lane[index], murmur2Block(keys[key + index].data() + block * 4));
+      }
+    }
+
+    for (std::size_t index = 0; index < Lanes; index++) {
+      hashes[key + index] = static_cast<int32_t>(
+          murmur2Finish(lane[index], keys[key + index], commonBlocks));
+    }
+  }
+
+  for (; key < count; key++) {
+    hashes[key] = Murmur2(keys[key]);
+  }
+}
+
+// ToPositive clears the sign bit like Utils.toPositive of the Java client
+inline int32_t ToPositive(int32_t value) { return value & 0x7fffffff; }
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_MURMUR2_H
@@ -0,0 +1,61 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_OFFSETTRACKER_H
+#define AHIV_KAFKA_INTERNAL_OFFSETTRACKER_H
+
+#include <cstdint>
+#include <map>
+#include <optional>
+
+namespace ahiv::kafka::internal {
+// OffsetTracker follows the batches of a partition while they are processed
+// out of order and reports the contiguous processed offset, which is the
+// offset after the last batch that has been processed along with all batches
+// in front of it. A batch may be split into parts, it counts as processed
+// once every part has been completed. Batches have to be tracked in offset
+// order, the tracker is not thread safe
+class OffsetTracker {
+ public:
+  // Track registers a batch ending at lastOffset which is processed in parts
+  void Track(int64_t lastOffset, uint32_t parts) {
+    if (parts == 0) {
+      parts = 1;
+    }
+    this->outstanding[lastOffset] += parts;
+  }
+
+  // Complete marks one part of the batch ending at lastOffset as processed.
+  // Returns true if the committable offset advanced
+  bool Complete(int64_t lastOffset) {
+    auto batch = this->outstanding.find(lastOffset);
+    if (batch == this->outstanding.end() || batch->second == 0) {
+      return false;
+    }
+    batch->second--;
+
+    bool advanced = false;
+    while (!this->outstanding.empty() &&
+           this->outstanding.begin()->second == 0) {
+      this->committable = this->outstanding.begin()->first + 1;
+      this->outstanding.erase(this->outstanding.begin());
+      advanced = true;
+    }
+
+    return advanced;
+  }
+
+  // Committable returns the offset to resume consuming from, nothing if no
+  // batch has been processed yet
+  std::optional<int64_t> Committable() const { return this->committable; }
+
+  // Pending reports how many batches are still being processed
+  std::size_t Pending() const { return this->outstanding.size(); }
+
+ private:
+  std::map<int64_t, uint32_t> outstanding;
+  std::optional<int64_t> committable;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_OFFSETTRACKER_H
@@ -0,0 +1,50 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_PACINGGATE_H
+#define AHIV_KAFKA_INTERNAL_PACINGGATE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace ahiv::kafka::internal {
+// PacingGate holds the sends to a broker while the broker throttles the
+// client. Brokers answer a request which violated a quota right away along
+// with a throttle time and mute the connection for that time (KIP-219),
+// requests sent before it expired would only extend it. A throttle time never
+// shortens a hold which is already longer
+class PacingGate {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Throttle closes the gate for the throttle time reported by the broker
+  void Throttle(int32_t throttleTimeMs, Clock::time_point now = Clock::now()) {
+    if (throttleTimeMs <= 0) {
+      return;
+    }
+
+    this->opensAt = std::max(
+        this->opensAt, now + std::chrono::milliseconds(throttleTimeMs));
+  }
+
+  // IsOpen reports if requests may be sent
+  bool IsOpen(Clock::time_point now = Clock::now()) const {
+    return now >= this->opensAt;
+  }
+
+  // Remaining returns the time until the gate opens, zero if it is open
+  std::chrono::milliseconds Remaining(Clock::time_point now = Clock::now()) const {
+    if (this->IsOpen(now)) {
+      return std::chrono::milliseconds{0};
+    }
+
+    return std::chrono::ceil<std::chrono::milliseconds>(this->opensAt - now);
+  }
+
+ private:
+  Clock::time_point opensAt{};
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_PACINGGATE_H
@@ -0,0 +1,127 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_REPLICASELECTOR_H
+#define AHIV_KAFKA_INTERNAL_REPLICASELECTOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/metadata.h"
+
+namespace ahiv::kafka::internal {
+// ReplicaSelector picks the replica every partition is fetched from. Without
+// a client rack that is always the leader. With a rack, an in-sync replica in
+// the same rack is preferred (KIP-392), which keeps fetch traffic inside the
+// availability zone. The broker has the last word: a preferred read replica
+// in a fetch response is followed, and any error from a follower falls back
+// to the leader until the broker points to a follower again
+class ReplicaSelector {
+ public:
+  void SetClientRack(std::string rack) { this->clientRack = std::move(rack); }
+  const std::string& ClientRack() const { return this->clientRack; }
+
+  // UpdateBrokers takes the racks of the brokers from metadata
+  void UpdateBrokers(
+      const std::vector<protocol::packet::BrokerNodeInformation>& brokers) {
+    for (const auto& broker : brokers) {
+      this->brokerRacks[broker.nodeId] = broker.rack;
+    }
+  }
+
+  // UpdatePartition takes leader and in-sync replicas of a partition from
+  // metadata. The serving replica is kept while it is still in sync
+  void UpdatePartition(const std::string& topic,
+                       const protocol::packet::PartitionInformation& partition) {
+    auto& state = this->partitions[{topic, partition.partitionIndex}];
+    state.leaderId = partition.leaderId;
+    state.isr = partition.isr;
+
+    if (!state.preferred || !state.inSync(state.servingId)) {
+      state.servingId = this->closest(state);
+      state.preferred = false;
+    }
+  }
+
+  // OnFetchResponse applies the outcome of a fetch of the partition from its
+  // serving replica and returns the replica to fetch from next
+  int32_t OnFetchResponse(const std::string& topic, int32_t partitionIndex,
+                          int16_t errorCode, int32_t preferredReadReplica) {
+    auto known = this->partitions.find({topic, partitionIndex});
+    if (known == this->partitions.end()) {
+      return -1;
+    }
+
+    auto& state = known->second;
+    if (errorCode != 0) {
+      state.servingId = state.leaderId;
+      state.preferred = false;
+    } else if (preferredReadReplica >= 0) {
+      state.servingId = preferredReadReplica;
+      state.preferred = true;
+    }
+
+    return state.servingId;
+  }
+
+  // ServingReplica returns the node id the partition is fetched from, -1 if
+  // the partition is unknown
+  int32_t ServingReplica(const std::string& topic,
+                         int32_t partitionIndex) const {
+    auto known = this->partitions.find({topic, partitionIndex});
+    return known != this->partitions.end() ? known->second.servingId : -1;
+  }
+
+  // LeaderId returns the leader of the partition, -1 if it is unknown
+  int32_t LeaderId(const std::string& topic, int32_t partitionIndex) const {
+    auto known = this->partitions.find({topic, partitionIndex});
+    return known != this->partitions.end() ? known->second.leaderId : -1;
+  }
+
+ private:
+  struct PartitionState {
+    int32_t leaderId = -1;
+    int32_t servingId = -1;
+    // Preferred is set when the serving replica was picked by the broker
+    bool preferred = false;
+    std::vector<int32_t> isr;
+
+    bool inSync(int32_t nodeId) const {
+      return nodeId == this->leaderId ||
+             std::find(this->isr.begin(), this->isr.end(), nodeId) !=
+                 this->isr.end();
+    }
+  };
+
+  // closest returns the leader if it is in the rack of the client, else the
+  // first in-sync replica which is, falling back to the leader
+  int32_t closest(const PartitionState& state) const {
+    if (this->clientRack.empty() || this->inClientRack(state.leaderId)) {
+      return state.leaderId;
+    }
+
+    for (auto replica : state.isr) {
+      if (this->inClientRack(replica)) {
+        return replica;
+      }
+    }
+
+    return state.leaderId;
+  }
+
+  bool inClientRack(int32_t nodeId) const {
+    auto rack = this->brokerRacks.find(nodeId);
+    return rack != this->brokerRacks.end() && rack->second == this->clientRack;
+  }
+
+  std::string clientRack;
+  std::map<int32_t, std::string> brokerRacks;
+  std::map<std::pair<std::string, int32_t>, PartitionState> partitions;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_REPLICASELECTOR_H
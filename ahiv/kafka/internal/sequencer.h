@@ -0,0 +1,250 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_SEQUENCER_H
+#define AHIV_KAFKA_INTERNAL_SEQUENCER_H
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "ahiv/kafka/internal/errorcodes.h"
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+
+namespace ahiv::kafka::internal {
+// BatchSequence is the producer identity and sequence of a single batch
+struct BatchSequence {
+  int64_t producerId;
+  int16_t producerEpoch;
+  int32_t baseSequence;
+};
+
+// SequenceOutcome tells the producer what to do with a batch which failed
+enum class SequenceOutcome {
+  // Retry sends the batch again with its sequence, also to a new leader
+  Retry,
+  // Acknowledged means the broker already wrote the batch
+  Acknowledged,
+  // ResetProducer needs a new producer id or epoch before sending again, all
+  // in flight batches are renumbered once it has been set
+  ResetProducer,
+  // Drop gives up on the batch, batches behind it are renumbered to close the
+  // gap
+  Drop
+};
+
+// Sequencer assigns idempotent producer sequences per partition. Sequences
+// are assigned when a batch is sent and stay with the batch on retries, so
+// multiple batches per partition can be in flight without the broker
+// reordering or duplicating them. Batches are identified by the id returned
+// from Assign, the sequence behind an id changes when the producer is reset
+class Sequencer {
+ public:
+  // MaxInFlightPerPartition is the highest amount of in flight batches per
+  // partition the broker keeps sequence state for
+  static constexpr std::size_t MaxInFlightPerPartition = 5;
+
+  bool HasProducerId() const { return this->producerId >= 0; }
+  int64_t ProducerId() const { return this->producerId; }
+  int16_t ProducerEpoch() const { return this->producerEpoch; }
+
+  // ResetPending is set from a ResetProducer outcome until the new identity
+  // has been set, no batch may be sent meanwhile
+  bool ResetPending() const { return this->resetPending; }
+
+  // SetProducerId stores the identity received via InitProducerId. When it
+  // replaces an older identity the sequences of all partitions start at 0
+  // again and the batches in flight are renumbered in their send order
+  void SetProducerId(int64_t producerId, int16_t producerEpoch) {
+    bool changed = producerId != this->producerId ||
+                   producerEpoch != this->producerEpoch;
+    this->producerId = producerId;
+    this->producerEpoch = producerEpoch;
+    this->resetPending = false;
+
+    if (changed) {
+      for (auto& [topicPartition, partition] : this->partitions) {
+        this->renumber(partition, 0, 0);
+      }
+    }
+  }
+
+  // CanSend checks if a new batch may be sent to the partition
+  bool CanSend(const std::string& topic, int32_t partitionIndex) const {
+    if (!this->HasProducerId() || this->resetPending) {
+      return false;
+    }
+
+    auto partition = this->partitions.find({topic, partitionIndex});
+    return partition == this->partitions.end() ||
+           partition->second.inFlight.size() < MaxInFlightPerPartition;
+  }
+
+  // Assign reserves the next recordCount sequences of the partition for a new
+  // batch and returns its id, nothing when the batch can't be sent yet
+  std::optional<uint64_t> Assign(const std::string& topic,
+                                 int32_t partitionIndex, int32_t recordCount) {
+    if (!this->CanSend(topic, partitionIndex)) {
+      return std::nullopt;
+    }
+
+    auto& partition = this->partitions[{topic, partitionIndex}];
+    uint64_t batchId = this->nextBatchId++;
+    partition.inFlight.push_back(
+        InFlightBatch{batchId, partition.nextSequence, recordCount});
+    partition.nextSequence = advance(partition.nextSequence, recordCount);
+    return batchId;
+  }
+
+  // Sequence returns the current sequence of the batch
+  std::optional<BatchSequence> Sequence(const std::string& topic,
+                                        int32_t partitionIndex,
+                                        uint64_t batchId) const {
+    auto partition = this->partitions.find({topic, partitionIndex});
+    if (partition == this->partitions.end()) {
+      return std::nullopt;
+    }
+
+    for (const auto& batch : partition->second.inFlight) {
+      if (batch.id == batchId) {
+        return BatchSequence{this->producerId, this->producerEpoch,
+                             batch.baseSequence};
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Stamp writes the current sequence of the batch into its header, it must
+  // be called again before a batch is retried
+  bool Stamp(const std::string& topic, int32_t partitionIndex,
+             uint64_t batchId,
+             protocol::packet::RecordBatchHeader& header) const {
+    auto sequence = this->Sequence(topic, partitionIndex, batchId);
+    if (!sequence.has_value()) {
+      return false;
+    }
+
+    header.producerId = sequence->producerId;
+    header.producerEpoch = sequence->producerEpoch;
+    header.baseSequence = sequence->baseSequence;
+    return true;
+  }
+
+  // Acknowledge removes a batch the broker has written
+  void Acknowledge(const std::string& topic, int32_t partitionIndex,
+                   uint64_t batchId) {
+    auto partition = this->partitions.find({topic, partitionIndex});
+    if (partition == this->partitions.end()) {
+      return;
+    }
+
+    auto& inFlight = partition->second.inFlight;
+    for (auto batch = inFlight.begin(); batch != inFlight.end(); batch++) {
+      if (batch->id == batchId) {
+        inFlight.erase(batch);
+        return;
+      }
+    }
+  }
+
+  // Fail decides how a batch which the broker rejected with the error code
+  // continues
+  SequenceOutcome Fail(const std::string& topic, int32_t partitionIndex,
+                       uint64_t batchId, ErrorCode errorCode) {
+    switch (errorCode) {
+      case ErrorCode::DUPLICATE_SEQUENCE_NUMBER:
+        this->Acknowledge(topic, partitionIndex, batchId);
+        return SequenceOutcome::Acknowledged;
+      case ErrorCode::OUT_OF_ORDER_SEQUENCE_NUMBER:
+      case ErrorCode::UNKNOWN_PRODUCER_ID:
+      case ErrorCode::INVALID_PRODUCER_EPOCH:
+        this->resetPending = true;
+        return SequenceOutcome::ResetProducer;
+      case ErrorCode::NOT_ENOUGH_REPLICAS:
+      case ErrorCode::NOT_ENOUGH_REPLICAS_AFTER_APPEND:
+        return SequenceOutcome::Retry;
+      default:
+        break;
+    }
+
+    if (IsErrorCodeRetryable(errorCode)) {
+      return SequenceOutcome::Retry;
+    }
+
+    this->drop(topic, partitionIndex, batchId);
+    return SequenceOutcome::Drop;
+  }
+
+  // InFlight returns the amount of unacknowledged batches of the partition
+  std::size_t InFlight(const std::string& topic, int32_t partitionIndex) const {
+    auto partition = this->partitions.find({topic, partitionIndex});
+    return partition == this->partitions.end()
+               ? 0
+               : partition->second.inFlight.size();
+  }
+
+ private:
+  struct InFlightBatch {
+    uint64_t id;
+    int32_t baseSequence;
+    int32_t recordCount;
+  };
+
+  struct PartitionSequence {
+    int32_t nextSequence = 0;
+    std::deque<InFlightBatch> inFlight;
+  };
+
+  // advance moves a sequence forward, sequences wrap around to 0 after the
+  // highest int32
+  static int32_t advance(int32_t sequence, int32_t count) {
+    int64_t next = static_cast<int64_t>(sequence) + count;
+    return static_cast<int32_t>(
+        next % (static_cast<int64_t>(std::numeric_limits<int32_t>::max()) + 1));
+  }
+
+  // renumber assigns consecutive sequences to the batches in flight starting
+  // at the given index and sequence
+  void renumber(PartitionSequence& partition, std::size_t fromIndex,
+                int32_t sequence) {
+    for (std::size_t index = fromIndex; index < partition.inFlight.size();
+         index++) {
+      partition.inFlight[index].baseSequence = sequence;
+      sequence = advance(sequence, partition.inFlight[index].recordCount);
+    }
+    partition.nextSequence = sequence;
+  }
+
+  // drop removes a batch and shifts the batches behind it down
+  void drop(const std::string& topic, int32_t partitionIndex,
+            uint64_t batchId) {
+    auto partition = this->partitions.find({topic, partitionIndex});
+    if (partition == this->partitions.end()) {
+      return;
+    }
+
+    auto& inFlight = partition->second.inFlight;
+    for (std::size_t index = 0; index < inFlight.size(); index++) {
+      if (inFlight[index].id == batchId) {
+        int32_t sequence = inFlight[index].baseSequence;
+        inFlight.erase(inFlight.begin() + index);
+        this->renumber(partition->second, index, sequence);
+        return;
+      }
+    }
+  }
+
+  int64_t producerId = -1;
+  int16_t producerEpoch = -1;
+  bool resetPending = false;
+  uint64_t nextBatchId = 0;
+  std::map<std::pair<std::string, int32_t>, PartitionSequence> partitions;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_SEQUENCER_H
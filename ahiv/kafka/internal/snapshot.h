@@ -0,0 +1,293 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_SNAPSHOT_H
+#define AHIV_KAFKA_INTERNAL_SNAPSHOT_H
+
+// Snapshots are written and mapped with POSIX calls. Elsewhere saving and
+// loading fail, so clients start without a warm start
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ahiv/kafka/protocol/endian.h"
+#include "ahiv/kafka/protocol/packet/metadata.h"
+
+namespace ahiv::kafka::internal {
+// SnapshotPartition is a partition with its last known leader and the
+// position the consumer had reached, -1 if it had none
+struct SnapshotPartition {
+  int32_t partitionIndex{};
+  int32_t leaderId = -1;
+  int64_t position = -1;
+
+  using Schema = protocol::schema::Fields<
+      protocol::schema::Field<&SnapshotPartition::partitionIndex>,
+      protocol::schema::Field<&SnapshotPartition::leaderId>,
+      protocol::schema::Field<&SnapshotPartition::position>>;
+};
+
+struct SnapshotTopic {
+  std::string name;
+  std::vector<SnapshotPartition> partitions;
+
+  using Schema = protocol::schema::Fields<
+      protocol::schema::Field<&SnapshotTopic::name>,
+      protocol::schema::Field<&SnapshotTopic::partitions>>;
+};
+
+// WarmStartSnapshot is the last known cluster metadata and consumer
+// positions of a client. A restarting client connects to the brokers of the
+// snapshot right away instead of waiting for bootstrap and metadata, the
+// snapshot is replaced once the real metadata arrived.
+//
+// The file starts with a fixed header (magic, version, payload length and an
+// FNV-1a checksum of the payload) followed by the schema encoded payload. It
+// is mapped and validated before anything is decoded, damaged or foreign
+// files are ignored
+struct WarmStartSnapshot {
+  static constexpr uint32_t Magic = 0x41484b53;  // "AHKS"
+  static constexpr uint16_t Version = 1;
+  static constexpr std::size_t HeaderSize = 20;
+
+  // WrittenAt is the time the snapshot has been taken, in milliseconds since
+  // the epoch
+  int64_t writtenAt{};
+  std::string clusterId;
+  std::vector<protocol::packet::BrokerNodeInformation> brokers;
+  std::vector<SnapshotTopic> topics;
+
+  using Schema = protocol::schema::Fields<
+      protocol::schema::Field<&WarmStartSnapshot::writtenAt>,
+      protocol::schema::Field<&WarmStartSnapshot::clusterId>,
+      protocol::schema::Field<&WarmStartSnapshot::brokers>,
+      protocol::schema::Field<&WarmStartSnapshot::topics>>;
+
+  // FromMetadata takes brokers and leaders from the metadata response, the
+  // positions are kept from the given previous snapshot
+  static WarmStartSnapshot FromMetadata(
+      const protocol::packet::MetadataResponsePacket& metadata,
+      const WarmStartSnapshot* previous = nullptr) {
+    WarmStartSnapshot snapshot;
+    snapshot.writtenAt =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    snapshot.clusterId = metadata.clusterId;
+    snapshot.brokers = metadata.brokers;
+
+    for (const auto& topicInformation : metadata.topicInformation) {
+      if (topicInformation.errorCode != 0) {
+        continue;
+      }
+
+      SnapshotTopic topic;
+      topic.name = topicInformation.name;
+      for (const auto& partition : topicInformation.partitionInformation) {
+        int64_t position =
+            previous != nullptr
+                ? previous->Position(topic.name, partition.partitionIndex)
+                : -1;
+        topic.partitions.emplace_back(SnapshotPartition{
+            partition.partitionIndex, partition.leaderId, position});
+      }
+      snapshot.topics.emplace_back(std::move(topic));
+    }
+
+    return snapshot;
+  }
+
+  // ToTopicInformation converts a snapshot topic back into metadata, so it can
+  // be handled like a topic of a metadata response
+  static protocol::packet::TopicInformation ToTopicInformation(
+      const SnapshotTopic& topic) {
+    protocol::packet::TopicInformation topicInformation;
+    topicInformation.name = topic.name;
+    for (const auto& partition : topic.partitions) {
+      protocol::packet::PartitionInformation partitionInformation;
+      partitionInformation.partitionIndex = partition.partitionIndex;
+      partitionInformation.leaderId = partition.leaderId;
+      topicInformation.partitionInformation.emplace_back(
+          std::move(partitionInformation));
+    }
+
+    return topicInformation;
+  }
+
+  // Position returns the stored position of the partition, -1 if unknown
+  int64_t Position(const std::string& topicName, int32_t partitionIndex) const {
+    for (const auto& topic : this->topics) {
+      if (topic.name != topicName) {
+        continue;
+      }
+
+      for (const auto& partition : topic.partitions) {
+        if (partition.partitionIndex == partitionIndex) {
+          return partition.position;
+        }
+      }
+    }
+
+    return -1;
+  }
+
+  // SetPosition stores the position of a partition which is part of the
+  // snapshot
+  void SetPosition(const std::string& topicName, int32_t partitionIndex,
+                   int64_t position) {
+    for (auto& topic : this->topics) {
+      if (topic.name != topicName) {
+        continue;
+      }
+
+      for (auto& partition : topic.partitions) {
+        if (partition.partitionIndex == partitionIndex) {
+          partition.position = position;
+        }
+      }
+    }
+  }
+
+  // Save writes the snapshot to a temporary file next to the path, syncs it
+  // and renames it over the path, so readers never see a partial snapshot,
+  // not even after a crash of the machine
+  bool Save(const std::string& path) const {
+#if defined(__unix__) || defined(__APPLE__)
+    std::size_t payloadSize = Schema::Size(*this);
+    protocol::Buffer buffer;
+    buffer.EnsureAllocated(HeaderSize + payloadSize);
+    buffer.Reserve(HeaderSize);
+    Schema::Encode(*this, buffer);
+
+    const char* payload = buffer.View(HeaderSize);
+    char* header = const_cast<char*>(buffer.View(0));
+    protocol::schema::Codec<uint32_t>::EncodeFixed(Magic, header);
+    protocol::schema::Codec<uint16_t>::EncodeFixed(Version, header + 4);
+    protocol::schema::Codec<uint16_t>::EncodeFixed(0, header + 6);
+    protocol::schema::Codec<uint32_t>::EncodeFixed(payloadSize, header + 8);
+    protocol::schema::Codec<uint64_t>::EncodeFixed(
+        checksum(payload, payloadSize), header + 12);
+
+    std::string temporaryPath = path + ".tmp";
+    int fd = ::open(temporaryPath.c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+
+    const char* data = buffer.View(0);
+    std::size_t written = 0;
+    while (written < buffer.Size()) {
+      ssize_t result = ::write(fd, data + written, buffer.Size() - written);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      if (result < 0) {
+        ::close(fd);
+        ::unlink(temporaryPath.c_str());
+        return false;
+      }
+      written += result;
+    }
+
+    if (::fsync(fd) != 0) {
+      ::close(fd);
+      ::unlink(temporaryPath.c_str());
+      return false;
+    }
+
+    ::close(fd);
+    return std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+#else
+    return false;
+#endif
+  }
+
+  // Load maps the snapshot file and decodes it if it is valid
+  static std::optional<WarmStartSnapshot> Load(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return std::nullopt;
+    }
+
+    struct stat fileStat {};
+    if (::fstat(fd, &fileStat) != 0 ||
+        static_cast<std::size_t>(fileStat.st_size) < HeaderSize) {
+      ::close(fd);
+      return std::nullopt;
+    }
+
+    std::size_t fileSize = fileStat.st_size;
+    void* mapping = ::mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      return std::nullopt;
+    }
+
+    auto snapshot = decode(static_cast<const char*>(mapping), fileSize);
+    ::munmap(mapping, fileSize);
+    return snapshot;
+#else
+    return std::nullopt;
+#endif
+  }
+
+ private:
+  static uint64_t checksum(const char* data, std::size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (std::size_t index = 0; index < size; index++) {
+      hash ^= static_cast<unsigned char>(data[index]);
+      hash *= 0x100000001b3;
+    }
+    return hash;
+  }
+
+  // decode validates the header and payload in the mapped file before the
+  // payload is copied and decoded
+  static std::optional<WarmStartSnapshot> decode(const char* data,
+                                                 std::size_t size) {
+    uint32_t magic, payloadSize;
+    uint16_t version;
+    uint64_t expectedChecksum;
+    std::memcpy(&magic, data, 4);
+    std::memcpy(&version, data + 4, 2);
+    std::memcpy(&payloadSize, data + 8, 4);
+    std::memcpy(&expectedChecksum, data + 12, 8);
+
+    if (be32toh(magic) != Magic || be16toh(version) != Version ||
+        be32toh(payloadSize) != size - HeaderSize ||
+        checksum(data + HeaderSize, size - HeaderSize) !=
+            be64toh(expectedChecksum)) {
+      return std::nullopt;
+    }
+
+    protocol::Buffer buffer;
+    buffer.EnsureAllocated(size);
+    buffer.WriteData(data, size);
+    buffer.SeekRead(HeaderSize);
+
+    WarmStartSnapshot snapshot;
+    Schema::Decode(snapshot, buffer);
+    if (buffer.ReadPosition() != size) {
+      return std::nullopt;
+    }
+
+    return snapshot;
+  }
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_SNAPSHOT_H
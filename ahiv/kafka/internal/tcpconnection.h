@@ -4,111 +4,235 @@
 #ifndef AHIV_KAFKA_INTERNAL_TCPCONNECTION_H
 #define AHIV_KAFKA_INTERNAL_TCPCONNECTION_H
 
+// The socket options of the low latency mode are set with POSIX calls,
+// elsewhere only the options libuv offers are applied
+#if defined(__unix__) || defined(__APPLE__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 #include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <queue>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 #include "ahiv/kafka/connectionconfig.h"
+#include "ahiv/kafka/internal/bytestream.h"
+#include "ahiv/kafka/internal/connectionstats.h"
+#include "ahiv/kafka/internal/framecapture.h"
+#include "ahiv/kafka/internal/inflighttable.h"
+#include "ahiv/kafka/internal/inlinefunction.h"
+#include "ahiv/kafka/internal/iouring.h"
+#include "ahiv/kafka/internal/loopactivity.h"
+#include "ahiv/kafka/internal/memorybudget.h"
+#include "ahiv/kafka/internal/pacinggate.h"
+#include "ahiv/kafka/internal/timerwheel.h"
+#include "ahiv/kafka/internal/tlssession.h"
 #include "ahiv/kafka/protocol/buffer.h"
 #include "ahiv/kafka/protocol/packet/metadata.h"
+#include "ahiv/kafka/trace.h"
 #include "ahiv/kafka/util.h"
 #include "uvw.hpp"
 
 namespace ahiv::kafka::internal {
+// ConnectionAttemptDelay is the time to wait for a connection attempt before
+// racing it against the next resolved address, as recommended by RFC 8305
+const uvw::TimerHandle::Time ConnectionAttemptDelay{250};
+
+// InlineCallbackCapacity is the amount of bytes a response callback and its
+// captures may use, see InlineFunction
+const std::size_t InlineCallbackCapacity = 64;
+
+// DefaultRequestTimeout is the time to wait for the response to a request
+const std::chrono::milliseconds DefaultRequestTimeout{30000};
+
+// MaxInFlightRequests is the amount of requests which can be in flight on a
+// single connection
+const std::size_t MaxInFlightRequests = 1024;
+
+// InlineResponseCallback receives the response frame of a request, or
+// nullptr and the error when the request failed
+using InlineResponseCallback =
+    InlineFunction<void(protocol::Buffer*, Error), InlineCallbackCapacity>;
+
+// IgnoreFailure is the failure callback of requests whose failures are only
+// reported as ErrorEvent
+struct IgnoreFailure {
+  void operator()(Error) const {}
+};
+
 struct ResponseCorrelationCallback {
   int32_t correlationId;
-  const ahiv::kafka::ResponseCallback<protocol::Buffer> responseCallback;
+  int16_t apiKey;
+  std::chrono::steady_clock::time_point sentAt;
+  InlineResponseCallback responseCallback;
+  TimerId timeout;
+};
+
+// PendingWrite is a request which has been handed to the socket but not
+// fully written yet
+struct PendingWrite {
+  int32_t correlationId;
+  int16_t apiKey;
+  std::size_t bytes;
 };
 
-class TCPConnection : public uvw::Emitter<TCPConnection> {
+// HeldRequest is a serialized request which waits for the pacing gate of a
+// throttled connection
+struct HeldRequest {
+  protocol::Buffer buffer;
+  int32_t correlationId;
+  int16_t apiKey;
+  InlineResponseCallback responseCallback;
+};
+
+// StreamHandle is the connected handle of a broker connection, the pipe
+// handle of unix:// brokers and the TCP handle of all others
+using StreamHandle = std::variant<std::shared_ptr<uvw::TCPHandle>,
+                                  std::shared_ptr<uvw::PipeHandle>>;
+
+// BasicTCPConnection is a single connection to a broker. The Tracer policy
+// receives a hook call for every stage of every request, see trace.h. Request
+// buffers and received bytes are accounted against the memory budget, which
+// is shared by all connections of a client
+template <typename Tracer = trace::DefaultTracer>
+class BasicTCPConnection : public uvw::Emitter<BasicTCPConnection<Tracer>> {
  public:
-  TCPConnection(const std::shared_ptr<uvw::Loop>& loop,
-                const std::shared_ptr<ConnectionConfig>& connectionConfig) {
-    this->handle = loop->resource<uvw::TCPHandle>();
+  BasicTCPConnection(const std::shared_ptr<uvw::Loop>& loop,
+                     const std::shared_ptr<ConnectionConfig>& connectionConfig,
+                     const std::shared_ptr<MemoryBudget>& memoryBudget =
+                         std::make_shared<MemoryBudget>()) {
+    this->loop = loop;
     this->connectionConfig = connectionConfig;
+    this->memoryBudget = memoryBudget;
 
-    this->handle->on<uvw::ErrorEvent>(
-        [this](const uvw::ErrorEvent& errorEvent, auto&) {
-          const char* errorName = errorEvent.name();
-          if (strncmp(errorName, "ECONNREFUSED", 12) == 0) {
-            this->publish(
-                ErrorEvent{.Reason = std::string("Could not connect to IP ")
-                                         .append(errorEvent.what()),
-                           .Error = Error::TCPConnectionRefused});
-          } else {
-            this->publish(
-                ErrorEvent{.Reason = std::string("Got unknown TCP error: ")
-                                         .append(errorEvent.what()),
-                           .Error = Error::UnknownTCPError});
-          }
+    this->attemptTimer = loop->resource<uvw::TimerHandle>();
+    this->attemptTimer->on<uvw::TimerEvent>(
+        [this](const uvw::TimerEvent&, auto&) {
+          this->connectToNextAddress();
         });
 
-    this->handle->once<uvw::ConnectEvent>(
-        [this](const uvw::ConnectEvent&, uvw::TCPHandle& newTcpHandle) {
-          newTcpHandle.read();
-          this->publish(ConnectedEvent{});
-        });
-
-    this->handle->on<uvw::DataEvent>([this](const uvw::DataEvent& event,
-                                            uvw::TCPHandle&) {
-      ahiv::kafka::protocol::Buffer buffer;
-      buffer.EnsureAllocated(event.length);
-      buffer.WriteData(event.data.get(), event.length);
-      int32_t payloadLength = buffer.Read<int32_t>();
-      int32_t correlationId = buffer.Read<int32_t>();
-
-      ResponseCorrelationCallback callback = this->responseCallbacks.front();
-      if (callback.correlationId == correlationId) {
-        this->responseCallbacks.pop();
-        buffer.ResetReadPosition();
-        callback.responseCallback(buffer);
-      } else {
-        DumpAsHex(event.data.get(), event.length);
-      }
-    });
+    this->timers = LoopTimerWheel::Of(loop);
+    this->activity = LoopActivity::Of(loop);
 
-    this->handle->connect(*connectionConfig->address->resolvedAddress);
+    const auto& addresses = connectionConfig->address->resolvedAddresses;
+    if (connectionConfig->connectionType == ConnectionType::Unix) {
+      this->connectToPath();
+    } else if (addresses == nullptr || addresses->empty()) {
+      // nobody listens yet, the failure is reported from the loop
+      this->attemptTimer->start(uvw::TimerHandle::Time{0},
+                                uvw::TimerHandle::Time{0});
+    } else {
+      this->connectToNextAddress();
+    }
   }
 
   // On registers a listener for the given event via the E template type. This
   // listener gets called every time the event E is published on this instance
   template <typename E>
-  void On(std::function<void(E&, TCPConnection&)> listener) {
-    this->on<E>(listener);
+  void On(std::function<void(E&, BasicTCPConnection&)> listener) {
+    this->template on<E>(listener);
   }
 
   // Once registers a listener for the given event via the E template type. This
   // listener gets called on the first time the event E is published on this
   // instance
   template <typename E>
-  void Once(std::function<void(E&, TCPConnection&)> listener) {
-    this->once<E>(listener);
+  void Once(std::function<void(E&, BasicTCPConnection&)> listener) {
+    this->template once<E>(listener);
   }
 
   // Send will serialize a packet, transmit it over TCP and deserialize its
-  // response packet and call the given callback
-  template <typename Message>
-  void Send(typename Message::Request& request,
-            ahiv::kafka::ResponseCallback<typename Message::Response>
-                responseCallback) {
+  // response packet and call the given callback. When no response arrives in
+  // time the failure callback is called with Error::RequestTimedOut instead,
+  // a held request which can't be written once the throttle time is over
+  // fails with Error::TooManyInFlightRequests.
+  // Both callbacks are stored inline without allocating, they have to fit
+  // into InlineCallbackCapacity together with the bookkeeping of this call.
+  // Returns false when the request has not been sent because the memory
+  // budget is exhausted or too many requests are in flight, no callback is
+  // called in that case. While the broker throttles this connection requests
+  // are held back and sent once the throttle time is over
+  template <typename Message, typename Callback,
+            typename FailureCallback = IgnoreFailure>
+  bool Send(typename Message::Request& request, Callback&& responseCallback,
+            FailureCallback&& failureCallback = FailureCallback{}) {
+    std::size_t requestSize = request.Size();
+    if (!this->memoryBudget->TryReserve(requestSize)) {
+      return false;
+    }
+
+    int32_t correlationId = this->idCounter.fetch_add(1);
+    int16_t apiKey = request.apiKey;
+    Tracer::Hit(trace::Stage::Enqueue, correlationId, apiKey);
+
     ahiv::kafka::protocol::Buffer requestBuffer;
-    requestBuffer.EnsureAllocated(request.Size());
+    requestBuffer.EnsureAllocated(requestSize);
     request.Write(requestBuffer);
+    requestBuffer.Overwrite<int32_t>(8, correlationId);
+    Tracer::Hit(trace::Stage::Serialize, correlationId, apiKey);
+
+    InlineResponseCallback callback(
+                [this, responseCallback = std::forward<Callback>(responseCallback),
+                 failureCallback =
+                     std::forward<FailureCallback>(failureCallback),
+                 correlationId, apiKey](protocol::Buffer* respBuffer,
+                                        Error error) mutable {
+                  if (respBuffer == nullptr) {
+                    failureCallback(error);
+                    return;
+                  }
 
-    this->write(requestBuffer,
-                [this, &responseCallback](protocol::Buffer& respBuffer) {
                   typename Message::Response responsePacket;
-                  responsePacket.Read(respBuffer);
+                  responsePacket.Read(*respBuffer);
+                  Tracer::Hit(trace::Stage::Decode, correlationId, apiKey);
+                  int32_t throttleTime =
+                      protocol::packet::ThrottleTime(responsePacket);
+                  this->stats.RecordThrottle(throttleTime);
+                  this->pacingGate.Throttle(throttleTime);
                   responseCallback(responsePacket);
+                  Tracer::Hit(trace::Stage::Callback, correlationId, apiKey);
                 });
+
+    if (!this->heldRequests.empty() || !this->pacingGate.IsOpen()) {
+      this->hold(HeldRequest{std::move(requestBuffer), correlationId, apiKey,
+                             std::move(callback)});
+      return true;
+    }
+
+    return this->write(requestBuffer, correlationId, apiKey, callback);
+  }
+
+  // SetRequestTimeout changes the time to wait for responses. Requests which
+  // time out are reported with an ErrorEvent and to their failure callback
+  void SetRequestTimeout(std::chrono::milliseconds timeout) {
+    this->requestTimeout = timeout;
+  }
+
+  // CaptureFrames appends every request and response frame of this
+  // connection to the capture, nullptr stops capturing
+  void CaptureFrames(std::shared_ptr<FrameCapture> capture) {
+    this->capture = std::move(capture);
   }
 
-  // ConsumeFromMetadata for the broker id
+  // IsThrottled reports if the broker currently throttles this connection
+  bool IsThrottled() const { return !this->pacingGate.IsOpen(); }
+
+  // ConsumeFromMetadata for the broker id. Brokers behind a unix:// proxy
+  // are advertised with the socket path as host, their port is ignored
   bool ConsumeFromMetadata(const ahiv::kafka::protocol::packet::BrokerNodeInformation&
                                brokerNodeInformation) {
+    bool viaPath =
+        this->connectionConfig->connectionType == ConnectionType::Unix;
     if (this->connectionConfig->address->hostname ==
             brokerNodeInformation.host &&
-        this->connectionConfig->address->port ==
-            std::to_string(brokerNodeInformation.port)) {
+        (viaPath || this->connectionConfig->address->port ==
+                        std::to_string(brokerNodeInformation.port))) {
       this->brokerId = brokerNodeInformation.nodeId;
       return true;
     }
@@ -116,25 +240,563 @@ class TCPConnection : public uvw::Emitter<TCPConnection> {
     return false;
   }
 
+  // Stats fills the given broker stats with the counters of this connection
+  void Stats(BrokerStats& brokerStats) const {
+    brokerStats.NodeId = this->brokerId;
+    brokerStats.Host = this->connectionConfig->address->hostname;
+    brokerStats.Port = this->connectionConfig->address->port;
+    brokerStats.QueueDepth = this->queuedBytes();
+    brokerStats.HeldRequests = this->heldRequests.size();
+    brokerStats.NoDelay = this->noDelay;
+    brokerStats.BusyPollUs = this->busyPollUs;
+    if (this->stream != nullptr) {
+      this->stream->Stats(brokerStats);
+    }
+    this->stats.Snapshot(brokerStats);
+  }
+
+  // ResumeReading continues reading responses after it has been paused
+  // because the memory budget was exhausted
+  void ResumeReading() {
+    if (this->readingPaused && this->connected) {
+      this->readingPaused = false;
+      this->startReading();
+    }
+  }
+
+  // IsConnected reports if one of the connection attempts has succeeded and,
+  // for ssl:// brokers, the TLS session is established
+  bool IsConnected() const { return this->connected; }
+
+  // HasBrokerId reports if this connection has been matched to a broker of
+  // the cluster metadata
+  bool HasBrokerId() const { return this->brokerId >= 0; }
+
+  // Close stops all pending connection attempts and closes the connected
+  // handle. No further events will be published
+  void Close() {
+    this->clear();
+    this->closed = true;
+    this->connected = false;
+    if (!this->attemptTimer->closing()) {
+      this->attemptTimer->close();
+    }
+    this->timers->Cancel(this->pacingTimer);
+
+    for (const auto& attempt : this->pendingAttempts) {
+      attempt->clear();
+      attempt->close();
+    }
+    this->pendingAttempts.clear();
+    if (this->pendingPipe != nullptr) {
+      this->pendingPipe->clear();
+      this->pendingPipe->close();
+      this->pendingPipe = nullptr;
+    }
+
+    if (this->stream != nullptr) {
+      this->stream->clear();
+      this->stream->Close();
+    }
+    if (this->hasHandle()) {
+      this->withHandle([](auto& handle) {
+        handle.clear();
+        handle.close();
+      });
+    }
+
+    while (auto* inFlight = this->responseCallbacks.Oldest()) {
+      this->timers->Cancel(inFlight->timeout);
+      this->responseCallbacks.Erase(inFlight->correlationId);
+    }
+
+    for (auto& held : this->heldRequests) {
+      this->memoryBudget->Release(held.buffer.Size());
+    }
+    this->heldRequests.clear();
+
+    while (!this->pendingWrites.empty()) {
+      this->memoryBudget->Release(this->pendingWrites.front().bytes);
+      this->pendingWrites.pop();
+    }
+    this->memoryBudget->Release(this->readBuffer.size());
+    this->readBuffer.clear();
+  }
+
   std::shared_ptr<ConnectionConfig> connectionConfig;
 
  private:
-  void write(protocol::Buffer& buffer, const ahiv::kafka::ResponseCallback<protocol::Buffer>& responseCallback) {
-    int32_t correlationId = this->idCounter.fetch_add(1);
-    this->responseCallbacks.emplace(ResponseCorrelationCallback{
-      correlationId : correlationId,
-      responseCallback : responseCallback
+  // write hands the request to the socket, the reserved bytes of the request
+  // are released once the socket has written it. The callback is only taken
+  // when the request has been written, it stays with the caller otherwise
+  bool write(protocol::Buffer& buffer, int32_t correlationId, int16_t apiKey,
+             InlineResponseCallback& responseCallback) {
+    ResponseCorrelationCallback entry{
+        correlationId : correlationId,
+        apiKey : apiKey,
+        sentAt : std::chrono::steady_clock::now(),
+        responseCallback : std::move(responseCallback)
+    };
+    if (!this->responseCallbacks.Insert(correlationId, std::move(entry))) {
+      responseCallback = std::move(entry.responseCallback);
+      this->publish(ErrorEvent{
+          .Reason = std::string("Too many requests in flight to broker ")
+                        .append(std::to_string(this->brokerId)),
+          .Error = Error::TooManyInFlightRequests});
+      this->memoryBudget->Release(buffer.Size());
+      return false;
+    }
+
+    this->responseCallbacks.Find(correlationId)->timeout =
+        this->timers->Schedule(this->requestTimeout, [this, correlationId] {
+          this->onTimeout(correlationId);
+        });
+    this->pendingWrites.push(
+        PendingWrite{correlationId, apiKey, buffer.Size()});
+    this->stats.RecordRequest(buffer.Size());
+    if (this->capture != nullptr) {
+      this->capture->Append(FrameDirection::Request, apiKey, buffer.View(0),
+                            buffer.Size());
+    }
+    this->writeToSocket(buffer);
+    return true;
+  }
+
+  // writeToSocket hands the serialized request to the byte stream of the
+  // connection or the handle
+  void writeToSocket(protocol::Buffer& buffer) {
+    std::size_t size = buffer.Size();
+    if (this->stream != nullptr) {
+      this->stream->Write(buffer.Data(), size);
+      return;
+    }
+    this->withHandle([&buffer, size](auto& handle) {
+      handle.write(buffer.Data(), static_cast<unsigned int>(size));
     });
+  }
+
+  void startReading() {
+    if (this->stream != nullptr) {
+      this->stream->Read();
+      return;
+    }
+    this->withHandle([](auto& handle) { handle.read(); });
+  }
+
+  void stopReading() {
+    if (this->stream != nullptr) {
+      this->stream->Stop();
+      return;
+    }
+    this->withHandle([](auto& handle) { handle.stop(); });
+  }
+
+  // queuedBytes is the amount of bytes which wait to be written
+  std::size_t queuedBytes() const {
+    if (this->stream != nullptr) {
+      return this->stream->QueuedBytes();
+    }
+    if (!this->hasHandle()) {
+      return 0;
+    }
+    return this->withHandle(
+        [](auto& handle) -> std::size_t { return handle.writeQueueSize(); });
+  }
+
+  // withHandle calls fn with the connected TCP or pipe handle and returns its
+  // result
+  template <typename Fn>
+  decltype(auto) withHandle(Fn&& fn) const {
+    return std::visit([&fn](const auto& handle) -> decltype(auto) {
+      return fn(*handle);
+    }, this->handle);
+  }
+
+  bool hasHandle() const {
+    return std::visit([](const auto& handle) { return handle != nullptr; },
+                      this->handle);
+  }
+
+  // hold queues a request until the pacing gate opens
+  void hold(HeldRequest&& held) {
+    this->stats.RecordPaced();
+    this->heldRequests.emplace_back(std::move(held));
+    if (this->heldRequests.size() == 1) {
+      this->schedulePacing();
+    }
+  }
+
+  // releaseHeld sends the held requests in order once the gate is open. A
+  // response of the meantime may have throttled the connection again. Send
+  // has accepted the held requests already, those which can't be written are
+  // handed to their failure callback
+  void releaseHeld() {
+    while (!this->heldRequests.empty()) {
+      if (!this->pacingGate.IsOpen()) {
+        this->schedulePacing();
+        return;
+      }
+
+      HeldRequest held = std::move(this->heldRequests.front());
+      this->heldRequests.pop_front();
+      if (!this->write(held.buffer, held.correlationId, held.apiKey,
+                       held.responseCallback)) {
+        held.responseCallback(nullptr, Error::TooManyInFlightRequests);
+      }
+    }
+  }
+
+  void schedulePacing() {
+    this->pacingTimer = this->timers->Schedule(
+        this->pacingGate.Remaining(), [this] { this->releaseHeld(); });
+  }
+
+  // onTimeout drops a request which has not been answered in time and calls
+  // its failure callback
+  void onTimeout(int32_t correlationId) {
+    auto* entry = this->responseCallbacks.Find(correlationId);
+    if (entry == nullptr) {
+      return;
+    }
+
+    this->stats.RecordTimeout();
+    ResponseCorrelationCallback callback = std::move(*entry);
+    this->responseCallbacks.Erase(correlationId);
+    this->publish(ErrorEvent{
+        .Reason = std::string("Request timed out on broker ")
+                      .append(std::to_string(this->brokerId)),
+        .Error = Error::RequestTimedOut});
+    callback.responseCallback(nullptr, Error::RequestTimedOut);
+  }
+
+  // onData collects the received bytes until at least one full response
+  // frame is available and hands every complete frame to onFrame. Reading is
+  // paused while the memory budget is exhausted, but only between frames: the
+  // bytes of a frame in progress are released once it completes, so pausing
+  // in the middle of one could wait for a release which never happens
+  void onData(const char* data, std::size_t length) {
+    this->activity->RecordEvent();
+    this->stats.RecordBytesIn(length);
+    this->memoryBudget->Reserve(length);
+
+    if constexpr (Tracer::Enabled) {
+      auto* next = this->responseCallbacks.Oldest();
+      if (this->readBuffer.empty() && next != nullptr) {
+        Tracer::Hit(trace::Stage::FirstByte, next->correlationId, next->apiKey);
+      }
+    }
+
+    this->readBuffer.insert(this->readBuffer.end(), data, data + length);
+
+    std::size_t offset = 0;
+    while (this->readBuffer.size() - offset >= 4) {
+      uint32_t frameLength;
+      std::memcpy(&frameLength, this->readBuffer.data() + offset, 4);
+      frameLength = be32toh(frameLength);
+      if (this->readBuffer.size() - offset < 4 + frameLength) {
+        break;
+      }
+
+      this->onFrame(this->readBuffer.data() + offset, 4 + frameLength);
+      if (this->closed) {
+        // a response callback has closed the connection and released the
+        // buffer
+        return;
+      }
+      offset += 4 + frameLength;
+    }
+
+    this->readBuffer.erase(this->readBuffer.begin(),
+                           this->readBuffer.begin() + offset);
+    this->memoryBudget->Release(offset);
 
-    buffer.Overwrite<int32_t>(8, correlationId);
-    handle->write(buffer.Data(), buffer.Size());
+    if (this->memoryBudget->Blocked() && this->readBuffer.empty() &&
+        !this->readingPaused && this->connected) {
+      this->readingPaused = true;
+      this->stopReading();
+    }
+  }
+
+  // onFrame matches a complete response frame to its request and calls the
+  // response callback. Frames no request waits for, mostly late responses to
+  // requests which timed out, are only counted
+  void onFrame(const char* frame, std::size_t length) {
+    ahiv::kafka::protocol::Buffer buffer;
+    buffer.EnsureAllocated(length);
+    buffer.WriteData(frame, length);
+    int32_t payloadLength = buffer.Read<int32_t>();
+    int32_t correlationId = buffer.Read<int32_t>();
+
+    auto* entry = this->responseCallbacks.Find(correlationId);
+    if (this->capture != nullptr) {
+      this->capture->Append(FrameDirection::Response,
+                            entry != nullptr ? entry->apiKey : -1, frame,
+                            length);
+    }
+    if (entry == nullptr) {
+      this->stats.RecordUnmatchedResponse();
+      return;
+    }
+
+    ResponseCorrelationCallback callback = std::move(*entry);
+    this->responseCallbacks.Erase(correlationId);
+    this->timers->Cancel(callback.timeout);
+    Tracer::Hit(trace::Stage::FrameComplete, correlationId, callback.apiKey);
+    this->stats.RecordResponse(
+        callback.apiKey, std::chrono::steady_clock::now() - callback.sentAt);
+    buffer.ResetReadPosition();
+    callback.responseCallback(&buffer, Error{});
+  }
+
+  // connectToNextAddress starts a connection attempt to the next resolved
+  // address. Attempts are started ConnectionAttemptDelay apart (or right away
+  // when the previous one failed) and race each other, the first one to
+  // connect is kept and all others are closed
+  void connectToNextAddress() {
+    const auto& addresses = this->connectionConfig->address->resolvedAddresses;
+    if (addresses == nullptr || this->nextAddress >= addresses->size()) {
+      // a host without any address fails like one whose addresses all
+      // refused, a racing attempt which is still pending reports on its own
+      if (this->pendingAttempts.empty()) {
+        this->attemptTimer->stop();
+        this->connectionConfig->address->Invalidate();
+        this->publish(ErrorEvent{
+            .Reason = std::string("No address to connect to for host ")
+                          .append(this->connectionConfig->address->hostname),
+            .Error = Error::UnknownTCPError});
+      }
+      return;
+    }
+
+    const auto& address = (*addresses)[this->nextAddress++];
+    auto attempt = this->loop->resource<uvw::TCPHandle>();
+    this->pendingAttempts.emplace_back(attempt);
+
+    attempt->once<uvw::ErrorEvent>(
+        [this](const uvw::ErrorEvent& errorEvent, uvw::TCPHandle& failed) {
+          this->dropAttempt(failed);
+          if (this->nextAddress < this->connectionConfig->address
+                                      ->resolvedAddresses->size()) {
+            this->connectToNextAddress();
+          } else if (this->pendingAttempts.empty()) {
+            this->attemptTimer->stop();
+            this->connectionConfig->address->Invalidate();
+            this->publishError(errorEvent);
+          }
+        });
+
+    attempt->once<uvw::ConnectEvent>(
+        [this](const uvw::ConnectEvent&, uvw::TCPHandle& connected) {
+          this->adoptAttempt(connected);
+        });
+
+    attempt->connect(reinterpret_cast<const sockaddr&>(address));
+    this->attemptTimer->start(ConnectionAttemptDelay,
+                              uvw::TimerHandle::Time{0});
+  }
+
+  // connectToPath connects the pipe of a unix:// broker, there is only a
+  // single attempt
+  void connectToPath() {
+    this->pendingPipe = this->loop->resource<uvw::PipeHandle>();
+    this->pendingPipe->once<uvw::ErrorEvent>(
+        [this](const uvw::ErrorEvent& errorEvent, uvw::PipeHandle& failed) {
+          failed.clear();
+          failed.close();
+          this->pendingPipe = nullptr;
+          this->publishError(errorEvent);
+        });
+    this->pendingPipe->once<uvw::ConnectEvent>(
+        [this](const uvw::ConnectEvent&, uvw::PipeHandle&) {
+          this->adopt(std::move(this->pendingPipe));
+        });
+    this->pendingPipe->connect(this->connectionConfig->address->hostname);
   }
 
-  int32_t brokerId;
-  std::shared_ptr<uvw::TCPHandle> handle;
-  std::queue<ResponseCorrelationCallback> responseCallbacks;
-  std::atomic<int32_t> idCounter;
+  // adoptAttempt makes the given attempt the handle of this connection and
+  // closes all attempts which are still pending
+  void adoptAttempt(uvw::TCPHandle& connected) {
+    this->attemptTimer->stop();
+    std::shared_ptr<uvw::TCPHandle> adopted;
+    for (const auto& attempt : this->pendingAttempts) {
+      if (attempt.get() == &connected) {
+        adopted = attempt;
+      } else {
+        attempt->clear();
+        attempt->close();
+      }
+    }
+    this->pendingAttempts.clear();
+    this->adopt(adopted);
+  }
+
+  // adopt reads responses from the connected handle and publishes the
+  // connection as connected
+  template <typename Handle>
+  void adopt(std::shared_ptr<Handle> connected) {
+    this->handle = connected;
+    connected->template clear<uvw::ErrorEvent>();
+    connected->template on<uvw::ErrorEvent>(
+        [this](const uvw::ErrorEvent& errorEvent, auto&) {
+          this->publishError(errorEvent);
+        });
+    if (this->connectionConfig->lowLatency.has_value()) {
+      this->tuneSocket(*connected, *this->connectionConfig->lowLatency);
+    }
+
+#ifdef AHIV_KAFKA_TLS
+    if (this->connectionConfig->connectionType == ConnectionType::SSL) {
+      this->startStream(std::make_shared<TLSStream>(
+          this->loop, this->socket(), this->connectionConfig->tlsContext,
+          this->connectionConfig->address->hostname));
+      return;
+    }
+#endif
+#ifdef AHIV_KAFKA_IO_URING
+    if (this->connectionConfig->ioBackend == IOBackend::IOUring) {
+      if (auto ring = LoopIOUring::Of(this->loop)) {
+        this->startStream(
+            std::make_shared<IOUringStream>(ring, this->socket()));
+        return;
+      }
+    }
+#endif
+
+    connected->template on<uvw::DataEvent>(
+        [this](const uvw::DataEvent& event, Handle&) {
+          this->onData(event.data.get(), event.length);
+        });
+
+    connected->template on<uvw::WriteEvent>(
+        [this](const uvw::WriteEvent&, Handle&) { this->onWritten(); });
+
+    connected->read();
+    this->connected = true;
+    this->publish(ConnectedEvent{});
+  }
+
+  // startStream moves all bytes of the connected socket through the stream,
+  // the handle stays idle from here on. The connection counts as connected
+  // once the stream is ready
+  void startStream(std::shared_ptr<ByteStream> stream) {
+    this->stream = std::move(stream);
+    this->stream->on<ErrorEvent>(
+        [this](const ErrorEvent& event, ByteStream&) { this->publish(event); });
+    this->stream->on<ReceivedEvent>(
+        [this](const ReceivedEvent& event, ByteStream&) {
+          this->onData(event.Data, event.Length);
+        });
+    this->stream->on<uvw::WriteEvent>(
+        [this](const uvw::WriteEvent&, ByteStream&) { this->onWritten(); });
+    this->stream->on<ConnectedEvent>(
+        [this](const ConnectedEvent& event, ByteStream& stream) {
+          stream.Read();
+          this->connected = true;
+          this->publish(event);
+        });
+    this->stream->Start();
+  }
+
+  // tuneSocket applies the socket options of the low latency mode. Options
+  // the kernel refuses are left at their defaults, the stats show what is in
+  // effect
+  template <typename Handle>
+  void tuneSocket(Handle& connected, const LowLatencyConfig& lowLatency) {
+    if constexpr (std::is_same_v<Handle, uvw::TCPHandle>) {
+      this->noDelay = connected.noDelay(true);
+
+#ifdef SO_BUSY_POLL
+      int busyPoll = static_cast<int>(lowLatency.BusyPoll.count());
+      if (busyPoll > 0 && setsockopt(this->socket(), SOL_SOCKET, SO_BUSY_POLL,
+                                     &busyPoll, sizeof(busyPoll)) == 0) {
+        this->busyPollUs = busyPoll;
+      }
+#endif
+    }
+
+    if (lowLatency.SendBufferSize > 0) {
+      connected.sendBufferSize(lowLatency.SendBufferSize);
+    }
+    if (lowLatency.ReceiveBufferSize > 0) {
+      connected.recvBufferSize(lowLatency.ReceiveBufferSize);
+    }
+  }
+
+  int socket() const {
+    return this->withHandle(
+        [](auto& handle) { return static_cast<int>(handle.fileno()); });
+  }
+
+  // onWritten releases the request which the socket has written completely
+  void onWritten() {
+    this->activity->RecordEvent();
+    if (!this->pendingWrites.empty()) {
+      auto pendingWrite = this->pendingWrites.front();
+      this->pendingWrites.pop();
+      Tracer::Hit(trace::Stage::WriteComplete, pendingWrite.correlationId,
+                  pendingWrite.apiKey);
+      this->memoryBudget->Release(pendingWrite.bytes);
+    }
+  }
+
+  // dropAttempt forgets about a failed connection attempt
+  void dropAttempt(uvw::TCPHandle& failed) {
+    for (auto attempt = this->pendingAttempts.begin();
+         attempt != this->pendingAttempts.end(); attempt++) {
+      if (attempt->get() == &failed) {
+        (*attempt)->close();
+        this->pendingAttempts.erase(attempt);
+        return;
+      }
+    }
+  }
+
+  // publishError translates a libuv error into our ErrorEvent
+  void publishError(const uvw::ErrorEvent& errorEvent) {
+    const char* errorName = errorEvent.name();
+    if (strncmp(errorName, "ECONNREFUSED", 12) == 0) {
+      this->publish(
+          ErrorEvent{.Reason = std::string("Could not connect to IP ")
+                                   .append(errorEvent.what()),
+                     .Error = Error::TCPConnectionRefused});
+    } else {
+      this->publish(
+          ErrorEvent{.Reason = std::string("Got unknown TCP error: ")
+                                   .append(errorEvent.what()),
+                     .Error = Error::UnknownTCPError});
+    }
+  }
+
+  int32_t brokerId = -1;
+  std::shared_ptr<uvw::Loop> loop;
+  StreamHandle handle;
+  std::shared_ptr<ByteStream> stream;
+  std::shared_ptr<uvw::TimerHandle> attemptTimer;
+  std::shared_ptr<LoopTimerWheel> timers;
+  std::shared_ptr<LoopActivity> activity;
+  TimerId pacingTimer;
+  std::chrono::milliseconds requestTimeout = DefaultRequestTimeout;
+  PacingGate pacingGate;
+  std::deque<HeldRequest> heldRequests;
+  std::vector<std::shared_ptr<uvw::TCPHandle>> pendingAttempts;
+  std::shared_ptr<uvw::PipeHandle> pendingPipe;
+  std::size_t nextAddress = 0;
+  InFlightTable<ResponseCorrelationCallback, MaxInFlightRequests>
+      responseCallbacks;
+  std::queue<PendingWrite> pendingWrites;
+  std::vector<char> readBuffer;
+  std::shared_ptr<MemoryBudget> memoryBudget;
+  std::shared_ptr<FrameCapture> capture;
+  bool readingPaused = false;
+  bool connected = false;
+  bool closed = false;
+  bool noDelay = false;
+  uint64_t busyPollUs = 0;
+  ConnectionStats stats;
+  std::atomic<int32_t> idCounter{0};
 };
+
+using TCPConnection = BasicTCPConnection<>;
 }  // namespace ahiv::kafka::internal
 
 #endif  // AHIV_KAFKA_INTERNAL_TCPCONNECTION_H
@@ -0,0 +1,334 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_TIMERWHEEL_H
+#define AHIV_KAFKA_INTERNAL_TIMERWHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/internal/inlinefunction.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::internal {
+// TimerCallbackCapacity is the amount of bytes a timer callback and its
+// captures may use, see InlineFunction
+const std::size_t TimerCallbackCapacity = 48;
+
+using TimerCallback = InlineFunction<void(), TimerCallbackCapacity>;
+
+// TimerId identifies a scheduled timer. Ids of fired or cancelled timers are
+// never reused, cancelling them does nothing
+struct TimerId {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+};
+
+// TimerWheel is a hierarchical timing wheel with millisecond ticks. Level 0
+// has one slot per tick, every further level has slots which span a whole
+// rotation of the level below. Timers go into the lowest level which covers
+// their deadline and are cascaded down one level whenever the level below
+// wraps around, they reach level 0 right before they are due. Scheduling and
+// cancelling are O(1), timers live in a slab and are linked into their slot,
+// so neither allocates once the slab has grown. Timers further out than the
+// top level covers (about 4.6 hours) are parked in its last slot and
+// cascaded until they are due. The wheel is driven by Advance with the
+// current time and is used from a single thread
+class TimerWheel {
+ public:
+  static constexpr uint32_t SlotBits = 6;
+  static constexpr uint32_t Slots = 1 << SlotBits;
+  static constexpr uint32_t Levels = 4;
+  static constexpr uint64_t Range = uint64_t{1} << (SlotBits * Levels);
+
+  explicit TimerWheel(uint64_t now = 0) : current(now) {
+    this->heads.fill(Nil);
+    this->tails.fill(Nil);
+  }
+
+  // Schedule runs the callback once the wheel has been advanced delayMs
+  // ticks, at least one tick after now
+  TimerId Schedule(uint64_t delayMs, TimerCallback callback) {
+    uint32_t index = this->allocate();
+    auto& entry = this->entries[index];
+    entry.deadline = this->current + (delayMs > 0 ? delayMs : 1);
+    entry.callback = std::move(callback);
+    entry.active = true;
+    this->insert(index);
+    this->active++;
+
+    return TimerId{index, entry.generation};
+  }
+
+  // Cancel removes the timer, returns false if it has fired or has been
+  // cancelled already
+  bool Cancel(TimerId id) {
+    if (id.index >= this->entries.size()) {
+      return false;
+    }
+
+    auto& entry = this->entries[id.index];
+    if (!entry.active || entry.generation != id.generation) {
+      return false;
+    }
+
+    this->unlink(id.index);
+    this->release(id.index);
+    return true;
+  }
+
+  // Advance moves the wheel to now and runs every timer which is due.
+  // Callbacks may schedule and cancel timers
+  void Advance(uint64_t now) {
+    while (this->current < now) {
+      if (this->active == 0) {
+        this->current = now;
+        return;
+      }
+
+      this->current++;
+      this->cascade();
+      this->fire(this->current & (Slots - 1));
+    }
+  }
+
+  // NextExpiry returns the tick the wheel has to be advanced to next, either
+  // because a timer is due or because a level has to be cascaded. Nothing if
+  // no timer is scheduled
+  std::optional<uint64_t> NextExpiry() const {
+    if (this->active == 0) {
+      return std::nullopt;
+    }
+
+    for (uint64_t tick = this->current + 1;
+         tick <= ((this->current >> SlotBits) + 1) << SlotBits; tick++) {
+      if (this->heads[tick & (Slots - 1)] != Nil) {
+        return tick;
+      }
+    }
+
+    return ((this->current >> SlotBits) + 1) << SlotBits;
+  }
+
+  uint64_t Now() const { return this->current; }
+
+  // Size returns the amount of scheduled timers
+  std::size_t Size() const { return this->active; }
+
+ private:
+  static constexpr uint32_t Nil = UINT32_MAX;
+
+  struct Entry {
+    uint64_t deadline = 0;
+    uint32_t previous = Nil;
+    uint32_t next = Nil;
+    uint32_t slot = Nil;
+    uint32_t generation = 0;
+    bool active = false;
+    TimerCallback callback;
+  };
+
+  uint32_t allocate() {
+    if (!this->freeEntries.empty()) {
+      uint32_t index = this->freeEntries.back();
+      this->freeEntries.pop_back();
+      return index;
+    }
+
+    this->entries.emplace_back();
+    return static_cast<uint32_t>(this->entries.size() - 1);
+  }
+
+  void release(uint32_t index) {
+    auto& entry = this->entries[index];
+    entry.active = false;
+    entry.generation++;
+    entry.callback.reset();
+    this->freeEntries.emplace_back(index);
+    this->active--;
+  }
+
+  // slotFor returns the slot of the lowest level covering the deadline
+  uint32_t slotFor(uint64_t deadline) const {
+    uint64_t delta = deadline - this->current;
+    if (delta >= Range) {
+      deadline = this->current + Range - 1;
+      delta = Range - 1;
+    }
+
+    uint32_t level = 0;
+    while (level + 1 < Levels &&
+           delta >= (uint64_t{1} << (SlotBits * (level + 1)))) {
+      level++;
+    }
+
+    return level * Slots + ((deadline >> (SlotBits * level)) & (Slots - 1));
+  }
+
+  // insert appends the timer to its slot, timers of the same tick fire in
+  // the order they have been scheduled
+  void insert(uint32_t index) {
+    auto& entry = this->entries[index];
+    entry.slot = this->slotFor(entry.deadline);
+    entry.previous = this->tails[entry.slot];
+    entry.next = Nil;
+    if (entry.previous != Nil) {
+      this->entries[entry.previous].next = index;
+    } else {
+      this->heads[entry.slot] = index;
+    }
+    this->tails[entry.slot] = index;
+  }
+
+  void unlink(uint32_t index) {
+    auto& entry = this->entries[index];
+    if (entry.previous != Nil) {
+      this->entries[entry.previous].next = entry.next;
+    } else {
+      this->heads[entry.slot] = entry.next;
+    }
+
+    if (entry.next != Nil) {
+      this->entries[entry.next].previous = entry.previous;
+    } else {
+      this->tails[entry.slot] = entry.previous;
+    }
+  }
+
+  // cascade moves the timers of the upper levels down whenever the level
+  // below wrapped around at the current tick
+  void cascade() {
+    for (uint32_t level = 1; level < Levels; level++) {
+      if ((this->current & ((uint64_t{1} << (SlotBits * level)) - 1)) != 0) {
+        return;
+      }
+
+      uint32_t slot =
+          level * Slots + ((this->current >> (SlotBits * level)) & (Slots - 1));
+      uint32_t index = std::exchange(this->heads[slot], Nil);
+      this->tails[slot] = Nil;
+      while (index != Nil) {
+        uint32_t next = this->entries[index].next;
+        this->insert(index);
+        index = next;
+      }
+    }
+  }
+
+  // fire runs the timers of the level 0 slot one by one, so callbacks may
+  // cancel timers of the same slot
+  void fire(uint32_t slot) {
+    while (this->heads[slot] != Nil) {
+      uint32_t index = this->heads[slot];
+      this->unlink(index);
+
+      TimerCallback callback = std::move(this->entries[index].callback);
+      this->release(index);
+      callback();
+    }
+  }
+
+  uint64_t current;
+  std::size_t active = 0;
+  std::array<uint32_t, Slots * Levels> heads;
+  std::array<uint32_t, Slots * Levels> tails;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> freeEntries;
+};
+
+// LoopTimerWheel drives a TimerWheel with a single uvw::TimerHandle, which is
+// armed for the next expiry of the wheel only. There is one wheel per loop,
+// shared by every connection running on it
+class LoopTimerWheel {
+ public:
+  // Of returns the wheel of the loop, it is created on first use
+  static std::shared_ptr<LoopTimerWheel> Of(
+      const std::shared_ptr<uvw::Loop>& loop) {
+    thread_local std::map<uvw::Loop*, std::weak_ptr<LoopTimerWheel>> wheels;
+    auto& known = wheels[loop.get()];
+    if (auto wheel = known.lock()) {
+      return wheel;
+    }
+
+    std::shared_ptr<LoopTimerWheel> wheel(new LoopTimerWheel(loop));
+    known = wheel;
+    return wheel;
+  }
+
+  ~LoopTimerWheel() {
+    if (!this->handle->closing()) {
+      this->handle->close();
+    }
+  }
+
+  LoopTimerWheel(const LoopTimerWheel&) = delete;
+  LoopTimerWheel& operator=(const LoopTimerWheel&) = delete;
+
+  // Schedule runs the callback on the loop after the delay. The wheel is
+  // only advanced from the timer handle, so no callback runs from within
+  // Schedule. The delay is counted from the time of the loop, which the
+  // wheel may lag behind
+  TimerId Schedule(std::chrono::milliseconds delay, TimerCallback callback) {
+    uint64_t now = this->now();
+    if (this->wheel.Size() == 0) {
+      // nothing can fire, catching up only moves the wheel to now
+      this->wheel.Advance(now);
+    }
+
+    uint64_t lag = now > this->wheel.Now() ? now - this->wheel.Now() : 0;
+    auto id = this->wheel.Schedule(delay.count() + lag, std::move(callback));
+    this->arm();
+    return id;
+  }
+
+  bool Cancel(TimerId id) { return this->wheel.Cancel(id); }
+
+  std::size_t Size() const { return this->wheel.Size(); }
+
+ private:
+  explicit LoopTimerWheel(const std::shared_ptr<uvw::Loop>& loop)
+      : loop(loop), wheel(loop->now().count()) {
+    this->handle = loop->resource<uvw::TimerHandle>();
+    this->handle->on<uvw::TimerEvent>([this](const uvw::TimerEvent&, auto&) {
+      this->armedAt.reset();
+      this->wheel.Advance(this->now());
+      this->arm();
+    });
+  }
+
+  uint64_t now() const { return this->loop->now().count(); }
+
+  // arm starts the handle for the next expiry unless it is armed for it
+  // already. Cancelled timers leave the handle armed, which at worst wakes
+  // the loop once for nothing
+  void arm() {
+    auto expiry = this->wheel.NextExpiry();
+    if (!expiry.has_value()) {
+      return;
+    }
+
+    if (this->armedAt.has_value() && *this->armedAt <= *expiry) {
+      return;
+    }
+
+    this->armedAt = expiry;
+    uint64_t now = this->now();
+    this->handle->start(
+        uvw::TimerHandle::Time{*expiry > now ? *expiry - now : 0},
+        uvw::TimerHandle::Time{0});
+  }
+
+  std::shared_ptr<uvw::Loop> loop;
+  std::shared_ptr<uvw::TimerHandle> handle;
+  TimerWheel wheel;
+  std::optional<uint64_t> armedAt;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_TIMERWHEEL_H
@@ -0,0 +1,479 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_TLSSESSION_H
+#define AHIV_KAFKA_INTERNAL_TLSSESSION_H
+
+// The ssl:// transport needs OpenSSL, build with --config=tls to enable it.
+// Without it only plaintext:// brokers can be connected.
+#ifdef AHIV_KAFKA_TLS
+
+#include <arpa/inet.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "ahiv/kafka/error.h"
+#include "ahiv/kafka/event.h"
+#include "ahiv/kafka/internal/bytestream.h"
+#include "ahiv/kafka/tlsconfig.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::internal {
+// TLSReadChunk is the amount of plaintext read from a session at once
+const std::size_t TLSReadChunk = 64 << 10;
+
+// TLSStatus is the outcome of a step of a session. WantRead and WantWrite ask
+// to repeat the step once the socket is readable or writable
+enum class TLSStatus { Done, WantRead, WantWrite, Closed, Failed };
+
+// TLSErrorString pops the oldest error of the OpenSSL error queue of this
+// thread and clears the rest
+inline std::string TLSErrorString() {
+  unsigned long code = ERR_get_error();
+  ERR_clear_error();
+  if (code == 0) {
+    return "unknown TLS error";
+  }
+
+  char reason[256];
+  ERR_error_string_n(code, reason, sizeof(reason));
+  return reason;
+}
+
+// TLSContext is the OpenSSL context shared by all ssl:// connections of a
+// client, it holds the loaded certificates
+class TLSContext {
+ public:
+  // Create sets up a client context for the config. Returns nullptr when the
+  // certificates could not be loaded, see TLSErrorString for the reason
+  static std::shared_ptr<TLSContext> Create(const TLSConfig& config) {
+    SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+    if (context == nullptr) {
+      return nullptr;
+    }
+
+    std::shared_ptr<TLSContext> tlsContext(new TLSContext(context, config));
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                  SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+    if (config.KernelOffload) {
+      SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+
+    if (config.VerifyPeer) {
+      SSL_CTX_set_verify(context, SSL_VERIFY_PEER, nullptr);
+      int loaded = config.CAFile.empty()
+                       ? SSL_CTX_set_default_verify_paths(context)
+                       : SSL_CTX_load_verify_locations(
+                             context, config.CAFile.c_str(), nullptr);
+      if (loaded != 1) {
+        return nullptr;
+      }
+    }
+
+    if (!config.CertificateFile.empty()) {
+      const std::string& keyFile =
+          config.KeyFile.empty() ? config.CertificateFile : config.KeyFile;
+      if (SSL_CTX_use_certificate_chain_file(
+              context, config.CertificateFile.c_str()) != 1 ||
+          SSL_CTX_use_PrivateKey_file(context, keyFile.c_str(),
+                                      SSL_FILETYPE_PEM) != 1 ||
+          SSL_CTX_check_private_key(context) != 1) {
+        return nullptr;
+      }
+    }
+
+    return tlsContext;
+  }
+
+  ~TLSContext() { SSL_CTX_free(this->context); }
+
+  TLSContext(const TLSContext&) = delete;
+  TLSContext& operator=(const TLSContext&) = delete;
+
+  SSL_CTX* Get() const { return this->context; }
+
+  const TLSConfig& Config() const { return this->config; }
+
+ private:
+  TLSContext(SSL_CTX* context, const TLSConfig& config)
+      : context(context), config(config) {}
+
+  SSL_CTX* context;
+  TLSConfig config;
+};
+
+// PendingPlaintext is a write which has not been fully taken by the session
+struct PendingPlaintext {
+  std::unique_ptr<char[]> data;
+  std::size_t length;
+  std::size_t written;
+};
+
+// TLSSession is the client side of a TLS session on a non-blocking socket.
+// OpenSSL reads and writes the socket itself, which lets it switch the
+// socket to kTLS after the handshake when the context asked for it: the
+// kernel then encrypts and decrypts the records and the session only moves
+// plaintext through the socket. Sessions without kTLS encrypt in userspace.
+// Every step returns what the session waits for, driving it on readiness is
+// up to the caller, see TLSStream
+class TLSSession {
+ public:
+  TLSSession(const std::shared_ptr<TLSContext>& context, int socket,
+             const std::string& hostname)
+      : context(context) {
+    this->session = SSL_new(context->Get());
+    SSL_set_fd(this->session, socket);
+    SSL_set_connect_state(this->session);
+
+    // IP literals are neither sent as server name nor matched as host name
+    unsigned char address[sizeof(in6_addr)];
+    bool literal = inet_pton(AF_INET, hostname.c_str(), address) == 1 ||
+                   inet_pton(AF_INET6, hostname.c_str(), address) == 1;
+    if (!literal) {
+      SSL_set_tlsext_host_name(this->session, hostname.c_str());
+    }
+
+    if (context->Config().VerifyPeer) {
+      X509_VERIFY_PARAM* verification = SSL_get0_param(this->session);
+      if (literal) {
+        X509_VERIFY_PARAM_set1_ip_asc(verification, hostname.c_str());
+      } else {
+        X509_VERIFY_PARAM_set1_host(verification, hostname.c_str(), 0);
+      }
+    }
+  }
+
+  ~TLSSession() { SSL_free(this->session); }
+
+  TLSSession(const TLSSession&) = delete;
+  TLSSession& operator=(const TLSSession&) = delete;
+
+  // Handshake continues the handshake, Done once the session is established
+  TLSStatus Handshake() {
+    int result = SSL_do_handshake(this->session);
+    return result == 1 ? TLSStatus::Done : this->status(result);
+  }
+
+  // Read hands all plaintext which is available to onData(data, length) and
+  // stops early when onData returns false. The data is only valid during
+  // the call
+  template <typename OnData>
+  TLSStatus Read(OnData&& onData) {
+    if (this->readBuffer == nullptr) {
+      this->readBuffer.reset(new char[TLSReadChunk]);
+    }
+
+    while (true) {
+      int result = SSL_read(this->session, this->readBuffer.get(),
+                            static_cast<int>(TLSReadChunk));
+      if (result <= 0) {
+        return this->status(result);
+      }
+
+      if (!onData(static_cast<const char*>(this->readBuffer.get()),
+                  static_cast<std::size_t>(result))) {
+        return TLSStatus::Done;
+      }
+    }
+  }
+
+  // Write queues the plaintext, it is written in order by Flush
+  void Write(std::unique_ptr<char[]> data, std::size_t length) {
+    this->queuedBytes += length;
+    this->writes.emplace_back(PendingPlaintext{std::move(data), length, 0});
+  }
+
+  // Flush writes the queued plaintext and calls onWritten(length) for every
+  // write which has been taken completely
+  template <typename OnWritten>
+  TLSStatus Flush(OnWritten&& onWritten) {
+    while (!this->writes.empty()) {
+      auto& front = this->writes.front();
+      int result = SSL_write(this->session, front.data.get() + front.written,
+                             static_cast<int>(front.length - front.written));
+      if (result <= 0) {
+        return this->status(result);
+      }
+
+      front.written += static_cast<std::size_t>(result);
+      this->queuedBytes -= static_cast<std::size_t>(result);
+      if (front.written == front.length) {
+        std::size_t length = front.length;
+        this->writes.pop_front();
+        onWritten(length);
+      }
+    }
+
+    return TLSStatus::Done;
+  }
+
+  // Shutdown sends the close notification without waiting for the broker
+  void Shutdown() {
+    SSL_shutdown(this->session);
+    ERR_clear_error();
+  }
+
+  // HasPendingWrites reports if Flush has plaintext left to write
+  bool HasPendingWrites() const { return !this->writes.empty(); }
+
+  // QueuedBytes is the amount of plaintext waiting to be written
+  std::size_t QueuedBytes() const { return this->queuedBytes; }
+
+  // KernelSend reports if the kernel encrypts the records sent
+  bool KernelSend() const {
+#ifdef BIO_get_ktls_send
+    return BIO_get_ktls_send(SSL_get_wbio(this->session));
+#else
+    return false;
+#endif
+  }
+
+  // KernelReceive reports if the kernel decrypts the records received
+  bool KernelReceive() const {
+#ifdef BIO_get_ktls_recv
+    return BIO_get_ktls_recv(SSL_get_rbio(this->session));
+#else
+    return false;
+#endif
+  }
+
+  // Error describes why the last step failed
+  const std::string& Error() const { return this->error; }
+
+ private:
+  // status translates the result of a failed OpenSSL call
+  TLSStatus status(int result) {
+    switch (SSL_get_error(this->session, result)) {
+      case SSL_ERROR_WANT_READ:
+        return TLSStatus::WantRead;
+      case SSL_ERROR_WANT_WRITE:
+        return TLSStatus::WantWrite;
+      case SSL_ERROR_ZERO_RETURN:
+        this->error = "session closed by the broker";
+        return TLSStatus::Closed;
+      case SSL_ERROR_SYSCALL:
+        if (ERR_peek_error() == 0) {
+          this->error = errno != 0 ? std::strerror(errno)
+                                   : "connection closed by the broker";
+          return TLSStatus::Failed;
+        }
+        break;
+    }
+
+    long verification = SSL_get_verify_result(this->session);
+    this->error = verification != X509_V_OK
+                      ? X509_verify_cert_error_string(verification)
+                      : TLSErrorString();
+    ERR_clear_error();
+    return TLSStatus::Failed;
+  }
+
+  std::shared_ptr<TLSContext> context;
+  SSL* session;
+  std::unique_ptr<char[]> readBuffer;
+  std::deque<PendingPlaintext> writes;
+  std::size_t queuedBytes = 0;
+  std::string error;
+};
+
+// TLSStream drives a TLSSession on the socket of a connected TCP handle with
+// the loop, the socket is watched by a poll handle. ConnectedEvent is
+// published once the handshake is done and ReceivedEvent carries plaintext
+class TLSStream : public ByteStream {
+ public:
+  TLSStream(const std::shared_ptr<uvw::Loop>& loop, int socket,
+            const std::shared_ptr<TLSContext>& context,
+            const std::string& hostname)
+      : session(context, socket, hostname) {
+    this->poll = loop->resource<uvw::PollHandle>(socket);
+    this->poll->on<uvw::PollEvent>(
+        [this](const uvw::PollEvent&, uvw::PollHandle&) { this->onPoll(); });
+    this->poll->on<uvw::ErrorEvent>(
+        [this](const uvw::ErrorEvent& errorEvent, uvw::PollHandle&) {
+          this->fail(Error::TLSSessionFailed, errorEvent.what());
+        });
+  }
+
+  // Start begins the handshake
+  void Start() override { this->handshake(); }
+
+  void Read() override {
+    this->reading = true;
+    this->readAvailable();
+  }
+
+  void Stop() override {
+    this->reading = false;
+    this->watch();
+  }
+
+  // Write queues the plaintext and writes as much as the socket takes
+  void Write(std::unique_ptr<char[]> data, std::size_t length) override {
+    this->session.Write(std::move(data), length);
+    if (this->established && this->writeStatus != TLSStatus::WantRead &&
+        this->writeStatus != TLSStatus::WantWrite) {
+      this->flush();
+    }
+  }
+
+  // Close sends the close notification and stops watching the socket
+  void Close() override {
+    if (this->closed) {
+      return;
+    }
+
+    this->closed = true;
+    if (this->established) {
+      this->session.Shutdown();
+    }
+    this->poll->clear();
+    this->poll->close();
+  }
+
+  bool Established() const { return this->established; }
+
+  std::size_t QueuedBytes() const override {
+    return this->session.QueuedBytes();
+  }
+
+  void Stats(BrokerStats& brokerStats) const override {
+    brokerStats.TLS = true;
+    brokerStats.KernelTLSSend = this->session.KernelSend();
+    brokerStats.KernelTLSReceive = this->session.KernelReceive();
+  }
+
+ private:
+  void onPoll() {
+    if (!this->established) {
+      this->handshake();
+      return;
+    }
+
+    if (this->reading) {
+      this->readAvailable();
+    }
+    if (!this->closed && this->session.HasPendingWrites()) {
+      this->flush();
+    }
+  }
+
+  void handshake() {
+    TLSStatus status = this->session.Handshake();
+    if (status == TLSStatus::Done) {
+      this->established = true;
+      this->handshakeStatus = status;
+      this->publish(ConnectedEvent{});
+      if (!this->closed && this->session.HasPendingWrites()) {
+        this->flush();
+      }
+      this->watch();
+    } else if (status == TLSStatus::WantRead ||
+               status == TLSStatus::WantWrite) {
+      this->handshakeStatus = status;
+      this->watch();
+    } else {
+      this->fail(Error::TLSHandshakeFailed, this->session.Error());
+    }
+  }
+
+  void readAvailable() {
+    if (this->closed || !this->established) {
+      return;
+    }
+
+    this->readStatus =
+        this->session.Read([this](const char* data, std::size_t length) {
+          this->publish(ReceivedEvent{data, length});
+          return this->reading && !this->closed;
+        });
+    if (this->readStatus == TLSStatus::Closed ||
+        this->readStatus == TLSStatus::Failed) {
+      this->fail(Error::TLSSessionFailed, this->session.Error());
+      return;
+    }
+    this->watch();
+  }
+
+  void flush() {
+    this->writeStatus = this->session.Flush(
+        [this](std::size_t) { this->publish(uvw::WriteEvent{}); });
+    if (this->writeStatus == TLSStatus::Closed ||
+        this->writeStatus == TLSStatus::Failed) {
+      this->fail(Error::TLSSessionFailed, this->session.Error());
+      return;
+    }
+    this->watch();
+  }
+
+  // watch polls the socket for what the pending steps wait for
+  void watch() {
+    if (this->closed) {
+      return;
+    }
+
+    auto wants = [this](TLSStatus status) {
+      return (!this->established && this->handshakeStatus == status) ||
+             (this->reading && this->readStatus == status) ||
+             (this->session.HasPendingWrites() && this->writeStatus == status);
+    };
+
+    int events = 0;
+    if (wants(TLSStatus::WantRead)) {
+      events |= static_cast<int>(uvw::PollHandle::Event::READABLE);
+    }
+    if (wants(TLSStatus::WantWrite)) {
+      events |= static_cast<int>(uvw::PollHandle::Event::WRITABLE);
+    }
+
+    if (events == this->watchedEvents) {
+      return;
+    }
+
+    this->watchedEvents = events;
+    if (events == 0) {
+      this->poll->stop();
+    } else {
+      using Events = uvw::Flags<uvw::PollHandle::Event>;
+      this->poll->start(Events(static_cast<Events::Type>(events)));
+    }
+  }
+
+  void fail(Error error, const std::string& reason) {
+    if (this->closed) {
+      return;
+    }
+
+    // a failed session must not be shut down
+    this->established = false;
+    this->Close();
+    this->publish(ErrorEvent{.Reason = std::string("TLS session failed: ")
+                                           .append(reason),
+                             .Error = error});
+  }
+
+  TLSSession session;
+  std::shared_ptr<uvw::PollHandle> poll;
+  TLSStatus handshakeStatus = TLSStatus::WantWrite;
+  TLSStatus readStatus = TLSStatus::WantRead;
+  TLSStatus writeStatus = TLSStatus::Done;
+  int watchedEvents = 0;
+  bool established = false;
+  bool reading = false;
+  bool closed = false;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_TLS
+
+#endif  // AHIV_KAFKA_INTERNAL_TLSSESSION_H
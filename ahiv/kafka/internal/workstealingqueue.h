@@ -0,0 +1,56 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_INTERNAL_WORKSTEALINGQUEUE_H
+#define AHIV_KAFKA_INTERNAL_WORKSTEALINGQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace ahiv::kafka::internal {
+// WorkStealingQueue is the queue of a single worker. The owner pushes and
+// pops at the back, so it keeps working on what it queued last while its
+// caches are warm. Idle workers steal from the front, which is the oldest
+// work. Every operation takes a short lock, the queues of different workers
+// never contend with each other unless one of them is stealing
+template <typename T>
+class WorkStealingQueue {
+ public:
+  void Push(T value) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->items.emplace_back(std::move(value));
+  }
+
+  // Pop takes the newest item, it is called by the owner only
+  std::optional<T> Pop() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->items.empty()) {
+      return std::nullopt;
+    }
+
+    T value = std::move(this->items.back());
+    this->items.pop_back();
+    return value;
+  }
+
+  // Steal takes the oldest item, it is called by other workers
+  std::optional<T> Steal() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->items.empty()) {
+      return std::nullopt;
+    }
+
+    T value = std::move(this->items.front());
+    this->items.pop_front();
+    return value;
+  }
+
+ private:
+  std::mutex mutex;
+  std::deque<T> items;
+};
+}  // namespace ahiv::kafka::internal
+
+#endif  // AHIV_KAFKA_INTERNAL_WORKSTEALINGQUEUE_H
@@ -0,0 +1,26 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_LOWLATENCYCONFIG_H
+#define AHIV_KAFKA_LOWLATENCYCONFIG_H
+
+#include <chrono>
+
+namespace ahiv::kafka {
+// LowLatencyConfig tunes the sockets of broker connections for the low
+// latency mode, see Connection::UseLowLatency. Every connection disables
+// Nagle's algorithm (TCP_NODELAY) in this mode.
+struct LowLatencyConfig {
+  // BusyPoll is how long the kernel busy polls the device queue of a socket
+  // for new packets instead of waiting for the interrupt (SO_BUSY_POLL).
+  // Values above the net.core.busy_read sysctl need CAP_NET_ADMIN, zero
+  // keeps busy polling off.
+  std::chrono::microseconds BusyPoll{50};
+  // SendBufferSize and ReceiveBufferSize set the socket buffers in bytes, the
+  // defaults of the system are kept when they are zero.
+  int SendBufferSize = 0;
+  int ReceiveBufferSize = 0;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_LOWLATENCYCONFIG_H
@@ -0,0 +1,290 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PARALLELEXECUTOR_H
+#define AHIV_KAFKA_PARALLELEXECUTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/batch.h"
+#include "ahiv/kafka/internal/offsettracker.h"
+#include "ahiv/kafka/internal/workstealingqueue.h"
+
+namespace ahiv::kafka {
+// OrderingMode is the guarantee the ParallelExecutor gives for the order
+// records are processed in
+enum class OrderingMode {
+  // Partition processes the records of a partition one after another, in
+  // offset order
+  Partition,
+  // Key only keeps records with the same key in offset order, records of one
+  // partition with different keys are processed in parallel. Records without
+  // a key are ordered among each other
+  Key,
+};
+
+struct ExecutorOptions {
+  // Workers is the amount of worker threads, by default one per core
+  std::size_t Workers = std::max(1u, std::thread::hardware_concurrency());
+  OrderingMode Ordering = OrderingMode::Partition;
+  // KeyLanes is the amount of lanes the keys of a partition are hashed to with
+  // OrderingMode::Key, which bounds the parallelism within one partition. Zero
+  // is treated as one lane
+  std::size_t KeyLanes = 16;
+};
+
+// ParallelExecutor processes consumed batches on a pool of worker threads.
+// Records are split into lanes, by partition or by key, and a lane is only
+// ever run by one worker at a time, so ordering within a lane is kept while
+// different lanes run in parallel. Runnable lanes are spread over per worker
+// queues and idle workers steal from the others.
+//
+// The executor tracks the contiguous processed offset of every partition,
+// which is the offset consuming can safely resume from. The committable
+// listener is called from a worker thread whenever one of them advanced
+class ParallelExecutor {
+ public:
+  using Processor =
+      std::function<void(const PartitionBatch&, const RecordView&)>;
+
+  // The processor is called from the worker threads and must not throw
+  explicit ParallelExecutor(Processor processor,
+                            ExecutorOptions options = ExecutorOptions{})
+      : processor(std::move(processor)),
+        options(options),
+        queues(std::max<std::size_t>(options.Workers, 1)) {
+    this->options.KeyLanes = std::max<std::size_t>(this->options.KeyLanes, 1);
+    for (std::size_t worker = 0; worker < this->queues.size(); worker++) {
+      this->workers.emplace_back([this, worker] { this->work(worker); });
+    }
+  }
+
+  // The destructor lets the workers finish the submitted batches and joins
+  // them
+  ~ParallelExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopping = true;
+    }
+    this->wakeup.notify_all();
+
+    for (auto& worker : this->workers) {
+      worker.join();
+    }
+  }
+
+  ParallelExecutor(const ParallelExecutor&) = delete;
+  ParallelExecutor& operator=(const ParallelExecutor&) = delete;
+
+  // OnCommittable registers the listener which is called from a worker when
+  // the committable offset of a partition advanced. It has to be registered
+  // before batches are submitted
+  void OnCommittable(std::function<void()> listener) {
+    this->committableListener = std::move(listener);
+  }
+
+  // Submit queues the records of the batch. Batches of a partition have to be
+  // submitted in offset order
+  void Submit(PartitionBatch batch) {
+    if (batch.Records.empty()) {
+      return;
+    }
+
+    auto shared = std::make_shared<const PartitionBatch>(std::move(batch));
+    std::map<std::size_t, Work> parts;
+    if (this->options.Ordering == OrderingMode::Partition) {
+      parts[0] = Work{shared, {}};
+    } else {
+      for (uint32_t index = 0; index < shared->Records.size(); index++) {
+        auto& part = parts[this->keyLane(shared->Records[index])];
+        part.batch = shared;
+        part.records.emplace_back(index);
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->trackers[{shared->Topic, shared->Partition}].Track(
+        shared->LastOffset, parts.size());
+    this->outstandingParts += parts.size();
+
+    for (auto& [laneIndex, part] : parts) {
+      Lane& lane = this->lanes[{shared->Topic, shared->Partition, laneIndex}];
+      lane.pending.emplace_back(std::move(part));
+      if (!lane.scheduled) {
+        lane.scheduled = true;
+        this->queues[this->nextQueue++ % this->queues.size()].Push(&lane);
+        this->queued++;
+      }
+    }
+    this->wakeup.notify_all();
+  }
+
+  // TakeCommittable returns the partitions whose committable offset advanced
+  // since the last call, along with the offset consuming can resume from
+  std::map<std::pair<std::string, int32_t>, int64_t> TakeCommittable() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return std::exchange(this->advancedOffsets, {});
+  }
+
+  // Committable returns the offset consuming of the partition can resume
+  // from, nothing if none of its records have been processed yet
+  std::optional<int64_t> Committable(const std::string& topic,
+                                     int32_t partitionIndex) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto tracker = this->trackers.find({topic, partitionIndex});
+    if (tracker == this->trackers.end()) {
+      return std::nullopt;
+    }
+
+    return tracker->second.Committable();
+  }
+
+  // WaitIdle blocks until every submitted record has been processed
+  void WaitIdle() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->idle.wait(lock, [this] { return this->outstandingParts == 0; });
+  }
+
+ private:
+  // Work is a part of a batch which runs on one lane. Without record indexes
+  // it covers the whole batch
+  struct Work {
+    std::shared_ptr<const PartitionBatch> batch;
+    std::vector<uint32_t> records;
+  };
+
+  // Lane is a queue of work which has to run in order. A scheduled lane is
+  // queued for or run by exactly one worker
+  struct Lane {
+    std::deque<Work> pending;
+    bool scheduled = false;
+  };
+
+  std::size_t keyLane(const RecordView& record) const {
+    if (!record.Key.has_value()) {
+      return 0;
+    }
+
+    return std::hash<std::string_view>{}(*record.Key) % this->options.KeyLanes;
+  }
+
+  // next takes a lane from the own queue or steals one from another worker
+  Lane* next(std::size_t worker) {
+    if (auto lane = this->queues[worker].Pop()) {
+      return *lane;
+    }
+
+    for (std::size_t offset = 1; offset < this->queues.size(); offset++) {
+      if (auto lane =
+              this->queues[(worker + offset) % this->queues.size()].Steal()) {
+        return *lane;
+      }
+    }
+
+    return nullptr;
+  }
+
+  void work(std::size_t worker) {
+    while (true) {
+      Lane* lane = this->next(worker);
+      if (lane == nullptr) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->wakeup.wait(
+            lock, [this] { return this->stopping || this->queued > 0; });
+        if (this->stopping && this->queued == 0) {
+          return;
+        }
+        continue;
+      }
+      this->queued--;
+
+      Work current;
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        current = std::move(lane->pending.front());
+        lane->pending.pop_front();
+      }
+
+      this->run(current);
+      if (this->complete(worker, lane, *current.batch) &&
+          this->committableListener) {
+        this->committableListener();
+      }
+    }
+  }
+
+  void run(const Work& current) {
+    const auto& batch = *current.batch;
+    if (current.records.empty()) {
+      for (const auto& record : batch.Records) {
+        this->processor(batch, record);
+      }
+      return;
+    }
+
+    for (auto index : current.records) {
+      this->processor(batch, batch.Records[index]);
+    }
+  }
+
+  // complete records the processed work and keeps the lane on the queue of
+  // the worker if more work is pending for it. Returns true if the
+  // committable offset of the partition advanced
+  bool complete(std::size_t worker, Lane* lane, const PartitionBatch& batch) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto key = std::make_pair(batch.Topic, batch.Partition);
+    auto& tracker = this->trackers[key];
+    bool advanced = tracker.Complete(batch.LastOffset);
+    if (advanced) {
+      this->advancedOffsets[key] = *tracker.Committable();
+    }
+
+    if (lane->pending.empty()) {
+      lane->scheduled = false;
+    } else {
+      this->queues[worker].Push(lane);
+      this->queued++;
+    }
+
+    if (--this->outstandingParts == 0) {
+      this->idle.notify_all();
+    }
+    return advanced;
+  }
+
+  Processor processor;
+  ExecutorOptions options;
+  std::function<void()> committableListener;
+  std::vector<internal::WorkStealingQueue<Lane*>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> queued{0};
+  std::size_t nextQueue = 0;
+
+  // Guarded by mutex
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::condition_variable idle;
+  bool stopping = false;
+  std::size_t outstandingParts = 0;
+  std::map<std::tuple<std::string, int32_t, std::size_t>, Lane> lanes;
+  std::map<std::pair<std::string, int32_t>, internal::OffsetTracker> trackers;
+  std::map<std::pair<std::string, int32_t>, int64_t> advancedOffsets;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_PARALLELEXECUTOR_H
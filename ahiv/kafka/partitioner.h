@@ -0,0 +1,164 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PARTITIONER_H
+#define AHIV_KAFKA_PARTITIONER_H
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ahiv/kafka/internal/murmur2.h"
+#include "ahiv/kafka/protocol/packet/metadata.h"
+
+namespace ahiv::kafka {
+// Partitioner picks the partition a record is produced to, based on the
+// partitions known from the metadata of the topic. Keyless records have no
+// key. Partitioners return -1 when the topic has no partitions
+class Partitioner {
+ public:
+  virtual ~Partitioner() = default;
+
+  virtual int32_t Partition(const protocol::packet::TopicInformation& topic,
+                            std::optional<std::string_view> key) = 0;
+
+  // OnNewBatch is called when the batch of the previously picked partition is
+  // full and a new one is started
+  virtual void OnNewBatch(const protocol::packet::TopicInformation& topic,
+                          int32_t previousPartition) {}
+};
+
+// Murmur2Partitioner hashes keys like the default partitioner of the Java
+// client, keyed records land on the same partitions as those of JVM
+// producers. Keyless records go round robin over the available partitions
+class Murmur2Partitioner : public Partitioner {
+ public:
+  int32_t Partition(const protocol::packet::TopicInformation& topic,
+                    std::optional<std::string_view> key) override {
+    if (key.has_value()) {
+      return PartitionForHash(topic, internal::Murmur2(*key));
+    }
+
+    auto available = AvailablePartitions(topic);
+    if (available.empty()) {
+      return PartitionCount(topic) > 0
+                 ? this->nextPartition++ % PartitionCount(topic)
+                 : -1;
+    }
+
+    return available[this->nextPartition++ % available.size()];
+  }
+
+  // PartitionKeys picks the partitions of many keyed records at once, the
+  // keys are hashed in bulk
+  void PartitionKeys(const protocol::packet::TopicInformation& topic,
+                     const std::vector<std::string_view>& keys,
+                     std::vector<int32_t>& partitions) {
+    partitions.resize(keys.size());
+    internal::Murmur2Bulk(keys.data(), keys.size(), partitions.data());
+    for (auto& partition : partitions) {
+      partition = PartitionForHash(topic, partition);
+    }
+  }
+
+  // PartitionForHash maps a murmur2 hash to one of all partitions of the
+  // topic, available or not, to match the Java client
+  static int32_t PartitionForHash(
+      const protocol::packet::TopicInformation& topic, int32_t hash) {
+    int32_t partitionCount = PartitionCount(topic);
+    return partitionCount > 0 ? internal::ToPositive(hash) % partitionCount
+                              : -1;
+  }
+
+  static int32_t PartitionCount(
+      const protocol::packet::TopicInformation& topic) {
+    return static_cast<int32_t>(topic.partitionInformation.size());
+  }
+
+  // AvailablePartitions returns the partitions which currently have a leader
+  static std::vector<int32_t> AvailablePartitions(
+      const protocol::packet::TopicInformation& topic) {
+    std::vector<int32_t> available;
+    for (const auto& partition : topic.partitionInformation) {
+      if (partition.leaderId >= 0) {
+        available.emplace_back(partition.partitionIndex);
+      }
+    }
+
+    return available;
+  }
+
+ private:
+  uint32_t nextPartition = 0;
+};
+
+// StickyPartitioner hashes keyed records with murmur2 and sticks keyless
+// records to one partition until its batch is full (KIP-480). Filling one
+// batch at a time instead of spreading keyless records over all partitions
+// gives fewer and larger batches
+class StickyPartitioner : public Murmur2Partitioner {
+ public:
+  StickyPartitioner() : random(std::random_device{}()) {}
+
+  int32_t Partition(const protocol::packet::TopicInformation& topic,
+                    std::optional<std::string_view> key) override {
+    if (key.has_value()) {
+      return Murmur2Partitioner::Partition(topic, key);
+    }
+
+    auto sticky = this->stickyPartitions.find(topic.name);
+    if (sticky != this->stickyPartitions.end()) {
+      return sticky->second;
+    }
+
+    return this->nextStickyPartition(topic, -1);
+  }
+
+  void OnNewBatch(const protocol::packet::TopicInformation& topic,
+                  int32_t previousPartition) override {
+    auto sticky = this->stickyPartitions.find(topic.name);
+    if (sticky == this->stickyPartitions.end() ||
+        sticky->second == previousPartition) {
+      this->nextStickyPartition(topic, previousPartition);
+    }
+  }
+
+ private:
+  // nextStickyPartition picks a random available partition other than the
+  // previous one, if there is another one
+  int32_t nextStickyPartition(const protocol::packet::TopicInformation& topic,
+                              int32_t previousPartition) {
+    auto candidates = AvailablePartitions(topic);
+    if (candidates.empty()) {
+      int32_t partitionCount = PartitionCount(topic);
+      for (int32_t partition = 0; partition < partitionCount; partition++) {
+        candidates.emplace_back(partition);
+      }
+    }
+
+    if (candidates.size() > 1) {
+      candidates.erase(
+          std::remove(candidates.begin(), candidates.end(), previousPartition),
+          candidates.end());
+    }
+
+    if (candidates.empty()) {
+      return -1;
+    }
+
+    std::uniform_int_distribution<std::size_t> pick(0, candidates.size() - 1);
+    int32_t partition = candidates[pick(this->random)];
+    this->stickyPartitions[topic.name] = partition;
+    return partition;
+  }
+
+  std::minstd_rand random;
+  std::map<std::string, int32_t> stickyPartitions;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_PARTITIONER_H
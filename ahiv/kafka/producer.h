@@ -0,0 +1,107 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PRODUCER_H
+#define AHIV_KAFKA_PRODUCER_H
+
+#include <memory>
+#include <string>
+
+#include "ahiv/kafka/connection.h"
+#include "ahiv/kafka/internal/batchcontroller.h"
+#include "ahiv/kafka/internal/sequencer.h"
+#include "ahiv/kafka/partitioner.h"
+#include "ahiv/kafka/protocol/packet/initproducerid.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka {
+using BatchingBounds = internal::BatchingBounds;
+
+// Producer is an idempotent producer. After connecting it asks the cluster
+// for a producer id and tracks the sequences of every partition, so up to
+// internal::Sequencer::MaxInFlightPerPartition batches per partition can be in
+// flight without duplicates or reordering on retries
+class Producer : public Connection {
+ public:
+  Producer(std::shared_ptr<uvw::Loop>& loop) : Connection(loop) {
+    this->Once<ConnectedEvent>(
+        [this](const ConnectedEvent& event, auto&) { this->initProducerId(); });
+    this->extendStats([this](StatsEvent& stats) {
+      stats.Batching = this->batchController.Stats();
+    });
+  }
+
+  // ResetProducerId asks for a new producer identity. It has to be called
+  // when the Sequencer reported SequenceOutcome::ResetProducer for a batch,
+  // the batches in flight are renumbered once the new identity arrived
+  void ResetProducerId() { this->initProducerId(); }
+
+  int64_t ProducerId() const { return this->sequencer.ProducerId(); }
+  int16_t ProducerEpoch() const { return this->sequencer.ProducerEpoch(); }
+
+  // Sequencer gives access to the per partition sequences batches are
+  // stamped with
+  internal::Sequencer& Sequencer() { return this->sequencer; }
+
+  // UsePartitioner replaces the partitioner records are spread with, the
+  // default is the StickyPartitioner
+  void UsePartitioner(std::unique_ptr<Partitioner> partitioner) {
+    this->partitioner = std::move(partitioner);
+  }
+
+  Partitioner& RecordPartitioner() { return *this->partitioner; }
+
+  // SetBatchingBounds limits linger and batch size, within them both are
+  // tuned per partition by the adaptive batch controller. Inverted bounds
+  // are swapped
+  void SetBatchingBounds(BatchingBounds bounds) {
+    this->batchController.SetBounds(bounds);
+  }
+
+  // UseLowLatency tunes the broker sockets like Connection::UseLowLatency and
+  // sends every batch without lingering, batches still fill up while their
+  // partition has requests in flight
+  void UseLowLatency(const LowLatencyConfig& config = LowLatencyConfig{}) {
+    Connection::UseLowLatency(config);
+    BatchingBounds bounds = this->batchController.Bounds();
+    bounds.MinLinger = std::chrono::microseconds{0};
+    bounds.MaxLinger = std::chrono::microseconds{0};
+    this->batchController.SetBounds(bounds);
+  }
+
+  // BatchController gives access to the linger and batch size decisions, the
+  // accumulator reports records, closed batches and produce round trips to it
+  internal::AdaptiveBatchController& BatchController() {
+    return this->batchController;
+  }
+
+ private:
+  // initProducerId requests a producer id without a transactional id, which
+  // makes this producer idempotent but not transactional
+  void initProducerId() {
+    this->SendToFirstConnection<protocol::packet::InitProducerIdPacket>(
+        protocol::packet::InitProducerIdRequestPacket(),
+        [this](protocol::packet::InitProducerIdResponsePacket& response) {
+          if (response.errorCode != 0) {
+            this->publish(ErrorEvent{
+                .Reason = "InitProducerId failed with error code " +
+                          std::to_string(response.errorCode),
+                .Error = Error::InitProducerIdFailed});
+            return;
+          }
+
+          this->sequencer.SetProducerId(response.producerId,
+                                        response.producerEpoch);
+          this->publish(ProducerIdEvent{.ProducerId = response.producerId,
+                                        .ProducerEpoch = response.producerEpoch});
+        });
+  }
+
+  internal::Sequencer sequencer;
+  internal::AdaptiveBatchController batchController;
+  std::unique_ptr<Partitioner> partitioner =
+      std::make_unique<StickyPartitioner>();
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_PRODUCER_H
@@ -6,7 +6,9 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -15,8 +17,33 @@
 namespace ahiv::kafka::protocol {
 class Buffer {
  public:
+  Buffer() = default;
+  Buffer(Buffer&&) = default;
+  Buffer& operator=(Buffer&&) = default;
+
   std::size_t Size() { return this->writePositionInBuffer; }
 
+  // ReadPosition returns the offset of the next byte to read
+  std::size_t ReadPosition() const { return this->readPositionInBuffer; }
+
+  // SeekRead moves the read position to the given offset
+  void SeekRead(std::size_t position) { this->readPositionInBuffer = position; }
+
+  // Skip advances the read position by length bytes without reading them
+  void Skip(std::size_t length) { this->readPositionInBuffer += length; }
+
+  // Remaining returns the amount of written bytes which have not been read
+  std::size_t Remaining() const {
+    return this->writePositionInBuffer > this->readPositionInBuffer
+               ? this->writePositionInBuffer - this->readPositionInBuffer
+               : 0;
+  }
+
+  // View returns a pointer to the byte at the given offset
+  const char* View(std::size_t position) const {
+    return this->internalBuffer.get() + position;
+  }
+
   template <typename T>
   std::size_t Write(T value) {
     std::size_t length = sizeof(T);
@@ -94,18 +121,16 @@ class Buffer {
 
   std::size_t WriteData(const char* data, std::size_t length) {
     std::size_t currentWritePosition = this->writePositionInBuffer;
-    for (std::size_t positionInData = 0; positionInData < length;
-         positionInData++) {
-      this->internalBuffer[this->writePositionInBuffer++] =
-          data[positionInData];
-    }
+    std::memcpy(this->Reserve(length), data, length);
     return currentWritePosition;
   }
 
-  ~Buffer() {
-      if (this->internalBuffer) {
-          this->internalBuffer.release();
-      }
+  // Reserve advances the write position by length bytes and returns a pointer
+  // to the skipped region, the caller fills it in place
+  char* Reserve(std::size_t length) {
+    char* region = this->internalBuffer.get() + this->writePositionInBuffer;
+    this->writePositionInBuffer += length;
+    return region;
   }
 
  private:
@@ -0,0 +1,43 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_CRC32C_H
+#define AHIV_KAFKA_PROTOCOL_CRC32C_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ahiv::kafka::protocol {
+// Crc32cPolynomial is the reversed Castagnoli polynomial record batches are
+// checksummed with
+constexpr uint32_t Crc32cPolynomial = 0x82f63b78;
+
+// crc32cTable builds the lookup table of the byte wise CRC32C at compile time
+constexpr std::array<uint32_t, 256> crc32cTable() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t index = 0; index < 256; index++) {
+    uint32_t crc = index;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) != 0 ? (crc >> 1) ^ Crc32cPolynomial : crc >> 1;
+    }
+    table[index] = crc;
+  }
+
+  return table;
+}
+
+// Crc32c returns the CRC32C of the data, a previous result can be passed as
+// crc to continue the checksum over several pieces
+inline uint32_t Crc32c(const char* data, std::size_t size, uint32_t crc = 0) {
+  static constexpr std::array<uint32_t, 256> table = crc32cTable();
+  crc = ~crc;
+  for (std::size_t index = 0; index < size; index++) {
+    crc = table[(crc ^ static_cast<uint8_t>(data[index])) & 0xff] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+}  // namespace ahiv::kafka::protocol
+
+#endif  // AHIV_KAFKA_PROTOCOL_CRC32C_H
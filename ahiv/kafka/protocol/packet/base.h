@@ -4,40 +4,24 @@
 #ifndef AHIV_KAFKA_PROTOCOL_PACKET_BASE_H
 #define AHIV_KAFKA_PROTOCOL_PACKET_BASE_H
 
+#include <type_traits>
+
 #include "ahiv/kafka/protocol/buffer.h"
+#include "ahiv/kafka/protocol/schema.h"
 
 namespace ahiv::kafka::protocol::packet {
+    // Packets describe their wire format with a Schema (see schema.h) which
+    // lists the header fields of these base structs followed by their own.
+    // There is no virtual dispatch, packets are always used by their concrete
+    // type
     struct BasePacket {
-        std::size_t packetSizePosition{};
         int32_t packetSize{};
-
-        virtual void Write(Buffer& buffer) {
-            packetSizePosition = buffer.Write<int32_t>(0);
-        }
-
-        virtual void Read(Buffer& buffer) {
-            packetSize = buffer.Read<int32_t>();
-        }
-
-        virtual std::size_t Size() { return 4; }
     };
 
     struct RequestPacket : public BasePacket {
         RequestPacket(int16_t apiKey, int16_t apiVersion)
                 : apiKey(apiKey), apiVersion(apiVersion) {}
 
-        void Write(Buffer& buffer) override {
-            BasePacket::Write(buffer);
-
-            //
-            buffer.Write<int16_t>(apiKey);
-            buffer.Write<int16_t>(apiVersion);
-            buffer.Write<int32_t>(correlationId);
-            buffer.Write<int16_t>(clientId);
-        }
-
-        std::size_t Size() { return BasePacket::Size() + 2 + 2 + 4 + 2; }
-
         int16_t apiKey;
         int16_t apiVersion;
         int32_t correlationId{};
@@ -45,14 +29,43 @@ namespace ahiv::kafka::protocol::packet {
                 -1;  // TODO: Currently "nulled" because we don't support client ids
     };
 
+    // RequestSchema lists the fields every request starts with
+    template <typename... FieldList>
+    using RequestSchema = schema::Fields<
+            schema::Field<&BasePacket::packetSize>,
+            schema::Field<&RequestPacket::apiKey>,
+            schema::Field<&RequestPacket::apiVersion>,
+            schema::Field<&RequestPacket::correlationId>,
+            schema::Field<&RequestPacket::clientId>, FieldList...>;
+
     struct ResponsePacket : public BasePacket {
         int32_t correlationId{};
+    };
 
-        void Read(Buffer& buffer) override {
-            BasePacket::Read(buffer);
-            correlationId = buffer.Read<int32_t>();
+    // ResponseSchema lists the fields every response starts with
+    template <typename... FieldList>
+    using ResponseSchema = schema::Fields<
+            schema::Field<&BasePacket::packetSize>,
+            schema::Field<&ResponsePacket::correlationId>, FieldList...>;
+
+    template <typename Response, typename = void>
+    struct HasThrottleTime : std::false_type {};
+
+    template <typename Response>
+    struct HasThrottleTime<Response, std::void_t<decltype(
+            std::declval<Response>().throttledInMilliseconds)>>
+            : std::true_type {};
+
+    // ThrottleTime returns the throttle time the broker reported in the
+    // response, responses without a throttle time field report 0
+    template <typename Response>
+    int32_t ThrottleTime(const Response& response) {
+        if constexpr (HasThrottleTime<Response>::value) {
+            return response.throttledInMilliseconds;
+        } else {
+            return 0;
         }
-    };
+    }
 }
 
 
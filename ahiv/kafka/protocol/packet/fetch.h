@@ -0,0 +1,156 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_PACKET_FETCH_H
+#define AHIV_KAFKA_PROTOCOL_PACKET_FETCH_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/base.h"
+
+namespace ahiv::kafka::protocol::packet {
+struct FetchPartition {
+  int32_t partitionIndex{};
+  int32_t currentLeaderEpoch = -1;
+  int64_t fetchOffset{};
+  int64_t logStartOffset = -1;
+  int32_t partitionMaxBytes = 1 << 20;
+
+  using Schema =
+      schema::Fields<schema::Field<&FetchPartition::partitionIndex>,
+                     schema::Field<&FetchPartition::currentLeaderEpoch>,
+                     schema::Field<&FetchPartition::fetchOffset>,
+                     schema::Field<&FetchPartition::logStartOffset>,
+                     schema::Field<&FetchPartition::partitionMaxBytes>>;
+};
+
+struct FetchTopic {
+  std::string name;
+  std::vector<FetchPartition> partitions;
+
+  using Schema = schema::Fields<schema::Field<&FetchTopic::name>,
+                                schema::Field<&FetchTopic::partitions>>;
+};
+
+struct ForgottenTopic {
+  std::string name;
+  std::vector<int32_t> partitions;
+
+  using Schema = schema::Fields<schema::Field<&ForgottenTopic::name>,
+                                schema::Field<&ForgottenTopic::partitions>>;
+};
+
+// FetchRequestPacket is version 11 of the Fetch request, the first version
+// which carries the rack of the client. Brokers with a replica selector use
+// it to point the client to a replica in the same rack (KIP-392)
+struct FetchRequestPacket : public RequestPacket {
+  explicit FetchRequestPacket(std::string rackId = "")
+      : RequestPacket(1, 11), rackId(std::move(rackId)) {}
+
+  void Write(Buffer& buffer) {
+    packetSize = Size() - 4;
+    Schema::Encode(*this, buffer);
+  }
+
+  std::size_t Size() const { return Schema::Size(*this); }
+
+  int32_t replicaId = -1;
+  int32_t maxWaitInMilliseconds = 500;
+  int32_t minBytes = 1;
+  int32_t maxBytes = 50 << 20;
+  int8_t isolationLevel{};
+  int32_t sessionId{};
+  int32_t sessionEpoch = -1;
+  std::vector<FetchTopic> topics;
+  std::vector<ForgottenTopic> forgottenTopics;
+  std::string rackId;
+
+  using Schema =
+      RequestSchema<schema::Field<&FetchRequestPacket::replicaId>,
+                    schema::Field<&FetchRequestPacket::maxWaitInMilliseconds>,
+                    schema::Field<&FetchRequestPacket::minBytes>,
+                    schema::Field<&FetchRequestPacket::maxBytes>,
+                    schema::Field<&FetchRequestPacket::isolationLevel>,
+                    schema::Field<&FetchRequestPacket::sessionId>,
+                    schema::Field<&FetchRequestPacket::sessionEpoch>,
+                    schema::Field<&FetchRequestPacket::topics>,
+                    schema::Field<&FetchRequestPacket::forgottenTopics>,
+                    schema::Field<&FetchRequestPacket::rackId>>;
+};
+
+struct AbortedTransaction {
+  int64_t producerId{};
+  int64_t firstOffset{};
+
+  using Schema =
+      schema::Fields<schema::Field<&AbortedTransaction::producerId>,
+                     schema::Field<&AbortedTransaction::firstOffset>>;
+};
+
+struct FetchPartitionResponse {
+  int32_t partitionIndex{};
+  int16_t errorCode{};
+  int64_t highWatermark{};
+  int64_t lastStableOffset{};
+  int64_t logStartOffset{};
+  std::vector<AbortedTransaction> abortedTransactions;
+  // PreferredReadReplica is the replica the client should fetch from next,
+  // -1 if the responding broker should be kept
+  int32_t preferredReadReplica = -1;
+  // records are the record batches of the partition, they point into the
+  // frame of the response packet
+  schema::BytesView records;
+
+  using Schema = schema::Fields<
+      schema::Field<&FetchPartitionResponse::partitionIndex>,
+      schema::Field<&FetchPartitionResponse::errorCode>,
+      schema::Field<&FetchPartitionResponse::highWatermark>,
+      schema::Field<&FetchPartitionResponse::lastStableOffset>,
+      schema::Field<&FetchPartitionResponse::logStartOffset>,
+      schema::Field<&FetchPartitionResponse::abortedTransactions>,
+      schema::Field<&FetchPartitionResponse::preferredReadReplica>,
+      schema::Field<&FetchPartitionResponse::records>>;
+};
+
+struct FetchTopicResponse {
+  std::string name;
+  std::vector<FetchPartitionResponse> partitions;
+
+  using Schema =
+      schema::Fields<schema::Field<&FetchTopicResponse::name>,
+                     schema::Field<&FetchTopicResponse::partitions>>;
+};
+
+// FetchResponsePacket is version 11 of the Fetch response. It takes over the
+// frame it is read from, the records of its partitions are views into the
+// frame and stay valid as long as the packet lives, also when it is moved
+struct FetchResponsePacket : public ResponsePacket {
+  void Read(Buffer& buffer) {
+    this->frame = std::move(buffer);
+    Schema::Decode(*this, this->frame);
+  }
+
+  int32_t throttledInMilliseconds{};
+  int16_t errorCode{};
+  int32_t sessionId{};
+  std::vector<FetchTopicResponse> topics;
+
+  using Schema =
+      ResponseSchema<schema::Field<&FetchResponsePacket::throttledInMilliseconds>,
+                     schema::Field<&FetchResponsePacket::errorCode>,
+                     schema::Field<&FetchResponsePacket::sessionId>,
+                     schema::Field<&FetchResponsePacket::topics>>;
+
+ private:
+  Buffer frame;
+};
+
+struct FetchPacket {
+  using Request = FetchRequestPacket;
+  using Response = FetchResponsePacket;
+};
+}  // namespace ahiv::kafka::protocol::packet
+
+#endif  // AHIV_KAFKA_PROTOCOL_PACKET_FETCH_H
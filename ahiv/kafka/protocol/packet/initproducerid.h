@@ -0,0 +1,62 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_PACKET_INITPRODUCERID_H
+#define AHIV_KAFKA_PROTOCOL_PACKET_INITPRODUCERID_H
+
+#include <optional>
+#include <string>
+
+#include "ahiv/kafka/protocol/packet/base.h"
+
+namespace ahiv::kafka::protocol::packet {
+
+// InitProducerIdRequestPacket is version 1 of the InitProducerId request. An
+// idempotent producer sends it without a transactional id
+struct InitProducerIdRequestPacket : public RequestPacket {
+  explicit InitProducerIdRequestPacket(
+      int32_t transactionTimeoutInMilliseconds = -1,
+      std::optional<std::string> transactionalId = std::nullopt)
+      : RequestPacket(22, 1),
+        transactionalId(std::move(transactionalId)),
+        transactionTimeoutInMilliseconds(transactionTimeoutInMilliseconds) {}
+
+  void Write(Buffer& buffer) {
+    packetSize = Size() - 4;
+    Schema::Encode(*this, buffer);
+  }
+
+  std::size_t Size() const { return Schema::Size(*this); }
+
+  std::optional<std::string> transactionalId;
+  int32_t transactionTimeoutInMilliseconds;
+
+  using Schema = RequestSchema<
+      schema::Field<&InitProducerIdRequestPacket::transactionalId>,
+      schema::Field<
+          &InitProducerIdRequestPacket::transactionTimeoutInMilliseconds>>;
+};
+
+// InitProducerIdResponsePacket is version 1 of the InitProducerId response
+struct InitProducerIdResponsePacket : public ResponsePacket {
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
+
+  int32_t throttledInMilliseconds{};
+  int16_t errorCode{};
+  int64_t producerId = -1;
+  int16_t producerEpoch = -1;
+
+  using Schema = ResponseSchema<
+      schema::Field<&InitProducerIdResponsePacket::throttledInMilliseconds>,
+      schema::Field<&InitProducerIdResponsePacket::errorCode>,
+      schema::Field<&InitProducerIdResponsePacket::producerId>,
+      schema::Field<&InitProducerIdResponsePacket::producerEpoch>>;
+};
+
+struct InitProducerIdPacket {
+  using Request = InitProducerIdRequestPacket;
+  using Response = InitProducerIdResponsePacket;
+};
+}  // namespace ahiv::kafka::protocol::packet
+
+#endif  // AHIV_KAFKA_PROTOCOL_PACKET_INITPRODUCERID_H
@@ -0,0 +1,244 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_PACKET_LAZYMETADATA_H
+#define AHIV_KAFKA_PROTOCOL_PACKET_LAZYMETADATA_H
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/metadata.h"
+
+namespace ahiv::kafka::protocol::packet {
+// LazyMetadataResponsePacket is a Metadata v8 response which only decodes the
+// broker list eagerly. Topics and partitions are skipped over once to build an
+// index of their offsets in the frame, an entry is only decoded when it is
+// accessed. Use it for full cluster metadata when only a few topics matter
+struct LazyMetadataResponsePacket : public ResponsePacket {
+  // Read takes over the buffer of the frame and indexes it
+  void Read(Buffer& buffer) {
+    this->frame = std::move(buffer);
+    this->valid = this->scan();
+  }
+
+  // Valid reports if the frame could be indexed, a truncated or malformed
+  // frame has no topics
+  bool Valid() const { return this->valid; }
+
+  std::size_t TopicCount() const { return this->topics.size(); }
+
+  // TopicName returns the name of the topic at the index without decoding it.
+  // The view is valid as long as this packet lives
+  std::string_view TopicName(std::size_t topicIndex) const {
+    const auto& topic = this->topics[topicIndex];
+    return std::string_view(this->frame.View(topic.nameOffset),
+                            topic.nameLength);
+  }
+
+  // TopicErrorCode returns the error code of the topic at the index
+  int16_t TopicErrorCode(std::size_t topicIndex) const {
+    return this->topics[topicIndex].errorCode;
+  }
+
+  // FindTopic returns the index of the topic with the given name
+  std::optional<std::size_t> FindTopic(std::string_view name) const {
+    for (std::size_t topicIndex = 0; topicIndex < this->topics.size();
+         topicIndex++) {
+      if (this->TopicName(topicIndex) == name) {
+        return topicIndex;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Topic decodes the topic at the index including all of its partitions
+  TopicInformation Topic(std::size_t topicIndex) {
+    TopicInformation topicInformation;
+    this->frame.SeekRead(this->topics[topicIndex].offset);
+    topicInformation.Read(this->frame);
+    return topicInformation;
+  }
+
+  std::size_t PartitionCount(std::size_t topicIndex) const {
+    return this->topics[topicIndex].partitionCount;
+  }
+
+  // Partition decodes a single partition of the topic at the index
+  PartitionInformation Partition(std::size_t topicIndex,
+                                 std::size_t partitionIndex) {
+    PartitionInformation partitionInformation;
+    this->frame.SeekRead(
+        this->partitionOffsets[this->topics[topicIndex].firstPartition +
+                               partitionIndex]);
+    partitionInformation.Read(this->frame);
+    return partitionInformation;
+  }
+
+  int32_t throttledInMilliseconds{};
+  std::vector<BrokerNodeInformation> brokers;
+  std::string clusterId;
+  int32_t controllerId{};
+  int32_t clusterAuthorizedOperations{};
+
+ private:
+  // MinTopicSize is the wire size of a topic with an empty name and no
+  // partitions
+  static constexpr std::size_t MinTopicSize = 9;
+
+  struct TopicIndex {
+    uint32_t offset;
+    uint32_t nameOffset;
+    uint16_t nameLength;
+    int16_t errorCode;
+    uint32_t firstPartition;
+    uint32_t partitionCount;
+  };
+
+  // scan decodes the header fields and walks over all topics and partitions,
+  // only reading the lengths needed to skip them
+  bool scan() {
+    this->topics.clear();
+    this->partitionOffsets.clear();
+
+    if (!this->has(12)) {
+      return false;
+    }
+    packetSize = this->frame.Read<int32_t>();
+    correlationId = this->frame.Read<int32_t>();
+    this->throttledInMilliseconds = this->frame.Read<int32_t>();
+
+    // Brokers are few and always needed to route requests
+    if (!this->has(4)) {
+      return false;
+    }
+    auto amountOfBrokers = this->frame.Read<int32_t>();
+    for (int32_t currentBroker = 0; currentBroker < amountOfBrokers;
+         currentBroker++) {
+      std::size_t start = this->frame.ReadPosition();
+      if (!this->skipFixed(4) || !this->skipString() || !this->skipFixed(4) ||
+          !this->skipString()) {
+        return false;
+      }
+
+      this->frame.SeekRead(start);
+      BrokerNodeInformation information;
+      information.Read(this->frame);
+      this->brokers.emplace_back(std::move(information));
+    }
+
+    std::size_t clusterIdStart = this->frame.ReadPosition();
+    if (!this->skipString()) {
+      return false;
+    }
+    this->frame.SeekRead(clusterIdStart);
+    this->clusterId = this->frame.ReadString();
+
+    if (!this->has(8)) {
+      return false;
+    }
+    this->controllerId = this->frame.Read<int32_t>();
+    auto amountOfTopics = this->frame.Read<int32_t>();
+    // the count comes from the wire, a topic takes at least an error code, an
+    // empty name, the internal flag and its partition count
+    if (amountOfTopics > 0) {
+      this->topics.reserve(std::min<std::size_t>(
+          amountOfTopics, this->frame.Remaining() / MinTopicSize));
+    }
+
+    for (int32_t currentTopic = 0; currentTopic < amountOfTopics;
+         currentTopic++) {
+      TopicIndex topic{};
+      topic.offset = this->frame.ReadPosition();
+      if (!this->has(2)) {
+        return false;
+      }
+      topic.errorCode = this->frame.Read<int16_t>();
+
+      if (!this->skipString()) {
+        return false;
+      }
+      topic.nameOffset = this->frame.ReadPosition() - this->lastStringLength;
+      topic.nameLength = this->lastStringLength;
+
+      if (!this->skipFixed(1) || !this->has(4)) {
+        return false;
+      }
+      auto amountOfPartitions = this->frame.Read<int32_t>();
+      topic.firstPartition = this->partitionOffsets.size();
+      topic.partitionCount = amountOfPartitions > 0 ? amountOfPartitions : 0;
+
+      for (int32_t currentPartition = 0; currentPartition < amountOfPartitions;
+           currentPartition++) {
+        this->partitionOffsets.emplace_back(this->frame.ReadPosition());
+        if (!this->skipFixed(14) || !this->skipInt32Array() ||
+            !this->skipInt32Array() || !this->skipInt32Array()) {
+          return false;
+        }
+      }
+
+      if (!this->skipFixed(4)) {
+        return false;
+      }
+      this->topics.emplace_back(topic);
+    }
+
+    if (!this->has(4)) {
+      return false;
+    }
+    this->clusterAuthorizedOperations = this->frame.Read<int32_t>();
+    return true;
+  }
+
+  bool has(std::size_t length) { return this->frame.Remaining() >= length; }
+
+  bool skipFixed(std::size_t length) {
+    if (!this->has(length)) {
+      return false;
+    }
+
+    this->frame.Skip(length);
+    return true;
+  }
+
+  bool skipString() {
+    if (!this->has(2)) {
+      return false;
+    }
+
+    auto stringLength = this->frame.Read<int16_t>();
+    this->lastStringLength = stringLength > 0 ? stringLength : 0;
+    return this->skipFixed(this->lastStringLength);
+  }
+
+  bool skipInt32Array() {
+    if (!this->has(4)) {
+      return false;
+    }
+
+    // the size is computed in 64 bit, a malformed count must not wrap around
+    // into something that passes the bounds check
+    auto amountOfElements = this->frame.Read<int32_t>();
+    return amountOfElements >= 0 &&
+           this->skipFixed(4 * static_cast<std::size_t>(amountOfElements));
+  }
+
+  Buffer frame;
+  bool valid = false;
+  uint16_t lastStringLength = 0;
+  std::vector<TopicIndex> topics;
+  std::vector<uint32_t> partitionOffsets;
+};
+
+// LazyMetadataPacket requests metadata like MetadataPacket but decodes the
+// response lazily
+struct LazyMetadataPacket {
+  using Request = MetadataRequestPacket;
+  using Response = LazyMetadataResponsePacket;
+};
+}  // namespace ahiv::kafka::protocol::packet
+
+#endif  // AHIV_KAFKA_PROTOCOL_PACKET_LAZYMETADATA_H
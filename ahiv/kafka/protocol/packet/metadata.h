@@ -10,8 +10,9 @@
 
 namespace ahiv::kafka::protocol::packet {
 
+// MetadataRequestPacket is version 8 of the Metadata request
 struct MetadataRequestPacket : public RequestPacket {
-  MetadataRequestPacket(std::vector<std::string>& topics,
+  MetadataRequestPacket(const std::vector<std::string>& topics,
                         bool allowAutoTopicCreation,
                         bool includeClusterAuthorizedOperations,
                         bool includeTopicAuthorizedOperations)
@@ -21,83 +22,41 @@ struct MetadataRequestPacket : public RequestPacket {
         includeClusterAuthorizedOperations(includeClusterAuthorizedOperations),
         includeTopicAuthorizedOperations(includeTopicAuthorizedOperations) {}
 
-  void Write(Buffer& buffer) override {
-    RequestPacket::Write(buffer);
-
-    // Write topics
-    buffer.Write<int32_t>(topics.size());
-    for (auto& topicName : topics) {
-      buffer.WriteString(topicName);
-    }
-
-    // Write options
-    buffer.WriteBoolean(allowAutoTopicCreation);
-    buffer.WriteBoolean(includeClusterAuthorizedOperations);
-    buffer.WriteBoolean(includeTopicAuthorizedOperations);
-
-    // Write size
-    packetSize = buffer.Size() - 4;
-    buffer.Overwrite<int32_t>(packetSizePosition, packetSize);
+  void Write(Buffer& buffer) {
+    packetSize = Size() - 4;
+    Schema::Encode(*this, buffer);
   }
 
-  std::size_t Size() override {
-    std::size_t packetSize = RequestPacket::Size() + 4 + 3;
-
-    for (auto& topicName : topics) {
-      packetSize += 2 + topicName.size();
-    }
+  std::size_t Size() const { return Schema::Size(*this); }
 
-    return packetSize;
-  }
-
-  std::vector<std::string>& topics;
+  std::vector<std::string> topics;
   bool allowAutoTopicCreation;
   bool includeClusterAuthorizedOperations;
   bool includeTopicAuthorizedOperations;
+
+  using Schema = RequestSchema<
+      schema::Field<&MetadataRequestPacket::topics>,
+      schema::Field<&MetadataRequestPacket::allowAutoTopicCreation>,
+      schema::Field<&MetadataRequestPacket::includeClusterAuthorizedOperations>,
+      schema::Field<&MetadataRequestPacket::includeTopicAuthorizedOperations>>;
 };
 
 struct BrokerNodeInformation {
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
+
   int32_t nodeId{};
   std::string host;
   int32_t port{};
   std::string rack;
 
-  void Read(Buffer& buffer) {
-    nodeId = buffer.Read<int32_t>();
-    host = buffer.ReadString();
-    port = buffer.Read<int32_t>();
-    rack = buffer.ReadString();
-  }
+  using Schema = schema::Fields<schema::Field<&BrokerNodeInformation::nodeId>,
+                                schema::Field<&BrokerNodeInformation::host>,
+                                schema::Field<&BrokerNodeInformation::port>,
+                                schema::Field<&BrokerNodeInformation::rack>>;
 };
 
 struct PartitionInformation {
-  void Read(Buffer& buffer) {
-    errorCode = buffer.Read<int16_t>();
-    partitionIndex = buffer.Read<int32_t>();
-    leaderId = buffer.Read<int32_t>();
-    leaderEpoch = buffer.Read<int32_t>();
-
-    auto amountOfReplicas = buffer.Read<int32_t>();
-    replicas.reserve(amountOfReplicas);
-    for (std::size_t currentReplica = 0; currentReplica < amountOfReplicas;
-         currentReplica++) {
-      replicas.emplace_back(buffer.Read<int32_t>());
-    }
-
-    auto amountOfIsr = buffer.Read<int32_t>();
-    isr.reserve(amountOfIsr);
-    for (std::size_t currentISR = 0; currentISR < amountOfIsr; currentISR++) {
-      isr.emplace_back(buffer.Read<int32_t>());
-    }
-
-    auto amountOfOfflineReplicas = buffer.Read<int32_t>();
-    offlineReplicas.reserve(amountOfOfflineReplicas);
-    for (std::size_t currentOfflineReplica = 0;
-         currentOfflineReplica < amountOfOfflineReplicas;
-         currentOfflineReplica++) {
-      offlineReplicas.emplace_back(buffer.Read<int32_t>());
-    }
-  }
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
 
   int16_t errorCode{};
   int32_t partitionIndex{};
@@ -106,68 +65,52 @@ struct PartitionInformation {
   std::vector<int32_t> replicas;
   std::vector<int32_t> isr;
   std::vector<int32_t> offlineReplicas;
+
+  using Schema =
+      schema::Fields<schema::Field<&PartitionInformation::errorCode>,
+                     schema::Field<&PartitionInformation::partitionIndex>,
+                     schema::Field<&PartitionInformation::leaderId>,
+                     schema::Field<&PartitionInformation::leaderEpoch>,
+                     schema::Field<&PartitionInformation::replicas>,
+                     schema::Field<&PartitionInformation::isr>,
+                     schema::Field<&PartitionInformation::offlineReplicas>>;
 };
 
 struct TopicInformation {
-  void Read(Buffer& buffer) {
-    errorCode = buffer.Read<int16_t>();
-    name = buffer.ReadString();
-    isInternal = buffer.ReadBoolean();
-
-    auto amountOfPartitions = buffer.Read<int32_t>();
-    partitionInformation.reserve(amountOfPartitions);
-    for (std::size_t currentPartition = 0;
-         currentPartition < amountOfPartitions; currentPartition++) {
-      PartitionInformation partitionInfo;
-      partitionInfo.Read(buffer);
-      partitionInformation.emplace_back(partitionInfo);
-    }
-
-    topicAuthorizedOperations = buffer.Read<int32_t>();
-  }
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
 
   int16_t errorCode{};
   std::string name;
   bool isInternal{};
   std::vector<PartitionInformation> partitionInformation;
   int32_t topicAuthorizedOperations{};
+
+  using Schema =
+      schema::Fields<schema::Field<&TopicInformation::errorCode>,
+                     schema::Field<&TopicInformation::name>,
+                     schema::Field<&TopicInformation::isInternal>,
+                     schema::Field<&TopicInformation::partitionInformation>,
+                     schema::Field<&TopicInformation::topicAuthorizedOperations>>;
 };
 
+// MetadataResponsePacket is version 8 of the Metadata response
 struct MetadataResponsePacket : public ResponsePacket {
-  void Read(Buffer& buffer) override {
-    ResponsePacket::Read(buffer);
-
-    throttledInMilliseconds = buffer.Read<int32_t>();
-    auto amountOfBrokers = buffer.Read<int32_t>();
-    brokers.reserve(amountOfBrokers);
-    for (std::size_t currentBroker = 0; currentBroker < amountOfBrokers;
-         currentBroker++) {
-      BrokerNodeInformation information;
-      information.Read(buffer);
-      brokers.emplace_back(information);
-    }
-
-    clusterId = buffer.ReadString();
-    controllerId = buffer.Read<int32_t>();
-
-    auto amountOfTopics = buffer.Read<int32_t>();
-    topicInformation.reserve(amountOfTopics);
-    for (std::size_t currentTopic = 0; currentTopic < amountOfTopics;
-         currentTopic++) {
-      TopicInformation topicInfo;
-      topicInfo.Read(buffer);
-      topicInformation.emplace_back(topicInfo);
-    }
-
-    clusterAuthorizedOperations = buffer.Read<int32_t>();
-  }
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
 
-  int32_t throttledInMilliseconds;
+  int32_t throttledInMilliseconds{};
   std::vector<BrokerNodeInformation> brokers;
   std::string clusterId;
-  int32_t controllerId;
+  int32_t controllerId{};
   std::vector<TopicInformation> topicInformation;
-  int32_t clusterAuthorizedOperations;
+  int32_t clusterAuthorizedOperations{};
+
+  using Schema = ResponseSchema<
+      schema::Field<&MetadataResponsePacket::throttledInMilliseconds>,
+      schema::Field<&MetadataResponsePacket::brokers>,
+      schema::Field<&MetadataResponsePacket::clusterId>,
+      schema::Field<&MetadataResponsePacket::controllerId>,
+      schema::Field<&MetadataResponsePacket::topicInformation>,
+      schema::Field<&MetadataResponsePacket::clusterAuthorizedOperations>>;
 };
 
 struct MetadataPacket {
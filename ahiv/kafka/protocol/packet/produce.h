@@ -0,0 +1,104 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_PACKET_PRODUCE_H
+#define AHIV_KAFKA_PROTOCOL_PACKET_PRODUCE_H
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ahiv/kafka/protocol/packet/base.h"
+
+namespace ahiv::kafka::protocol::packet {
+struct ProducePartitionData {
+  int32_t partitionIndex{};
+  // records are the encoded record batches of the partition, see
+  // RecordBatchWriter
+  std::vector<char> records;
+
+  using Schema =
+      schema::Fields<schema::Field<&ProducePartitionData::partitionIndex>,
+                     schema::Field<&ProducePartitionData::records>>;
+};
+
+struct ProduceTopicData {
+  std::string name;
+  std::vector<ProducePartitionData> partitions;
+
+  using Schema = schema::Fields<schema::Field<&ProduceTopicData::name>,
+                                schema::Field<&ProduceTopicData::partitions>>;
+};
+
+// ProduceRequestPacket is version 7 of the Produce request. Acks is -1 (all
+// in-sync replicas) or 1 (the leader). Acks 0 is not supported, brokers don't
+// answer those requests and every request waits for its response
+struct ProduceRequestPacket : public RequestPacket {
+  explicit ProduceRequestPacket(int16_t acks = -1,
+                                int32_t timeoutInMilliseconds = 30000)
+      : RequestPacket(0, 7),
+        acks(acks),
+        timeoutInMilliseconds(timeoutInMilliseconds) {}
+
+  void Write(Buffer& buffer) {
+    packetSize = Size() - 4;
+    Schema::Encode(*this, buffer);
+  }
+
+  std::size_t Size() const { return Schema::Size(*this); }
+
+  std::optional<std::string> transactionalId;
+  int16_t acks;
+  int32_t timeoutInMilliseconds;
+  std::vector<ProduceTopicData> topics;
+
+  using Schema =
+      RequestSchema<schema::Field<&ProduceRequestPacket::transactionalId>,
+                    schema::Field<&ProduceRequestPacket::acks>,
+                    schema::Field<&ProduceRequestPacket::timeoutInMilliseconds>,
+                    schema::Field<&ProduceRequestPacket::topics>>;
+};
+
+struct ProducePartitionResponse {
+  int32_t partitionIndex{};
+  int16_t errorCode{};
+  int64_t baseOffset{};
+  int64_t logAppendTimeInMilliseconds = -1;
+  int64_t logStartOffset{};
+
+  using Schema = schema::Fields<
+      schema::Field<&ProducePartitionResponse::partitionIndex>,
+      schema::Field<&ProducePartitionResponse::errorCode>,
+      schema::Field<&ProducePartitionResponse::baseOffset>,
+      schema::Field<&ProducePartitionResponse::logAppendTimeInMilliseconds>,
+      schema::Field<&ProducePartitionResponse::logStartOffset>>;
+};
+
+struct ProduceTopicResponse {
+  std::string name;
+  std::vector<ProducePartitionResponse> partitions;
+
+  using Schema =
+      schema::Fields<schema::Field<&ProduceTopicResponse::name>,
+                     schema::Field<&ProduceTopicResponse::partitions>>;
+};
+
+// ProduceResponsePacket is version 7 of the Produce response
+struct ProduceResponsePacket : public ResponsePacket {
+  void Read(Buffer& buffer) { Schema::Decode(*this, buffer); }
+
+  std::vector<ProduceTopicResponse> topics;
+  int32_t throttledInMilliseconds{};
+
+  using Schema = ResponseSchema<
+      schema::Field<&ProduceResponsePacket::topics>,
+      schema::Field<&ProduceResponsePacket::throttledInMilliseconds>>;
+};
+
+struct ProducePacket {
+  using Request = ProduceRequestPacket;
+  using Response = ProduceResponsePacket;
+};
+}  // namespace ahiv::kafka::protocol::packet
+
+#endif  // AHIV_KAFKA_PROTOCOL_PACKET_PRODUCE_H
@@ -0,0 +1,401 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_PACKET_RECORDBATCH_H
+#define AHIV_KAFKA_PROTOCOL_PACKET_RECORDBATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ahiv/kafka/protocol/buffer.h"
+#include "ahiv/kafka/protocol/crc32c.h"
+#include "ahiv/kafka/protocol/endian.h"
+#include "ahiv/kafka/protocol/schema.h"
+
+namespace ahiv::kafka::protocol::packet {
+
+// RecordBatchHeader is the fixed size header of a v2 record batch (magic 2).
+// The producer fields make a batch idempotent: the broker drops batches whose
+// sequence it has already written and rejects gaps. The crc covers everything
+// from attributes to the end of the records and is filled in by the writer of
+// the batch
+struct RecordBatchHeader {
+  static constexpr int8_t Magic = 2;
+
+  int64_t baseOffset{};
+  int32_t batchLength{};
+  int32_t partitionLeaderEpoch = -1;
+  int8_t magic = Magic;
+  uint32_t crc{};
+  int16_t attributes{};
+  int32_t lastOffsetDelta{};
+  int64_t firstTimestamp{};
+  int64_t maxTimestamp{};
+  int64_t producerId = -1;
+  int16_t producerEpoch = -1;
+  int32_t baseSequence = -1;
+  int32_t recordCount{};
+
+  using Schema = schema::Fields<
+      schema::Field<&RecordBatchHeader::baseOffset>,
+      schema::Field<&RecordBatchHeader::batchLength>,
+      schema::Field<&RecordBatchHeader::partitionLeaderEpoch>,
+      schema::Field<&RecordBatchHeader::magic>,
+      schema::Field<&RecordBatchHeader::crc>,
+      schema::Field<&RecordBatchHeader::attributes>,
+      schema::Field<&RecordBatchHeader::lastOffsetDelta>,
+      schema::Field<&RecordBatchHeader::firstTimestamp>,
+      schema::Field<&RecordBatchHeader::maxTimestamp>,
+      schema::Field<&RecordBatchHeader::producerId>,
+      schema::Field<&RecordBatchHeader::producerEpoch>,
+      schema::Field<&RecordBatchHeader::baseSequence>,
+      schema::Field<&RecordBatchHeader::recordCount>>;
+};
+
+static_assert(RecordBatchHeader::Schema::FixedSize == 61,
+              "v2 record batch header is 61 bytes");
+
+// RecordBatchSpan is a single encoded record batch, pointing into the memory
+// it has been received or mapped into
+struct RecordBatchSpan {
+  const char* data;
+  std::size_t size;
+  int64_t baseOffset;
+  int64_t lastOffset;
+};
+
+// RecordBatchReader walks over the record batches of a buffer without
+// copying them. A fetch response may end with a partial batch, reading stops
+// in front of it
+class RecordBatchReader {
+ public:
+  // LengthOffset is the size of the fields in front of and including
+  // batchLength, which is not part of the length
+  static constexpr std::size_t LengthOffset = 12;
+
+  RecordBatchReader(const char* data, std::size_t size)
+      : data(data), size(size) {}
+
+  // Next returns the next complete batch
+  std::optional<RecordBatchSpan> Next() {
+    if (this->size - this->position < RecordBatchHeader::Schema::FixedSize) {
+      return std::nullopt;
+    }
+
+    const char* batch = this->data + this->position;
+    int64_t baseOffset = readBigEndian<int64_t>(batch);
+    int32_t batchLength = readBigEndian<int32_t>(batch + 8);
+    int32_t lastOffsetDelta = readBigEndian<int32_t>(batch + 23);
+
+    std::size_t batchSize =
+        LengthOffset + static_cast<std::size_t>(batchLength);
+    if (batchLength < 0 || batchSize < RecordBatchHeader::Schema::FixedSize ||
+        batchSize > this->size - this->position) {
+      return std::nullopt;
+    }
+
+    this->position += batchSize;
+    return RecordBatchSpan{batch, batchSize, baseOffset,
+                           baseOffset + lastOffsetDelta};
+  }
+
+  // Position returns the amount of bytes read so far
+  std::size_t Position() const { return this->position; }
+
+ private:
+  template <typename Type>
+  static Type readBigEndian(const char* in) {
+    if constexpr (sizeof(Type) == 8) {
+      uint64_t wire;
+      std::memcpy(&wire, in, 8);
+      return static_cast<Type>(be64toh(wire));
+    } else {
+      uint32_t wire;
+      std::memcpy(&wire, in, 4);
+      return static_cast<Type>(be32toh(wire));
+    }
+  }
+
+  const char* data;
+  std::size_t size;
+  std::size_t position = 0;
+};
+
+// RecordView is a single record of a batch. Key and value point into the
+// memory of the batch, a null key or value is empty
+struct RecordView {
+  int64_t Offset;
+  int64_t Timestamp;
+  std::optional<std::string_view> Key;
+  std::optional<std::string_view> Value;
+};
+
+// RecordReader decodes the records of an uncompressed batch without copying
+// their keys and values. Headers are skipped
+class RecordReader {
+ public:
+  // AttributesOffset and the following are the positions of header fields in
+  // the batch
+  static constexpr std::size_t AttributesOffset = 21;
+  static constexpr std::size_t FirstTimestampOffset = 27;
+  static constexpr std::size_t CompressionMask = 0x07;
+
+  explicit RecordReader(const RecordBatchSpan& batch) : batch(batch) {
+    uint16_t attributes;
+    std::memcpy(&attributes, batch.data + AttributesOffset, 2);
+    this->compression = be16toh(attributes) & CompressionMask;
+
+    uint64_t firstTimestamp;
+    std::memcpy(&firstTimestamp, batch.data + FirstTimestampOffset, 8);
+    this->firstTimestamp = static_cast<int64_t>(be64toh(firstTimestamp));
+  }
+
+  // Compressed reports if the records of the batch are compressed, which is
+  // not supported yet. Next returns no records for those
+  bool Compressed() const { return this->compression != 0; }
+
+  // CompressionName returns the name of the codec the records are compressed
+  // with
+  const char* CompressionName() const {
+    switch (this->compression) {
+      case 0:
+        return "none";
+      case 1:
+        return "gzip";
+      case 2:
+        return "snappy";
+      case 3:
+        return "lz4";
+      case 4:
+        return "zstd";
+      default:
+        return "unknown";
+    }
+  }
+
+  // Next decodes the next record, nothing at the end of the batch or when the
+  // record is malformed
+  std::optional<RecordView> Next() {
+    if (this->Compressed()) {
+      return std::nullopt;
+    }
+
+    int64_t length;
+    if (!this->readVarint(length) || length < 0 ||
+        static_cast<uint64_t>(length) > this->remaining()) {
+      return std::nullopt;
+    }
+    std::size_t end = this->position + length;
+
+    int64_t timestampDelta, offsetDelta, headerCount;
+    RecordView record{};
+    if (!this->skip(1) || !this->readVarint(timestampDelta) ||
+        !this->readVarint(offsetDelta) || !this->readBytes(record.Key) ||
+        !this->readBytes(record.Value) || !this->readVarint(headerCount)) {
+      return std::nullopt;
+    }
+
+    record.Offset = this->batch.baseOffset + offsetDelta;
+    record.Timestamp = this->firstTimestamp + timestampDelta;
+    this->position = end;
+    return record;
+  }
+
+ private:
+  std::size_t remaining() const { return this->batch.size - this->position; }
+
+  bool skip(std::size_t length) {
+    if (length > this->remaining()) {
+      return false;
+    }
+
+    this->position += length;
+    return true;
+  }
+
+  // readVarint reads a zig zag encoded variable length integer
+  bool readVarint(int64_t& value) {
+    uint64_t raw = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (this->remaining() == 0) {
+        return false;
+      }
+
+      auto byte = static_cast<uint8_t>(this->batch.data[this->position++]);
+      raw |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool readBytes(std::optional<std::string_view>& bytes) {
+    int64_t length;
+    if (!this->readVarint(length)) {
+      return false;
+    }
+
+    if (length < 0) {
+      bytes.reset();
+      return true;
+    }
+
+    if (static_cast<uint64_t>(length) > this->remaining()) {
+      return false;
+    }
+
+    bytes.emplace(this->batch.data + this->position, length);
+    this->position += length;
+    return true;
+  }
+
+  RecordBatchSpan batch;
+  std::size_t position = RecordBatchHeader::Schema::FixedSize;
+  uint16_t compression;
+  int64_t firstTimestamp;
+};
+
+// RecordBatchWriter encodes an uncompressed batch. Records are appended right
+// behind the space of the header, Finish fills in the header and the
+// checksum, so the batch is built in a single buffer without copies
+class RecordBatchWriter {
+ public:
+  // CrcOffset is the position of the crc in the batch, it covers everything
+  // from the attributes on
+  static constexpr std::size_t CrcOffset = 17;
+  // ProducerIdOffset is the position of the producer id, followed by the
+  // producer epoch and the base sequence
+  static constexpr std::size_t ProducerIdOffset = 43;
+
+  explicit RecordBatchWriter(std::size_t expectedSize = 0) {
+    this->data.reserve(
+        std::max(expectedSize, RecordBatchHeader::Schema::FixedSize));
+    this->data.resize(RecordBatchHeader::Schema::FixedSize);
+  }
+
+  // Append adds a record with the given timestamp in milliseconds, a missing
+  // key or value is written as null
+  void Append(std::optional<std::string_view> key,
+              std::optional<std::string_view> value, int64_t timestamp) {
+    if (this->recordCount == 0) {
+      this->firstTimestamp = timestamp;
+    }
+    this->maxTimestamp = std::max(this->maxTimestamp, timestamp);
+
+    int64_t timestampDelta = timestamp - this->firstTimestamp;
+    int64_t keyLength = key.has_value() ? key->size() : -1;
+    int64_t valueLength = value.has_value() ? value->size() : -1;
+    std::size_t bodySize = 1 + varintSize(timestampDelta) +
+                           varintSize(this->recordCount) +
+                           varintSize(keyLength) + std::max<int64_t>(keyLength, 0) +
+                           varintSize(valueLength) +
+                           std::max<int64_t>(valueLength, 0) + 1;
+
+    this->appendVarint(bodySize);
+    this->data.push_back(0);  // attributes
+    this->appendVarint(timestampDelta);
+    this->appendVarint(this->recordCount);
+    this->appendBytes(key);
+    this->appendBytes(value);
+    this->data.push_back(0);  // header count
+    this->recordCount++;
+  }
+
+  int32_t RecordCount() const { return this->recordCount; }
+
+  // Size returns the size of the batch so far, including the header
+  std::size_t Size() const { return this->data.size(); }
+
+  // Finish writes the header fields which are not derived from the records
+  // (producer id, epoch, sequence and base offset) along with the derived
+  // ones and returns the encoded batch. The writer is empty afterwards
+  std::vector<char> Finish(RecordBatchHeader header) {
+    header.batchLength = static_cast<int32_t>(
+        this->data.size() - RecordBatchReader::LengthOffset);
+    header.lastOffsetDelta = this->recordCount - 1;
+    header.firstTimestamp = this->firstTimestamp;
+    header.maxTimestamp = this->maxTimestamp;
+    header.recordCount = this->recordCount;
+    header.crc = 0;
+
+    Buffer encoded;
+    encoded.EnsureAllocated(RecordBatchHeader::Schema::FixedSize);
+    RecordBatchHeader::Schema::Encode(header, encoded);
+    std::memcpy(this->data.data(), encoded.View(0),
+                RecordBatchHeader::Schema::FixedSize);
+
+    std::size_t covered = RecordReader::AttributesOffset;
+    uint32_t crc = htobe32(Crc32c(this->data.data() + covered,
+                                  this->data.size() - covered));
+    std::memcpy(this->data.data() + CrcOffset, &crc, 4);
+
+    std::vector<char> batch = std::move(this->data);
+    *this = RecordBatchWriter();
+    return batch;
+  }
+
+  // Restamp writes the producer id, epoch and base sequence of the header
+  // into a finished batch and updates its checksum, so a batch which is sent
+  // again carries the sequence it has now
+  static void Restamp(std::vector<char>& batch,
+                      const RecordBatchHeader& header) {
+    char* producer = batch.data() + ProducerIdOffset;
+    schema::Codec<int64_t>::EncodeFixed(header.producerId, producer);
+    schema::Codec<int16_t>::EncodeFixed(header.producerEpoch, producer + 8);
+    schema::Codec<int32_t>::EncodeFixed(header.baseSequence, producer + 10);
+
+    std::size_t covered = RecordReader::AttributesOffset;
+    uint32_t crc =
+        htobe32(Crc32c(batch.data() + covered, batch.size() - covered));
+    std::memcpy(batch.data() + CrcOffset, &crc, 4);
+  }
+
+ private:
+  // varintSize returns the size of the zig zag encoded value
+  static std::size_t varintSize(int64_t value) {
+    uint64_t raw = (static_cast<uint64_t>(value) << 1) ^
+                   static_cast<uint64_t>(value >> 63);
+    std::size_t size = 1;
+    while (raw >= 0x80) {
+      raw >>= 7;
+      size++;
+    }
+    return size;
+  }
+
+  void appendVarint(int64_t value) {
+    uint64_t raw = (static_cast<uint64_t>(value) << 1) ^
+                   static_cast<uint64_t>(value >> 63);
+    while (raw >= 0x80) {
+      this->data.push_back(static_cast<char>((raw & 0x7f) | 0x80));
+      raw >>= 7;
+    }
+    this->data.push_back(static_cast<char>(raw));
+  }
+
+  void appendBytes(const std::optional<std::string_view>& bytes) {
+    if (!bytes.has_value()) {
+      this->appendVarint(-1);
+      return;
+    }
+
+    this->appendVarint(bytes->size());
+    this->data.insert(this->data.end(), bytes->begin(), bytes->end());
+  }
+
+  std::vector<char> data;
+  int32_t recordCount = 0;
+  int64_t firstTimestamp = 0;
+  int64_t maxTimestamp = 0;
+};
+}  // namespace ahiv::kafka::protocol::packet
+
+#endif  // AHIV_KAFKA_PROTOCOL_PACKET_RECORDBATCH_H
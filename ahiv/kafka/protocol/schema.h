@@ -0,0 +1,392 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_PROTOCOL_SCHEMA_H
+#define AHIV_KAFKA_PROTOCOL_SCHEMA_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ahiv/kafka/protocol/buffer.h"
+#include "ahiv/kafka/protocol/endian.h"
+
+// A schema lists the fields of a packet in wire order:
+//
+//   using Schema = schema::Fields<schema::Field<&Packet::a>,
+//                                 schema::Field<&Packet::b>>;
+//
+// Encode, Decode and Size are generated from that list at compile time, so
+// the size of a packet can't drift from what is written. Runs of fixed width
+// fields are written with a single bounds step straight into the buffer
+namespace ahiv::kafka::protocol::schema {
+template <typename Type, typename = void>
+struct Codec;
+
+// HasSchema detects packets and structs which describe themselves via a
+// Schema type
+template <typename Type, typename = void>
+struct HasSchema : std::false_type {};
+
+template <typename Type>
+struct HasSchema<Type, std::void_t<typename Type::Schema>> : std::true_type {};
+
+// Codec of fixed width integers and booleans, encoded in network byte order
+template <typename Type>
+struct Codec<Type, std::enable_if_t<std::is_integral_v<Type>>> {
+  static constexpr bool IsFixed = true;
+  static constexpr std::size_t FixedSize = sizeof(Type);
+
+  static void EncodeFixed(Type value, char* out) {
+    if constexpr (sizeof(Type) == 8) {
+      uint64_t wire = htobe64(static_cast<uint64_t>(value));
+      std::memcpy(out, &wire, 8);
+    } else if constexpr (sizeof(Type) == 4) {
+      uint32_t wire = htobe32(static_cast<uint32_t>(value));
+      std::memcpy(out, &wire, 4);
+    } else if constexpr (sizeof(Type) == 2) {
+      uint16_t wire = htobe16(static_cast<uint16_t>(value));
+      std::memcpy(out, &wire, 2);
+    } else {
+      out[0] = static_cast<char>(value);
+    }
+  }
+
+  static void Encode(Type value, Buffer& buffer) {
+    EncodeFixed(value, buffer.Reserve(FixedSize));
+  }
+
+  static void Decode(Type& value, Buffer& buffer) {
+    if constexpr (std::is_same_v<Type, bool>) {
+      value = buffer.ReadBoolean();
+    } else {
+      value = buffer.Read<Type>();
+    }
+  }
+
+  static constexpr std::size_t Size(Type) { return FixedSize; }
+};
+
+// Codec of strings, encoded with an int16 length prefix
+template <>
+struct Codec<std::string> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const std::string& value, Buffer& buffer) {
+    buffer.WriteString(value);
+  }
+
+  static void Decode(std::string& value, Buffer& buffer) {
+    value = buffer.ReadString();
+  }
+
+  static std::size_t Size(const std::string& value) { return 2 + value.size(); }
+};
+
+// Codec of nullable strings, a missing value is encoded as length -1
+template <>
+struct Codec<std::optional<std::string>> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const std::optional<std::string>& value, Buffer& buffer) {
+    if (!value.has_value()) {
+      Codec<int16_t>::Encode(-1, buffer);
+      return;
+    }
+
+    buffer.WriteString(*value);
+  }
+
+  static void Decode(std::optional<std::string>& value, Buffer& buffer) {
+    if (buffer.Read<int16_t>() == -1) {
+      value.reset();
+      return;
+    }
+
+    buffer.SeekRead(buffer.ReadPosition() - 2);
+    value = buffer.ReadString();
+  }
+
+  static std::size_t Size(const std::optional<std::string>& value) {
+    return 2 + (value.has_value() ? value->size() : 0);
+  }
+};
+
+// Codec of byte arrays, encoded with an int32 length and copied as a whole.
+// Null bytes (length -1) and a length beyond the end of the buffer are
+// decoded as empty, the rest of the buffer is skipped for the latter
+template <>
+struct Codec<std::vector<char>> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const std::vector<char>& value, Buffer& buffer) {
+    Codec<int32_t>::Encode(static_cast<int32_t>(value.size()), buffer);
+    buffer.WriteData(value.data(), value.size());
+  }
+
+  static void Decode(std::vector<char>& value, Buffer& buffer) {
+    auto length = buffer.Read<int32_t>();
+    value.clear();
+    if (length <= 0) {
+      return;
+    }
+    if (static_cast<std::size_t>(length) > buffer.Remaining()) {
+      buffer.Skip(buffer.Remaining());
+      return;
+    }
+
+    const char* data = buffer.View(buffer.ReadPosition());
+    value.assign(data, data + length);
+    buffer.Skip(length);
+  }
+
+  static std::size_t Size(const std::vector<char>& value) {
+    return 4 + value.size();
+  }
+};
+
+// BytesView is a byte array which points into the memory it has been
+// decoded from instead of copying it, whoever owns that memory has to keep it
+// alive as long as the view is used
+class BytesView {
+ public:
+  BytesView() = default;
+  BytesView(const char* data, std::size_t size) : pointer(data), length(size) {}
+
+  const char* data() const { return this->pointer; }
+  std::size_t size() const { return this->length; }
+  bool empty() const { return this->length == 0; }
+
+ private:
+  const char* pointer = nullptr;
+  std::size_t length = 0;
+};
+
+// Codec of byte arrays which are decoded as a view into the buffer, encoded
+// like std::vector<char>. A length beyond the end of the buffer is decoded as
+// empty and the rest of the buffer is skipped
+template <>
+struct Codec<BytesView> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const BytesView& value, Buffer& buffer) {
+    Codec<int32_t>::Encode(static_cast<int32_t>(value.size()), buffer);
+    buffer.WriteData(value.data(), value.size());
+  }
+
+  static void Decode(BytesView& value, Buffer& buffer) {
+    auto length = buffer.Read<int32_t>();
+    value = BytesView();
+    if (length <= 0) {
+      return;
+    }
+    if (static_cast<std::size_t>(length) > buffer.Remaining()) {
+      buffer.Skip(buffer.Remaining());
+      return;
+    }
+
+    value = BytesView(buffer.View(buffer.ReadPosition()), length);
+    buffer.Skip(length);
+  }
+
+  static std::size_t Size(const BytesView& value) { return 4 + value.size(); }
+};
+
+// Codec of arrays, encoded with an int32 element count. A null array (count
+// -1) is decoded as empty
+template <typename Element>
+struct Codec<std::vector<Element>> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const std::vector<Element>& value, Buffer& buffer) {
+    Codec<int32_t>::Encode(static_cast<int32_t>(value.size()), buffer);
+    for (const auto& element : value) {
+      Codec<Element>::Encode(element, buffer);
+    }
+  }
+
+  static void Decode(std::vector<Element>& value, Buffer& buffer) {
+    auto amountOfElements = buffer.Read<int32_t>();
+    value.clear();
+    if (amountOfElements <= 0) {
+      return;
+    }
+
+    value.resize(amountOfElements);
+    for (auto& element : value) {
+      Codec<Element>::Decode(element, buffer);
+    }
+  }
+
+  static std::size_t Size(const std::vector<Element>& value) {
+    if constexpr (Codec<Element>::IsFixed) {
+      return 4 + value.size() * Codec<Element>::FixedSize;
+    } else {
+      std::size_t size = 4;
+      for (const auto& element : value) {
+        size += Codec<Element>::Size(element);
+      }
+      return size;
+    }
+  }
+};
+
+// Codec of nested structs which have their own schema
+template <typename Type>
+struct Codec<Type, std::enable_if_t<HasSchema<Type>::value>> {
+  static constexpr bool IsFixed = false;
+  static constexpr std::size_t FixedSize = 0;
+
+  static void Encode(const Type& value, Buffer& buffer) {
+    Type::Schema::Encode(value, buffer);
+  }
+
+  static void Decode(Type& value, Buffer& buffer) {
+    Type::Schema::Decode(value, buffer);
+  }
+
+  static std::size_t Size(const Type& value) {
+    return Type::Schema::Size(value);
+  }
+};
+
+template <typename MemberPointer>
+struct MemberTraits;
+
+template <typename Owner, typename Type>
+struct MemberTraits<Type Owner::*> {
+  using OwnerType = Owner;
+  using ValueType = Type;
+};
+
+// Field binds a data member to its codec. Members of base classes can be
+// listed as well, they are accessed through the derived packet
+template <auto Member>
+struct Field {
+  using Owner = typename MemberTraits<decltype(Member)>::OwnerType;
+  using Value = typename MemberTraits<decltype(Member)>::ValueType;
+  using ValueCodec = Codec<Value>;
+
+  static constexpr bool IsFixed = ValueCodec::IsFixed;
+  static constexpr std::size_t FixedSize = ValueCodec::FixedSize;
+
+  static void EncodeFixed(const Owner& packet, char* out) {
+    ValueCodec::EncodeFixed(packet.*Member, out);
+  }
+
+  static void Encode(const Owner& packet, Buffer& buffer) {
+    ValueCodec::Encode(packet.*Member, buffer);
+  }
+
+  static void Decode(Owner& packet, Buffer& buffer) {
+    ValueCodec::Decode(packet.*Member, buffer);
+  }
+
+  static std::size_t Size(const Owner& packet) {
+    return ValueCodec::Size(packet.*Member);
+  }
+};
+
+// Fields is the schema of a packet, it generates encode, decode and size for
+// the listed fields
+template <typename... FieldList>
+struct Fields {
+  using List = std::tuple<FieldList...>;
+  static constexpr std::size_t Count = sizeof...(FieldList);
+
+  // FixedSize is the sum of all fixed width fields, the exact size of a
+  // packet without variable width fields
+  static constexpr std::size_t FixedSize = (FieldList::FixedSize + ... + 0);
+
+  template <typename Packet>
+  static void Encode(const Packet& packet, Buffer& buffer) {
+    encodeFrom<0>(packet, buffer);
+  }
+
+  template <typename Packet>
+  static void Decode(Packet& packet, Buffer& buffer) {
+    (FieldList::Decode(packet, buffer), ...);
+  }
+
+  template <typename Packet>
+  static std::size_t Size(const Packet& packet) {
+    return FixedSize + (variableSize<FieldList>(packet) + ... + 0);
+  }
+
+ private:
+  template <typename FieldType, typename Packet>
+  static std::size_t variableSize(const Packet& packet) {
+    if constexpr (FieldType::IsFixed) {
+      return 0;
+    } else {
+      return FieldType::Size(packet);
+    }
+  }
+
+  // fixedRunLength returns how many fixed width fields follow each other
+  // starting at the given index
+  static constexpr std::size_t fixedRunLength(std::size_t index) {
+    constexpr std::array<bool, Count> isFixed = {FieldList::IsFixed...};
+    std::size_t length = 0;
+    while (index + length < Count && isFixed[index + length]) {
+      length++;
+    }
+    return length;
+  }
+
+  template <std::size_t Index, typename Packet>
+  static void encodeFrom(const Packet& packet, Buffer& buffer) {
+    if constexpr (Index < Count) {
+      constexpr std::size_t run = fixedRunLength(Index);
+      if constexpr (run > 0) {
+        encodeRun<Index>(packet, buffer, std::make_index_sequence<run>{});
+        encodeFrom<Index + run>(packet, buffer);
+      } else {
+        std::tuple_element_t<Index, List>::Encode(packet, buffer);
+        encodeFrom<Index + 1>(packet, buffer);
+      }
+    }
+  }
+
+  // encodeRun reserves the space of a run of fixed width fields at once and
+  // stores every field at its compile time offset
+  template <std::size_t Start, typename Packet, std::size_t... Offsets>
+  static void encodeRun(const Packet& packet, Buffer& buffer,
+                        std::index_sequence<Offsets...>) {
+    constexpr std::array<std::size_t, sizeof...(Offsets)> sizes = {
+        std::tuple_element_t<Start + Offsets, List>::FixedSize...};
+    constexpr auto positions = prefixSums(sizes);
+
+    char* out = buffer.Reserve(positions.back() + sizes.back());
+    (std::tuple_element_t<Start + Offsets, List>::EncodeFixed(
+         packet, out + std::get<Offsets>(positions)),
+     ...);
+  }
+
+  // prefixSums returns the offset of every field in a run
+  template <std::size_t Length>
+  static constexpr std::array<std::size_t, Length> prefixSums(
+      std::array<std::size_t, Length> sizes) {
+    std::array<std::size_t, Length> positions{};
+    std::size_t position = 0;
+    for (std::size_t index = 0; index < Length; index++) {
+      positions[index] = position;
+      position += sizes[index];
+    }
+    return positions;
+  }
+};
+}  // namespace ahiv::kafka::protocol::schema
+
+#endif  // AHIV_KAFKA_PROTOCOL_SCHEMA_H
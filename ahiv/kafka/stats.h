@@ -0,0 +1,224 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_STATS_H
+#define AHIV_KAFKA_STATS_H
+
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ahiv::kafka {
+// HistogramSnapshot summarizes a latency histogram. All values are in
+// microseconds.
+struct HistogramSnapshot {
+  uint64_t Count;
+  uint64_t Min;
+  uint64_t Max;
+  double Mean;
+  uint64_t P50;
+  uint64_t P90;
+  uint64_t P99;
+  uint64_t P999;
+};
+
+// ApiStats holds the request latency of one api key on one broker.
+struct ApiStats {
+  int16_t ApiKey;
+  HistogramSnapshot Latency;
+};
+
+// BrokerStats holds the counters of a single broker connection.
+struct BrokerStats {
+  // NodeId is the broker id, -1 when the connection has not been matched to a
+  // broker yet.
+  int32_t NodeId;
+  std::string Host;
+  std::string Port;
+  // InFlight is the amount of requests which wait for a response.
+  uint64_t InFlight;
+  // QueueDepth is the amount of bytes queued for writing in the socket.
+  uint64_t QueueDepth;
+  uint64_t RequestsSent;
+  uint64_t ResponsesReceived;
+  uint64_t BytesOut;
+  uint64_t BytesIn;
+  // ThrottledResponses counts responses which had a throttle time set.
+  uint64_t ThrottledResponses;
+  // ThrottleTimeMs is the sum of all throttle times reported by the broker.
+  uint64_t ThrottleTimeMs;
+  // MaxThrottleTimeMs is the highest throttle time reported by the broker.
+  uint64_t MaxThrottleTimeMs;
+  // PacedRequests counts requests which were held back until the throttle
+  // time of the broker was over.
+  uint64_t PacedRequests;
+  // HeldRequests is the amount of requests which are currently held back.
+  uint64_t HeldRequests;
+  // RequestTimeouts counts requests which have not been answered in time.
+  uint64_t RequestTimeouts;
+  // UnmatchedResponses counts response frames without a request waiting for
+  // them, like late responses to requests which timed out.
+  uint64_t UnmatchedResponses;
+  // TLS is set for ssl:// connections. KernelTLSSend and KernelTLSReceive
+  // are set when the kernel encrypts or decrypts the records (kTLS) instead
+  // of the client.
+  bool TLS;
+  bool KernelTLSSend;
+  bool KernelTLSReceive;
+  // IOUring is set when the socket I/O of the connection goes through
+  // io_uring instead of libuv.
+  bool IOUring;
+  // NoDelay and BusyPollUs are the socket options of the low latency mode
+  // which are in effect, BusyPollUs is zero when the kernel refused it.
+  bool NoDelay;
+  uint64_t BusyPollUs;
+  std::vector<ApiStats> Apis;
+};
+
+// PartitionBatchingStats holds the decisions of the adaptive batch controller
+// of a producer for one partition.
+struct PartitionBatchingStats {
+  std::string Topic;
+  int32_t Partition;
+  // LingerUs is the time a batch currently waits for more records.
+  uint64_t LingerUs;
+  // BatchBytes is the size a batch is currently sent at.
+  uint64_t BatchBytes;
+  uint64_t ArrivalBytesPerSecond;
+  // Increases and Decreases count the adjustments of linger or batch size.
+  uint64_t Increases;
+  uint64_t Decreases;
+};
+
+// LoopStats shows what a BusyPollLoop spends its core on. Iterations which
+// handled no broker I/O are spins, the ratio of SpinUs to the total time is
+// the share of the core burnt on waiting.
+struct LoopStats {
+  uint64_t Iterations;
+  uint64_t SpinIterations;
+  uint64_t BusyUs;
+  uint64_t SpinUs;
+};
+
+// StatsEvent is fired periodically by a connection which has stats enabled,
+// it contains one entry per broker connection.
+struct StatsEvent {
+  std::vector<BrokerStats> Brokers;
+  // Batching is only filled by producers.
+  std::vector<PartitionBatchingStats> Batching;
+  // Loop is only filled when the loop is run by a BusyPollLoop.
+  std::optional<LoopStats> Loop;
+};
+
+namespace internal {
+// appendHistogramJSON writes the histogram as a JSON object
+inline void appendHistogramJSON(std::ostringstream& json,
+                                const HistogramSnapshot& histogram) {
+  json << "{\"count\":" << histogram.Count << ",\"min\":" << histogram.Min
+       << ",\"max\":" << histogram.Max << ",\"mean\":" << histogram.Mean
+       << ",\"p50\":" << histogram.P50 << ",\"p90\":" << histogram.P90
+       << ",\"p99\":" << histogram.P99 << ",\"p999\":" << histogram.P999
+       << "}";
+}
+
+// appendStringJSON writes the value as an escaped JSON string
+inline void appendStringJSON(std::ostringstream& json,
+                             const std::string& value) {
+  json << '"';
+  for (char character : value) {
+    if (character == '"' || character == '\\') {
+      json << '\\';
+    }
+    json << character;
+  }
+  json << '"';
+}
+}  // namespace internal
+
+// ToJSON serializes the stats snapshot into a JSON document, latencies are
+// given in microseconds.
+inline std::string ToJSON(const StatsEvent& stats) {
+  std::ostringstream json;
+  json << "{\"brokers\":[";
+  for (std::size_t brokerIndex = 0; brokerIndex < stats.Brokers.size();
+       brokerIndex++) {
+    const auto& broker = stats.Brokers[brokerIndex];
+    if (brokerIndex > 0) {
+      json << ',';
+    }
+
+    json << "{\"nodeId\":" << broker.NodeId << ",\"host\":";
+    internal::appendStringJSON(json, broker.Host);
+    json << ",\"port\":";
+    internal::appendStringJSON(json, broker.Port);
+    json << ",\"inFlight\":" << broker.InFlight
+         << ",\"queueDepth\":" << broker.QueueDepth
+         << ",\"requestsSent\":" << broker.RequestsSent
+         << ",\"responsesReceived\":" << broker.ResponsesReceived
+         << ",\"bytesOut\":" << broker.BytesOut
+         << ",\"bytesIn\":" << broker.BytesIn
+         << ",\"throttledResponses\":" << broker.ThrottledResponses
+         << ",\"throttleTimeMs\":" << broker.ThrottleTimeMs
+         << ",\"maxThrottleTimeMs\":" << broker.MaxThrottleTimeMs
+         << ",\"pacedRequests\":" << broker.PacedRequests
+         << ",\"heldRequests\":" << broker.HeldRequests
+         << ",\"requestTimeouts\":" << broker.RequestTimeouts
+         << ",\"unmatchedResponses\":" << broker.UnmatchedResponses
+         << ",\"tls\":" << (broker.TLS ? "true" : "false")
+         << ",\"kernelTLSSend\":" << (broker.KernelTLSSend ? "true" : "false")
+         << ",\"kernelTLSReceive\":"
+         << (broker.KernelTLSReceive ? "true" : "false")
+         << ",\"ioUring\":" << (broker.IOUring ? "true" : "false")
+         << ",\"noDelay\":" << (broker.NoDelay ? "true" : "false")
+         << ",\"busyPollUs\":" << broker.BusyPollUs
+         << ",\"apis\":[";
+
+    for (std::size_t apiIndex = 0; apiIndex < broker.Apis.size(); apiIndex++) {
+      if (apiIndex > 0) {
+        json << ',';
+      }
+
+      json << "{\"apiKey\":" << broker.Apis[apiIndex].ApiKey
+           << ",\"latencyUs\":";
+      internal::appendHistogramJSON(json, broker.Apis[apiIndex].Latency);
+      json << '}';
+    }
+
+    json << "]}";
+  }
+
+  json << "],\"batching\":[";
+  for (std::size_t index = 0; index < stats.Batching.size(); index++) {
+    const auto& batching = stats.Batching[index];
+    if (index > 0) {
+      json << ',';
+    }
+
+    json << "{\"topic\":";
+    internal::appendStringJSON(json, batching.Topic);
+    json << ",\"partition\":" << batching.Partition
+         << ",\"lingerUs\":" << batching.LingerUs
+         << ",\"batchBytes\":" << batching.BatchBytes
+         << ",\"arrivalBytesPerSecond\":" << batching.ArrivalBytesPerSecond
+         << ",\"increases\":" << batching.Increases
+         << ",\"decreases\":" << batching.Decreases << '}';
+  }
+  json << ']';
+
+  if (stats.Loop.has_value()) {
+    uint64_t total = stats.Loop->BusyUs + stats.Loop->SpinUs;
+    json << ",\"loop\":{\"iterations\":" << stats.Loop->Iterations
+         << ",\"spinIterations\":" << stats.Loop->SpinIterations
+         << ",\"busyUs\":" << stats.Loop->BusyUs
+         << ",\"spinUs\":" << stats.Loop->SpinUs << ",\"spinRatio\":"
+         << (total > 0 ? static_cast<double>(stats.Loop->SpinUs) / total : 0.0)
+         << '}';
+  }
+  json << '}';
+  return json.str();
+}
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_STATS_H
@@ -0,0 +1,30 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_TLSCONFIG_H
+#define AHIV_KAFKA_TLSCONFIG_H
+
+#include <string>
+
+namespace ahiv::kafka {
+// TLSConfig configures the sessions of ssl:// broker connections.
+struct TLSConfig {
+  // CAFile is the PEM file of the certificates brokers are verified against.
+  // The default locations of the system are used when it is empty.
+  std::string CAFile;
+  // CertificateFile is the PEM file of the client certificate chain, for
+  // brokers which authenticate clients. KeyFile holds its private key, it may
+  // be left empty when the key is part of CertificateFile.
+  std::string CertificateFile;
+  std::string KeyFile;
+  // VerifyPeer checks the certificate of the broker and that it has been
+  // issued for the broker host.
+  bool VerifyPeer = true;
+  // KernelOffload hands the record encryption to the kernel (kTLS) once the
+  // handshake is done, where the kernel and OpenSSL support it. Sessions fall
+  // back to encrypting in userspace otherwise.
+  bool KernelOffload = true;
+};
+}  // namespace ahiv::kafka
+
+#endif  // AHIV_KAFKA_TLSCONFIG_H
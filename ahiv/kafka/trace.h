@@ -0,0 +1,147 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_TRACE_H
+#define AHIV_KAFKA_TRACE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define AHIV_KAFKA_HAS_USDT
+#endif
+#endif
+
+namespace ahiv::kafka::trace {
+// Stage is a step in the lifecycle of a single request.
+enum class Stage : uint8_t {
+  // Enqueue is hit when a request has been handed to a broker connection.
+  Enqueue,
+  // Serialize is hit when the request has been written into its buffer.
+  Serialize,
+  // WriteComplete is hit when the socket accepted all bytes of the request.
+  WriteComplete,
+  // FirstByte is hit when the first bytes of the response arrived.
+  FirstByte,
+  // FrameComplete is hit when the whole response frame has been received.
+  FrameComplete,
+  // Decode is hit when the response has been decoded into its packet.
+  Decode,
+  // Callback is hit when the response callback has returned.
+  Callback
+};
+
+// NoopTracer is the default policy. All hooks are empty and inlined, so a
+// build without tracing does not pay for them.
+struct NoopTracer {
+  static constexpr bool Enabled = false;
+
+  static void Hit(Stage, int32_t, int16_t) {}
+};
+
+// Record is a single hook hit stored by the RingBufferTracer.
+struct Record {
+  // Timestamp is the steady clock time in nanoseconds.
+  int64_t Timestamp;
+  int32_t CorrelationId;
+  int16_t ApiKey;
+  trace::Stage Stage;
+};
+
+// RingBufferTracer stores the last Capacity hook hits with timestamps in a
+// process wide ring buffer. Capacity must be a power of two.
+template <std::size_t Capacity = 65536>
+struct RingBufferTracer {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+  static constexpr bool Enabled = true;
+
+  static void Hit(Stage stage, int32_t correlationId, int16_t apiKey) {
+    uint64_t position = next.fetch_add(1, std::memory_order_relaxed);
+    records[position & (Capacity - 1)] = Record{
+        .Timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count(),
+        .CorrelationId = correlationId,
+        .ApiKey = apiKey,
+        .Stage = stage};
+  }
+
+  // Records returns the recorded hits, oldest first. Must not be called while
+  // hooks are hit concurrently.
+  static std::vector<Record> Records() {
+    uint64_t end = next.load(std::memory_order_acquire);
+    uint64_t begin = end > Capacity ? end - Capacity : 0;
+
+    std::vector<Record> copy;
+    copy.reserve(end - begin);
+    for (uint64_t position = begin; position < end; position++) {
+      copy.emplace_back(records[position & (Capacity - 1)]);
+    }
+
+    return copy;
+  }
+
+  // Reset forgets all recorded hits.
+  static void Reset() { next.store(0, std::memory_order_release); }
+
+ private:
+  static inline std::array<Record, Capacity> records{};
+  static inline std::atomic<uint64_t> next{0};
+};
+
+// USDTTracer fires a Linux USDT probe per stage in the provider ahiv_kafka,
+// with the correlation id and api key as arguments. Attach to them with for
+// example bpftrace -e 'usdt:./kafka-client:ahiv_kafka:decode { ... }'. On
+// systems without <sys/sdt.h> the hooks are empty.
+struct USDTTracer {
+  static constexpr bool Enabled = true;
+
+  static void Hit(Stage stage, int32_t correlationId, int16_t apiKey) {
+#ifdef AHIV_KAFKA_HAS_USDT
+    switch (stage) {
+      case Stage::Enqueue:
+        DTRACE_PROBE2(ahiv_kafka, enqueue, correlationId, apiKey);
+        break;
+      case Stage::Serialize:
+        DTRACE_PROBE2(ahiv_kafka, serialize, correlationId, apiKey);
+        break;
+      case Stage::WriteComplete:
+        DTRACE_PROBE2(ahiv_kafka, write_complete, correlationId, apiKey);
+        break;
+      case Stage::FirstByte:
+        DTRACE_PROBE2(ahiv_kafka, first_byte, correlationId, apiKey);
+        break;
+      case Stage::FrameComplete:
+        DTRACE_PROBE2(ahiv_kafka, frame_complete, correlationId, apiKey);
+        break;
+      case Stage::Decode:
+        DTRACE_PROBE2(ahiv_kafka, decode, correlationId, apiKey);
+        break;
+      case Stage::Callback:
+        DTRACE_PROBE2(ahiv_kafka, callback, correlationId, apiKey);
+        break;
+    }
+#endif
+  }
+};
+
+// DefaultTracer is the policy used by the client. It is selected at compile
+// time with -DAHIV_KAFKA_TRACE_RING_BUFFER or -DAHIV_KAFKA_TRACE_USDT and
+// falls back to the NoopTracer.
+#if defined(AHIV_KAFKA_TRACE_RING_BUFFER)
+using DefaultTracer = RingBufferTracer<>;
+#elif defined(AHIV_KAFKA_TRACE_USDT)
+using DefaultTracer = USDTTracer;
+#else
+using DefaultTracer = NoopTracer;
+#endif
+}  // namespace ahiv::kafka::trace
+
+#endif  // AHIV_KAFKA_TRACE_H
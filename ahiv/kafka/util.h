@@ -4,24 +4,30 @@
 #ifndef AHIV_KAFKA_UTIL_H_
 #define AHIV_KAFKA_UTIL_H_
 
+#include <cstddef>
+#include <functional>
+#include <iomanip>
 #include <iostream>
 
 namespace ahiv::kafka {
 template<class Value>
 using ResponseCallback = std::function<void (Value&)>;
 
-// DumpAsHex prints the input to stdout as a hex string.
-static void DumpAsHex(const char* input, std::size_t length) {
-  DumpAsHex(input, length, std::cout);
-}
-
 // DumpAsHex prints the input to the given output stream as a hex string.
-static void DumpAsHex(const char* input, std::size_t length, std::ostream output) {
-  output << length << '\n\';
-  for (int index = 0; index < length; index++) {
-    fprintf(output, "%02X ", input[index]);
+inline void DumpAsHex(const char* input, std::size_t length,
+                      std::ostream& output) {
+  output << length << '\n' << std::hex << std::uppercase << std::setfill('0');
+  for (std::size_t index = 0; index < length; index++) {
+    output << std::setw(2)
+           << static_cast<unsigned>(static_cast<unsigned char>(input[index]))
+           << ' ';
   }
-  output << std::flush;
+  output << std::dec << std::nouppercase << std::setfill(' ') << std::flush;
+}
+
+// DumpAsHex prints the input to stdout as a hex string.
+inline void DumpAsHex(const char* input, std::size_t length) {
+  DumpAsHex(input, length, std::cout);
 }
 
 } // namespace ahiv::kafka
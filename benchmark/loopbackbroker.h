@@ -0,0 +1,326 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#ifndef AHIV_KAFKA_BENCHMARK_LOOPBACKBROKER_H
+#define AHIV_KAFKA_BENCHMARK_LOOPBACKBROKER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ahiv/kafka/internal/errorcodes.h"
+#include "ahiv/kafka/protocol/buffer.h"
+#include "ahiv/kafka/protocol/packet/fetch.h"
+#include "ahiv/kafka/protocol/packet/initproducerid.h"
+#include "ahiv/kafka/protocol/packet/metadata.h"
+#include "ahiv/kafka/protocol/packet/produce.h"
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+#include "uvw.hpp"
+
+namespace ahiv::kafka::perf {
+// LoopbackBroker is a single in-process broker for the perf test. It serves
+// Metadata, InitProducerId, Produce and Fetch on 127.0.0.1 from its own thread
+// and loop, so its work is not accounted to the client. Produced batches are
+// acknowledged and dropped, fetches are answered right away with freshly
+// generated records, so the broker is never what the client waits for. Every
+// topic exists and has the configured amount of partitions
+class LoopbackBroker {
+ public:
+  static constexpr int32_t NodeId = 0;
+  // GeneratedBatchBytes is the size the record batches of fetch responses
+  // are cut at
+  static constexpr std::size_t GeneratedBatchBytes = 16 << 10;
+
+  LoopbackBroker(int32_t partitions, std::size_t messageSize)
+      : partitions(partitions), payload(messageSize, 'x') {}
+
+  ~LoopbackBroker() { this->Stop(); }
+
+  LoopbackBroker(const LoopbackBroker&) = delete;
+  LoopbackBroker& operator=(const LoopbackBroker&) = delete;
+
+  // Start runs the broker on a free port and returns the port once it is
+  // listening
+  int Start() {
+    std::promise<int> bound;
+    auto port = bound.get_future();
+    this->thread = std::thread([this, &bound] { this->run(bound); });
+    return port.get();
+  }
+
+  // Stop closes all connections and joins the broker thread
+  void Stop() {
+    if (!this->thread.joinable()) {
+      return;
+    }
+
+    this->stopSignal->send();
+    this->thread.join();
+  }
+
+ private:
+  void run(std::promise<int>& bound) {
+    this->loop = uvw::Loop::create();
+    this->stopSignal = this->loop->resource<uvw::AsyncHandle>();
+    this->stopSignal->on<uvw::AsyncEvent>([this](const uvw::AsyncEvent&,
+                                                 uvw::AsyncHandle& signal) {
+      for (const auto& client : this->clients) {
+        if (!client->closing()) {
+          client->close();
+        }
+      }
+      this->server->close();
+      signal.close();
+    });
+
+    this->server = this->loop->resource<uvw::TCPHandle>();
+    this->server->on<uvw::ListenEvent>(
+        [this](const uvw::ListenEvent&, uvw::TCPHandle& server) {
+          this->accept(server);
+        });
+    this->server->bind("127.0.0.1", 0);
+    this->server->listen();
+    this->port = static_cast<int32_t>(this->server->sock().port);
+    bound.set_value(this->port);
+
+    this->loop->run();
+  }
+
+  void accept(uvw::TCPHandle& server) {
+    auto client = this->loop->resource<uvw::TCPHandle>();
+    auto pending = std::make_shared<std::vector<char>>();
+    client->noDelay(true);
+    client->on<uvw::DataEvent>(
+        [this, pending](const uvw::DataEvent& event, uvw::TCPHandle& client) {
+          pending->insert(pending->end(), event.data.get(),
+                          event.data.get() + event.length);
+          this->onData(client, *pending);
+        });
+    client->on<uvw::EndEvent>([](const uvw::EndEvent&, uvw::TCPHandle& client) {
+      if (!client.closing()) {
+        client.close();
+      }
+    });
+    client->on<uvw::ErrorEvent>(
+        [](const uvw::ErrorEvent&, uvw::TCPHandle& client) {
+          if (!client.closing()) {
+            client.close();
+          }
+        });
+
+    server.accept(*client);
+    client->read();
+    this->clients.emplace_back(client);
+  }
+
+  // onData handles every complete request frame and keeps the rest
+  void onData(uvw::TCPHandle& client, std::vector<char>& pending) {
+    std::size_t offset = 0;
+    while (pending.size() - offset >= 4) {
+      uint32_t length;
+      std::memcpy(&length, pending.data() + offset, 4);
+      std::size_t frameSize = 4 + be32toh(length);
+      if (pending.size() - offset < frameSize) {
+        break;
+      }
+
+      protocol::Buffer request;
+      request.EnsureAllocated(frameSize);
+      request.WriteData(pending.data() + offset, frameSize);
+      this->handle(client, request);
+      offset += frameSize;
+    }
+
+    pending.erase(pending.begin(), pending.begin() + offset);
+  }
+
+  void handle(uvw::TCPHandle& client, protocol::Buffer& request) {
+    request.Skip(4);
+    int16_t apiKey = request.Read<int16_t>();
+    request.ResetReadPosition();
+
+    switch (apiKey) {
+      case 0:
+        this->handleProduce(client, request);
+        break;
+      case 1:
+        this->handleFetch(client, request);
+        break;
+      case 3:
+        this->handleMetadata(client, request);
+        break;
+      case 22:
+        this->handleInitProducerId(client, request);
+        break;
+      default:
+        std::cerr << "loopback broker: unsupported api key " << apiKey
+                  << std::endl;
+        client.close();
+    }
+  }
+
+  void handleMetadata(uvw::TCPHandle& client, protocol::Buffer& buffer) {
+    protocol::packet::MetadataRequestPacket request({}, false, false, false);
+    protocol::packet::MetadataRequestPacket::Schema::Decode(request, buffer);
+
+    protocol::packet::MetadataResponsePacket response;
+    response.brokers.emplace_back(protocol::packet::BrokerNodeInformation{
+        NodeId, "127.0.0.1", this->port, ""});
+    response.clusterId = "loopback";
+    response.controllerId = NodeId;
+    for (const auto& name : request.topics) {
+      protocol::packet::TopicInformation topic;
+      topic.name = name;
+      for (int32_t index = 0; index < this->partitions; index++) {
+        protocol::packet::PartitionInformation partition;
+        partition.partitionIndex = index;
+        partition.leaderId = NodeId;
+        partition.replicas = {NodeId};
+        partition.isr = {NodeId};
+        topic.partitionInformation.emplace_back(std::move(partition));
+      }
+      response.topicInformation.emplace_back(std::move(topic));
+    }
+
+    this->respond(client, response, request.correlationId);
+  }
+
+  void handleInitProducerId(uvw::TCPHandle& client, protocol::Buffer& buffer) {
+    protocol::packet::InitProducerIdRequestPacket request;
+    protocol::packet::InitProducerIdRequestPacket::Schema::Decode(request,
+                                                                  buffer);
+
+    protocol::packet::InitProducerIdResponsePacket response;
+    response.producerId = this->nextProducerId++;
+    response.producerEpoch = 0;
+    this->respond(client, response, request.correlationId);
+  }
+
+  // handleProduce acknowledges every batch at the end of its partition
+  void handleProduce(uvw::TCPHandle& client, protocol::Buffer& buffer) {
+    protocol::packet::ProduceRequestPacket request;
+    protocol::packet::ProduceRequestPacket::Schema::Decode(request, buffer);
+
+    protocol::packet::ProduceResponsePacket response;
+    for (const auto& topic : request.topics) {
+      protocol::packet::ProduceTopicResponse topicResponse{topic.name, {}};
+      for (const auto& partition : topic.partitions) {
+        protocol::packet::ProducePartitionResponse partitionResponse;
+        partitionResponse.partitionIndex = partition.partitionIndex;
+        if (!this->known(partition.partitionIndex)) {
+          partitionResponse.errorCode = static_cast<int16_t>(
+              internal::ErrorCode::UNKNOWN_TOPIC_OR_PARTITION);
+        } else {
+          auto& logEnd = this->logEnds[{topic.name, partition.partitionIndex}];
+          partitionResponse.baseOffset = logEnd;
+          protocol::packet::RecordBatchReader reader(
+              partition.records.data(), partition.records.size());
+          while (auto batch = reader.Next()) {
+            logEnd += batch->lastOffset - batch->baseOffset + 1;
+          }
+        }
+        topicResponse.partitions.emplace_back(partitionResponse);
+      }
+      response.topics.emplace_back(std::move(topicResponse));
+    }
+
+    this->respond(client, response, request.correlationId);
+  }
+
+  // handleFetch answers with records from the fetch offset on, as many as
+  // fit into the partition limit but at least one batch
+  void handleFetch(uvw::TCPHandle& client, protocol::Buffer& buffer) {
+    protocol::packet::FetchRequestPacket request;
+    protocol::packet::FetchRequestPacket::Schema::Decode(request, buffer);
+
+    int64_t timestamp =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    std::size_t recordsPerBatch =
+        std::max<std::size_t>(1, GeneratedBatchBytes / (this->payload.size() + 8));
+
+    // the response only points to the records, they are kept here until it
+    // has been written
+    std::deque<std::vector<char>> recordsOfPartitions;
+    protocol::packet::FetchResponsePacket response;
+    for (const auto& topic : request.topics) {
+      protocol::packet::FetchTopicResponse topicResponse{topic.name, {}};
+      for (const auto& partition : topic.partitions) {
+        protocol::packet::FetchPartitionResponse partitionResponse;
+        partitionResponse.partitionIndex = partition.partitionIndex;
+        if (!this->known(partition.partitionIndex)) {
+          partitionResponse.errorCode = static_cast<int16_t>(
+              internal::ErrorCode::UNKNOWN_TOPIC_OR_PARTITION);
+          topicResponse.partitions.emplace_back(std::move(partitionResponse));
+          continue;
+        }
+
+        int64_t offset = partition.fetchOffset;
+        auto limit = static_cast<std::size_t>(partition.partitionMaxBytes);
+        auto& records = recordsOfPartitions.emplace_back();
+        do {
+          protocol::packet::RecordBatchWriter writer(GeneratedBatchBytes);
+          for (std::size_t record = 0; record < recordsPerBatch; record++) {
+            writer.Append(std::nullopt, this->payload, timestamp);
+          }
+
+          protocol::packet::RecordBatchHeader header;
+          header.baseOffset = offset;
+          offset += writer.RecordCount();
+          auto batch = writer.Finish(header);
+          records.insert(records.end(), batch.begin(), batch.end());
+        } while (records.size() + GeneratedBatchBytes <= limit);
+
+        partitionResponse.records =
+            protocol::schema::BytesView(records.data(), records.size());
+        partitionResponse.highWatermark = offset;
+        partitionResponse.lastStableOffset = offset;
+        topicResponse.partitions.emplace_back(std::move(partitionResponse));
+      }
+      response.topics.emplace_back(std::move(topicResponse));
+    }
+
+    this->respond(client, response, request.correlationId);
+  }
+
+  bool known(int32_t partitionIndex) const {
+    return partitionIndex >= 0 && partitionIndex < this->partitions;
+  }
+
+  template <typename Response>
+  void respond(uvw::TCPHandle& client, Response& response,
+               int32_t correlationId) {
+    response.correlationId = correlationId;
+    std::size_t size = Response::Schema::Size(response);
+    response.packetSize = static_cast<int32_t>(size - 4);
+
+    protocol::Buffer buffer;
+    buffer.EnsureAllocated(size);
+    Response::Schema::Encode(response, buffer);
+    client.write(buffer.Data(), static_cast<unsigned int>(size));
+  }
+
+  int32_t partitions;
+  std::string payload;
+  int32_t port = 0;
+  int64_t nextProducerId = 1000;
+  std::map<std::pair<std::string, int32_t>, int64_t> logEnds;
+  std::thread thread;
+  std::shared_ptr<uvw::Loop> loop;
+  std::shared_ptr<uvw::AsyncHandle> stopSignal;
+  std::shared_ptr<uvw::TCPHandle> server;
+  std::vector<std::shared_ptr<uvw::TCPHandle>> clients;
+};
+}  // namespace ahiv::kafka::perf
+
+#endif  // AHIV_KAFKA_BENCHMARK_LOOPBACKBROKER_H
@@ -12,7 +12,7 @@ static void MetadataWriter(benchmark::State& state) {
 
         ahiv::kafka::protocol::Buffer buffer;
         buffer.EnsureAllocated(requestPacket.Size());
-        requestPacket.Write(&buffer);
+        requestPacket.Write(buffer);
 
         benchmark::DoNotOptimize(buffer);
     }
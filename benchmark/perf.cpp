@@ -0,0 +1,863 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+// perf-test measures producing or consuming with this client end to end, in
+// the spirit of kafka-producer-perf-test and kafka-consumer-perf-test, so the
+// numbers can be put next to those of other clients:
+//
+//   perf-test --mode=produce --messages=1000000 --message-size=100
+//   perf-test --mode=consume --bootstrap=plaintext://broker:9092 --topic=perf
+//
+// Without --bootstrap an in-process loopback broker is started on its own
+// thread, which measures the client alone. The report has the throughput,
+// the latency percentiles and the CPU time the client thread used per MB of
+// payload. Produce latency is the time from appending a record until its
+// batch has been acknowledged. Consume latency is the time from the record
+// timestamp until the record is handed to the application, in millisecond
+// resolution, which is the end to end latency when producing concurrently
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "ahiv/kafka/busypoll.h"
+#include "ahiv/kafka/consumer.h"
+#include "ahiv/kafka/internal/histogram.h"
+#include "ahiv/kafka/producer.h"
+#include "ahiv/kafka/protocol/packet/produce.h"
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+#include "benchmark/loopbackbroker.h"
+#include "uvw.hpp"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using ahiv::kafka::internal::LatencyHistogram;
+
+// Options are the command line flags, see usage
+struct Options {
+  std::string mode = "produce";
+  std::string bootstrap;
+  std::string topic = "perf-test";
+  uint64_t messages = 1000000;
+  std::size_t messageSize = 100;
+  // rate is the amount of records per second to produce, 0 is unlimited
+  uint64_t rate = 0;
+  int32_t partitions = 6;
+  std::size_t batchBytes = 16 << 10;
+  std::chrono::milliseconds linger{5};
+  bool adaptive = false;
+  std::size_t inFlight =
+      ahiv::kafka::internal::Sequencer::MaxInFlightPerPartition;
+  int16_t acks = -1;
+  std::size_t bufferBytes = 32 << 20;
+  std::size_t batchRecords = 500;
+  std::chrono::milliseconds maxWait{1};
+  bool stats = false;
+  // tls configures ssl:// bootstrap servers, it is used when the client has
+  // been built with --config=tls
+  ahiv::kafka::TLSConfig tls;
+  ahiv::kafka::IOBackend ioBackend = ahiv::kafka::IOBackend::Libuv;
+  // lowLatency tunes the sockets, drops linger and max wait and busy polls
+  // the loop, pinned to cpu unless it is negative
+  bool lowLatency = false;
+  int cpu = -1;
+};
+
+void usage(const char* program) {
+  std::cerr
+      << "usage: " << program << " [flags]\n"
+      << "  --mode=produce|consume    what to measure (produce)\n"
+      << "  --bootstrap=URL           plaintext:// or ssl://host:port of a\n"
+      << "                            cluster or unix:///path of a local\n"
+      << "                            proxy, an in-process loopback broker\n"
+      << "                            if missing\n"
+      << "  --topic=NAME              topic to use (perf-test)\n"
+      << "  --messages=N              records to produce or consume (1000000)\n"
+      << "  --message-size=BYTES      size of produced values (100)\n"
+      << "  --rate=N                  records per second, 0 is unlimited (0)\n"
+      << "  --partitions=N            partitions of the loopback broker (6)\n"
+      << "  --batch-bytes=BYTES       batch size per partition (16384)\n"
+      << "  --linger-ms=MS            time a batch waits for records (5)\n"
+      << "  --adaptive                tune linger and batch size up to the\n"
+      << "                            limits above per partition\n"
+      << "  --in-flight=N             batches in flight per partition (5)\n"
+      << "  --acks=-1|1               acknowledgement of produce requests (-1)\n"
+      << "  --buffer-bytes=BYTES      payload waiting to be acknowledged\n"
+      << "                            before producing blocks (33554432)\n"
+      << "  --batch-records=N         records per consumed batch (500)\n"
+      << "  --max-wait-ms=MS          time consumed records wait for a batch\n"
+      << "                            to fill up (1)\n"
+      << "  --stats                   print the client stats as JSON at the end\n"
+      << "  --ca-file=PATH            CA certificates of ssl:// brokers\n"
+      << "  --no-ktls                 encrypt ssl:// connections in userspace\n"
+      << "  --io-uring                move plaintext bytes through io_uring,\n"
+      << "                            needs --config=io-uring\n"
+      << "  --low-latency             TCP_NODELAY, SO_BUSY_POLL, no linger or\n"
+      << "                            max wait and a busy polled loop\n"
+      << "  --cpu=N                   core the busy polled loop is pinned to\n";
+}
+
+std::optional<Options> parseOptions(int argc, char** argv) {
+  Options options;
+  for (int index = 1; index < argc; index++) {
+    std::string argument = argv[index];
+    auto separator = argument.find('=');
+    std::string name = argument.substr(0, separator);
+    std::string value =
+        separator == std::string::npos ? "" : argument.substr(separator + 1);
+
+    try {
+      if (name == "--mode" && (value == "produce" || value == "consume")) {
+        options.mode = value;
+      } else if (name == "--bootstrap") {
+        options.bootstrap = value;
+      } else if (name == "--topic" && !value.empty()) {
+        options.topic = value;
+      } else if (name == "--messages") {
+        options.messages = std::stoull(value);
+      } else if (name == "--message-size") {
+        options.messageSize = std::stoull(value);
+      } else if (name == "--rate") {
+        options.rate = std::stoull(value);
+      } else if (name == "--partitions") {
+        options.partitions = std::stoi(value);
+      } else if (name == "--batch-bytes") {
+        options.batchBytes = std::stoull(value);
+      } else if (name == "--linger-ms") {
+        options.linger = std::chrono::milliseconds(std::stoll(value));
+      } else if (name == "--adaptive" && value.empty()) {
+        options.adaptive = true;
+      } else if (name == "--in-flight") {
+        options.inFlight = std::clamp<std::size_t>(
+            std::stoull(value), 1,
+            ahiv::kafka::internal::Sequencer::MaxInFlightPerPartition);
+      } else if (name == "--acks" && (value == "-1" || value == "1")) {
+        options.acks = static_cast<int16_t>(std::stoi(value));
+      } else if (name == "--buffer-bytes") {
+        options.bufferBytes = std::stoull(value);
+      } else if (name == "--batch-records") {
+        options.batchRecords = std::max<std::size_t>(1, std::stoull(value));
+      } else if (name == "--max-wait-ms") {
+        options.maxWait = std::chrono::milliseconds(std::stoll(value));
+      } else if (name == "--stats" && value.empty()) {
+        options.stats = true;
+      } else if (name == "--ca-file" && !value.empty()) {
+        options.tls.CAFile = value;
+      } else if (name == "--no-ktls" && value.empty()) {
+        options.tls.KernelOffload = false;
+      } else if (name == "--io-uring" && value.empty()) {
+        options.ioBackend = ahiv::kafka::IOBackend::IOUring;
+      } else if (name == "--low-latency" && value.empty()) {
+        options.lowLatency = true;
+      } else if (name == "--cpu") {
+        options.cpu = std::stoi(value);
+      } else {
+        return std::nullopt;
+      }
+    } catch (const std::exception&) {
+      return std::nullopt;
+    }
+  }
+
+  if (options.messages == 0 || options.partitions <= 0) {
+    return std::nullopt;
+  }
+  if (options.lowLatency) {
+    options.linger = std::chrono::milliseconds{0};
+    options.maxWait = std::chrono::milliseconds{0};
+  }
+
+  return options;
+}
+
+// threadCpuSeconds returns the user and system time the calling thread used
+// so far, the whole process where that is not available
+double threadCpuSeconds() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+#ifdef RUSAGE_THREAD
+  getrusage(RUSAGE_THREAD, &usage);
+#else
+  getrusage(RUSAGE_SELF, &usage);
+#endif
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#else
+  return 0;
+#endif
+}
+
+int64_t wallClockMilliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Measurement collects the numbers of a run and prints the report
+class Measurement {
+ public:
+  void Start() {
+    this->startedAt = Clock::now();
+    this->cpuAtStart = threadCpuSeconds();
+  }
+
+  void Finish() {
+    this->elapsed = Clock::now() - this->startedAt;
+    this->cpu = threadCpuSeconds() - this->cpuAtStart;
+  }
+
+  void Record(std::size_t bytes, Clock::duration latency) {
+    this->records++;
+    this->bytes += bytes;
+    this->latency.Record(std::max<int64_t>(
+        0, std::chrono::duration_cast<std::chrono::microseconds>(latency)
+               .count()));
+  }
+
+  void Fail(uint64_t records) { this->failed += records; }
+
+  // Abort ends the run without a result
+  void Abort(std::string reason) { this->abortReason = std::move(reason); }
+
+  // AbortReason is set when the run has been aborted
+  const std::optional<std::string>& AbortReason() const {
+    return this->abortReason;
+  }
+
+  uint64_t Completed() const { return this->records + this->failed; }
+
+  void Print(const char* verb) const {
+    double seconds = std::chrono::duration<double>(this->elapsed).count();
+    double megabytes = this->bytes / (1024.0 * 1024.0);
+    auto snapshot = this->latency.Snapshot();
+    std::printf(
+        "%llu records %s in %.3f s, %.1f records/sec (%.2f MB/sec)\n"
+        "latency avg %.1f us, p50 %llu us, p99 %llu us, p999 %llu us, "
+        "max %llu us\n"
+        "cpu %.3f s, %.3f ms/MB\n",
+        static_cast<unsigned long long>(this->records), verb, seconds,
+        seconds > 0 ? this->records / seconds : 0.0,
+        seconds > 0 ? megabytes / seconds : 0.0, snapshot.Mean,
+        static_cast<unsigned long long>(snapshot.P50),
+        static_cast<unsigned long long>(snapshot.P99),
+        static_cast<unsigned long long>(snapshot.P999),
+        static_cast<unsigned long long>(snapshot.Max), this->cpu,
+        megabytes > 0 ? this->cpu * 1000 / megabytes : 0.0);
+    if (this->failed > 0) {
+      std::printf("%llu records failed\n",
+                  static_cast<unsigned long long>(this->failed));
+    }
+  }
+
+ private:
+  Clock::time_point startedAt;
+  Clock::duration elapsed{};
+  double cpuAtStart = 0;
+  double cpu = 0;
+  uint64_t records = 0;
+  uint64_t bytes = 0;
+  uint64_t failed = 0;
+  std::optional<std::string> abortReason;
+  LatencyHistogram latency;
+};
+
+// PerfProducer produces keyless records of the configured size into the
+// topic. Records are spread by the sticky partitioner and collected into one
+// batch per partition, which is closed when it reaches the batch size or has
+// lingered. Closed batches are sent as soon as their partition has a free in
+// flight slot, one produce request per broker carries the batches of all its
+// partitions. Batches the broker asks to retry, also after a producer reset,
+// are sent again with their sequence, other failed records are counted. A
+// produce request which times out aborts the run
+class PerfProducer : public ahiv::kafka::Producer {
+ public:
+  PerfProducer(std::shared_ptr<uvw::Loop>& loop, const Options& options)
+      : Producer(loop),
+        loop(loop),
+        options(options),
+        payload(options.messageSize, 'x') {
+    this->topics.emplace_back(options.topic);
+    ahiv::kafka::BatchingBounds bounds;
+    bounds.MaxLinger = options.linger;
+    bounds.MaxBatchBytes = options.batchBytes;
+    bounds.MinBatchBytes = std::min(bounds.MinBatchBytes, options.batchBytes);
+    this->SetBatchingBounds(bounds);
+
+    this->On<ahiv::kafka::ProducerIdEvent>(
+        [this](const ahiv::kafka::ProducerIdEvent&, auto&) {
+          this->requestMetadataForTopics(this->topics, true);
+        });
+    this->On<ahiv::kafka::UpdateTopicInformationEvent>(
+        [this](const ahiv::kafka::UpdateTopicInformationEvent& event, auto&) {
+          this->topic = event.topicInformation;
+          this->partitions.resize(this->topic.partitionInformation.size());
+        });
+    this->Once<ahiv::kafka::StartupEvent>(
+        [this](const ahiv::kafka::StartupEvent&, auto&) { this->start(); });
+  }
+
+  const Measurement& Result() const { return this->measurement; }
+
+ private:
+  // ClosedBatch is a batch which waits for a free in flight slot, it is
+  // finished once it is sent because the sequence is stamped into its header
+  struct ClosedBatch {
+    ahiv::kafka::protocol::packet::RecordBatchWriter writer;
+    std::vector<Clock::time_point> appendedAt;
+  };
+
+  // SentBatch is a finished batch, its records are part of the produce
+  // request until the connection has taken it and are kept for retries
+  struct SentBatch {
+    int32_t partition;
+    uint64_t batchId;
+    std::vector<char> records;
+    std::vector<Clock::time_point> appendedAt;
+  };
+
+  struct PartitionState {
+    std::optional<ahiv::kafka::protocol::packet::RecordBatchWriter> writer;
+    std::vector<Clock::time_point> appendedAt;
+    ahiv::kafka::internal::TimerId lingerTimer;
+    std::deque<ClosedBatch> closed;
+    // retries are sent batches the broker has not written, they are sent
+    // again before any closed batch
+    std::deque<SentBatch> retries;
+    std::size_t inFlight = 0;
+  };
+
+  // InFlightRequest is a produce request which has not been answered yet,
+  // the request is kept until it has been handed to the connection
+  struct InFlightRequest {
+    int32_t brokerId;
+    Clock::time_point sentAt;
+    ahiv::kafka::protocol::packet::ProduceRequestPacket request;
+    std::vector<SentBatch> batches;
+    bool sent = false;
+  };
+
+  void start() {
+    this->measurement.Start();
+    this->startedAt = Clock::now();
+    this->ticker = this->loop->resource<uvw::TimerHandle>();
+    this->ticker->on<uvw::TimerEvent>([this](const uvw::TimerEvent&, auto&) {
+      this->produceMore();
+      this->sendReady();
+    });
+    this->ticker->start(uvw::TimerHandle::Time{1}, uvw::TimerHandle::Time{1});
+    this->produceMore();
+    this->sendReady();
+  }
+
+  ahiv::kafka::internal::BatchingDecision decision(int32_t partition) {
+    if (this->options.adaptive) {
+      return this->BatchController().Decision(this->options.topic, partition);
+    }
+
+    return ahiv::kafka::internal::BatchingDecision{
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            this->options.linger),
+        this->options.batchBytes};
+  }
+
+  // produceMore appends the records which are due, as long as the buffer
+  // has room for them
+  void produceMore() {
+    uint64_t due = this->options.messages;
+    if (this->options.rate > 0) {
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - this->startedAt).count();
+      due = std::min(due, static_cast<uint64_t>(seconds * this->options.rate) + 1);
+    }
+
+    auto now = Clock::now();
+    int64_t timestamp = wallClockMilliseconds();
+    while (this->appended < due &&
+           this->buffered + this->payload.size() <= this->options.bufferBytes) {
+      int32_t partition =
+          this->RecordPartitioner().Partition(this->topic, std::nullopt);
+      if (partition < 0) {
+        return;
+      }
+
+      auto& state = this->partitions[partition];
+      if (!state.writer.has_value()) {
+        this->open(partition, state);
+      }
+
+      state.writer->Append(std::nullopt, this->payload, timestamp);
+      state.appendedAt.emplace_back(now);
+      this->BatchController().OnRecord(this->options.topic, partition,
+                                       this->payload.size(), now);
+      this->buffered += this->payload.size();
+      this->appended++;
+
+      if (state.writer->Size() >= this->decision(partition).BatchBytes) {
+        this->close(partition, true);
+        this->RecordPartitioner().OnNewBatch(this->topic, partition);
+      }
+    }
+  }
+
+  void open(int32_t partition, PartitionState& state) {
+    auto decision = this->decision(partition);
+    state.writer.emplace(decision.BatchBytes);
+    state.lingerTimer = this->timers()->Schedule(
+        std::chrono::ceil<std::chrono::milliseconds>(decision.Linger),
+        [this, partition] {
+          this->close(partition, false);
+          this->sendReady();
+        });
+  }
+
+  void close(int32_t partition, bool full) {
+    auto& state = this->partitions[partition];
+    if (!state.writer.has_value()) {
+      return;
+    }
+
+    this->timers()->Cancel(state.lingerTimer);
+    state.closed.emplace_back(
+        ClosedBatch{std::move(*state.writer), std::move(state.appendedAt)});
+    state.writer.reset();
+    state.appendedAt.clear();
+    this->BatchController().OnBatchClosed(this->options.topic, partition, full,
+                                          this->leader(partition));
+  }
+
+  int32_t leader(int32_t partition) const {
+    return this->topic.partitionInformation[partition].leaderId;
+  }
+
+  // sendReady retries requests the connections refused, then sends the
+  // closed batches of all partitions with a free in flight slot
+  void sendReady() {
+    for (auto& [requestId, inFlight] : this->requests) {
+      if (!inFlight.sent) {
+        this->send(requestId);
+      }
+    }
+
+    std::map<int32_t, uint64_t> requestByBroker;
+    for (int32_t partition = 0;
+         partition < static_cast<int32_t>(this->partitions.size());
+         partition++) {
+      auto& state = this->partitions[partition];
+      if (state.inFlight >= this->options.inFlight) {
+        continue;
+      }
+
+      ahiv::kafka::protocol::packet::RecordBatchHeader header;
+      if (!state.retries.empty()) {
+        if (!this->Sequencer().HasProducerId() ||
+            this->Sequencer().ResetPending()) {
+          continue;
+        }
+
+        SentBatch batch = std::move(state.retries.front());
+        state.retries.pop_front();
+        // the batch is renumbered when batches in front of it were dropped or
+        // the producer has been reset since it was sent
+        this->Sequencer().Stamp(this->options.topic, partition, batch.batchId,
+                                header);
+        ahiv::kafka::protocol::packet::RecordBatchWriter::Restamp(
+            batch.records, header);
+        this->add(requestByBroker, std::move(batch));
+        state.inFlight++;
+        continue;
+      }
+
+      if (state.closed.empty() ||
+          !this->Sequencer().CanSend(this->options.topic, partition)) {
+        continue;
+      }
+
+      auto& closed = state.closed.front();
+      auto batchId = this->Sequencer().Assign(
+          this->options.topic, partition, closed.writer.RecordCount());
+      this->Sequencer().Stamp(this->options.topic, partition, *batchId, header);
+      this->add(requestByBroker,
+                SentBatch{partition, *batchId, closed.writer.Finish(header),
+                          std::move(closed.appendedAt)});
+      state.closed.pop_front();
+      state.inFlight++;
+    }
+
+    for (const auto& [brokerId, requestId] : requestByBroker) {
+      this->send(requestId);
+    }
+  }
+
+  // add puts the batch into the produce request to the leader of its
+  // partition, one request per broker
+  void add(std::map<int32_t, uint64_t>& requestByBroker, SentBatch&& batch) {
+    int32_t brokerId = this->leader(batch.partition);
+    auto known = requestByBroker.find(brokerId);
+    if (known == requestByBroker.end()) {
+      known = requestByBroker.emplace(brokerId, this->nextRequestId++).first;
+      auto& created = this->requests[known->second];
+      created.brokerId = brokerId;
+      created.request = ahiv::kafka::protocol::packet::ProduceRequestPacket(
+          this->options.acks);
+      created.request.topics.emplace_back(
+          ahiv::kafka::protocol::packet::ProduceTopicData{this->options.topic,
+                                                          {}});
+    }
+
+    auto& inFlight = this->requests[known->second];
+    inFlight.request.topics[0].partitions.emplace_back(
+        ahiv::kafka::protocol::packet::ProducePartitionData{
+            batch.partition, std::move(batch.records)});
+    inFlight.batches.emplace_back(std::move(batch));
+  }
+
+  // send hands the request to the connection of its broker, it stays
+  // unsent when the connection refuses it and is retried with the next tick.
+  // Once sent the records go back to their batches for retries
+  void send(uint64_t requestId) {
+    auto& inFlight = this->requests[requestId];
+    inFlight.sentAt = Clock::now();
+    // Send doesn't move from the request, it is kept for retries
+    inFlight.sent = this->SendToBroker<ahiv::kafka::protocol::packet::ProducePacket>(
+        inFlight.brokerId, std::move(inFlight.request),
+        [this, requestId](
+            ahiv::kafka::protocol::packet::ProduceResponsePacket& response) {
+          this->onProduced(requestId, response);
+        },
+        [this](ahiv::kafka::Error) {
+          this->abort("produce request timed out");
+        });
+    if (inFlight.sent) {
+      auto& partitions = inFlight.request.topics[0].partitions;
+      for (std::size_t index = 0; index < partitions.size(); index++) {
+        inFlight.batches[index].records = std::move(partitions[index].records);
+      }
+      inFlight.request.topics.clear();
+    }
+  }
+
+  // abort ends the run, it would wait forever for the records of a request
+  // which failed
+  void abort(const std::string& reason) {
+    this->measurement.Abort(reason);
+    this->ticker->stop();
+    this->loop->stop();
+  }
+
+  void onProduced(uint64_t requestId,
+                  ahiv::kafka::protocol::packet::ProduceResponsePacket& response) {
+    auto now = Clock::now();
+    auto inFlight = std::move(this->requests[requestId]);
+    this->requests.erase(requestId);
+    this->BatchController().OnProduceResponse(inFlight.brokerId,
+                                              now - inFlight.sentAt);
+
+    std::map<int32_t, int16_t> errors;
+    for (const auto& topic : response.topics) {
+      for (const auto& partition : topic.partitions) {
+        errors[partition.partitionIndex] = partition.errorCode;
+      }
+    }
+
+    for (auto& batch : inFlight.batches) {
+      auto& state = this->partitions[batch.partition];
+      state.inFlight--;
+
+      auto error = errors.find(batch.partition);
+      auto outcome = ahiv::kafka::internal::SequenceOutcome::Acknowledged;
+      if (error != errors.end() && error->second == 0) {
+        this->Sequencer().Acknowledge(this->options.topic, batch.partition,
+                                      batch.batchId);
+      } else {
+        outcome = this->Sequencer().Fail(
+            this->options.topic, batch.partition, batch.batchId,
+            static_cast<ahiv::kafka::internal::ErrorCode>(
+                error != errors.end() ? error->second : -1));
+      }
+
+      if (outcome == ahiv::kafka::internal::SequenceOutcome::ResetProducer) {
+        this->ResetProducerId();
+      }
+      if (outcome == ahiv::kafka::internal::SequenceOutcome::Retry ||
+          outcome == ahiv::kafka::internal::SequenceOutcome::ResetProducer) {
+        state.retries.emplace_back(std::move(batch));
+        continue;
+      }
+
+      this->buffered -= batch.appendedAt.size() * this->payload.size();
+      if (outcome == ahiv::kafka::internal::SequenceOutcome::Drop) {
+        this->measurement.Fail(batch.appendedAt.size());
+        continue;
+      }
+      for (const auto& appendedAt : batch.appendedAt) {
+        this->measurement.Record(this->payload.size(), now - appendedAt);
+      }
+    }
+
+    if (this->measurement.Completed() >= this->options.messages) {
+      this->measurement.Finish();
+      this->ticker->stop();
+      this->loop->stop();
+      return;
+    }
+
+    this->produceMore();
+    this->sendReady();
+  }
+
+  std::shared_ptr<uvw::Loop>& loop;
+  const Options& options;
+  std::string payload;
+  std::vector<std::string> topics;
+  ahiv::kafka::protocol::packet::TopicInformation topic;
+  std::vector<PartitionState> partitions;
+  std::map<uint64_t, InFlightRequest> requests;
+  uint64_t nextRequestId = 0;
+  uint64_t appended = 0;
+  std::size_t buffered = 0;
+  Clock::time_point startedAt;
+  std::shared_ptr<uvw::TimerHandle> ticker;
+  Measurement measurement;
+};
+
+// PerfConsumer consumes the topic from the beginning. Every broker serving
+// partitions of the topic has one fetch in flight, the next one is sent as
+// soon as the response arrived. Records go through the regular batch
+// delivery of the consumer. A fetch which times out aborts the run
+class PerfConsumer : public ahiv::kafka::Consumer {
+ public:
+  PerfConsumer(std::shared_ptr<uvw::Loop>& loop, const Options& options)
+      : Consumer(loop), loop(loop), options(options) {
+    this->ConsumeFromTopic(options.topic);
+    this->AutoCreateTopics(false);
+    this->On<ahiv::kafka::UpdateTopicInformationEvent>(
+        [this](const ahiv::kafka::UpdateTopicInformationEvent& event, auto&) {
+          for (const auto& partition :
+               event.topicInformation.partitionInformation) {
+            this->fetchOffsets.emplace(partition.partitionIndex, 0);
+          }
+          if (this->ticker != nullptr) {
+            this->fetchAll();
+          }
+        });
+    this->Once<ahiv::kafka::StartupEvent>(
+        [this](const ahiv::kafka::StartupEvent&, auto&) { this->start(); });
+    this->OnBatch(
+        [this](ahiv::kafka::PartitionBatch& batch) { this->onBatch(batch); },
+        ahiv::kafka::BatchOptions{.MaxRecords = options.batchRecords,
+                                  .MaxWait = options.maxWait});
+  }
+
+  const Measurement& Result() const { return this->measurement; }
+
+ private:
+  void start() {
+    this->measurement.Start();
+    this->ticker = this->loop->resource<uvw::TimerHandle>();
+    this->ticker->on<uvw::TimerEvent>(
+        [this](const uvw::TimerEvent&, auto&) { this->fetchAll(); });
+    this->ticker->start(uvw::TimerHandle::Time{10},
+                        uvw::TimerHandle::Time{10});
+    this->fetchAll();
+  }
+
+  // fetchAll sends a fetch to every serving replica which has none in flight
+  void fetchAll() {
+    std::set<int32_t> replicas;
+    for (const auto& [partition, offset] : this->fetchOffsets) {
+      replicas.insert(this->ServingReplica(this->options.topic, partition));
+    }
+
+    for (int32_t replica : replicas) {
+      if (replica >= 0 && this->fetching.count(replica) == 0) {
+        this->fetch(replica);
+      }
+    }
+  }
+
+  void fetch(int32_t replica) {
+    auto request = this->newFetchRequest();
+    ahiv::kafka::protocol::packet::FetchTopic topic{this->options.topic, {}};
+    for (const auto& [partition, offset] : this->fetchOffsets) {
+      if (this->ServingReplica(this->options.topic, partition) == replica) {
+        ahiv::kafka::protocol::packet::FetchPartition fetchPartition;
+        fetchPartition.partitionIndex = partition;
+        fetchPartition.fetchOffset = offset;
+        topic.partitions.emplace_back(fetchPartition);
+      }
+    }
+    request.topics.emplace_back(std::move(topic));
+
+    bool sent = this->SendToBroker<ahiv::kafka::protocol::packet::FetchPacket>(
+        replica, std::move(request),
+        [this, replica](
+            ahiv::kafka::protocol::packet::FetchResponsePacket& response) {
+          this->onFetched(replica, response);
+        },
+        [this](ahiv::kafka::Error) { this->abort("fetch request timed out"); });
+    if (sent) {
+      this->fetching.insert(replica);
+    }
+  }
+
+  // onFetched moves the fetch offsets behind the last complete batch and
+  // hands the partitions to the consumer, the response is the storage the
+  // delivered records point into
+  void onFetched(int32_t replica,
+                 ahiv::kafka::protocol::packet::FetchResponsePacket& response) {
+    this->fetching.erase(replica);
+    auto storage =
+        std::make_shared<ahiv::kafka::protocol::packet::FetchResponsePacket>(
+            std::move(response));
+
+    for (const auto& topic : storage->topics) {
+      for (const auto& partition : topic.partitions) {
+        auto& offset = this->fetchOffsets[partition.partitionIndex];
+        int64_t fetchOffset = offset;
+        if (partition.errorCode ==
+            static_cast<int16_t>(
+                ahiv::kafka::internal::ErrorCode::OFFSET_OUT_OF_RANGE)) {
+          offset = partition.logStartOffset;
+        } else if (partition.errorCode == 0) {
+          ahiv::kafka::protocol::packet::RecordBatchReader reader(
+              partition.records.data(), partition.records.size());
+          while (auto batch = reader.Next()) {
+            offset = std::max(offset, batch->lastOffset + 1);
+          }
+        }
+
+        this->handleFetchedPartition(topic.name, partition, fetchOffset,
+                                     storage);
+      }
+    }
+
+    if (this->measurement.Completed() < this->options.messages) {
+      this->fetchAll();
+    }
+  }
+
+  void onBatch(ahiv::kafka::PartitionBatch& batch) {
+    if (this->measurement.Completed() >= this->options.messages) {
+      return;
+    }
+
+    int64_t now = wallClockMilliseconds();
+    for (const auto& record : batch.Records) {
+      std::size_t bytes = (record.Key.has_value() ? record.Key->size() : 0) +
+                          (record.Value.has_value() ? record.Value->size() : 0);
+      this->measurement.Record(
+          bytes, std::chrono::milliseconds(now - record.Timestamp));
+      if (this->measurement.Completed() >= this->options.messages) {
+        this->measurement.Finish();
+        this->ticker->stop();
+        this->loop->stop();
+        return;
+      }
+    }
+  }
+
+  // abort ends the run, the partition of a fetch which failed would never be
+  // fetched again
+  void abort(const std::string& reason) {
+    this->measurement.Abort(reason);
+    this->ticker->stop();
+    this->loop->stop();
+  }
+
+  std::shared_ptr<uvw::Loop>& loop;
+  const Options& options;
+  std::map<int32_t, int64_t> fetchOffsets;
+  std::set<int32_t> fetching;
+  std::shared_ptr<uvw::TimerHandle> ticker;
+  Measurement measurement;
+};
+
+// run runs the client until it has handled all messages, it returns false
+// when the run failed
+template <typename Client>
+bool run(std::shared_ptr<uvw::Loop>& loop, const Options& options,
+         const std::string& bootstrap, const char* verb) {
+  Client client(loop, options);
+  client.template On<ahiv::kafka::ErrorEvent>(
+      [](const ahiv::kafka::ErrorEvent& event, auto&) {
+        std::cerr << event.Reason << std::endl;
+      });
+#ifdef AHIV_KAFKA_TLS
+  if (!client.UseTLS(options.tls)) {
+    std::cerr << "could not set up TLS: "
+              << ahiv::kafka::internal::TLSErrorString() << std::endl;
+    return false;
+  }
+#endif
+  if (!client.UseIOBackend(options.ioBackend)) {
+    std::cerr << "io_uring is not available" << std::endl;
+    return false;
+  }
+  if (options.lowLatency) {
+    client.UseLowLatency();
+  }
+  client.Bootstrap({bootstrap});
+
+  if (!options.lowLatency) {
+    loop->run();
+  } else if (!ahiv::kafka::BusyPollLoop(loop).Run(options.cpu)) {
+    std::cerr << "could not pin the loop to CPU " << options.cpu << std::endl;
+    return false;
+  }
+
+  if (client.Result().AbortReason().has_value()) {
+    std::cerr << "run failed: " << *client.Result().AbortReason() << std::endl;
+    return false;
+  }
+
+  client.Result().Print(verb);
+  if (options.stats) {
+    std::printf("%s\n", client.StatsJSON().c_str());
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto options = parseOptions(argc, argv);
+  if (!options.has_value()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::unique_ptr<ahiv::kafka::perf::LoopbackBroker> broker;
+  std::string bootstrap = options->bootstrap;
+  if (bootstrap.empty()) {
+    broker = std::make_unique<ahiv::kafka::perf::LoopbackBroker>(
+        options->partitions, options->messageSize);
+    bootstrap = "plaintext://127.0.0.1:" + std::to_string(broker->Start());
+  }
+
+  auto loop = uvw::Loop::getDefault();
+  bool succeeded =
+      options->mode == "produce"
+          ? run<PerfProducer>(loop, *options, bootstrap, "sent")
+          : run<PerfConsumer>(loop, *options, bootstrap, "consumed");
+
+  // The clients are gone but their handles are still registered with the
+  // stopped loop, so the process ends right here instead of tearing it down
+  std::fflush(stdout);
+  if (broker != nullptr) {
+    broker->Stop();
+  }
+  std::_Exit(succeeded ? 0 : 1);
+}
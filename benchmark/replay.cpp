@@ -0,0 +1,94 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+// replay-benchmark decodes the response frames of a capture file written by
+// Connection::CaptureFrames with the packet decoders, one benchmark per api:
+//
+//   replay-benchmark <capture file> [benchmark flags]
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ahiv/kafka/internal/framecapture.h"
+#include "ahiv/kafka/protocol/buffer.h"
+#include "ahiv/kafka/protocol/packet/fetch.h"
+#include "ahiv/kafka/protocol/packet/initproducerid.h"
+#include "ahiv/kafka/protocol/packet/lazymetadata.h"
+#include "ahiv/kafka/protocol/packet/metadata.h"
+#include "benchmark/benchmark.h"
+
+using ahiv::kafka::internal::CapturedFrame;
+using ahiv::kafka::internal::FrameCaptureReader;
+using ahiv::kafka::internal::FrameDirection;
+
+// ReplayDecode decodes all frames with the response packet, every frame is
+// copied into a buffer first like the connection does
+template <typename Response>
+static void ReplayDecode(benchmark::State& state,
+                         const std::vector<CapturedFrame>* frames) {
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    for (const auto& frame : *frames) {
+      ahiv::kafka::protocol::Buffer buffer;
+      buffer.EnsureAllocated(frame.Size);
+      buffer.WriteData(frame.Data, frame.Size);
+      buffer.ResetReadPosition();
+
+      Response response;
+      response.Read(buffer);
+      benchmark::DoNotOptimize(response);
+      bytes += frame.Size;
+    }
+  }
+
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * frames->size());
+}
+
+template <typename Response>
+static void registerReplay(const std::string& name,
+                           const std::vector<CapturedFrame>& frames) {
+  if (frames.empty()) {
+    return;
+  }
+
+  benchmark::RegisterBenchmark(name.c_str(), ReplayDecode<Response>, &frames);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <capture file> [benchmark flags]"
+              << std::endl;
+    return 1;
+  }
+
+  auto reader = FrameCaptureReader::Open(argv[1]);
+  if (!reader.has_value()) {
+    std::cerr << "could not read capture file " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::map<int16_t, std::vector<CapturedFrame>> responses;
+  while (auto frame = reader->Next()) {
+    if (frame->Direction == FrameDirection::Response) {
+      responses[frame->ApiKey].emplace_back(*frame);
+    }
+  }
+
+  using namespace ahiv::kafka::protocol::packet;
+  registerReplay<MetadataResponsePacket>("Replay/Metadata", responses[3]);
+  registerReplay<LazyMetadataResponsePacket>("Replay/LazyMetadata",
+                                             responses[3]);
+  registerReplay<FetchResponsePacket>("Replay/Fetch", responses[1]);
+  registerReplay<InitProducerIdResponsePacket>("Replay/InitProducerId",
+                                               responses[22]);
+
+  argv[1] = argv[0];
+  argc--;
+  benchmark::Initialize(&argc, argv + 1);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -33,6 +33,38 @@ TEST(ConnectionConfigTest, ParseSuccessWithDefaultPortURL) {
   EXPECT_EQ(connectionConfig->address->port, "9092");
 }
 
+// Test if the parser correctly parses ssl urls
+TEST(ConnectionConfigTest, ParseSuccessWithSSLURL) {
+  auto connectionConfig = ahiv::kafka::ConnectionConfig::ParseFromConnectionURL(
+          "ssl://localhost:9093");
+  EXPECT_EQ(connectionConfig->connectionType,
+            ahiv::kafka::ConnectionType::SSL);
+  EXPECT_EQ(connectionConfig->address->hostname, "localhost");
+  EXPECT_EQ(connectionConfig->address->port, "9093");
+}
+
+// Test if the socket path of unix urls is kept as hostname
+TEST(ConnectionConfigTest, ParseSuccessWithUnixURL) {
+  auto connectionConfig = ahiv::kafka::ConnectionConfig::ParseFromConnectionURL(
+          "unix:///run/kafka-proxy.sock");
+  EXPECT_EQ(connectionConfig->connectionType,
+            ahiv::kafka::ConnectionType::Unix);
+  EXPECT_EQ(connectionConfig->address->hostname, "/run/kafka-proxy.sock");
+  EXPECT_EQ(connectionConfig->address->port, "");
+}
+
+TEST(ConnectionConfigTest, ConnectionTypeOfURL) {
+  EXPECT_EQ(ahiv::kafka::ConnectionTypeOf("plaintext://localhost"),
+            ahiv::kafka::ConnectionType::Plaintext);
+  EXPECT_EQ(ahiv::kafka::ConnectionTypeOf("ssl://localhost"),
+            ahiv::kafka::ConnectionType::SSL);
+  EXPECT_EQ(ahiv::kafka::ConnectionTypeOf("unix:///tmp/kafka.sock"),
+            ahiv::kafka::ConnectionType::Unix);
+  EXPECT_FALSE(ahiv::kafka::ConnectionTypeOf("sasl_ssl://localhost"));
+  EXPECT_EQ(ahiv::kafka::ConnectionURLPrefix(ahiv::kafka::ConnectionType::SSL),
+            "ssl://");
+}
+
 TEST(ConnectionConfigTest, ResolveHostWithSuccess) {
     auto loop = uvw::Loop::getDefault();
     auto connectionConfig = ahiv::kafka::ConnectionConfig::ParseFromConnectionURL(
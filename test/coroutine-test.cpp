@@ -0,0 +1,118 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/coroutine.h"
+
+#include "gtest/gtest.h"
+
+#ifdef AHIV_KAFKA_HAS_COROUTINES
+
+#include <functional>
+
+namespace {
+struct EchoMessage {
+  using Request = int;
+  using Response = int;
+};
+
+// FakeConnection keeps the callbacks of the last request, so the test can
+// play the read path
+struct FakeConnection {
+  template <typename Message>
+  bool Send(typename Message::Request& request,
+            std::function<void(typename Message::Response&)> callback,
+            std::function<void(ahiv::kafka::Error)> failureCallback) {
+    if (this->wouldBlock) {
+      return false;
+    }
+
+    this->lastRequest = request;
+    this->callback = std::move(callback);
+    this->failureCallback = std::move(failureCallback);
+    return true;
+  }
+
+  bool wouldBlock = false;
+  int lastRequest = 0;
+  std::function<void(int&)> callback;
+  std::function<void(ahiv::kafka::Error)> failureCallback;
+};
+
+ahiv::kafka::Task requestTwice(std::shared_ptr<FakeConnection> connection,
+                               std::vector<int>& responses) {
+  for (int request = 1; request <= 2; request++) {
+    auto response =
+        co_await ahiv::kafka::RequestAwaitable<EchoMessage, FakeConnection>(
+            connection, request);
+    responses.emplace_back(response.value());
+  }
+}
+
+ahiv::kafka::Task requestWithoutConnection(
+    std::shared_ptr<FakeConnection> connection, bool& empty) {
+  auto response =
+      co_await ahiv::kafka::RequestAwaitable<EchoMessage, FakeConnection>(
+          connection, 1);
+  empty = !response.has_value();
+}
+}  // namespace
+
+// Test if the coroutine is resumed with each response in turn
+TEST(CoroutineTest, ResumesWithResponses) {
+  auto connection = std::make_shared<FakeConnection>();
+  std::vector<int> responses;
+  requestTwice(connection, responses);
+
+  EXPECT_EQ(connection->lastRequest, 1);
+  EXPECT_TRUE(responses.empty());
+
+  int first = 10;
+  connection->callback(first);
+  EXPECT_EQ(connection->lastRequest, 2);
+  ASSERT_EQ(responses.size(), 1);
+
+  int second = 20;
+  connection->callback(second);
+  ASSERT_EQ(responses.size(), 2);
+  EXPECT_EQ(responses[0], 10);
+  EXPECT_EQ(responses[1], 20);
+}
+
+// Test if awaiting without a connection does not suspend
+TEST(CoroutineTest, EmptyResponseWithoutConnection) {
+  bool empty = false;
+  requestWithoutConnection(nullptr, empty);
+  EXPECT_TRUE(empty);
+}
+
+// Test if a request which would block resumes right away without a response
+TEST(CoroutineTest, EmptyResponseWhenBlocked) {
+  auto connection = std::make_shared<FakeConnection>();
+  connection->wouldBlock = true;
+  bool empty = false;
+  requestWithoutConnection(connection, empty);
+  EXPECT_TRUE(empty);
+}
+
+// Test if a request which timed out resumes without a response
+TEST(CoroutineTest, EmptyResponseOnTimeout) {
+  auto connection = std::make_shared<FakeConnection>();
+  bool empty = false;
+  requestWithoutConnection(connection, empty);
+  EXPECT_FALSE(empty);
+
+  connection->failureCallback(ahiv::kafka::Error::RequestTimedOut);
+  EXPECT_TRUE(empty);
+}
+
+// Test if frames of the same size class are reused
+TEST(CoroutineTest, FramePoolReusesFrames) {
+  ahiv::kafka::internal::FramePool pool;
+  void* frame = pool.Allocate(100);
+  pool.Deallocate(frame, 100);
+
+  EXPECT_EQ(pool.Allocate(120), frame);
+  pool.Deallocate(frame, 120);
+}
+
+#endif  // AHIV_KAFKA_HAS_COROUTINES
@@ -0,0 +1,164 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/batchaccumulator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::BatchOptions;
+using ahiv::kafka::PartitionBatch;
+using ahiv::kafka::internal::BatchAccumulator;
+using ahiv::kafka::protocol::Buffer;
+using ahiv::kafka::protocol::packet::RecordBatchHeader;
+using ahiv::kafka::protocol::packet::RecordBatchReader;
+
+namespace {
+void writeVarint(std::string& out, int64_t value) {
+  uint64_t raw = (static_cast<uint64_t>(value) << 1) ^ (value >> 63);
+  while (raw >= 0x80) {
+    out.push_back(static_cast<char>((raw & 0x7f) | 0x80));
+    raw >>= 7;
+  }
+  out.push_back(static_cast<char>(raw));
+}
+
+// appendBatch encodes a batch with one record per value, keyed with the
+// offset delta. The records are never compressed, the attributes only claim
+// it
+void appendBatch(Buffer& buffer, int64_t baseOffset,
+                 const std::vector<std::string>& values,
+                 int16_t attributes = 0) {
+  std::string records;
+  for (std::size_t delta = 0; delta < values.size(); delta++) {
+    std::string record;
+    record.push_back(0);
+    writeVarint(record, delta * 10);
+    writeVarint(record, delta);
+    std::string key = std::to_string(delta);
+    writeVarint(record, key.size());
+    record += key;
+    writeVarint(record, values[delta].size());
+    record += values[delta];
+    writeVarint(record, 0);
+
+    writeVarint(records, record.size());
+    records += record;
+  }
+
+  RecordBatchHeader header;
+  header.baseOffset = baseOffset;
+  header.batchLength = RecordBatchHeader::Schema::FixedSize -
+                       RecordBatchReader::LengthOffset + records.size();
+  header.attributes = attributes;
+  header.firstTimestamp = 1000;
+  header.lastOffsetDelta = values.size() - 1;
+  header.recordCount = values.size();
+  RecordBatchHeader::Schema::Encode(header, buffer);
+  buffer.WriteData(records.data(), records.size());
+}
+}  // namespace
+
+// Test if records are decoded in place and full batches are delivered once
+// MaxRecords is reached, skipping records in front of the fetch offset
+TEST(BatchAccumulatorTest, DeliversFullBatches) {
+  Buffer fetched;
+  fetched.EnsureAllocated(1024);
+  appendBatch(fetched, 10, {"a", "b", "c"});
+  appendBatch(fetched, 13, {"d", "e"});
+
+  std::vector<PartitionBatch> delivered;
+  BatchAccumulator accumulator(
+      BatchOptions{.MaxRecords = 2},
+      [&](PartitionBatch& batch) { delivered.emplace_back(std::move(batch)); });
+
+  auto storage = std::make_shared<int>(0);
+  accumulator.Add("test", 3, 20, 11, fetched.View(0), fetched.Size(), storage);
+
+  ASSERT_EQ(delivered.size(), 2);
+  EXPECT_EQ(delivered[0].Topic, "test");
+  EXPECT_EQ(delivered[0].Partition, 3);
+  EXPECT_EQ(delivered[0].FirstOffset, 11);
+  EXPECT_EQ(delivered[0].LastOffset, 12);
+  EXPECT_EQ(delivered[0].HighWatermark, 20);
+  EXPECT_EQ(*delivered[0].Records[0].Key, "1");
+  EXPECT_EQ(*delivered[0].Records[0].Value, "b");
+  EXPECT_EQ(delivered[0].Records[0].Timestamp, 1010);
+  EXPECT_EQ(delivered[1].FirstOffset, 13);
+  EXPECT_EQ(*delivered[1].Records[1].Value, "e");
+  EXPECT_EQ(delivered[1].Storage.size(), 1);
+  EXPECT_EQ(storage.use_count(), 3);
+}
+
+// Test if a partial batch is held back until it waited MaxWait
+TEST(BatchAccumulatorTest, FlushesExpiredBatches) {
+  Buffer fetched;
+  fetched.EnsureAllocated(1024);
+  appendBatch(fetched, 0, {"a"});
+
+  std::vector<PartitionBatch> delivered;
+  BatchAccumulator accumulator(
+      BatchOptions{.MaxRecords = 10, .MaxWait = std::chrono::milliseconds(5)},
+      [&](PartitionBatch& batch) { delivered.emplace_back(std::move(batch)); });
+
+  auto now = BatchAccumulator::Clock::now();
+  accumulator.Add("test", 0, 1, 0, fetched.View(0), fetched.Size(), nullptr,
+                  now);
+  EXPECT_EQ(*accumulator.NextDeadline(), now + std::chrono::milliseconds(5));
+
+  accumulator.FlushExpired(now + std::chrono::milliseconds(4));
+  EXPECT_TRUE(delivered.empty());
+
+  accumulator.FlushExpired(now + std::chrono::milliseconds(5));
+  ASSERT_EQ(delivered.size(), 1);
+  EXPECT_EQ(delivered[0].Records.size(), 1);
+  EXPECT_FALSE(accumulator.NextDeadline().has_value());
+}
+
+// Test if a MaxWait of zero delivers the records of a fetch right away
+TEST(BatchAccumulatorTest, DeliversImmediatelyWithoutMaxWait) {
+  Buffer fetched;
+  fetched.EnsureAllocated(1024);
+  appendBatch(fetched, 0, {"a", "b", "c"});
+
+  std::vector<PartitionBatch> delivered;
+  BatchAccumulator accumulator(
+      BatchOptions{.MaxRecords = 2, .MaxWait = std::chrono::milliseconds(0)},
+      [&](PartitionBatch& batch) { delivered.emplace_back(std::move(batch)); });
+
+  accumulator.Add("test", 0, 3, 0, fetched.View(0), fetched.Size(), nullptr);
+  ASSERT_EQ(delivered.size(), 2);
+  EXPECT_EQ(delivered[0].Records.size(), 2);
+  EXPECT_EQ(delivered[1].Records.size(), 1);
+  EXPECT_FALSE(accumulator.NextDeadline().has_value());
+}
+
+// Test if compressed batches are returned as skipped with their codec while
+// the uncompressed batches around them are delivered
+TEST(BatchAccumulatorTest, ReturnsCompressedBatchesAsSkipped) {
+  Buffer fetched;
+  fetched.EnsureAllocated(1024);
+  appendBatch(fetched, 0, {"a"});
+  appendBatch(fetched, 1, {"b", "c"}, 4);
+  appendBatch(fetched, 3, {"d"});
+
+  std::vector<PartitionBatch> delivered;
+  BatchAccumulator accumulator(
+      BatchOptions{.MaxRecords = 10, .MaxWait = std::chrono::milliseconds(0)},
+      [&](PartitionBatch& batch) { delivered.emplace_back(std::move(batch)); });
+
+  auto skipped = accumulator.Add("test", 0, 4, 0, fetched.View(0),
+                                 fetched.Size(), nullptr);
+  ASSERT_EQ(skipped.size(), 1);
+  EXPECT_EQ(skipped[0].BaseOffset, 1);
+  EXPECT_EQ(skipped[0].LastOffset, 2);
+  EXPECT_STREQ(skipped[0].Codec, "zstd");
+
+  ASSERT_EQ(delivered.size(), 1);
+  ASSERT_EQ(delivered[0].Records.size(), 2);
+  EXPECT_EQ(*delivered[0].Records[0].Value, "a");
+  EXPECT_EQ(*delivered[0].Records[1].Value, "d");
+}
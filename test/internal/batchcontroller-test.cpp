@@ -0,0 +1,85 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/batchcontroller.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::AdaptiveBatchController;
+using ahiv::kafka::internal::BatchingBounds;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace {
+BatchingBounds testBounds() {
+  return BatchingBounds{.MinLinger = microseconds(0),
+                        .MaxLinger = microseconds(16000),
+                        .MinBatchBytes = 1000,
+                        .MaxBatchBytes = 17000};
+}
+}  // namespace
+
+// Test if full batches grow the batch size additively up to the bound
+TEST(AdaptiveBatchControllerTest, GrowsBatchWhenFull) {
+  AdaptiveBatchController controller(testBounds());
+  EXPECT_EQ(controller.Decision("test", 0).BatchBytes, 1000);
+
+  controller.OnBatchClosed("test", 0, true, 1);
+  EXPECT_EQ(controller.Decision("test", 0).BatchBytes, 2000);
+
+  for (int batch = 0; batch < 100; batch++) {
+    controller.OnBatchClosed("test", 0, true, 1);
+  }
+  EXPECT_EQ(controller.Decision("test", 0).BatchBytes, 17000);
+  EXPECT_EQ(controller.Stats()[0].Increases, 101);
+}
+
+// Test if linger grows while the broker is congested and halves once it
+// recovered
+TEST(AdaptiveBatchControllerTest, LingersOnCongestion) {
+  AdaptiveBatchController controller(testBounds());
+  controller.OnProduceResponse(1, milliseconds(1));
+  for (int response = 0; response < 20; response++) {
+    controller.OnProduceResponse(1, milliseconds(10));
+  }
+
+  controller.OnBatchClosed("test", 0, false, 1);
+  controller.OnBatchClosed("test", 0, false, 1);
+  EXPECT_EQ(controller.Decision("test", 0).Linger, microseconds(2000));
+
+  controller.OnBatchClosed("test", 0, false, 2);
+  EXPECT_EQ(controller.Decision("test", 0).Linger, microseconds(1000));
+  EXPECT_EQ(controller.Stats()[0].Decreases, 1);
+}
+
+// Test if linger is capped by the time the partition needs to fill a batch
+TEST(AdaptiveBatchControllerTest, CapsLingerByFillTime) {
+  AdaptiveBatchController controller(testBounds());
+  controller.OnProduceResponse(1, milliseconds(1));
+  controller.OnProduceResponse(1, milliseconds(100));
+  for (int batch = 0; batch < 16; batch++) {
+    controller.OnBatchClosed("test", 0, false, 1);
+  }
+  EXPECT_EQ(controller.Decision("test", 0).Linger, microseconds(16000));
+
+  auto now = AdaptiveBatchController::Clock::now();
+  controller.OnRecord("test", 0, 1000, now);
+  controller.OnRecord("test", 0, 1000, now + milliseconds(10));
+  EXPECT_EQ(controller.Stats()[0].ArrivalBytesPerSecond, 200000);
+  EXPECT_EQ(controller.Decision("test", 0).Linger, microseconds(5000));
+}
+
+// Test if inverted bounds are swapped instead of stepping by a wrapped
+// difference
+TEST(AdaptiveBatchControllerTest, SwapsInvertedBounds) {
+  AdaptiveBatchController controller;
+  controller.SetBounds(BatchingBounds{.MinLinger = microseconds(16000),
+                                      .MaxLinger = microseconds(0),
+                                      .MinBatchBytes = 17000,
+                                      .MaxBatchBytes = 1000});
+  EXPECT_EQ(controller.Bounds().MinBatchBytes, 1000);
+  EXPECT_EQ(controller.Bounds().MaxLinger, microseconds(16000));
+
+  controller.OnBatchClosed("test", 0, true, 1);
+  EXPECT_EQ(controller.Decision("test", 0).BatchBytes, 2000);
+}
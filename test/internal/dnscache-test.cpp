@@ -0,0 +1,58 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/dnscache.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+sockaddr_storage addressOfFamily(int family) {
+  sockaddr_storage address{};
+  address.ss_family = family;
+  return address;
+}
+}  // namespace
+
+// Test if stored addresses are served until they expire
+TEST(DNSCacheTest, LookupReturnsStoredAddresses) {
+  ahiv::kafka::internal::DNSCache cache;
+  cache.Store("localhost", "9092", {addressOfFamily(AF_INET)});
+
+  auto addresses = cache.Lookup("localhost", "9092");
+  ASSERT_NE(addresses, nullptr);
+  EXPECT_EQ(addresses->size(), 1);
+  EXPECT_EQ(cache.Lookup("localhost", "9093"), nullptr);
+}
+
+// Test if expired entries are not served
+TEST(DNSCacheTest, LookupSkipsExpiredEntries) {
+  ahiv::kafka::internal::DNSCache cache;
+  cache.Store("localhost", "9092", {addressOfFamily(AF_INET)},
+              std::chrono::milliseconds(0));
+
+  EXPECT_EQ(cache.Lookup("localhost", "9092"), nullptr);
+}
+
+// Test if invalidated entries are not served
+TEST(DNSCacheTest, InvalidateDropsEntry) {
+  ahiv::kafka::internal::DNSCache cache;
+  cache.Store("localhost", "9092", {addressOfFamily(AF_INET)});
+  cache.Invalidate("localhost", "9092");
+
+  EXPECT_EQ(cache.Lookup("localhost", "9092"), nullptr);
+}
+
+// Test if address families alternate starting with the first family
+TEST(DNSCacheTest, InterleavesAddressFamilies) {
+  auto interleaved = ahiv::kafka::internal::InterleaveAddressFamilies(
+      {addressOfFamily(AF_INET6), addressOfFamily(AF_INET6),
+       addressOfFamily(AF_INET6), addressOfFamily(AF_INET),
+       addressOfFamily(AF_INET)});
+
+  ASSERT_EQ(interleaved.size(), 5);
+  EXPECT_EQ(interleaved[0].ss_family, AF_INET6);
+  EXPECT_EQ(interleaved[1].ss_family, AF_INET);
+  EXPECT_EQ(interleaved[2].ss_family, AF_INET6);
+  EXPECT_EQ(interleaved[3].ss_family, AF_INET);
+  EXPECT_EQ(interleaved[4].ss_family, AF_INET6);
+}
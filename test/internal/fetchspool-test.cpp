@@ -0,0 +1,116 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/fetchspool.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::FetchSpool;
+using ahiv::kafka::protocol::Buffer;
+using ahiv::kafka::protocol::packet::RecordBatchHeader;
+using ahiv::kafka::protocol::packet::RecordBatchReader;
+
+namespace {
+// appendBatch encodes a batch of recordCount records with a fake payload
+void appendBatch(Buffer& buffer, int64_t baseOffset, int32_t recordCount,
+                 std::size_t payloadSize) {
+  RecordBatchHeader header;
+  header.baseOffset = baseOffset;
+  header.batchLength = RecordBatchHeader::Schema::FixedSize -
+                       RecordBatchReader::LengthOffset + payloadSize;
+  header.lastOffsetDelta = recordCount - 1;
+  header.recordCount = recordCount;
+  RecordBatchHeader::Schema::Encode(header, buffer);
+  std::string payload(payloadSize, 'x');
+  buffer.WriteData(payload.data(), payload.size());
+}
+}  // namespace
+
+// FetchSpoolTest spools into a fresh directory which is removed afterwards
+class FetchSpoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char pattern[] = "/tmp/fetchspool-XXXXXX";
+    ASSERT_NE(::mkdtemp(pattern), nullptr);
+    this->directory = pattern;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(this->directory); }
+
+  std::string directory;
+};
+
+// Test if spooled batches are read back starting at the batch containing the
+// offset and only spooled ranges are reported as contained
+TEST_F(FetchSpoolTest, ReadsSpooledBatches) {
+  Buffer fetched;
+  fetched.EnsureAllocated(1024);
+  appendBatch(fetched, 0, 10, 20);
+  appendBatch(fetched, 10, 10, 20);
+  appendBatch(fetched, 20, 5, 20);
+
+  FetchSpool spool(this->directory);
+  EXPECT_EQ(spool.Append("test", 0, 0, fetched.View(0), fetched.Size()),
+            fetched.Size());
+  EXPECT_TRUE(spool.Contains("test", 0, 24));
+  EXPECT_FALSE(spool.Contains("test", 0, 25));
+  EXPECT_FALSE(spool.Contains("test", 1, 0));
+
+  auto view = spool.Read("test", 0, 15, 1 << 20);
+  ASSERT_TRUE(view.has_value());
+  RecordBatchReader reader(view->data, view->size);
+  EXPECT_EQ(reader.Next()->baseOffset, 10);
+  EXPECT_EQ(reader.Next()->lastOffset, 24);
+  EXPECT_FALSE(reader.Next().has_value());
+
+  auto limited = spool.Read("test", 0, 0, 1);
+  ASSERT_TRUE(limited.has_value());
+  EXPECT_EQ(limited->size, 81);
+}
+
+// Test if a partial batch at the end of a fetch is not consumed and a
+// continued fetch skips batches which are spooled already
+TEST_F(FetchSpoolTest, ContinuesFetches) {
+  Buffer first;
+  first.EnsureAllocated(1024);
+  appendBatch(first, 0, 10, 20);
+  appendBatch(first, 10, 10, 20);
+
+  FetchSpool spool(this->directory);
+  EXPECT_EQ(spool.Append("test", 0, 0, first.View(0), first.Size() - 5),
+            81);
+
+  Buffer second;
+  second.EnsureAllocated(1024);
+  appendBatch(second, 0, 10, 20);
+  appendBatch(second, 10, 10, 20);
+  spool.Append("test", 0, 5, second.View(0), second.Size());
+
+  auto view = spool.Read("test", 0, 0, 1 << 20);
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->size, 162);
+}
+
+// Test if segments roll over and are found again by a new spool
+TEST_F(FetchSpoolTest, ReopensSegments) {
+  {
+    FetchSpool spool(this->directory, 200);
+    for (int64_t offset = 0; offset < 50; offset += 10) {
+      Buffer fetched;
+      fetched.EnsureAllocated(128);
+      appendBatch(fetched, offset, 10, 20);
+      spool.Append("test", 3, offset, fetched.View(0), fetched.Size());
+    }
+  }
+
+  FetchSpool reopened(this->directory, 200);
+  EXPECT_TRUE(reopened.Contains("test", 3, 0));
+  EXPECT_TRUE(reopened.Contains("test", 3, 49));
+  auto view = reopened.Read("test", 3, 42, 1 << 20);
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(RecordBatchReader(view->data, view->size).Next()->baseOffset, 40);
+}
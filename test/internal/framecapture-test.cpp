@@ -0,0 +1,62 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/framecapture.h"
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::FrameCapture;
+using ahiv::kafka::internal::FrameCaptureReader;
+using ahiv::kafka::internal::FrameDirection;
+
+// Test if frames are read back in the order they have been captured
+TEST(FrameCaptureTest, RoundTrip) {
+  std::string path = testing::TempDir() + "framecapture-test.ahkc";
+  {
+    auto capture = FrameCapture::Open(path);
+    ASSERT_NE(capture, nullptr);
+    capture->Append(FrameDirection::Request, 3, "request", 7);
+    capture->Append(FrameDirection::Response, 3, "response", 8);
+    capture->Append(FrameDirection::Response, -1, "", 0);
+  }
+
+  auto reader = FrameCaptureReader::Open(path);
+  ASSERT_TRUE(reader.has_value());
+
+  auto request = reader->Next();
+  ASSERT_TRUE(request.has_value());
+  EXPECT_EQ(request->Direction, FrameDirection::Request);
+  EXPECT_EQ(request->ApiKey, 3);
+  EXPECT_EQ(std::string(request->Data, request->Size), "request");
+  EXPECT_GT(request->Timestamp, 0);
+
+  auto response = reader->Next();
+  ASSERT_TRUE(response.has_value());
+  EXPECT_EQ(response->Direction, FrameDirection::Response);
+  EXPECT_EQ(std::string(response->Data, response->Size), "response");
+
+  auto unmatched = reader->Next();
+  ASSERT_TRUE(unmatched.has_value());
+  EXPECT_EQ(unmatched->ApiKey, -1);
+  EXPECT_EQ(unmatched->Size, 0u);
+  EXPECT_FALSE(reader->Next().has_value());
+
+  reader->Rewind();
+  EXPECT_EQ(reader->Next()->ApiKey, 3);
+  std::remove(path.c_str());
+}
+
+// Test if files which are no capture are rejected
+TEST(FrameCaptureTest, RejectsForeignFile) {
+  std::string path = testing::TempDir() + "framecapture-foreign.ahkc";
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  std::fputs("not a capture", file);
+  std::fclose(file);
+
+  EXPECT_FALSE(FrameCaptureReader::Open(path).has_value());
+  EXPECT_FALSE(FrameCaptureReader::Open(path + ".missing").has_value());
+  std::remove(path.c_str());
+}
@@ -0,0 +1,53 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/histogram.h"
+
+#include "gtest/gtest.h"
+
+// Test if small values are recorded exactly
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  for (uint64_t value = 0; value < 16; value++) {
+    EXPECT_EQ(ahiv::kafka::internal::LatencyHistogram::BucketIndex(value),
+              value);
+    EXPECT_EQ(ahiv::kafka::internal::LatencyHistogram::BucketUpperBound(value),
+              value);
+  }
+}
+
+// Test if every value lies within the bounds of its bucket
+TEST(LatencyHistogramTest, BucketsContainTheirValues) {
+  using ahiv::kafka::internal::LatencyHistogram;
+  for (uint64_t value = 1; value < (uint64_t{1} << 32); value = value * 3 + 1) {
+    auto index = LatencyHistogram::BucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::BucketCount);
+    EXPECT_LE(value, LatencyHistogram::BucketUpperBound(index));
+    EXPECT_GT(value, LatencyHistogram::BucketUpperBound(index - 1));
+  }
+}
+
+// Test if percentiles stay within the relative error of the histogram
+TEST(LatencyHistogramTest, PercentilesAreWithinPrecision) {
+  ahiv::kafka::internal::LatencyHistogram histogram;
+  for (uint64_t value = 1; value <= 1000; value++) {
+    histogram.Record(value);
+  }
+
+  auto snapshot = histogram.Snapshot();
+  EXPECT_EQ(snapshot.Count, 1000);
+  EXPECT_EQ(snapshot.Min, 1);
+  EXPECT_EQ(snapshot.Max, 1000);
+  EXPECT_DOUBLE_EQ(snapshot.Mean, 500.5);
+  EXPECT_NEAR(snapshot.P50, 500, 500 * 0.125);
+  EXPECT_NEAR(snapshot.P99, 990, 990 * 0.125);
+  EXPECT_EQ(snapshot.P999, 1000);
+}
+
+// Test if an empty histogram reports zeros
+TEST(LatencyHistogramTest, EmptySnapshot) {
+  ahiv::kafka::internal::LatencyHistogram histogram;
+  auto snapshot = histogram.Snapshot();
+  EXPECT_EQ(snapshot.Count, 0);
+  EXPECT_EQ(snapshot.Max, 0);
+  EXPECT_EQ(snapshot.P99, 0);
+}
@@ -0,0 +1,66 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/inflighttable.h"
+
+#include "gtest/gtest.h"
+
+// Test if entries can be found by their correlation id
+TEST(InFlightTableTest, FindsInsertedEntries) {
+  ahiv::kafka::internal::InFlightTable<int, 4> table;
+  EXPECT_TRUE(table.Insert(0, 10));
+  EXPECT_TRUE(table.Insert(1, 11));
+
+  ASSERT_NE(table.Find(1), nullptr);
+  EXPECT_EQ(*table.Find(1), 11);
+  EXPECT_EQ(table.Find(5), nullptr);
+  EXPECT_EQ(table.Size(), 2);
+}
+
+// Test if a full table rejects ids which map to a taken slot
+TEST(InFlightTableTest, RejectsWhenFull) {
+  ahiv::kafka::internal::InFlightTable<int, 2> table;
+  EXPECT_TRUE(table.Insert(0, 10));
+  EXPECT_TRUE(table.Insert(1, 11));
+  EXPECT_FALSE(table.Insert(2, 12));
+
+  table.Erase(0);
+  EXPECT_TRUE(table.Insert(2, 12));
+  EXPECT_EQ(table.Find(0), nullptr);
+  EXPECT_EQ(*table.Find(2), 12);
+}
+
+// Test if the oldest entry follows erasures in any order
+TEST(InFlightTableTest, TracksOldestEntry) {
+  ahiv::kafka::internal::InFlightTable<int, 8> table;
+  EXPECT_EQ(table.Oldest(), nullptr);
+  table.Insert(3, 13);
+  table.Insert(4, 14);
+  table.Insert(5, 15);
+
+  EXPECT_EQ(*table.Oldest(), 13);
+  table.Erase(4);
+  EXPECT_EQ(*table.Oldest(), 13);
+  table.Erase(3);
+  EXPECT_EQ(*table.Oldest(), 15);
+  table.Erase(5);
+  EXPECT_TRUE(table.Empty());
+  EXPECT_EQ(table.Oldest(), nullptr);
+}
+
+// Test if the oldest entry is found by its id when newer ids wrapped around
+// the slab and occupy the slots behind it
+TEST(InFlightTableTest, TracksOldestEntryAcrossWrappedIds) {
+  ahiv::kafka::internal::InFlightTable<int, 1024> table;
+  table.Insert(5, 5);
+  table.Insert(1030, 1030);
+  table.Insert(1031, 1031);
+  EXPECT_FALSE(table.Insert(5 + 1024, 0));
+
+  table.Erase(5);
+  EXPECT_EQ(*table.Oldest(), 1030);
+  table.Erase(1030);
+  EXPECT_EQ(*table.Oldest(), 1031);
+  table.Erase(1031);
+  EXPECT_EQ(table.Oldest(), nullptr);
+}
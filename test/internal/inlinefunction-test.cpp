@@ -0,0 +1,44 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/inlinefunction.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+// Test if the stored callable is invoked with its captures
+TEST(InlineFunctionTest, InvokesCallable) {
+  int offset = 2;
+  ahiv::kafka::internal::InlineFunction<int(int), 32> function(
+      [offset](int value) { return value + offset; });
+
+  ASSERT_TRUE(function);
+  EXPECT_EQ(function(40), 42);
+}
+
+// Test if moving transfers the callable and empties the source
+TEST(InlineFunctionTest, MoveTransfersCallable) {
+  auto counter = std::make_shared<int>(0);
+  ahiv::kafka::internal::InlineFunction<void(), 32> source(
+      [counter]() { (*counter)++; });
+  ahiv::kafka::internal::InlineFunction<void(), 32> destination(
+      std::move(source));
+
+  EXPECT_FALSE(source);
+  destination();
+  EXPECT_EQ(*counter, 1);
+  EXPECT_EQ(counter.use_count(), 2);
+}
+
+// Test if captures are destroyed on reset
+TEST(InlineFunctionTest, ResetDestroysCaptures) {
+  auto counter = std::make_shared<int>(0);
+  ahiv::kafka::internal::InlineFunction<void(), 32> function(
+      [counter]() { (*counter)++; });
+  EXPECT_EQ(counter.use_count(), 2);
+
+  function.reset();
+  EXPECT_FALSE(function);
+  EXPECT_EQ(counter.use_count(), 1);
+}
@@ -0,0 +1,147 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/iouring.h"
+
+#ifdef AHIV_KAFKA_IO_URING
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::BrokerStats;
+using ahiv::kafka::ConnectedEvent;
+using ahiv::kafka::ErrorEvent;
+using ahiv::kafka::internal::ByteStream;
+using ahiv::kafka::internal::IOUring;
+using ahiv::kafka::internal::IOUringStream;
+using ahiv::kafka::internal::ReceivedEvent;
+
+namespace {
+// drive submits and reaps until done returns true or five seconds passed
+bool drive(IOUring& ring, const std::function<bool()>& done) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+
+    ring.Submit();
+    if (ring.Reap() == 0) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<char[]> copyOf(const std::string& message) {
+  std::unique_ptr<char[]> data(new char[message.size()]);
+  std::copy(message.begin(), message.end(), data.get());
+  return data;
+}
+}  // namespace
+
+// Test if writes are sent in order and received bytes are published, with
+// more data than fits into the socket buffers and the receive buffers
+TEST(IOUringTest, StreamsThroughSocketPair) {
+  auto ring = IOUring::Create();
+  if (ring == nullptr) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+
+  int sockets[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+  fcntl(sockets[0], F_SETFL, fcntl(sockets[0], F_GETFL) | O_NONBLOCK);
+
+  auto stream = std::make_shared<IOUringStream>(ring, sockets[0]);
+  bool connected = false;
+  std::size_t written = 0;
+  std::string received;
+  stream->on<ConnectedEvent>(
+      [&connected](const ConnectedEvent&, ByteStream& stream) {
+        connected = true;
+        stream.Read();
+      });
+  stream->on<uvw::WriteEvent>(
+      [&written](const uvw::WriteEvent&, ByteStream&) { written++; });
+  stream->on<ReceivedEvent>(
+      [&received](const ReceivedEvent& event, ByteStream&) {
+        received.append(event.Data, event.Length);
+      });
+
+  std::string first(3 << 20, 'a');
+  std::string second(100, 'b');
+  stream->Write(copyOf(first), first.size());
+  stream->Start();
+  stream->Write(copyOf(second), second.size());
+  EXPECT_TRUE(connected);
+  EXPECT_EQ(stream->QueuedBytes(), first.size() + second.size());
+
+  // the peer echoes everything it gets
+  std::thread peer([&sockets, total = first.size() + second.size()] {
+    char buffer[65536];
+    std::size_t echoed = 0;
+    while (echoed < total) {
+      ssize_t length = read(sockets[1], buffer, sizeof(buffer));
+      if (length <= 0) {
+        break;
+      }
+      for (ssize_t offset = 0; offset < length;) {
+        offset += write(sockets[1], buffer + offset, length - offset);
+      }
+      echoed += length;
+    }
+  });
+
+  std::size_t total = first.size() + second.size();
+  EXPECT_TRUE(drive(*ring, [&] { return received.size() == total; }));
+  peer.join();
+
+  EXPECT_EQ(written, 2);
+  EXPECT_EQ(stream->QueuedBytes(), 0);
+  EXPECT_EQ(received, first + second);
+
+  BrokerStats stats{};
+  stream->Stats(stats);
+  EXPECT_TRUE(stats.IOUring);
+
+  stream->Close();
+  EXPECT_TRUE(drive(*ring, [&ring] { return ring->Streams() == 0; }));
+  close(sockets[0]);
+  close(sockets[1]);
+}
+
+// Test if the stream reports the peer going away
+TEST(IOUringTest, PublishesErrorWhenPeerCloses) {
+  auto ring = IOUring::Create();
+  if (ring == nullptr) {
+    GTEST_SKIP() << "io_uring is not available";
+  }
+
+  int sockets[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+  auto stream = std::make_shared<IOUringStream>(ring, sockets[0]);
+  std::string reason;
+  stream->on<ErrorEvent>([&reason](const ErrorEvent& event, ByteStream&) {
+    reason = event.Reason;
+  });
+  stream->Start();
+  stream->Read();
+  ring->Submit();
+  close(sockets[1]);
+
+  EXPECT_TRUE(drive(*ring, [&reason] { return !reason.empty(); }));
+  EXPECT_TRUE(drive(*ring, [&ring] { return ring->Streams() == 0; }));
+  close(sockets[0]);
+}
+
+#endif  // AHIV_KAFKA_IO_URING
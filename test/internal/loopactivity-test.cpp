@@ -0,0 +1,31 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/loopactivity.h"
+
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::LoopActivity;
+
+// Test if iterations are split into busy ones and spins
+TEST(LoopActivityTest, SplitsBusyAndSpinIterations) {
+  LoopActivity activity;
+  EXPECT_FALSE(activity.BusyPolled());
+
+  activity.RecordEvent();
+  activity.RecordEvent();
+  EXPECT_EQ(activity.Events(), 2);
+
+  activity.RecordIteration(true, std::chrono::microseconds(30));
+  activity.RecordIteration(false, std::chrono::microseconds(2));
+  activity.RecordIteration(false, std::chrono::microseconds(3));
+  EXPECT_TRUE(activity.BusyPolled());
+
+  auto stats = activity.Stats();
+  EXPECT_EQ(stats.Iterations, 3);
+  EXPECT_EQ(stats.SpinIterations, 2);
+  EXPECT_EQ(stats.BusyUs, 30);
+  EXPECT_EQ(stats.SpinUs, 5);
+}
@@ -0,0 +1,51 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/memorybudget.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Test if reservations are refused once the budget is exhausted and allowed
+// again below the low watermark
+TEST(MemoryBudgetTest, BlocksUntilLowWatermark) {
+  ahiv::kafka::internal::MemoryBudget budget(100);
+  std::vector<bool> transitions;
+  budget.OnStateChange(
+      [&transitions](bool blocked) { transitions.emplace_back(blocked); });
+
+  EXPECT_TRUE(budget.TryReserve(60));
+  EXPECT_TRUE(budget.TryReserve(30));
+  EXPECT_FALSE(budget.TryReserve(20));
+  EXPECT_TRUE(budget.Blocked());
+  EXPECT_EQ(budget.Used(), 90);
+
+  budget.Release(10);
+  EXPECT_TRUE(budget.Blocked());
+  EXPECT_FALSE(budget.TryReserve(1));
+
+  budget.Release(5);
+  EXPECT_FALSE(budget.Blocked());
+  EXPECT_TRUE(budget.TryReserve(1));
+  EXPECT_EQ(transitions, std::vector<bool>({true, false}));
+}
+
+// Test if received bytes are always accounted and block the budget
+TEST(MemoryBudgetTest, ReserveExceedsLimit) {
+  ahiv::kafka::internal::MemoryBudget budget(100);
+  budget.Reserve(150);
+  EXPECT_TRUE(budget.Blocked());
+  EXPECT_EQ(budget.Used(), 150);
+
+  budget.Release(150);
+  EXPECT_FALSE(budget.Blocked());
+}
+
+// Test if a reservation larger than the budget fails without blocking
+TEST(MemoryBudgetTest, OversizedReservation) {
+  ahiv::kafka::internal::MemoryBudget budget(100);
+  EXPECT_FALSE(budget.TryReserve(101));
+  EXPECT_FALSE(budget.Blocked());
+  EXPECT_TRUE(budget.TryReserve(100));
+}
@@ -0,0 +1,37 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/murmur2.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+// Test if hashes match the ones of the Java client
+TEST(Murmur2Test, MatchesJavaClient) {
+  using ahiv::kafka::internal::Murmur2;
+  EXPECT_EQ(Murmur2("21"), -973932308);
+  EXPECT_EQ(Murmur2("foobar"), -790332482);
+  EXPECT_EQ(Murmur2("a-little-bit-long-string"), -985981536);
+  EXPECT_EQ(Murmur2("a-little-bit-longer-string"), -1486304829);
+  EXPECT_EQ(Murmur2("lkjh234lh9fiuh90y23oiuhsafujhadof229phr9h19h89h8"),
+            -58897971);
+  EXPECT_EQ(Murmur2("abc"), 479470107);
+}
+
+// Test if bulk hashing gives the same hashes as hashing one key at a time
+TEST(Murmur2Test, BulkMatchesSingle) {
+  std::vector<std::string> storage;
+  for (int key = 0; key < 23; key++) {
+    storage.emplace_back(std::string(key, 'a' + key % 26) +
+                         std::to_string(key * 7919));
+  }
+  std::vector<std::string_view> keys(storage.begin(), storage.end());
+
+  std::vector<int32_t> hashes(keys.size());
+  ahiv::kafka::internal::Murmur2Bulk(keys.data(), keys.size(), hashes.data());
+  for (std::size_t key = 0; key < keys.size(); key++) {
+    EXPECT_EQ(hashes[key], ahiv::kafka::internal::Murmur2(keys[key]));
+  }
+}
@@ -0,0 +1,30 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/offsettracker.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::OffsetTracker;
+
+// Test if the committable offset only advances over batches which are
+// processed along with all batches in front of them
+TEST(OffsetTrackerTest, AdvancesContiguously) {
+  OffsetTracker tracker;
+  tracker.Track(9, 1);
+  tracker.Track(19, 2);
+  tracker.Track(29, 1);
+  EXPECT_FALSE(tracker.Committable().has_value());
+
+  EXPECT_FALSE(tracker.Complete(29));
+  EXPECT_FALSE(tracker.Complete(19));
+  EXPECT_FALSE(tracker.Committable().has_value());
+
+  EXPECT_TRUE(tracker.Complete(9));
+  EXPECT_EQ(*tracker.Committable(), 10);
+
+  EXPECT_TRUE(tracker.Complete(19));
+  EXPECT_EQ(*tracker.Committable(), 30);
+  EXPECT_EQ(tracker.Pending(), 0);
+  EXPECT_FALSE(tracker.Complete(29));
+}
@@ -0,0 +1,27 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/pacinggate.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::PacingGate;
+using std::chrono::milliseconds;
+
+// Test if the gate stays closed for the throttle time and a shorter throttle
+// time does not shorten the hold
+TEST(PacingGateTest, HoldsForThrottleTime) {
+  PacingGate gate;
+  auto now = PacingGate::Clock::now();
+  EXPECT_TRUE(gate.IsOpen(now));
+
+  gate.Throttle(0, now);
+  EXPECT_TRUE(gate.IsOpen(now));
+
+  gate.Throttle(100, now);
+  gate.Throttle(20, now + milliseconds(10));
+  EXPECT_FALSE(gate.IsOpen(now + milliseconds(99)));
+  EXPECT_EQ(gate.Remaining(now + milliseconds(40)), milliseconds(60));
+  EXPECT_TRUE(gate.IsOpen(now + milliseconds(100)));
+  EXPECT_EQ(gate.Remaining(now + milliseconds(100)), milliseconds(0));
+}
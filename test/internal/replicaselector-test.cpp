@@ -0,0 +1,54 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/replicaselector.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::ReplicaSelector;
+using ahiv::kafka::protocol::packet::BrokerNodeInformation;
+using ahiv::kafka::protocol::packet::PartitionInformation;
+
+namespace {
+ReplicaSelector makeSelector(const std::string& clientRack) {
+  ReplicaSelector selector;
+  selector.SetClientRack(clientRack);
+  selector.UpdateBrokers({BrokerNodeInformation{1, "a", 9092, "az-1"},
+                          BrokerNodeInformation{2, "b", 9092, "az-2"},
+                          BrokerNodeInformation{3, "c", 9092, "az-3"}});
+
+  PartitionInformation partition;
+  partition.partitionIndex = 0;
+  partition.leaderId = 1;
+  partition.isr = {1, 2, 3};
+  selector.UpdatePartition("test", partition);
+  return selector;
+}
+}  // namespace
+
+// Test if an in-sync replica in the rack of the client is picked, and the
+// leader without a rack
+TEST(ReplicaSelectorTest, PrefersClientRack) {
+  EXPECT_EQ(makeSelector("az-2").ServingReplica("test", 0), 2);
+  EXPECT_EQ(makeSelector("az-9").ServingReplica("test", 0), 1);
+  EXPECT_EQ(makeSelector("").ServingReplica("test", 0), 1);
+  EXPECT_EQ(makeSelector("az-2").ServingReplica("test", 1), -1);
+}
+
+// Test if the preferred read replica of the broker is followed and errors
+// fall back to the leader
+TEST(ReplicaSelectorTest, FollowsBroker) {
+  auto selector = makeSelector("");
+  EXPECT_EQ(selector.OnFetchResponse("test", 0, 0, 3), 3);
+  EXPECT_EQ(selector.OnFetchResponse("test", 0, 0, -1), 3);
+
+  PartitionInformation partition;
+  partition.partitionIndex = 0;
+  partition.leaderId = 1;
+  partition.isr = {1, 3};
+  selector.UpdatePartition("test", partition);
+  EXPECT_EQ(selector.ServingReplica("test", 0), 3);
+
+  EXPECT_EQ(selector.OnFetchResponse("test", 0, 6, -1), 1);
+  EXPECT_EQ(selector.ServingReplica("test", 0), 1);
+}
@@ -0,0 +1,102 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/sequencer.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::ErrorCode;
+using ahiv::kafka::internal::SequenceOutcome;
+using ahiv::kafka::internal::Sequencer;
+
+// Test if batches get consecutive sequences per partition and no batch can
+// be sent before the producer id is known
+TEST(SequencerTest, AssignsConsecutiveSequences) {
+  Sequencer sequencer;
+  EXPECT_FALSE(sequencer.Assign("test", 0, 10).has_value());
+
+  sequencer.SetProducerId(1000, 0);
+  auto first = sequencer.Assign("test", 0, 10);
+  auto second = sequencer.Assign("test", 0, 5);
+  auto other = sequencer.Assign("test", 1, 3);
+  ASSERT_TRUE(first.has_value() && second.has_value() && other.has_value());
+
+  EXPECT_EQ(sequencer.Sequence("test", 0, *first)->baseSequence, 0);
+  EXPECT_EQ(sequencer.Sequence("test", 0, *second)->baseSequence, 10);
+  EXPECT_EQ(sequencer.Sequence("test", 1, *other)->baseSequence, 0);
+
+  ahiv::kafka::protocol::packet::RecordBatchHeader header;
+  EXPECT_TRUE(sequencer.Stamp("test", 0, *second, header));
+  EXPECT_EQ(header.producerId, 1000);
+  EXPECT_EQ(header.producerEpoch, 0);
+  EXPECT_EQ(header.baseSequence, 10);
+}
+
+// Test if only MaxInFlightPerPartition batches can be in flight at once
+TEST(SequencerTest, LimitsInFlightBatches) {
+  Sequencer sequencer;
+  sequencer.SetProducerId(1, 0);
+
+  std::optional<uint64_t> first;
+  for (std::size_t batch = 0; batch < Sequencer::MaxInFlightPerPartition;
+       batch++) {
+    auto batchId = sequencer.Assign("test", 0, 1);
+    ASSERT_TRUE(batchId.has_value());
+    if (!first.has_value()) {
+      first = batchId;
+    }
+  }
+
+  EXPECT_FALSE(sequencer.CanSend("test", 0));
+  EXPECT_TRUE(sequencer.CanSend("test", 1));
+
+  sequencer.Acknowledge("test", 0, *first);
+  EXPECT_TRUE(sequencer.CanSend("test", 0));
+}
+
+// Test if retried batches keep their sequence and a producer reset
+// renumbers the batches in flight in send order
+TEST(SequencerTest, ResequencesAfterReset) {
+  Sequencer sequencer;
+  sequencer.SetProducerId(1, 0);
+  auto first = *sequencer.Assign("test", 0, 4);
+  auto second = *sequencer.Assign("test", 0, 4);
+  auto third = *sequencer.Assign("test", 0, 4);
+
+  EXPECT_EQ(sequencer.Fail("test", 0, second,
+                           ErrorCode::NOT_LEADER_FOR_PARTITION),
+            SequenceOutcome::Retry);
+  EXPECT_EQ(sequencer.Sequence("test", 0, second)->baseSequence, 4);
+
+  sequencer.Acknowledge("test", 0, first);
+  EXPECT_EQ(
+      sequencer.Fail("test", 0, second, ErrorCode::OUT_OF_ORDER_SEQUENCE_NUMBER),
+      SequenceOutcome::ResetProducer);
+  EXPECT_FALSE(sequencer.CanSend("test", 0));
+
+  sequencer.SetProducerId(1, 1);
+  EXPECT_EQ(sequencer.Sequence("test", 0, second)->baseSequence, 0);
+  EXPECT_EQ(sequencer.Sequence("test", 0, third)->baseSequence, 4);
+  EXPECT_EQ(sequencer.Sequence("test", 0, third)->producerEpoch, 1);
+  EXPECT_EQ(sequencer.Sequence("test", 0, *sequencer.Assign("test", 0, 1))
+                ->baseSequence,
+            8);
+}
+
+// Test if duplicates count as written and dropped batches close their gap
+TEST(SequencerTest, HandlesDuplicatesAndDrops) {
+  Sequencer sequencer;
+  sequencer.SetProducerId(1, 0);
+  auto first = *sequencer.Assign("test", 0, 2);
+  auto second = *sequencer.Assign("test", 0, 2);
+  auto third = *sequencer.Assign("test", 0, 2);
+
+  EXPECT_EQ(
+      sequencer.Fail("test", 0, first, ErrorCode::DUPLICATE_SEQUENCE_NUMBER),
+      SequenceOutcome::Acknowledged);
+  EXPECT_EQ(sequencer.InFlight("test", 0), 2);
+
+  EXPECT_EQ(sequencer.Fail("test", 0, second, ErrorCode::INVALID_FETCH_SIZE),
+            SequenceOutcome::Drop);
+  EXPECT_EQ(sequencer.Sequence("test", 0, third)->baseSequence, 2);
+}
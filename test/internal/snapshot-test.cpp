@@ -0,0 +1,90 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/snapshot.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::WarmStartSnapshot;
+
+namespace {
+ahiv::kafka::protocol::packet::MetadataResponsePacket createMetadata() {
+  ahiv::kafka::protocol::packet::MetadataResponsePacket metadata;
+  metadata.clusterId = "cluster";
+  metadata.brokers.resize(1);
+  metadata.brokers[0].nodeId = 1;
+  metadata.brokers[0].host = "localhost";
+  metadata.brokers[0].port = 9092;
+  metadata.topicInformation.resize(2);
+  metadata.topicInformation[0].name = "test";
+  metadata.topicInformation[0].partitionInformation.resize(2);
+  metadata.topicInformation[0].partitionInformation[1].partitionIndex = 1;
+  metadata.topicInformation[0].partitionInformation[1].leaderId = 1;
+  metadata.topicInformation[1].name = "missing";
+  metadata.topicInformation[1].errorCode = 3;
+  return metadata;
+}
+}  // namespace
+
+// SnapshotTest writes its snapshots into a fresh directory which is removed
+// afterwards
+class SnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char pattern[] = "/tmp/snapshot-XXXXXX";
+    ASSERT_NE(::mkdtemp(pattern), nullptr);
+    this->directory = pattern;
+    this->path = this->directory + "/snapshot";
+  }
+
+  void TearDown() override { std::filesystem::remove_all(this->directory); }
+
+  std::string directory;
+  std::string path;
+};
+
+// Test if a snapshot survives a save and load round trip and keeps positions
+// when it is replaced with new metadata
+TEST_F(SnapshotTest, RoundTrip) {
+  auto snapshot = WarmStartSnapshot::FromMetadata(createMetadata());
+  ASSERT_EQ(snapshot.topics.size(), 1);
+  snapshot.SetPosition("test", 1, 42);
+
+  ASSERT_TRUE(snapshot.Save(this->path));
+
+  auto loaded = WarmStartSnapshot::Load(this->path);
+  ASSERT_TRUE(loaded.has_value());
+  EXPECT_EQ(loaded->clusterId, "cluster");
+  ASSERT_EQ(loaded->brokers.size(), 1);
+  EXPECT_EQ(loaded->brokers[0].host, "localhost");
+  EXPECT_EQ(loaded->Position("test", 1), 42);
+  EXPECT_EQ(loaded->Position("test", 0), -1);
+
+  auto topic = WarmStartSnapshot::ToTopicInformation(loaded->topics[0]);
+  EXPECT_EQ(topic.partitionInformation[1].leaderId, 1);
+
+  auto refreshed = WarmStartSnapshot::FromMetadata(createMetadata(), &*loaded);
+  EXPECT_EQ(refreshed.Position("test", 1), 42);
+}
+
+// Test if damaged and missing files are rejected
+TEST_F(SnapshotTest, RejectsDamagedFiles) {
+  EXPECT_FALSE(WarmStartSnapshot::Load(this->path).has_value());
+
+  ASSERT_TRUE(
+      WarmStartSnapshot::FromMetadata(createMetadata()).Save(this->path));
+  {
+    std::fstream file(this->path,
+                      std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(WarmStartSnapshot::HeaderSize + 3);
+    file.put('\x7f');
+  }
+  EXPECT_FALSE(WarmStartSnapshot::Load(this->path).has_value());
+
+  std::ofstream(this->path, std::ios::binary | std::ios::trunc) << "AHKS";
+  EXPECT_FALSE(WarmStartSnapshot::Load(this->path).has_value());
+}
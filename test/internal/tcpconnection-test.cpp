@@ -0,0 +1,355 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/tcpconnection.h"
+
+#include <arpa/inet.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::ConnectedEvent;
+using ahiv::kafka::ConnectionConfig;
+using ahiv::kafka::Error;
+using ahiv::kafka::internal::MemoryBudget;
+using ahiv::kafka::internal::TCPConnection;
+using ahiv::kafka::protocol::Buffer;
+using ahiv::kafka::protocol::packet::MetadataPacket;
+using ahiv::kafka::protocol::packet::MetadataRequestPacket;
+using ahiv::kafka::protocol::packet::MetadataResponsePacket;
+
+namespace {
+// Chunk is a part of a response frame which the broker writes after the delay
+struct Chunk {
+  uint64_t delayMs;
+  std::size_t bytes;
+};
+
+// FakeBroker answers every metadata request on 127.0.0.1 with a response of
+// the given amount of topics. The response frame is written in chunks, so
+// the client sees it arrive piece by piece. With a uvw::PipeHandle it
+// listens on the unix socket at path instead
+template <typename Handle = uvw::TCPHandle>
+class FakeBroker {
+ public:
+  FakeBroker(std::shared_ptr<uvw::Loop> loop, int topics,
+             std::vector<Chunk> chunks, std::string path = "")
+      : loop(std::move(loop)),
+        topics(topics),
+        chunks(std::move(chunks)),
+        path(std::move(path)) {
+    this->server = this->loop->template resource<Handle>();
+    this->server->template on<uvw::ListenEvent>(
+        [this](const uvw::ListenEvent&, Handle& server) {
+          this->accept(server);
+        });
+    if constexpr (std::is_same_v<Handle, uvw::PipeHandle>) {
+      this->server->bind(this->path);
+    } else {
+      this->server->bind("127.0.0.1", 0);
+    }
+    this->server->listen();
+  }
+
+  // Config returns a connection config whose address is resolved to the
+  // broker already, unix:// configs have nothing to resolve
+  std::shared_ptr<ConnectionConfig> Config() const {
+    if constexpr (std::is_same_v<Handle, uvw::PipeHandle>) {
+      return ConnectionConfig::ParseFromConnectionURL("unix://" + this->path);
+    } else {
+      auto config = ConnectionConfig::ParseFromConnectionURL(
+          "plaintext://127.0.0.1:" +
+          std::to_string(this->server->sock().port));
+
+      sockaddr_storage storage{};
+      auto* address = reinterpret_cast<sockaddr_in*>(&storage);
+      address->sin_family = AF_INET;
+      address->sin_port = htons(this->server->sock().port);
+      inet_pton(AF_INET, "127.0.0.1", &address->sin_addr);
+      config->address->resolvedAddresses =
+          std::make_shared<const ahiv::kafka::internal::ResolvedAddresses>(
+              ahiv::kafka::internal::ResolvedAddresses{storage});
+      return config;
+    }
+  }
+
+  void Close() {
+    for (const auto& client : this->clients) {
+      client->close();
+    }
+    for (const auto& timer : this->timers) {
+      timer->close();
+    }
+    this->server->close();
+  }
+
+  // FrameSize is the size of every response frame
+  std::size_t FrameSize() const { return this->response(0).size(); }
+
+ private:
+  void accept(Handle& server) {
+    auto client = this->loop->template resource<Handle>();
+    auto pending = std::make_shared<std::vector<char>>();
+    client->template on<uvw::DataEvent>(
+        [this, pending](const uvw::DataEvent& event, Handle& client) {
+          pending->insert(pending->end(), event.data.get(),
+                          event.data.get() + event.length);
+          if (pending->size() < 12) {
+            return;
+          }
+
+          int32_t correlationId;
+          std::memcpy(&correlationId, pending->data() + 8, 4);
+          pending->clear();
+          this->respond(client, be32toh(correlationId));
+        });
+    server.accept(*client);
+    client->read();
+    this->clients.emplace_back(client);
+  }
+
+  std::vector<char> response(int32_t correlationId) const {
+    MetadataResponsePacket response;
+    response.correlationId = correlationId;
+    response.topicInformation.resize(this->topics);
+    for (int topic = 0; topic < this->topics; topic++) {
+      response.topicInformation[topic].name =
+          "topic-with-a-long-name-" + std::to_string(topic);
+    }
+    response.packetSize = MetadataResponsePacket::Schema::Size(response) - 4;
+
+    Buffer buffer;
+    buffer.EnsureAllocated(response.packetSize + 4);
+    MetadataResponsePacket::Schema::Encode(response, buffer);
+    return std::vector<char>(buffer.View(0), buffer.View(buffer.Size()));
+  }
+
+  // respond writes the response frame chunk by chunk, the last chunk takes
+  // all remaining bytes
+  void respond(Handle& client, int32_t correlationId) {
+    auto frame =
+        std::make_shared<std::vector<char>>(this->response(correlationId));
+    std::size_t offset = 0;
+    for (std::size_t index = 0; index < this->chunks.size(); index++) {
+      std::size_t bytes = index + 1 == this->chunks.size()
+                              ? frame->size() - offset
+                              : this->chunks[index].bytes;
+      auto timer = this->loop->resource<uvw::TimerHandle>();
+      timer->on<uvw::TimerEvent>(
+          [&client, frame, offset, bytes](const uvw::TimerEvent&,
+                                          uvw::TimerHandle& timer) {
+            client.write(frame->data() + offset,
+                         static_cast<unsigned int>(bytes));
+            timer.close();
+          });
+      timer->start(uvw::TimerHandle::Time{this->chunks[index].delayMs},
+                   uvw::TimerHandle::Time{0});
+      this->timers.emplace_back(timer);
+      offset += bytes;
+    }
+  }
+
+  std::shared_ptr<uvw::Loop> loop;
+  int topics;
+  std::vector<Chunk> chunks;
+  std::string path;
+  std::shared_ptr<Handle> server;
+  std::vector<std::shared_ptr<Handle>> clients;
+  std::vector<std::shared_ptr<uvw::TimerHandle>> timers;
+};
+
+// requestMetadata sends a metadata request once the connection is connected
+// and counts the responses
+void requestMetadata(const std::shared_ptr<TCPConnection>& connection,
+                     int& responses, std::function<void()> done) {
+  connection->Once<ConnectedEvent>(
+      [&responses, done](ConnectedEvent&, TCPConnection& connection) {
+        MetadataRequestPacket request({}, false, false, false);
+        bool sent = connection.Send<MetadataPacket>(
+            request, [&responses, done](MetadataResponsePacket&) {
+              responses++;
+              done();
+            });
+        EXPECT_TRUE(sent);
+      });
+}
+
+// guard fails the test and stops the loop when it stalls
+std::shared_ptr<uvw::TimerHandle> guard(const std::shared_ptr<uvw::Loop>& loop,
+                                        std::function<void()> stop) {
+  auto timer = loop->resource<uvw::TimerHandle>();
+  timer->on<uvw::TimerEvent>(
+      [stop](const uvw::TimerEvent&, uvw::TimerHandle&) {
+        ADD_FAILURE() << "reading stalled";
+        stop();
+      });
+  timer->start(uvw::TimerHandle::Time{5000}, uvw::TimerHandle::Time{0});
+  return timer;
+}
+}  // namespace
+
+// Test if a response frame larger than the whole memory budget is read
+// completely instead of pausing in the middle of it
+TEST(TCPConnectionTest, ReadsFrameLargerThanBudget) {
+  auto loop = uvw::Loop::create();
+  FakeBroker broker(loop, 256, {{0, 1024}, {10, 1024}, {20, 1024}, {30, 0}});
+  auto budget = std::make_shared<MemoryBudget>(1024);
+  ASSERT_GT(broker.FrameSize(), 4 * budget->Limit());
+
+  auto connection =
+      std::make_shared<TCPConnection>(loop, broker.Config(), budget);
+  std::shared_ptr<uvw::TimerHandle> timer;
+  auto stop = [&] {
+    connection->Close();
+    broker.Close();
+    timer->close();
+  };
+  timer = guard(loop, stop);
+
+  int responses = 0;
+  requestMetadata(connection, responses, stop);
+  loop->run();
+
+  EXPECT_EQ(responses, 1);
+  EXPECT_EQ(budget->Used(), 0);
+}
+
+// Test if two connections which both hold a partial frame when the shared
+// budget is exhausted finish their frames instead of waiting for each other
+TEST(TCPConnectionTest, FinishesPartialFramesOfAllConnections) {
+  auto loop = uvw::Loop::create();
+  FakeBroker broker(loop, 160, {{0, 2500}, {50, 2500}, {100, 0}});
+  auto budget = std::make_shared<MemoryBudget>(4096);
+  ASSERT_GT(broker.FrameSize(), 5000);
+
+  auto first = std::make_shared<TCPConnection>(loop, broker.Config(), budget);
+  auto second = std::make_shared<TCPConnection>(loop, broker.Config(), budget);
+  budget->OnStateChange([&first, &second](bool blocked) {
+    if (!blocked) {
+      first->ResumeReading();
+      second->ResumeReading();
+    }
+  });
+
+  std::shared_ptr<uvw::TimerHandle> timer;
+  int responses = 0;
+  auto stop = [&] {
+    first->Close();
+    second->Close();
+    broker.Close();
+    timer->close();
+  };
+  auto done = [&] {
+    if (responses == 2) {
+      stop();
+    }
+  };
+  timer = guard(loop, stop);
+
+  requestMetadata(first, responses, done);
+  requestMetadata(second, responses, done);
+  loop->run();
+
+  EXPECT_EQ(responses, 2);
+  EXPECT_EQ(budget->Used(), 0);
+}
+
+// Test if a request which is not answered in time is handed to its failure
+// callback
+TEST(TCPConnectionTest, CallsFailureCallbackOnTimeout) {
+  auto loop = uvw::Loop::create();
+  FakeBroker broker(loop, 1, {{10000, 0}});
+  auto connection = std::make_shared<TCPConnection>(loop, broker.Config());
+  connection->SetRequestTimeout(std::chrono::milliseconds{50});
+
+  std::shared_ptr<uvw::TimerHandle> timer;
+  auto stop = [&] {
+    connection->Close();
+    broker.Close();
+    timer->close();
+  };
+  timer = guard(loop, stop);
+
+  std::vector<Error> failures;
+  connection->Once<ConnectedEvent>([&](ConnectedEvent&, TCPConnection&) {
+    MetadataRequestPacket request({}, false, false, false);
+    connection->Send<MetadataPacket>(
+        request,
+        [](MetadataResponsePacket&) { ADD_FAILURE() << "unexpected response"; },
+        [&failures, &stop](Error error) {
+          failures.emplace_back(error);
+          stop();
+        });
+  });
+  loop->run();
+
+  ASSERT_EQ(failures.size(), 1);
+  EXPECT_EQ(failures[0], Error::RequestTimedOut);
+}
+
+// Test if the late response to a request which timed out is counted as
+// unmatched instead of being handed to anybody
+TEST(TCPConnectionTest, CountsLateResponses) {
+  auto loop = uvw::Loop::create();
+  FakeBroker broker(loop, 1, {{100, 0}});
+  auto connection = std::make_shared<TCPConnection>(loop, broker.Config());
+  connection->SetRequestTimeout(std::chrono::milliseconds{20});
+
+  int failures = 0;
+  connection->Once<ConnectedEvent>([&](ConnectedEvent&, TCPConnection&) {
+    MetadataRequestPacket request({}, false, false, false);
+    connection->Send<MetadataPacket>(
+        request,
+        [](MetadataResponsePacket&) { ADD_FAILURE() << "unexpected response"; },
+        [&failures](Error) { failures++; });
+  });
+
+  ahiv::kafka::BrokerStats stats{};
+  auto timer = loop->resource<uvw::TimerHandle>();
+  timer->on<uvw::TimerEvent>([&](const uvw::TimerEvent&, uvw::TimerHandle&) {
+    connection->Stats(stats);
+    connection->Close();
+    broker.Close();
+    timer->close();
+  });
+  timer->start(uvw::TimerHandle::Time{300}, uvw::TimerHandle::Time{0});
+  loop->run();
+
+  EXPECT_EQ(failures, 1);
+  EXPECT_EQ(stats.RequestTimeouts, 1);
+  EXPECT_EQ(stats.UnmatchedResponses, 1);
+}
+
+// Test if a request is sent and its response frame received over the unix
+// socket of a unix:// broker
+TEST(TCPConnectionTest, RequestsOverUnixSocket) {
+  char directory[] = "/tmp/tcpconnection-XXXXXX";
+  ASSERT_NE(::mkdtemp(directory), nullptr);
+
+  auto loop = uvw::Loop::create();
+  FakeBroker<uvw::PipeHandle> broker(loop, 16, {{0, 100}, {10, 0}},
+                                     std::string(directory) + "/broker.sock");
+  auto connection = std::make_shared<TCPConnection>(loop, broker.Config());
+  std::shared_ptr<uvw::TimerHandle> timer;
+  auto stop = [&] {
+    connection->Close();
+    broker.Close();
+    timer->close();
+  };
+  timer = guard(loop, stop);
+
+  int responses = 0;
+  requestMetadata(connection, responses, stop);
+  loop->run();
+  std::filesystem::remove_all(directory);
+
+  EXPECT_EQ(responses, 1);
+}
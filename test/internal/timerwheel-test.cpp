@@ -0,0 +1,110 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/timerwheel.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::internal::LoopTimerWheel;
+using ahiv::kafka::internal::TimerId;
+using ahiv::kafka::internal::TimerWheel;
+
+// Test if timers fire exactly at their deadline across all levels, including
+// deadlines beyond the range of the wheel
+TEST(TimerWheelTest, FiresAtDeadline) {
+  TimerWheel wheel(1000);
+  std::vector<uint64_t> delays = {1,    63,    64,     65,      4095,
+                                  4096, 70000, 300000, 1 << 24, (1 << 24) + 5};
+  std::vector<uint64_t> firedAt(delays.size());
+  for (std::size_t index = 0; index < delays.size(); index++) {
+    wheel.Schedule(delays[index],
+                   [&wheel, &firedAt, index] { firedAt[index] = wheel.Now(); });
+  }
+
+  uint64_t now = 1000;
+  while (auto expiry = wheel.NextExpiry()) {
+    ASSERT_GT(*expiry, now);
+    now = *expiry;
+    wheel.Advance(now);
+  }
+
+  for (std::size_t index = 0; index < delays.size(); index++) {
+    EXPECT_EQ(firedAt[index], 1000 + delays[index]) << delays[index];
+  }
+  EXPECT_EQ(wheel.Size(), 0);
+}
+
+// Test if cancelled timers never fire and stale ids are ignored
+TEST(TimerWheelTest, CancelsTimers) {
+  TimerWheel wheel;
+  std::mt19937 random(42);
+  std::vector<TimerId> ids;
+  int fired = 0;
+  for (int timer = 0; timer < 10000; timer++) {
+    ids.emplace_back(wheel.Schedule(random() % 100000, [&fired] { fired++; }));
+  }
+
+  for (std::size_t index = 0; index < ids.size(); index += 2) {
+    EXPECT_TRUE(wheel.Cancel(ids[index]));
+    EXPECT_FALSE(wheel.Cancel(ids[index]));
+  }
+  EXPECT_EQ(wheel.Size(), 5000);
+
+  wheel.Advance(100000);
+  EXPECT_EQ(fired, 5000);
+  EXPECT_FALSE(wheel.Cancel(ids[1]));
+
+  TimerId reused = wheel.Schedule(10, [&fired] { fired++; });
+  EXPECT_FALSE(wheel.Cancel(ids[reused.index]));
+  wheel.Advance(100010);
+  EXPECT_EQ(fired, 5001);
+}
+
+// Test if callbacks may cancel other timers of the same tick and schedule new
+// ones
+TEST(TimerWheelTest, CallbacksChangeTimers) {
+  TimerWheel wheel;
+  int fired = 0;
+  TimerId second;
+  wheel.Schedule(5, [&] {
+    fired++;
+    wheel.Cancel(second);
+    wheel.Schedule(0, [&fired] { fired += 10; });
+  });
+  second = wheel.Schedule(5, [&fired] { fired += 100; });
+
+  wheel.Advance(5);
+  EXPECT_EQ(fired, 1);
+  wheel.Advance(6);
+  EXPECT_EQ(fired, 11);
+}
+
+// Test if scheduling on the loop wheel never runs timers which are due, they
+// only fire from the loop, and if delays count from the time of the loop
+TEST(LoopTimerWheelTest, SchedulesWithoutFiring) {
+  auto loop = uvw::Loop::create();
+  auto handle = loop->resource<uvw::TimerHandle>();
+  auto wheel = LoopTimerWheel::Of(loop);
+
+  int fired = 0;
+  uint64_t scheduledAt = 0;
+  uint64_t firedAt = 0;
+  handle->on<uvw::TimerEvent>([&](const uvw::TimerEvent&, auto& timer) {
+    wheel->Schedule(std::chrono::milliseconds{30}, [&] {
+      fired += 10;
+      firedAt = loop->now().count();
+    });
+    scheduledAt = loop->now().count();
+    EXPECT_EQ(fired, 0);
+    timer.close();
+  });
+  handle->start(uvw::TimerHandle::Time{20}, uvw::TimerHandle::Time{0});
+  wheel->Schedule(std::chrono::milliseconds{20}, [&fired] { fired++; });
+
+  loop->run();
+  EXPECT_EQ(fired, 11);
+  EXPECT_GE(firedAt, scheduledAt + 30);
+}
@@ -0,0 +1,234 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/internal/tlssession.h"
+
+#ifdef AHIV_KAFKA_TLS
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <openssl/pem.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::TLSConfig;
+using ahiv::kafka::internal::TLSContext;
+using ahiv::kafka::internal::TLSSession;
+using ahiv::kafka::internal::TLSStatus;
+
+namespace {
+// SelfSigned is a key and a certificate for 127.0.0.1, signed by the key
+struct SelfSigned {
+  SelfSigned() {
+    this->key = EVP_EC_gen("P-256");
+    this->certificate = X509_new();
+    X509_set_version(this->certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(this->certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(this->certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(this->certificate), 3600);
+    X509_set_pubkey(this->certificate, this->key);
+
+    X509_NAME* name = X509_get_subject_name(this->certificate);
+    X509_NAME_add_entry_by_txt(
+        name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("loopback"), -1, -1, 0);
+    X509_set_issuer_name(this->certificate, name);
+
+    X509V3_CTX extensionContext;
+    X509V3_set_ctx_nodb(&extensionContext);
+    X509V3_set_ctx(&extensionContext, this->certificate, this->certificate,
+                   nullptr, nullptr, 0);
+    X509_EXTENSION* alternativeName = X509V3_EXT_conf_nid(
+        nullptr, &extensionContext, NID_subject_alt_name, "IP:127.0.0.1");
+    X509_add_ext(this->certificate, alternativeName, -1);
+    X509_EXTENSION_free(alternativeName);
+
+    X509_sign(this->certificate, this->key, EVP_sha256());
+  }
+
+  ~SelfSigned() {
+    X509_free(this->certificate);
+    EVP_PKEY_free(this->key);
+  }
+
+  // WriteCertificate stores the certificate as PEM, for use as CA file
+  std::string WriteCertificate(const std::string& name) const {
+    std::string path = testing::TempDir() + name;
+    FILE* file = std::fopen(path.c_str(), "w");
+    PEM_write_X509(file, this->certificate);
+    std::fclose(file);
+    return path;
+  }
+
+  EVP_PKEY* key;
+  X509* certificate;
+};
+
+// LoopbackListener accepts a single TLS client on 127.0.0.1 and echoes
+// everything it receives until the client goes away
+class LoopbackListener {
+ public:
+  explicit LoopbackListener(const SelfSigned& identity) {
+    this->context = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_use_certificate(this->context, identity.certificate);
+    SSL_CTX_use_PrivateKey(this->context, identity.key);
+
+    this->listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(this->listener, reinterpret_cast<sockaddr*>(&address),
+         sizeof(address));
+    listen(this->listener, 1);
+
+    socklen_t length = sizeof(address);
+    getsockname(this->listener, reinterpret_cast<sockaddr*>(&address),
+                &length);
+    this->port = ntohs(address.sin_port);
+
+    this->thread = std::thread([this] { this->serve(); });
+  }
+
+  ~LoopbackListener() {
+    this->thread.join();
+    close(this->listener);
+    SSL_CTX_free(this->context);
+  }
+
+  // Connect returns a non-blocking socket connected to the listener
+  int Connect() const {
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(this->port);
+    connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+    return client;
+  }
+
+ private:
+  void serve() {
+    int client = accept(this->listener, nullptr, nullptr);
+    SSL* session = SSL_new(this->context);
+    SSL_set_fd(session, client);
+    if (SSL_accept(session) == 1) {
+      char buffer[4096];
+      int received;
+      while ((received = SSL_read(session, buffer, sizeof(buffer))) > 0) {
+        SSL_write(session, buffer, received);
+      }
+    }
+
+    SSL_free(session);
+    close(client);
+  }
+
+  SSL_CTX* context;
+  int listener;
+  uint16_t port;
+  std::thread thread;
+};
+
+// await blocks until the socket is ready for what the status asks for
+void await(int socket, TLSStatus status) {
+  pollfd descriptor{socket,
+                    static_cast<int16_t>(
+                        status == TLSStatus::WantWrite ? POLLOUT : POLLIN),
+                    0};
+  poll(&descriptor, 1, 5000);
+}
+
+TLSStatus handshake(TLSSession& session, int socket) {
+  TLSStatus status;
+  while ((status = session.Handshake()) == TLSStatus::WantRead ||
+         status == TLSStatus::WantWrite) {
+    await(socket, status);
+  }
+  return status;
+}
+}  // namespace
+
+// Test if plaintext goes through a session verified against a self-signed
+// loopback listener
+TEST(TLSSessionTest, EchoThroughLoopback) {
+  SelfSigned identity;
+  LoopbackListener listener(identity);
+
+  TLSConfig config;
+  config.CAFile = identity.WriteCertificate("tlssession-test-ca.pem");
+  auto context = TLSContext::Create(config);
+  ASSERT_NE(context, nullptr);
+
+  int socket = listener.Connect();
+  {
+    TLSSession session(context, socket, "127.0.0.1");
+    ASSERT_EQ(handshake(session, socket), TLSStatus::Done) << session.Error();
+
+    std::string message(100000, 'k');
+    std::unique_ptr<char[]> data(new char[message.size()]);
+    std::copy(message.begin(), message.end(), data.get());
+    session.Write(std::move(data), message.size());
+    EXPECT_EQ(session.QueuedBytes(), message.size());
+
+    std::size_t written = 0;
+    std::string echoed;
+    while (echoed.size() < message.size()) {
+      TLSStatus status =
+          session.Flush([&written](std::size_t length) { written += length; });
+      ASSERT_NE(status, TLSStatus::Failed) << session.Error();
+
+      status = session.Read([&echoed](const char* data, std::size_t length) {
+        echoed.append(data, length);
+        return true;
+      });
+      ASSERT_EQ(status, TLSStatus::WantRead) << session.Error();
+      if (echoed.size() < message.size()) {
+        await(socket, status);
+      }
+    }
+
+    EXPECT_EQ(written, message.size());
+    EXPECT_EQ(session.QueuedBytes(), 0);
+    EXPECT_EQ(echoed, message);
+    session.Shutdown();
+  }
+  close(socket);
+}
+
+// Test if the handshake fails when the listener is not trusted
+TEST(TLSSessionTest, RejectsUntrustedCertificate) {
+  SelfSigned identity;
+  SelfSigned other;
+  LoopbackListener listener(identity);
+
+  TLSConfig config;
+  config.CAFile = other.WriteCertificate("tlssession-test-other.pem");
+  auto context = TLSContext::Create(config);
+  ASSERT_NE(context, nullptr);
+
+  int socket = listener.Connect();
+  {
+    TLSSession session(context, socket, "127.0.0.1");
+    EXPECT_EQ(handshake(session, socket), TLSStatus::Failed);
+    EXPECT_FALSE(session.Error().empty());
+  }
+  close(socket);
+}
+
+// Test if a missing CA file is reported when creating the context
+TEST(TLSSessionTest, MissingCAFile) {
+  TLSConfig config;
+  config.CAFile = testing::TempDir() + "tlssession-test-missing.pem";
+  EXPECT_EQ(TLSContext::Create(config), nullptr);
+  EXPECT_FALSE(ahiv::kafka::internal::TLSErrorString().empty());
+}
+
+#endif  // AHIV_KAFKA_TLS
@@ -0,0 +1,118 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/parallelexecutor.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::ExecutorOptions;
+using ahiv::kafka::OrderingMode;
+using ahiv::kafka::ParallelExecutor;
+using ahiv::kafka::PartitionBatch;
+using ahiv::kafka::RecordView;
+
+namespace {
+PartitionBatch makeBatch(int32_t partition, int64_t firstOffset,
+                         std::size_t count,
+                         const std::vector<std::string>* keys = nullptr) {
+  PartitionBatch batch;
+  batch.Topic = "test";
+  batch.Partition = partition;
+  batch.FirstOffset = firstOffset;
+  batch.LastOffset = firstOffset + count - 1;
+  for (std::size_t index = 0; index < count; index++) {
+    RecordView record{};
+    record.Offset = firstOffset + index;
+    if (keys != nullptr) {
+      record.Key = (*keys)[index % keys->size()];
+    }
+    batch.Records.emplace_back(record);
+  }
+  return batch;
+}
+}  // namespace
+
+// Test if the records of every partition are processed in offset order and
+// the committable offsets cover all of them
+TEST(ParallelExecutorTest, KeepsPartitionOrder) {
+  std::mutex mutex;
+  std::map<int32_t, std::vector<int64_t>> processed;
+  ParallelExecutor executor(
+      [&](const PartitionBatch& batch, const RecordView& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        processed[batch.Partition].emplace_back(record.Offset);
+      },
+      ExecutorOptions{.Workers = 4});
+
+  for (int64_t offset = 0; offset < 1000; offset += 10) {
+    for (int32_t partition = 0; partition < 8; partition++) {
+      executor.Submit(makeBatch(partition, offset, 10));
+    }
+  }
+  executor.WaitIdle();
+
+  for (int32_t partition = 0; partition < 8; partition++) {
+    ASSERT_EQ(processed[partition].size(), 1000);
+    for (int64_t offset = 0; offset < 1000; offset++) {
+      EXPECT_EQ(processed[partition][offset], offset);
+    }
+    EXPECT_EQ(*executor.Committable("test", partition), 1000);
+  }
+  EXPECT_EQ(executor.TakeCommittable().size(), 8);
+  EXPECT_TRUE(executor.TakeCommittable().empty());
+}
+
+// Test if records with the same key are kept in order when a partition is
+// processed per key
+TEST(ParallelExecutorTest, KeepsKeyOrder) {
+  std::vector<std::string> keys = {"a", "b", "c", "d", "e"};
+  std::mutex mutex;
+  std::map<std::string, std::vector<int64_t>> processed;
+  ParallelExecutor executor(
+      [&](const PartitionBatch& batch, const RecordView& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        processed[std::string(*record.Key)].emplace_back(record.Offset);
+      },
+      ExecutorOptions{.Workers = 4, .Ordering = OrderingMode::Key});
+
+  for (int64_t offset = 0; offset < 500; offset += 50) {
+    executor.Submit(makeBatch(0, offset, 50, &keys));
+  }
+  executor.WaitIdle();
+
+  for (const auto& [key, offsets] : processed) {
+    ASSERT_EQ(offsets.size(), 100);
+    for (std::size_t index = 1; index < offsets.size(); index++) {
+      EXPECT_EQ(offsets[index] - offsets[index - 1], 5);
+    }
+  }
+  EXPECT_EQ(*executor.Committable("test", 0), 500);
+}
+
+// Test if zero key lanes are treated as a single lane instead of dividing by
+// zero
+TEST(ParallelExecutorTest, ClampsZeroKeyLanes) {
+  std::vector<std::string> keys = {"a", "b"};
+  std::mutex mutex;
+  std::vector<int64_t> processed;
+  ParallelExecutor executor(
+      [&](const PartitionBatch& batch, const RecordView& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        processed.emplace_back(record.Offset);
+      },
+      ExecutorOptions{
+          .Workers = 2, .Ordering = OrderingMode::Key, .KeyLanes = 0});
+
+  executor.Submit(makeBatch(0, 0, 10, &keys));
+  executor.WaitIdle();
+
+  ASSERT_EQ(processed.size(), 10);
+  for (int64_t offset = 0; offset < 10; offset++) {
+    EXPECT_EQ(processed[offset], offset);
+  }
+}
@@ -0,0 +1,67 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/partitioner.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+ahiv::kafka::protocol::packet::TopicInformation createTopic(
+    int32_t partitionCount) {
+  ahiv::kafka::protocol::packet::TopicInformation topic;
+  topic.name = "test";
+  topic.partitionInformation.resize(partitionCount);
+  for (int32_t partition = 0; partition < partitionCount; partition++) {
+    topic.partitionInformation[partition].partitionIndex = partition;
+    topic.partitionInformation[partition].leaderId = 1;
+  }
+  return topic;
+}
+}  // namespace
+
+// Test if keyed records are partitioned like the Java client does and bulk
+// partitioning agrees with single records
+TEST(PartitionerTest, Murmur2PartitionsKeys) {
+  auto topic = createTopic(10);
+  ahiv::kafka::Murmur2Partitioner partitioner;
+  // toPositive(-790332482) % 10
+  EXPECT_EQ(partitioner.Partition(topic, "foobar"), 6);
+
+  std::vector<std::string_view> keys({"21", "foobar", "abc", "x", "y"});
+  std::vector<int32_t> partitions;
+  partitioner.PartitionKeys(topic, keys, partitions);
+  ASSERT_EQ(partitions.size(), keys.size());
+  for (std::size_t key = 0; key < keys.size(); key++) {
+    EXPECT_EQ(partitions[key], partitioner.Partition(topic, keys[key]));
+  }
+}
+
+// Test if keyless records stick to one partition until a new batch starts
+TEST(PartitionerTest, StickyKeepsPartitionPerBatch) {
+  auto topic = createTopic(4);
+  topic.partitionInformation[3].leaderId = -1;
+  ahiv::kafka::StickyPartitioner partitioner;
+
+  int32_t sticky = partitioner.Partition(topic, std::nullopt);
+  EXPECT_NE(sticky, 3);
+  for (int record = 0; record < 100; record++) {
+    EXPECT_EQ(partitioner.Partition(topic, std::nullopt), sticky);
+  }
+
+  partitioner.OnNewBatch(topic, sticky);
+  int32_t next = partitioner.Partition(topic, std::nullopt);
+  EXPECT_NE(next, sticky);
+  EXPECT_NE(next, 3);
+
+  // A stale notification for the old partition keeps the new one
+  partitioner.OnNewBatch(topic, sticky);
+  EXPECT_EQ(partitioner.Partition(topic, std::nullopt), next);
+}
+
+// Test if topics without partitions are reported as such
+TEST(PartitionerTest, NoPartitions) {
+  auto topic = createTopic(0);
+  ahiv::kafka::StickyPartitioner partitioner;
+  EXPECT_EQ(partitioner.Partition(topic, std::nullopt), -1);
+  EXPECT_EQ(partitioner.Partition(topic, "key"), -1);
+}
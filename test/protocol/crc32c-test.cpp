@@ -0,0 +1,20 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/protocol/crc32c.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::protocol::Crc32c;
+
+// Test if checksums match the check value of CRC-32C and can be continued
+TEST(Crc32cTest, MatchesCheckValue) {
+  std::string input = "123456789";
+  EXPECT_EQ(Crc32c(input.data(), input.size()), 0xe3069283u);
+  EXPECT_EQ(Crc32c(input.data() + 4, input.size() - 4,
+                   Crc32c(input.data(), 4)),
+            0xe3069283u);
+  EXPECT_EQ(Crc32c(nullptr, 0), 0u);
+}
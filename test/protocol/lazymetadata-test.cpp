@@ -0,0 +1,152 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/protocol/packet/lazymetadata.h"
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::protocol::Buffer;
+using ahiv::kafka::protocol::packet::LazyMetadataResponsePacket;
+using ahiv::kafka::protocol::packet::MetadataResponsePacket;
+
+namespace {
+MetadataResponsePacket createResponse() {
+  MetadataResponsePacket response;
+  response.correlationId = 3;
+  response.brokers.resize(2);
+  response.brokers[0].nodeId = 1;
+  response.brokers[0].host = "broker-1";
+  response.brokers[1].nodeId = 2;
+  response.brokers[1].host = "broker-2";
+  response.clusterId = "cluster";
+  response.controllerId = 2;
+  response.topicInformation.resize(3);
+  for (int topic = 0; topic < 3; topic++) {
+    auto& information = response.topicInformation[topic];
+    information.name = "topic-" + std::to_string(topic);
+    information.partitionInformation.resize(topic + 1);
+    for (int partition = 0; partition <= topic; partition++) {
+      information.partitionInformation[partition].partitionIndex = partition;
+      information.partitionInformation[partition].leaderId = partition % 2 + 1;
+      information.partitionInformation[partition].replicas = {1, 2};
+    }
+  }
+  response.clusterAuthorizedOperations = 42;
+  return response;
+}
+
+Buffer encode(MetadataResponsePacket& response) {
+  response.packetSize = MetadataResponsePacket::Schema::Size(response) - 4;
+  Buffer buffer;
+  buffer.EnsureAllocated(response.packetSize + 4);
+  MetadataResponsePacket::Schema::Encode(response, buffer);
+  return buffer;
+}
+}  // namespace
+
+// Test if the header is decoded eagerly and topics are indexed
+TEST(LazyMetadataTest, IndexesTopics) {
+  auto response = createResponse();
+  auto buffer = encode(response);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(buffer);
+  ASSERT_TRUE(lazy.Valid());
+  EXPECT_EQ(lazy.correlationId, 3);
+  EXPECT_EQ(lazy.brokers.size(), 2);
+  EXPECT_EQ(lazy.brokers[1].host, "broker-2");
+  EXPECT_EQ(lazy.clusterId, "cluster");
+  EXPECT_EQ(lazy.controllerId, 2);
+  EXPECT_EQ(lazy.clusterAuthorizedOperations, 42);
+  ASSERT_EQ(lazy.TopicCount(), 3);
+  EXPECT_EQ(lazy.TopicName(2), "topic-2");
+  EXPECT_EQ(lazy.PartitionCount(2), 3);
+  EXPECT_EQ(lazy.FindTopic("topic-1"), 1);
+  EXPECT_FALSE(lazy.FindTopic("missing").has_value());
+}
+
+// Test if single topics and partitions decode the same as the eager packet
+TEST(LazyMetadataTest, DecodesOnAccess) {
+  auto response = createResponse();
+  auto buffer = encode(response);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(buffer);
+  ASSERT_TRUE(lazy.Valid());
+
+  auto partition = lazy.Partition(2, 1);
+  EXPECT_EQ(partition.partitionIndex, 1);
+  EXPECT_EQ(partition.leaderId, 2);
+  EXPECT_EQ(partition.replicas, std::vector<int32_t>({1, 2}));
+
+  auto topic = lazy.Topic(1);
+  EXPECT_EQ(topic.name, "topic-1");
+  ASSERT_EQ(topic.partitionInformation.size(), 2);
+  EXPECT_EQ(topic.partitionInformation[1].partitionIndex, 1);
+}
+
+// Test if a truncated frame is rejected instead of read past its end
+TEST(LazyMetadataTest, RejectsTruncatedFrame) {
+  auto response = createResponse();
+  auto full = encode(response);
+
+  Buffer truncated;
+  truncated.EnsureAllocated(full.Size() - 10);
+  truncated.WriteData(full.View(0), full.Size() - 10);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(truncated);
+  EXPECT_FALSE(lazy.Valid());
+}
+
+// Test if an element count whose size overflows 32 bit is rejected
+TEST(LazyMetadataTest, RejectsOverflowingArrayCount) {
+  auto response = createResponse();
+  response.topicInformation[0].partitionInformation[0].replicas = {
+      0x7a7a7a7a};
+  auto buffer = encode(response);
+
+  const char marker[] = {0, 0, 0, 1, 0x7a, 0x7a, 0x7a, 0x7a};
+  std::string bytes(buffer.View(0), buffer.Size());
+  auto position = bytes.find(std::string(marker, sizeof(marker)));
+  ASSERT_NE(position, std::string::npos);
+  buffer.Overwrite<int32_t>(position, 0x40000001);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(buffer);
+  EXPECT_FALSE(lazy.Valid());
+}
+
+// Test if a negative element count is rejected
+TEST(LazyMetadataTest, RejectsNegativeArrayCount) {
+  auto response = createResponse();
+  response.topicInformation[0].partitionInformation[0].replicas = {
+      0x7a7a7a7a};
+  auto buffer = encode(response);
+
+  const char marker[] = {0, 0, 0, 1, 0x7a, 0x7a, 0x7a, 0x7a};
+  std::string bytes(buffer.View(0), buffer.Size());
+  auto position = bytes.find(std::string(marker, sizeof(marker)));
+  ASSERT_NE(position, std::string::npos);
+  buffer.Overwrite<int32_t>(position, -2);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(buffer);
+  EXPECT_FALSE(lazy.Valid());
+}
+
+// Test if a huge topic count is rejected instead of reserving memory for it
+TEST(LazyMetadataTest, RejectsHugeTopicCount) {
+  auto response = createResponse();
+  auto buffer = encode(response);
+
+  const char marker[] = {0, 0, 0, 2, 0, 0, 0, 3};
+  std::string bytes(buffer.View(0), buffer.Size());
+  auto position = bytes.find(std::string(marker, sizeof(marker)));
+  ASSERT_NE(position, std::string::npos);
+  buffer.Overwrite<int32_t>(position + 4, 0x7fffffff);
+
+  LazyMetadataResponsePacket lazy;
+  lazy.Read(buffer);
+  EXPECT_FALSE(lazy.Valid());
+}
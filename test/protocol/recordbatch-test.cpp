@@ -0,0 +1,98 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/protocol/packet/recordbatch.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using ahiv::kafka::protocol::Crc32c;
+using ahiv::kafka::protocol::packet::RecordBatchHeader;
+using ahiv::kafka::protocol::packet::RecordBatchReader;
+using ahiv::kafka::protocol::packet::RecordBatchWriter;
+using ahiv::kafka::protocol::packet::RecordReader;
+
+// Test if written batches are read back with their records, header fields
+// and a valid checksum
+TEST(RecordBatchTest, WriterRoundTrip) {
+  RecordBatchWriter writer;
+  writer.Append(std::string_view("key"), std::string_view("value"), 1000);
+  writer.Append(std::nullopt, std::string_view("second"), 1005);
+  writer.Append(std::string_view("last"), std::nullopt, 1002);
+  EXPECT_EQ(writer.RecordCount(), 3);
+
+  RecordBatchHeader header;
+  header.baseOffset = 40;
+  header.producerId = 7;
+  header.producerEpoch = 1;
+  header.baseSequence = 12;
+  std::vector<char> batch = writer.Finish(header);
+  EXPECT_EQ(writer.RecordCount(), 0);
+
+  RecordBatchReader reader(batch.data(), batch.size());
+  auto span = reader.Next();
+  ASSERT_TRUE(span.has_value());
+  EXPECT_EQ(span->size, batch.size());
+  EXPECT_EQ(span->baseOffset, 40);
+  EXPECT_EQ(span->lastOffset, 42);
+  EXPECT_FALSE(reader.Next().has_value());
+
+  uint32_t crc;
+  std::memcpy(&crc, batch.data() + RecordBatchWriter::CrcOffset, 4);
+  EXPECT_EQ(be32toh(crc),
+            Crc32c(batch.data() + RecordReader::AttributesOffset,
+                   batch.size() - RecordReader::AttributesOffset));
+
+  RecordReader records(*span);
+  auto first = records.Next();
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->Offset, 40);
+  EXPECT_EQ(first->Timestamp, 1000);
+  EXPECT_EQ(first->Key, "key");
+  EXPECT_EQ(first->Value, "value");
+
+  auto second = records.Next();
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ(second->Timestamp, 1005);
+  EXPECT_FALSE(second->Key.has_value());
+  EXPECT_EQ(second->Value, "second");
+
+  auto last = records.Next();
+  ASSERT_TRUE(last.has_value());
+  EXPECT_EQ(last->Offset, 42);
+  EXPECT_EQ(last->Key, "last");
+  EXPECT_FALSE(last->Value.has_value());
+  EXPECT_FALSE(records.Next().has_value());
+}
+
+// Test if a restamped batch carries the new producer fields and a valid
+// checksum
+TEST(RecordBatchTest, RestampsProducerFields) {
+  RecordBatchWriter writer;
+  writer.Append(std::nullopt, std::string_view("value"), 1000);
+  RecordBatchHeader header;
+  header.producerId = 7;
+  header.producerEpoch = 1;
+  header.baseSequence = 12;
+  std::vector<char> batch = writer.Finish(header);
+
+  header.producerId = 8;
+  header.producerEpoch = 2;
+  header.baseSequence = 3;
+  RecordBatchWriter::Restamp(batch, header);
+
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(batch.size());
+  buffer.WriteData(batch.data(), batch.size());
+  RecordBatchHeader decoded;
+  RecordBatchHeader::Schema::Decode(decoded, buffer);
+  EXPECT_EQ(decoded.producerId, 8);
+  EXPECT_EQ(decoded.producerEpoch, 2);
+  EXPECT_EQ(decoded.baseSequence, 3);
+  EXPECT_EQ(decoded.recordCount, 1);
+  EXPECT_EQ(decoded.crc,
+            Crc32c(batch.data() + RecordReader::AttributesOffset,
+                   batch.size() - RecordReader::AttributesOffset));
+}
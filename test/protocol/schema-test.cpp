@@ -0,0 +1,176 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/protocol/schema.h"
+
+#include "ahiv/kafka/protocol/packet/fetch.h"
+#include "ahiv/kafka/protocol/packet/initproducerid.h"
+#include "ahiv/kafka/protocol/packet/metadata.h"
+#include "ahiv/kafka/protocol/packet/produce.h"
+#include "gtest/gtest.h"
+
+// Test if the request is written as Metadata v8 with a correct size prefix
+TEST(SchemaTest, MetadataRequestEncoding) {
+  std::vector<std::string> topics({"test"});
+  ahiv::kafka::protocol::packet::MetadataRequestPacket request(topics, true,
+                                                                false, false);
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(request.Size());
+  request.Write(buffer);
+
+  EXPECT_EQ(request.Size(), 27);
+  EXPECT_EQ(buffer.Size(), request.Size());
+  EXPECT_EQ(buffer.Read<int32_t>(), 23);
+  EXPECT_EQ(buffer.Read<int16_t>(), 3);
+  EXPECT_EQ(buffer.Read<int16_t>(), 8);
+  EXPECT_EQ(buffer.Read<int32_t>(), 0);
+  EXPECT_EQ(buffer.Read<int16_t>(), -1);
+  EXPECT_EQ(buffer.Read<int32_t>(), 1);
+  EXPECT_EQ(buffer.ReadString(), "test");
+  EXPECT_TRUE(buffer.ReadBoolean());
+  EXPECT_FALSE(buffer.ReadBoolean());
+  EXPECT_FALSE(buffer.ReadBoolean());
+}
+
+// Test if a response survives an encode and decode round trip and the
+// generated size matches the encoded bytes
+TEST(SchemaTest, MetadataResponseRoundTrip) {
+  using ahiv::kafka::protocol::packet::MetadataResponsePacket;
+  MetadataResponsePacket response;
+  response.correlationId = 7;
+  response.throttledInMilliseconds = 100;
+  response.brokers.resize(1);
+  response.brokers[0].nodeId = 1;
+  response.brokers[0].host = "localhost";
+  response.brokers[0].port = 9092;
+  response.clusterId = "cluster";
+  response.controllerId = 1;
+  response.topicInformation.resize(1);
+  response.topicInformation[0].name = "test";
+  response.topicInformation[0].partitionInformation.resize(2);
+  response.topicInformation[0].partitionInformation[1].partitionIndex = 1;
+  response.topicInformation[0].partitionInformation[1].replicas = {1, 2, 3};
+
+  std::size_t size = MetadataResponsePacket::Schema::Size(response);
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(size);
+  MetadataResponsePacket::Schema::Encode(response, buffer);
+  EXPECT_EQ(buffer.Size(), size);
+
+  MetadataResponsePacket decoded;
+  decoded.Read(buffer);
+  EXPECT_EQ(decoded.correlationId, 7);
+  EXPECT_EQ(decoded.throttledInMilliseconds, 100);
+  ASSERT_EQ(decoded.brokers.size(), 1);
+  EXPECT_EQ(decoded.brokers[0].host, "localhost");
+  EXPECT_EQ(decoded.brokers[0].port, 9092);
+  EXPECT_EQ(decoded.clusterId, "cluster");
+  ASSERT_EQ(decoded.topicInformation.size(), 1);
+  ASSERT_EQ(decoded.topicInformation[0].partitionInformation.size(), 2);
+  EXPECT_EQ(decoded.topicInformation[0].partitionInformation[1].replicas,
+            std::vector<int32_t>({1, 2, 3}));
+}
+
+// Test if a missing nullable string is written with length -1
+TEST(SchemaTest, NullableStringEncoding) {
+  ahiv::kafka::protocol::packet::InitProducerIdRequestPacket request;
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(request.Size());
+  request.Write(buffer);
+
+  EXPECT_EQ(request.Size(), 20);
+  EXPECT_EQ(buffer.Read<int32_t>(), 16);
+  EXPECT_EQ(buffer.Read<int16_t>(), 22);
+  EXPECT_EQ(buffer.Read<int16_t>(), 1);
+  EXPECT_EQ(buffer.Read<int32_t>(), 0);
+  EXPECT_EQ(buffer.Read<int16_t>(), -1);
+  EXPECT_EQ(buffer.Read<int16_t>(), -1);
+  EXPECT_EQ(buffer.Read<int32_t>(), -1);
+}
+
+// Test if a fetch response with a preferred read replica and records survives
+// encoding and decoding, the decoded records point into the frame
+TEST(SchemaTest, FetchResponseRoundTrip) {
+  const char records[] = {'a', 'b', 'c'};
+  ahiv::kafka::protocol::packet::FetchPartitionResponse partition;
+  partition.partitionIndex = 2;
+  partition.highWatermark = 42;
+  partition.preferredReadReplica = 3;
+  partition.records = ahiv::kafka::protocol::schema::BytesView(records, 3);
+
+  ahiv::kafka::protocol::packet::FetchResponsePacket response;
+  response.correlationId = 9;
+  response.topics.emplace_back(
+      ahiv::kafka::protocol::packet::FetchTopicResponse{"test", {partition}});
+
+  using Schema = ahiv::kafka::protocol::packet::FetchResponsePacket::Schema;
+  std::size_t size = Schema::Size(response);
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(size);
+  Schema::Encode(response, buffer);
+  const char* frame = buffer.View(0);
+
+  ahiv::kafka::protocol::packet::FetchResponsePacket read;
+  read.Read(buffer);
+  auto decoded = std::move(read);
+  ASSERT_EQ(decoded.topics.size(), 1);
+  ASSERT_EQ(decoded.topics[0].partitions.size(), 1);
+  EXPECT_EQ(decoded.topics[0].partitions[0].preferredReadReplica, 3);
+  EXPECT_EQ(decoded.topics[0].partitions[0].highWatermark, 42);
+
+  const auto& decodedRecords = decoded.topics[0].partitions[0].records;
+  ASSERT_EQ(decodedRecords.size(), 3);
+  EXPECT_EQ(decodedRecords.data(), frame + size - 3);
+  EXPECT_EQ(std::string(decodedRecords.data(), 3), "abc");
+}
+
+// Test if byte arrays whose length points beyond the end of the buffer are
+// decoded as empty
+TEST(SchemaTest, RejectsTruncatedBytes) {
+  using ahiv::kafka::protocol::schema::BytesView;
+  using ahiv::kafka::protocol::schema::Codec;
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(7);
+  Codec<int32_t>::Encode(10, buffer);
+  buffer.WriteData("abc", 3);
+
+  std::vector<char> copied = {'x'};
+  Codec<std::vector<char>>::Decode(copied, buffer);
+  EXPECT_TRUE(copied.empty());
+  EXPECT_EQ(buffer.ReadPosition(), buffer.Size());
+
+  buffer.ResetReadPosition();
+  BytesView view(buffer.View(0), 1);
+  Codec<BytesView>::Decode(view, buffer);
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(buffer.ReadPosition(), buffer.Size());
+}
+
+// Test if a produce request is written as Produce v7 and decodes back into
+// the same request, as the loopback broker of the perf test reads it
+TEST(SchemaTest, ProduceRequestRoundTrip) {
+  using ahiv::kafka::protocol::packet::ProduceRequestPacket;
+  ProduceRequestPacket request(1, 1500);
+  request.topics.emplace_back(ahiv::kafka::protocol::packet::ProduceTopicData{
+      "test", {{3, {'x', 'y'}}}});
+
+  ahiv::kafka::protocol::Buffer buffer;
+  buffer.EnsureAllocated(request.Size());
+  request.Write(buffer);
+  EXPECT_EQ(buffer.Size(), request.Size());
+
+  ProduceRequestPacket decoded(0, 0);
+  ProduceRequestPacket::Schema::Decode(decoded, buffer);
+  EXPECT_EQ(decoded.packetSize, request.Size() - 4);
+  EXPECT_EQ(decoded.apiKey, 0);
+  EXPECT_EQ(decoded.apiVersion, 7);
+  EXPECT_FALSE(decoded.transactionalId.has_value());
+  EXPECT_EQ(decoded.acks, 1);
+  EXPECT_EQ(decoded.timeoutInMilliseconds, 1500);
+  ASSERT_EQ(decoded.topics.size(), 1);
+  EXPECT_EQ(decoded.topics[0].name, "test");
+  ASSERT_EQ(decoded.topics[0].partitions.size(), 1);
+  EXPECT_EQ(decoded.topics[0].partitions[0].partitionIndex, 3);
+  EXPECT_EQ(decoded.topics[0].partitions[0].records,
+            std::vector<char>({'x', 'y'}));
+}
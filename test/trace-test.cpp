@@ -0,0 +1,36 @@
+// Copyright 2019 Ahiv Authors. All rights reserved. Use of this source  code
+// is governed by a MIT-style license that can be found in the LICENSE file.
+
+#include "ahiv/kafka/trace.h"
+
+#include "gtest/gtest.h"
+
+// Test if the ring buffer keeps hits in order with their arguments
+TEST(TraceTest, RingBufferRecordsHits) {
+  using Tracer = ahiv::kafka::trace::RingBufferTracer<4>;
+  Tracer::Reset();
+  Tracer::Hit(ahiv::kafka::trace::Stage::Enqueue, 1, 3);
+  Tracer::Hit(ahiv::kafka::trace::Stage::Callback, 1, 3);
+
+  auto records = Tracer::Records();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].Stage, ahiv::kafka::trace::Stage::Enqueue);
+  EXPECT_EQ(records[0].CorrelationId, 1);
+  EXPECT_EQ(records[0].ApiKey, 3);
+  EXPECT_EQ(records[1].Stage, ahiv::kafka::trace::Stage::Callback);
+  EXPECT_LE(records[0].Timestamp, records[1].Timestamp);
+}
+
+// Test if the ring buffer only keeps the newest hits once it wrapped
+TEST(TraceTest, RingBufferOverwritesOldestHits) {
+  using Tracer = ahiv::kafka::trace::RingBufferTracer<4>;
+  Tracer::Reset();
+  for (int32_t correlationId = 0; correlationId < 6; correlationId++) {
+    Tracer::Hit(ahiv::kafka::trace::Stage::Decode, correlationId, 0);
+  }
+
+  auto records = Tracer::Records();
+  ASSERT_EQ(records.size(), 4);
+  EXPECT_EQ(records.front().CorrelationId, 2);
+  EXPECT_EQ(records.back().CorrelationId, 5);
+}